@@ -28,6 +28,7 @@ For more information, please refer to <http://unlicense.org>
 #include <plcore/pl.h>
 #include <plcore/pl_console.h>
 #include <plcore/pl_image.h>
+#include <plcore/pl_package.h>
 
 /**
  * Command line utility to interface with the platform lib.
@@ -54,14 +55,7 @@ static void ConvertImage( const char *path, const char *destination ) {
 	PlDestroyImage( image );
 }
 
-static void ConvertImageCallback( const char *path, void *userData ) {
-	char *outDir = ( char * ) userData;
-
-	if ( !PlCreateDirectory( outDir ) ) {
-		Error( "Error: %s\n", PlGetError() );
-		return;
-	}
-
+static void ConvertImageToDirectory( const char *path, const char *outDir ) {
 	const char *fileName = PlGetFileName( path );
 	if ( fileName == NULL ) {
 		Error( "Error: %s\n", PlGetError() );
@@ -99,9 +93,233 @@ static void Cmd_IMGBulkConvert( unsigned int argc, char **argv ) {
 		snprintf( outDir, sizeof( outDir ), "out/" );
 	}
 
-	PlScanDirectory( argv[ 1 ], argv[ 2 ], ConvertImageCallback, false, outDir );
+	if ( !PlCreateDirectory( outDir ) ) {
+		Error( "Error: %s\n", PlGetError() );
+		return;
+	}
+
+	unsigned int numEntries;
+	PLDirectoryEntry *entries = PlScanDirectoryEntries( argv[ 1 ], argv[ 2 ], false, &numEntries );
+	if ( entries == NULL ) {
+		Error( "Error: %s\n", PlGetError() );
+		return;
+	}
+
+	size_t totalSize = 0;
+	for ( unsigned int i = 0; i < numEntries; ++i ) {
+		ConvertImageToDirectory( entries[ i ].path, outDir );
+		totalSize += entries[ i ].size;
+	}
+
+	PlDestroyDirectoryEntries( entries );
+
+	printf( "Done! Converted %u files (%.2fMiB)\n", numEntries, PlBytesToMebibytes( totalSize ) );
+}
+
+/**
+ * Times loading the given package with and without the
+ * read-ahead buffer used for uncached files.
+ */
+static double TimePackageLoad( const char *path, unsigned int iterations, const char *bufferSize ) {
+	PlSetConsoleVariableByName( "fs.bufferSize", bufferSize );
+
+	double start = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < iterations; ++i ) {
+		PLPackage *package = PlLoadPackage( path );
+		if ( package == NULL ) {
+			printf( "Failed to load \"%s\"! (%s)\n", path, PlGetError() );
+			return -1.0;
+		}
+
+		PlDestroyPackage( package );
+	}
+
+	return ( ( PlGetCurrentSeconds() - start ) / iterations ) * 1000.0;
+}
+
+static void Cmd_PKGBench( unsigned int argc, char **argv ) {
+	if ( argc < 2 ) {
+		return;
+	}
+
+	unsigned int iterations = 100;
+	if ( argc >= 3 ) {
+		iterations = ( unsigned int ) strtoul( argv[ 2 ], NULL, 10 );
+		if ( iterations == 0 ) {
+			iterations = 1;
+		}
+	}
+
+	char bufferSize[ PL_VAR_VALUE_LENGTH ];
+	snprintf( bufferSize, sizeof( bufferSize ), "%s", PlGetConsoleVariableValue( "fs.bufferSize" ) );
+
+	double unbuffered = TimePackageLoad( argv[ 1 ], iterations, "0" );
+	double buffered = TimePackageLoad( argv[ 1 ], iterations, bufferSize );
+	PlSetConsoleVariableByName( "fs.bufferSize", bufferSize );
+	if ( unbuffered < 0.0 || buffered < 0.0 ) {
+		return;
+	}
+
+	printf( "%u iterations\n"
+	        " unbuffered:  %.3fms\n"
+	        " buffered:    %.3fms (%s bytes)\n",
+	        iterations, unbuffered, buffered, bufferSize );
+}
+
+/**
+ * Checks every entry in the given packages against its checksum.
+ */
+static void Cmd_PKGVerify( unsigned int argc, char **argv ) {
+	for ( unsigned int i = 1; i < argc; ++i ) {
+		PLPackage *package = PlLoadPackage( argv[ i ] );
+		if ( package == NULL ) {
+			printf( "Failed to load \"%s\"! (%s)\n", argv[ i ], PlGetError() );
+			continue;
+		}
+
+		size_t totalSize = 0;
+		for ( unsigned int j = 0; j < package->table_size; ++j ) {
+			totalSize += package->table[ j ].fileSize;
+		}
+
+		bool *failed = pl_calloc( package->table_size, sizeof( bool ) );
+		unsigned int numChecked;
+		double start = PlGetCurrentSeconds();
+		unsigned int numFailed = PlVerifyPackage( package, failed, &numChecked );
+		double elapsed = PlGetCurrentSeconds() - start;
+
+		for ( unsigned int j = 0; j < package->table_size; ++j ) {
+			if ( failed[ j ] ) {
+				printf( " %s failed!\n", PlGetPackageFileName( package, j ) );
+			}
+		}
+
+		printf( "%s: %u/%u entries checked, %u failed (%.2fMiB in %.3fms)\n", argv[ i ], numChecked, package->table_size,
+		        numFailed, PlBytesToMebibytes( totalSize ), elapsed * 1000.0 );
+
+		pl_free( failed );
+		PlDestroyPackage( package );
+	}
+}
+
+/**
+ * Writes out a WAD with the given number of tiny lumps, for
+ * seeing how package loading holds up with large tables.
+ */
+static void Cmd_PKGGenerateWad( unsigned int argc, char **argv ) {
+	if ( argc < 2 ) {
+		return;
+	}
+
+	uint32_t numLumps = 50000;
+	if ( argc >= 3 ) {
+		numLumps = ( uint32_t ) strtoul( argv[ 2 ], NULL, 10 );
+	}
+
+	/* each lump gets four bytes of its own, followed by the table */
+	uint32_t tableOffset = 12 + numLumps * 4;
+	size_t size = tableOffset + ( size_t ) numLumps * 16;
+	uint8_t *buf = pl_calloc( size, 1 );
+	memcpy( buf, "PWAD", 4 );
+	memcpy( &buf[ 4 ], &numLumps, 4 );
+	memcpy( &buf[ 8 ], &tableOffset, 4 );
+	for ( uint32_t i = 0; i < numLumps; ++i ) {
+		uint32_t offset = 12 + i * 4, lumpSize = 4;
+		memcpy( &buf[ offset ], &i, 4 );
+
+		uint8_t *index = &buf[ tableOffset + i * 16 ];
+		memcpy( index, &offset, 4 );
+		memcpy( index + 4, &lumpSize, 4 );
+		snprintf( ( char * ) index + 8, 8, "%07X", i );
+	}
+
+	if ( !PlWriteFile( argv[ 1 ], buf, size ) ) {
+		printf( "Failed to write \"%s\"! (%s)\n", argv[ 1 ], PlGetError() );
+	} else {
+		printf( "Wrote %u lumps to \"%s\"\n", numLumps, argv[ 1 ] );
+	}
+
+	pl_free( buf );
+}
+
+/**
+ * Writes the given package back out in our own format.
+ */
+static void Cmd_PKGRepack( unsigned int argc, char **argv ) {
+	if ( argc < 3 ) {
+		return;
+	}
+
+	PLCompressionType compressionType = PL_COMPRESSION_NONE;
+	if ( argc >= 4 && pl_strcasecmp( argv[ 3 ], "zlib" ) == 0 ) {
+		compressionType = PL_COMPRESSION_ZLIB;
+	}
+
+	PLPackage *package = PlLoadPackage( argv[ 1 ] );
+	if ( package == NULL ) {
+		printf( "Failed to load \"%s\"! (%s)\n", argv[ 1 ], PlGetError() );
+		return;
+	}
+
+	if ( !PlWritePackage( package, argv[ 2 ], compressionType ) ) {
+		printf( "Failed to write \"%s\"! (%s)\n", argv[ 2 ], PlGetError() );
+	} else {
+		printf( "Done! Wrote %u files to \"%s\"\n", PlGetPackageTableSize( package ), argv[ 2 ] );
+	}
+
+	PlDestroyPackage( package );
+}
+
+/**
+ * Times opening everything in the given location, as a stand-in for an
+ * application starting up. If a trace is given it's replayed beforehand,
+ * or recorded if it doesn't exist yet. Drop the system's file cache
+ * before each run to compare cold starts.
+ */
+static void Cmd_MountBench( unsigned int argc, char **argv ) {
+	if ( argc < 2 ) {
+		return;
+	}
+
+	PLFileSystemMount *mount = PlMountLocation( argv[ 1 ] );
+	if ( mount == NULL ) {
+		printf( "Failed to mount \"%s\"! (%s)\n", argv[ 1 ], PlGetError() );
+		return;
+	}
+
+	const char *trace = ( argc >= 3 ) ? argv[ 2 ] : NULL;
+	bool isReplay = ( trace != NULL && PlLocalFileExists( trace ) );
+
+	double start = PlGetCurrentSeconds();
+	if ( isReplay ) {
+		if ( !PlReplayAccessTrace( trace ) ) {
+			printf( "Failed to replay \"%s\"! (%s)\n", trace, PlGetError() );
+		}
+	} else if ( trace != NULL ) {
+		if ( !PlStartAccessTrace( trace ) ) {
+			printf( "Failed to record \"%s\"! (%s)\n", trace, PlGetError() );
+		}
+	}
+
+	unsigned int numEntries = 0;
+	size_t totalSize = 0;
+	PLDirectoryEntry *entries = PlScanDirectoryEntries( "", NULL, true, &numEntries );
+	for ( unsigned int i = 0; i < numEntries; ++i ) {
+		PLFile *file = PlOpenFile( entries[ i ].path, true );
+		if ( file != NULL ) {
+			totalSize += PlGetFileSize( file );
+			PlCloseFile( file );
+		}
+	}
+
+	double elapsed = ( PlGetCurrentSeconds() - start ) * 1000.0;
+
+	PlStopAccessTrace();
+	PlDestroyDirectoryEntries( entries );
+	PlClearMountedLocation( mount );
 
-	printf( "Done!\n" );
+	printf( "Opened %u files (%.2fMiB) in %.3fms%s\n", numEntries, PlBytesToMebibytes( totalSize ), elapsed,
+	        isReplay ? ", replaying trace" : ( trace != NULL ? ", recording trace" : "" ) );
 }
 
 static bool isRunning = true;
@@ -124,6 +342,7 @@ int main( int argc, char **argv ) {
 	PlInitializeSubSystems( PL_SUBSYSTEM_IO );
 
 	PlRegisterStandardImageLoaders( PL_IMAGE_FILEFORMAT_ALL );
+	PlRegisterStandardPackageLoaders();
 
 	PlRegisterPlugins( "./" );
 
@@ -136,6 +355,21 @@ int main( int argc, char **argv ) {
 	PlRegisterConsoleCommand( "img_bulkconvert", Cmd_IMGBulkConvert,
 	                          "Bulk convert images in the given directory.\n"
 	                          "Usage: img_bulkconvert ./path bmp [./outpath]" );
+	PlRegisterConsoleCommand( "pkg_bench", Cmd_PKGBench,
+	                          "Time parsing the given package's table, with and without read buffering.\n"
+	                          "Usage: pkg_bench ./package.wad [iterations]" );
+	PlRegisterConsoleCommand( "pkg_verify", Cmd_PKGVerify,
+	                          "Check every entry in the given packages against its checksum.\n"
+	                          "Usage: pkg_verify ./package.pkg [./another.pkg]" );
+	PlRegisterConsoleCommand( "pkg_genwad", Cmd_PKGGenerateWad,
+	                          "Write out a WAD with the given number of lumps, for use with pkg_bench.\n"
+	                          "Usage: pkg_genwad ./large.wad [50000]" );
+	PlRegisterConsoleCommand( "pkg_repack", Cmd_PKGRepack,
+	                          "Write out the given package in the native format, optionally compressing each file.\n"
+	                          "Usage: pkg_repack ./package.wad ./out.pkg [zlib]" );
+	PlRegisterConsoleCommand( "mount_bench", Cmd_MountBench,
+	                          "Time opening everything in the given location, replaying the trace if it exists or recording it if not.\n"
+	                          "Usage: mount_bench ./package.wad [./startup.trace]" );
 
 	PlInitializePlugins();
 
@@ -43,6 +43,22 @@ For more information, please refer to <http://unlicense.org>
 
 #define _pl_fclose(a)  fclose((a)); (a) = NULL
 
+/* mapped files are reference counted, so views into
+ * them can outlive the handle they were created from */
+typedef struct FSMapping {
+	void			*base;
+	size_t			size;
+	volatile unsigned int	refCount; /* views can be created from any thread */
+	bool			isAllocated; /* heap memory rather than a mapped file */
+	bool			isBorrowed; /* someone else's memory, so it's left alone */
+} FSMapping;
+
+/* compressed entries above this size are inflated as they're read,
+ * rather than all in one go */
+#define FS_INFLATE_STREAM_THRESHOLD ( 256 * 1024 )
+
+typedef struct FSInflateStream FSInflateStream;
+
 typedef struct PLFile {
 	char		path[ PL_SYSTEM_MAX_PATH ];
 	uint8_t		*data;
@@ -50,4 +66,84 @@ typedef struct PLFile {
 	size_t		size;
 	time_t		timeStamp;
 	void		*fptr;
+	FSMapping	*mapping;	/* if set, data points into the mapping rather than a copy */
+
+	/* uncached files read ahead into their own buffer, so
+	 * small reads don't each have to go to the disk */
+	size_t		offset;
+	uint8_t		*buffer;
+	size_t		bufferSize;
+	size_t		bufferOffset;	/* offset of the buffer within the file */
+	size_t		bufferLength;
+
+	FSInflateStream	*stream; /* if set, reads are inflated from a compressed source */
+
+	bool		isRegistered; /* opened from PlCreateFileFromMemory, and reachable by its path until closed */
 } PLFile;
+
+PLFile *PlCreateFileView( PLFile *parent, const char *path, size_t offset, size_t size );
+PLFile *PlCreateBufferFile( const char *path, uint8_t *data, size_t size );
+PLFile *PlCreateInflateStream( PLFile *source, const char *path, size_t offset, size_t compressedSize, size_t size );
+size_t PlReadFileAt( PLFile *ptr, void *dest, size_t size, size_t offset );
+void PlPrefetchFileRange( PLFile *ptr, size_t offset, size_t size );
+
+/* files created over memory can be opened by path, see pl_filesystem_memory.c */
+
+#define FS_MEMORY_HINT "mem://"
+#define FS_MEMORY_HINT_LENGTH ( sizeof( FS_MEMORY_HINT ) - 1 )
+
+PLFile *PlOpenMemoryFile( const char *path );
+bool PlStatMemoryFile( const char *path, PLFileInfo *info );
+void PlUnregisterMemoryFile( PLFile *ptr );
+void PlClearMemoryFiles( void );
+
+/* files can be opened on the worker pool, see pl_filesystem_async.c */
+
+void PlInitFileRequests( void );
+
+/* paths that weren't found in any mount are remembered, see pl_filesystem_miss.c */
+
+typedef struct PLMissCacheStats {
+	unsigned int numEntries, maxEntries;
+	unsigned int hits, misses, evictions, flushes;
+} PLMissCacheStats;
+
+void PlSetMissCacheSize( unsigned int size );
+bool PlIsCachedMiss( const char *path );
+void PlCacheMiss( const char *path );
+void PlFlushMissCache( void );
+void PlGetMissCacheStats( PLMissCacheStats *stats );
+
+/* opens can be recorded and then replayed, see pl_filesystem_trace.c */
+
+void PlTraceFileAccess( const char *path, const char *location, size_t offset, size_t size );
+void PlPrefetchMountedFile( const char *path );
+void PlCancelAccessTraceReplay( void );
+
+/* package and image loaders are picked by signature, or failing
+ * that by extension, see pl_filesystem_format.c */
+
+typedef void ( *FSLoadFunction )( void );
+
+typedef struct FSFormatLoader {
+	const char			*extension;
+	PLFileSignature			signature;
+	bool				hasSignature;
+	PLFileProbeFunction		Probe;
+	FSLoadFunction			LoadFunction;
+	struct FSFormatLoader		*next;			/* in the order they were registered */
+	struct FSFormatLoader		*nextWithExtension;
+} FSFormatLoader;
+
+typedef struct FSFormatRegistry {
+	FSFormatLoader		*first, *last;
+	struct PLHashTable	*extensions;	/* first loader registered for each extension */
+	unsigned int		numLoaders;
+	unsigned int		numIdentified;	/* loaders with a signature or probe */
+} FSFormatRegistry;
+
+#define FS_MAX_FORMAT_LOADERS 16 /* most that will be tried for any one file */
+
+bool PlRegisterFormatLoader( FSFormatRegistry *registry, const char *extension, const PLFileSignature *signature, PLFileProbeFunction Probe, FSLoadFunction LoadFunction );
+void PlClearFormatLoaders( FSFormatRegistry *registry );
+unsigned int PlGetFormatLoaders( const FSFormatRegistry *registry, const char *path, const FSFormatLoader **loaders, unsigned int maxLoaders );
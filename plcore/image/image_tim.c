@@ -129,7 +129,7 @@ static bool TIM_ReadFile( PLFile *fin, PLImage *out ) {
 			goto ERR_CLEANUP;
 		}
 
-		if ( PlReadFile( fin, palette, sizeof( uint16_t ), palette_size ) != palette_size ) {
+		if ( PlReadInt16Array( fin, ( int16_t * ) palette, palette_size, false ) != palette_size ) {
 			goto UNEXPECTED_EOF;
 		}
 	}
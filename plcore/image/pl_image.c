@@ -60,49 +60,52 @@ static PLImage *LoadStbImage( const char *path ) {
 
 #endif
 
-#define MAX_IMAGE_LOADERS 4096
+typedef PLImage *( *PLImageLoadFunction )( const char *path );
 
-typedef struct PLImageLoader {
-	const char *extension;
-	PLImage *( *LoadImage )( const char *path );
-} PLImageLoader;
-
-static PLImageLoader imageLoaders[ MAX_IMAGE_LOADERS ];
-static unsigned int numImageLoaders = 0;
+static FSFormatRegistry imageLoaders;
 
 void PlRegisterImageLoader( const char *extension, PLImage *( *LoadImage )( const char *path ) ) {
-	if ( numImageLoaders >= MAX_IMAGE_LOADERS ) {
-		PlReportBasicError( PL_RESULT_MEMORY_EOA );
-		return;
-	}
+	PlRegisterImageSignature( extension, NULL, NULL, LoadImage );
+}
 
-	imageLoaders[ numImageLoaders ].extension = extension;
-	imageLoaders[ numImageLoaders ].LoadImage = LoadImage;
+/**
+ * Registers a loader that can recognise its images by their contents,
+ * so they're loaded regardless of what they're named. Either the
+ * signature or the probe may be NULL.
+ */
+void PlRegisterImageSignature( const char *extension, const PLFileSignature *signature, PLFileProbeFunction Probe, PLImage *( *LoadImage )( const char *path ) ) {
+	PlRegisterFormatLoader( &imageLoaders, extension, signature, Probe, ( FSLoadFunction ) LoadImage );
+}
 
-	numImageLoaders++;
+static bool ProbePnmImage( const uint8_t *header, size_t size ) {
+	/* binary greyscale or rgb, which is all stb handles */
+	return ( size > 1 && ( header[ 1 ] == '5' || header[ 1 ] == '6' ) );
 }
 
 void PlRegisterStandardImageLoaders( unsigned int flags ) {
 	typedef struct SImageLoader {
 		unsigned int flag;
 		const char *extension;
-		PLImage *( *LoadFunction )( const char *path );
+		PLFileSignature signature;
+		PLFileProbeFunction Probe;
+		PLImageLoadFunction LoadFunction;
 	} SImageLoader;
 
 	static const SImageLoader loaderList[] = {
-	        { PL_IMAGE_FILEFORMAT_TGA, "tga", LoadStbImage },
-	        { PL_IMAGE_FILEFORMAT_PNG, "png", LoadStbImage },
-	        { PL_IMAGE_FILEFORMAT_JPG, "jpg", LoadStbImage },
-	        { PL_IMAGE_FILEFORMAT_BMP, "bmp", LoadStbImage },
-	        { PL_IMAGE_FILEFORMAT_PSD, "psd", LoadStbImage },
-	        { PL_IMAGE_FILEFORMAT_GIF, "gif", LoadStbImage },
-	        { PL_IMAGE_FILEFORMAT_HDR, "hdr", LoadStbImage },
-	        { PL_IMAGE_FILEFORMAT_PIC, "pic", LoadStbImage },
-	        { PL_IMAGE_FILEFORMAT_PNM, "pnm", LoadStbImage },
-	        { PL_IMAGE_FILEFORMAT_FTX, "ftx", PlLoadFtxImage },
-	        { PL_IMAGE_FILEFORMAT_3DF, "3df", PlLoad3dfImage },
-	        { PL_IMAGE_FILEFORMAT_TIM, "tim", PlLoadTimImage },
-	        { PL_IMAGE_FILEFORMAT_SWL, "swl", PlLoadSwlImage },
+	        { PL_IMAGE_FILEFORMAT_TGA, "tga", { 0 }, NULL, LoadStbImage },
+	        { PL_IMAGE_FILEFORMAT_PNG, "png", { 0, 8, "\x89PNG\r\n\x1a\n" }, NULL, LoadStbImage },
+	        { PL_IMAGE_FILEFORMAT_JPG, "jpg", { 0, 3, "\xff\xd8\xff" }, NULL, LoadStbImage },
+	        { PL_IMAGE_FILEFORMAT_BMP, "bmp", { 0, 2, "BM" }, NULL, LoadStbImage },
+	        { PL_IMAGE_FILEFORMAT_PSD, "psd", { 0, 4, "8BPS" }, NULL, LoadStbImage },
+	        { PL_IMAGE_FILEFORMAT_GIF, "gif", { 0, 4, "GIF8" }, NULL, LoadStbImage },
+	        { PL_IMAGE_FILEFORMAT_HDR, "hdr", { 0, 2, "#?" }, NULL, LoadStbImage },
+	        { PL_IMAGE_FILEFORMAT_PIC, "pic", { 0, 4, "\x53\x80\xf6\x34" }, NULL, LoadStbImage },
+	        { PL_IMAGE_FILEFORMAT_PNM, "pnm", { 0, 1, "P" }, ProbePnmImage, LoadStbImage },
+	        { PL_IMAGE_FILEFORMAT_FTX, "ftx", { 0 }, NULL, PlLoadFtxImage },
+	        { PL_IMAGE_FILEFORMAT_3DF, "3df", { 0, 4, "3df " }, NULL, PlLoad3dfImage },
+	        /* the low bits of the flags hold the type and whether there's a palette */
+	        { PL_IMAGE_FILEFORMAT_TIM, "tim", { 0, 8, { 0x10, 0, 0, 0, 0, 0, 0, 0 }, { 0xff, 0xff, 0xff, 0xff, 0xf0, 0xff, 0xff, 0xff } }, NULL, PlLoadTimImage },
+	        { PL_IMAGE_FILEFORMAT_SWL, "swl", { 0 }, NULL, PlLoadSwlImage },
 	};
 
 	for ( unsigned int i = 0; i < plArrayElements( loaderList ); ++i ) {
@@ -110,12 +113,13 @@ void PlRegisterStandardImageLoaders( unsigned int flags ) {
 			continue;
 		}
 
-		PlRegisterImageLoader( loaderList[ i ].extension, loaderList[ i ].LoadFunction );
+		const PLFileSignature *signature = ( loaderList[ i ].signature.length > 0 ) ? &loaderList[ i ].signature : NULL;
+		PlRegisterImageSignature( loaderList[ i ].extension, signature, loaderList[ i ].Probe, loaderList[ i ].LoadFunction );
 	}
 }
 
 void PlClearImageLoaders( void ) {
-	numImageLoaders = 0;
+	PlClearFormatLoaders( &imageLoaders );
 }
 
 PLImage *PlCreateImage( uint8_t *buf, unsigned int w, unsigned int h, PLColourFormat col, PLImageFormat dat ) {
@@ -165,18 +169,19 @@ PLImage *PlLoadImage( const char *path ) {
 		return NULL;
 	}
 
-	const char *extension = PlGetFileExtension( path );
-	for ( unsigned int i = 0; i < numImageLoaders; ++i ) {
-		if ( pl_strcasecmp( extension, imageLoaders[ i ].extension ) == 0 ) {
-			PLImage *image = imageLoaders[ i ].LoadImage( path );
-			if ( image != NULL ) {
-				strncpy( image->path, path, sizeof( image->path ) );
-				return image;
-			}
+	const FSFormatLoader *loaders[ FS_MAX_FORMAT_LOADERS ];
+	unsigned int numLoaders = PlGetFormatLoaders( &imageLoaders, path, loaders, plArrayElements( loaders ) );
+	for ( unsigned int i = 0; i < numLoaders; ++i ) {
+		PLImage *image = ( ( PLImageLoadFunction ) loaders[ i ]->LoadFunction )( path );
+		if ( image != NULL ) {
+			strncpy( image->path, path, sizeof( image->path ) );
+			return image;
 		}
 	}
 
-	PlReportBasicError( PL_RESULT_UNSUPPORTED );
+	if ( numLoaders == 0 ) {
+		PlReportBasicError( PL_RESULT_UNSUPPORTED );
+	}
 
 	return NULL;
 }
@@ -537,12 +542,15 @@ bool PlFlipImageVertical( PLImage *image ) {
  * the formats supported by the image loader.
  */
 const char **PlGetSupportedImageFormats( unsigned int *numElements ) {
-	static const char *imageFormats[ MAX_IMAGE_LOADERS ];
-	for ( unsigned int i = 0; i < numImageLoaders; ++i ) {
-		imageFormats[ i ] = imageLoaders[ i ].extension;
+	static const char **imageFormats = NULL;
+	imageFormats = pl_realloc( imageFormats, sizeof( char * ) * ( imageLoaders.numLoaders + 1 ) );
+
+	unsigned int i = 0;
+	for ( const FSFormatLoader *loader = imageLoaders.first; loader != NULL; loader = loader->next ) {
+		imageFormats[ i++ ] = loader->extension;
 	}
 
-	*numElements = numImageLoaders;
+	*numElements = i;
 
 	return imageFormats;
 }
@@ -201,6 +201,7 @@ bool PlIsSubSystemActive( unsigned int subsystem );
 #include <plcore/pl_memory.h>
 
 PL_EXTERN const char *PlGetFormattedTime( void );
+PL_EXTERN double PlGetCurrentSeconds( void );
 PL_EXTERN time_t PlStringToTime( const char *ts );
 
 //////////////////////////////////////////////////////////////////
@@ -30,8 +30,63 @@ typedef enum PLFileSeek {
 #endif
 } PLFileSeek;
 
+/* hints passed on to the system for mapped files */
+typedef enum PLFileAccessHint {
+	PL_FILE_ACCESS_NORMAL,
+	PL_FILE_ACCESS_SEQUENTIAL,
+	PL_FILE_ACCESS_RANDOM,
+} PLFileAccessHint;
+
+/* what becomes of the buffer given to PlCreateFileFromMemory */
+typedef enum PLFileMemoryOwnership {
+	PL_FILE_MEMORY_BORROW, /* left with the caller, who keeps it around until the file and anything opened from it is closed */
+	PL_FILE_MEMORY_TAKE,   /* freed with pl_free once the file and anything opened from it is closed */
+	PL_FILE_MEMORY_COPY,   /* copied, so the caller is free to do as they like with it straight away */
+} PLFileMemoryOwnership;
+
 typedef struct PLFileSystemMount PLFileSystemMount;
 
+typedef struct PLFileInfo {
+	size_t size;
+	size_t compressedSize;           /* 0 if the file isn't compressed */
+	time_t timeStamp;                /* packaged files share the timestamp of their package */
+	const PLFileSystemMount *mount;  /* NULL if the file isn't under a mounted location */
+	bool isPackaged;
+} PLFileInfo;
+
+typedef struct PLDirectoryEntry {
+	const char *path;
+	size_t size;
+	time_t timeStamp;
+} PLDirectoryEntry;
+
+typedef struct PLFileRequest PLFileRequest;
+typedef void ( *PLFileRequestCallback )( PLFileRequest *request, PLFile *file, void *userData );
+
+typedef enum PLWatchEvent {
+	PL_WATCH_CREATED,
+	PL_WATCH_MODIFIED,
+	PL_WATCH_DELETED,
+} PLWatchEvent;
+
+typedef struct PLFileWatch PLFileWatch;
+typedef void ( *PLWatchCallback )( const char *path, PLWatchEvent event, bool isDirectory, void *userData );
+
+/* signatures have to fall within this many bytes from the start of the file */
+#define PL_FILE_SIGNATURE_SIZE   64
+#define PL_MAX_SIGNATURE_LENGTH  16
+
+/* identifies a format by the bytes at a fixed offset into the file */
+typedef struct PLFileSignature {
+	unsigned int offset;
+	unsigned int length;
+	uint8_t magic[ PL_MAX_SIGNATURE_LENGTH ];
+	uint8_t mask[ PL_MAX_SIGNATURE_LENGTH ]; /* bits of each byte to compare, or all of them if left empty */
+} PLFileSignature;
+
+/* given the start of a file, returns true if it looks like the format */
+typedef bool ( *PLFileProbeFunction )( const uint8_t *header, size_t size );
+
 PL_EXTERN_C
 
 #if !defined( PL_COMPILE_PLUGIN )
@@ -50,10 +105,13 @@ PL_EXTERN const char *PlGetFileName( const char *path );
 
 PL_EXTERN bool PlLocalFileExists( const char *path );
 PL_EXTERN bool PlFileExists( const char *path );
+PL_EXTERN bool PlStatFile( const char *path, PLFileInfo *info );
 PL_EXTERN bool PlLocalPathExists( const char *path );
 PL_EXTERN bool PlPathExists( const char *path );
 
 PL_EXTERN void PlScanDirectory( const char *path, const char *extension, void ( *Function )( const char *, void * ), bool recursive, void *userData );
+PL_EXTERN PLDirectoryEntry *PlScanDirectoryEntries( const char *path, const char *extension, bool recursive, unsigned int *numEntries );
+PL_EXTERN void PlDestroyDirectoryEntries( PLDirectoryEntry *entries );
 
 PL_EXTERN bool PlCreateDirectory( const char *path );
 PL_EXTERN bool PlCreatePath( const char *path );
@@ -62,6 +120,11 @@ PL_EXTERN bool PlCreatePath( const char *path );
 
 PL_EXTERN PLFile *PlOpenLocalFile( const char *path, bool cache );
 PL_EXTERN PLFile *PlOpenFile( const char *path, bool cache );
+PL_EXTERN unsigned int PlOpenFiles( const char **paths, unsigned int numPaths, bool cache, PLFile **out );
+PL_EXTERN PLFile *PlMapLocalFile( const char *path, PLFileAccessHint hint );
+PL_EXTERN PLFile *PlMapFile( const char *path, PLFileAccessHint hint );
+PL_EXTERN PLFile *PlCreateFileFromMemory( const char *path, void *buffer, size_t size, PLFileMemoryOwnership ownership );
+PL_EXTERN void PlSetFileAccessHint( PLFile *ptr, PLFileAccessHint hint );
 PL_EXTERN void PlCloseFile( PLFile *ptr );
 
 PL_EXTERN bool PlCopyFile( const char *path, const char *dest );
@@ -87,11 +150,39 @@ PL_EXTERN int16_t PlReadInt16( PLFile *ptr, bool big_endian, bool *status );
 PL_EXTERN int32_t PlReadInt32( PLFile *ptr, bool big_endian, bool *status );
 PL_EXTERN int64_t PlReadInt64( PLFile *ptr, bool big_endian, bool *status );
 
+PL_EXTERN size_t PlReadInt16Array( PLFile *ptr, int16_t *dest, size_t count, bool bigEndian );
+PL_EXTERN size_t PlReadInt32Array( PLFile *ptr, int32_t *dest, size_t count, bool bigEndian );
+PL_EXTERN size_t PlReadInt64Array( PLFile *ptr, int64_t *dest, size_t count, bool bigEndian );
+PL_EXTERN size_t PlReadFloat32Array( PLFile *ptr, float *dest, size_t count, bool bigEndian );
+PL_EXTERN size_t PlReadFloat64Array( PLFile *ptr, double *dest, size_t count, bool bigEndian );
+
 PL_EXTERN char *PlReadString( PLFile *ptr, char *str, size_t size );
 
 PL_EXTERN bool PlFileSeek( PLFile *ptr, long int pos, PLFileSeek seek );
 PL_EXTERN void PlRewindFile( PLFile *ptr );
 
+/** Access Tracing **/
+
+PL_EXTERN bool PlStartAccessTrace( const char *path );
+PL_EXTERN void PlStopAccessTrace( void );
+PL_EXTERN bool PlReplayAccessTrace( const char *path );
+PL_EXTERN void PlWaitAccessTraceReplay( void );
+
+/** Async File I/O **/
+
+PL_EXTERN PLFileRequest *PlOpenFileAsync( const char *path, bool cache, PLFileRequestCallback Callback, void *userData );
+PL_EXTERN bool PlCancelFileRequest( PLFileRequest *request );
+PL_EXTERN bool PlIsFileRequestComplete( PLFileRequest *request );
+PL_EXTERN PLFile *PlWaitFileRequest( PLFileRequest *request );
+PL_EXTERN void PlWaitFileRequests( PLFileRequest **requests, unsigned int numRequests );
+PL_EXTERN void PlDestroyFileRequest( PLFileRequest *request );
+
+/** File Watching **/
+
+PL_EXTERN PLFileWatch *PlWatchPath( const char *path, PLWatchCallback Callback, void *userData );
+PL_EXTERN void PlUnwatchPath( PLFileWatch *watch );
+PL_EXTERN unsigned int PlPollWatchedPaths( void );
+
 /** FS Mounting **/
 
 PL_EXTERN PLFileSystemMount *PlMountLocalLocation( const char *path );
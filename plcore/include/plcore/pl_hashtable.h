@@ -0,0 +1,29 @@
+/**
+ * Hei Platform Library
+ * Copyright (C) 2017-2021 Mark E Sowden <hogsy@oldtimes-software.com>
+ * This software is licensed under MIT. See LICENSE for more details.
+ */
+
+#pragma once
+
+#include <plcore/pl.h>
+
+PL_EXTERN_C
+
+typedef struct PLHashTable PLHashTable;
+
+PL_EXTERN uint64_t PlGenerateHash( const void *data, size_t size );
+
+PL_EXTERN PLHashTable *PlCreateHashTable( void );
+PL_EXTERN void PlDestroyHashTable( PLHashTable *hashTable );
+PL_EXTERN void PlClearHashTable( PLHashTable *hashTable );
+
+PL_EXTERN bool PlInsertHashTableNode( PLHashTable *hashTable, const void *key, size_t keySize, void *value );
+PL_EXTERN bool PlRemoveHashTableNode( PLHashTable *hashTable, const void *key, size_t keySize );
+PL_EXTERN void *PlLookupHashTableUserData( const PLHashTable *hashTable, const void *key, size_t keySize );
+
+PL_EXTERN void PlIterateHashTable( PLHashTable *hashTable, void ( *Callback )( void *value, void *userData ), void *userData );
+
+PL_EXTERN unsigned int PlGetNumHashTableNodes( const PLHashTable *hashTable );
+
+PL_EXTERN_C_END
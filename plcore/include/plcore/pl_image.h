@@ -90,6 +90,7 @@ PL_EXTERN_C
 #if !defined( PL_COMPILE_PLUGIN )
 
 PL_EXTERN void PlRegisterImageLoader( const char *extension, PLImage *( *LoadImage )( const char *path ) );
+PL_EXTERN void PlRegisterImageSignature( const char *extension, const PLFileSignature *signature, PLFileProbeFunction Probe, PLImage *( *LoadImage )( const char *path ) );
 PL_EXTERN void PlRegisterStandardImageLoaders( unsigned int flags );
 PL_EXTERN void PlClearImageLoaders( void );
 
@@ -18,10 +18,12 @@ typedef enum PLCompressionType {
 
 typedef struct PLPackageIndex {
 	size_t offset;
-	char fileName[ PL_SYSTEM_MAX_PATH ];
 	size_t fileSize;
 	size_t compressedSize;
+	uint32_t nameOffset; /* into the package's string pool, see PlSetPackageFileName */
 	PLCompressionType compressionType;
+	uint32_t crc; /* crc32 of the decompressed data, if hasCrc is set */
+	bool hasCrc;
 } PLPackageIndex;
 
 typedef struct PLPackage {
@@ -30,9 +32,24 @@ typedef struct PLPackage {
 	PLPackageIndex *table;
 	struct {
 		uint8_t *( *LoadFile )( PLFile *package, PLPackageIndex *index );
+		PLFile *file; /* kept open for the lifetime of the package */
+		struct PLHashTable *index; /* file name to table entry */
+		int ( *LookupFile )( const struct PLPackage *package, const char *fileName ); /* optional, used instead of the index */
+		bool caseInsensitive;
+		char *stringPool;
+		size_t stringPoolSize;
+		size_t stringPoolCapacity;
+		struct PLHashTable *strings; /* interned names, only kept while loading */
+		PLFile *indexCache;          /* if set, the table and strings are used straight from this */
 	} internal;
 } PLPackage;
 
+/**
+ * Called on the extracting thread as files are written out by
+ * PlExtractPackage. Returning false stops the extraction early.
+ */
+typedef bool ( *PLPackageExtractCallback )( unsigned int numExtracted, unsigned int numFiles, uint64_t numBytes, void *userData );
+
 PL_EXTERN_C
 
 #if !defined( PL_COMPILE_PLUGIN )
@@ -42,9 +59,20 @@ PL_EXTERN PLPackage *PlCreatePackageHandle( const char *path, unsigned int table
 PL_EXTERN PLPackage *PlLoadPackage( const char *path );
 PL_EXTERN PLFile *PlLoadPackageFile( PLPackage *package, const char *path );
 PL_EXTERN PLFile *PlLoadPackageFileByIndex( PLPackage *package, unsigned int index );
+PL_EXTERN PLFile *PlOpenPackageFileByIndex( PLPackage *package, unsigned int index, bool cache );
+PL_EXTERN unsigned int PlOpenPackageFilesByIndex( PLPackage *package, const unsigned int *indices, unsigned int numIndices, bool cache, PLFile **out );
+PL_EXTERN PLFileRequest *PlLoadPackageFileAsync( PLPackage *package, const char *path, PLFileRequestCallback Callback, void *userData );
 PL_EXTERN void PlDestroyPackage( PLPackage *package );
 
+PL_EXTERN bool PlVerifyPackageFile( PLPackage *package, unsigned int index );
+PL_EXTERN unsigned int PlVerifyPackage( PLPackage *package, bool *failed, unsigned int *numChecked );
+
+PL_EXTERN unsigned int PlExtractPackage( PLPackage *package, const char *destination, PLPackageExtractCallback Progress, void *userData );
+
+PL_EXTERN bool PlWritePackage( PLPackage *package, const char *path, PLCompressionType compressionType );
+
 PL_EXTERN void PlRegisterPackageLoader( const char *ext, PLPackage *( *LoadFunction )( const char *path ) );
+PL_EXTERN void PlRegisterPackageSignature( const char *ext, const PLFileSignature *signature, PLFileProbeFunction Probe, PLPackage *( *LoadFunction )( const char *path ) );
 PL_EXTERN void PlRegisterStandardPackageLoaders( void );
 PL_EXTERN void PlClearPackageLoaders( void );
 
@@ -52,7 +80,10 @@ PL_EXTERN const char *PlGetPackagePath( const PLPackage *package );
 PL_EXTERN unsigned int PlGetPackageTableSize( const PLPackage *package );
 PL_EXTERN int PlGetPackageTableIndex( const PLPackage *package, const char *indexName );
 
-const char *PlGetPackageFileName( const PLPackage *package, unsigned int index );
+PL_EXTERN void PlSetPackageCaseInsensitive( PLPackage *package, bool caseInsensitive );
+
+PL_EXTERN const char *PlGetPackageFileName( const PLPackage *package, unsigned int index );
+PL_EXTERN bool PlSetPackageFileName( PLPackage *package, unsigned int index, const char *fileName, size_t maxLength );
 
 #endif
 
@@ -102,6 +102,7 @@ typedef struct PLPluginExportTable {
 	int ( *GetPackageTableIndex )( const PLPackage *package, const char *indexName );
 
 	const char *( *GetPackageFileName )( const PLPackage *package, unsigned int index );
+	bool ( *SetPackageFileName )( PLPackage *package, unsigned int index, const char *fileName, size_t maxLength );
 
 	/**
 	 * IMAGE API
@@ -147,11 +148,19 @@ typedef struct PLPluginExportTable {
 	const char *( *ParseToken )( const char **p, char *dest, size_t size );
 	int ( *ParseInteger )( const char **p, bool *status );
 	float ( *ParseFloat )( const char **p, bool *status );
+
+	/** v4.1 ************************************************/
+
+	size_t ( *ReadInt16Array )( PLFile *file, int16_t *dest, size_t count, bool bigEndian );
+	size_t ( *ReadInt32Array )( PLFile *file, int32_t *dest, size_t count, bool bigEndian );
+	size_t ( *ReadInt64Array )( PLFile *file, int64_t *dest, size_t count, bool bigEndian );
+	size_t ( *ReadFloat32Array )( PLFile *file, float *dest, size_t count, bool bigEndian );
+	size_t ( *ReadFloat64Array )( PLFile *file, double *dest, size_t count, bool bigEndian );
 } PLPluginExportTable;
 
 /* be absolutely sure to change this whenever the API is updated! */
-#define PL_PLUGIN_INTERFACE_VERSION_MAJOR 3
-#define PL_PLUGIN_INTERFACE_VERSION_MINOR 0
+#define PL_PLUGIN_INTERFACE_VERSION_MAJOR 4
+#define PL_PLUGIN_INTERFACE_VERSION_MINOR 1
 #define PL_PLUGIN_INTERFACE_VERSION ( uint16_t[ 2 ] ){ PL_PLUGIN_INTERFACE_VERSION_MAJOR, PL_PLUGIN_INTERFACE_VERSION_MINOR }
 
 #define PL_PLUGIN_QUERY_FUNCTION "PLQueryPlugin"
@@ -159,7 +168,11 @@ typedef const PLPluginDescription *( *PLPluginQueryFunction )( void );
 #define PL_PLUGIN_INIT_FUNCTION "PLInitializePlugin"
 typedef void ( *PLPluginInitializationFunction )( const PLPluginExportTable *exportTable );
 
-/* 2021-04-22
+/* 2026-10-16
+ * - added bulk array readers, e.g. ReadInt32Array
+ * - package index names are now stored in a pool, set via SetPackageFileName
+ *
+ * 2021-04-22
  * - Removed some functions from the default interface
  *
  * 2021-03-29;
@@ -7,9 +7,37 @@
 #include "pl_private.h"
 #include "package_private.h"
 #include "filesystem_private.h"
+#include "thread_private.h"
+
+#include <plcore/pl_hashtable.h>
 
 #include "miniz/miniz.h"
 
+static size_t GetStoredEntrySize( const PLPackageIndex *pi ) {
+	return ( pi->compressionType != PL_COMPRESSION_NONE ) ? pi->compressedSize : pi->fileSize;
+}
+
+/**
+ * Returns a copy of the entry from its data as it's stored in
+ * the package, decompressing it if need be.
+ */
+static uint8_t *DecodePackageEntry( const uint8_t *srcPtr, const PLPackageIndex *pi ) {
+	uint8_t *dataPtr = pl_malloc( pi->fileSize );
+	if ( pi->compressionType != PL_COMPRESSION_ZLIB ) {
+		memcpy( dataPtr, srcPtr, pi->fileSize );
+		return dataPtr;
+	}
+
+	unsigned long uncompressedLength = ( unsigned long ) pi->fileSize;
+	if ( mz_uncompress( dataPtr, &uncompressedLength, srcPtr, ( mz_ulong ) pi->compressedSize ) != MZ_OK ) {
+		pl_free( dataPtr );
+		PlReportErrorF( PL_RESULT_FILEREAD, "failed to decompress buffer" );
+		return NULL;
+	}
+
+	return dataPtr;
+}
+
 /**
  * Generic loader for package files, since this is unlikely to change
  * in most cases.
@@ -17,36 +45,136 @@
 static uint8_t *LoadGenericPackageFile( PLFile *fh, PLPackageIndex *pi ) {
 	FunctionStart();
 
-	size_t size = ( pi->compressionType != PL_COMPRESSION_NONE ) ? pi->compressedSize : pi->fileSize;
+	size_t size = GetStoredEntrySize( pi );
+
+	/* if the package is already in memory, we can decompress straight from it */
+	if ( fh->data != NULL ) {
+		if ( pi->offset > fh->size || size > fh->size - pi->offset ) {
+			PlReportErrorF( PL_RESULT_FILEREAD, "entry falls outside of package" );
+			return NULL;
+		}
+		return DecodePackageEntry( fh->data + pi->offset, pi );
+	}
+
 	uint8_t *dataPtr = pl_malloc( size );
-	if ( !PlFileSeek( fh, ( signed ) pi->offset, PL_SEEK_SET ) || PlReadFile( fh, dataPtr, size, 1 ) != 1 ) {
+	if ( PlReadFileAt( fh, dataPtr, size, pi->offset ) != size ) {
+		PlReportErrorF( PL_RESULT_FILEREAD, "failed to read entry from package" );
 		pl_free( dataPtr );
 		return NULL;
 	}
 
-	if ( pi->compressionType == PL_COMPRESSION_ZLIB ) {
-		uint8_t *decompressedPtr = pl_malloc( pi->fileSize );
-		unsigned long uncompressedLength;
-		int status = mz_uncompress( decompressedPtr, &uncompressedLength, dataPtr, pi->compressedSize );
+	if ( pi->compressionType == PL_COMPRESSION_NONE ) {
+		return dataPtr;
+	}
 
-		pl_free( dataPtr );
-		dataPtr = decompressedPtr;
+	uint8_t *decompressedPtr = DecodePackageEntry( dataPtr, pi );
+	pl_free( dataPtr );
 
-		if ( status != MZ_OK ) {
-			pl_free( dataPtr );
-			PlReportErrorF( PL_RESULT_FILEREAD, "failed to decompress buffer" );
-			return NULL;
-		}
+	return decompressedPtr;
+}
+
+/**
+ * Opens the handle to the package that all of its files are read
+ * through; this is kept open for as long as the package is.
+ */
+static PLFile *GetPackageFileHandle( PLPackage *package ) {
+	if ( package->internal.file != NULL ) {
+		return package->internal.file;
 	}
 
-	return dataPtr;
+	package->internal.file = PlMapFile( package->path, PL_FILE_ACCESS_RANDOM );
+	if ( package->internal.file == NULL ) {
+		/* might be on a filesystem that can't be mapped */
+		package->internal.file = PlOpenFile( package->path, false );
+	}
+
+	return package->internal.file;
+}
+
+static const char *GetPackageIndexKey( const PLPackage *package, const char *fileName, char *out, size_t size ) {
+	if ( !package->internal.caseInsensitive ) {
+		return fileName;
+	}
+
+	snprintf( out, size, "%s", fileName );
+	return pl_strtolower( out );
+}
+
+/**
+ * Builds the hash index used to look up files by name. Only the
+ * first entry for each name is indexed, to match the behaviour of
+ * searching the table in order.
+ */
+static void BuildPackageIndex( PLPackage *package ) {
+	if ( package->internal.index != NULL ) {
+		return;
+	}
+
+	package->internal.index = PlCreateHashTable();
+	if ( package->internal.index == NULL ) {
+		return;
+	}
+
+	char buf[ PL_SYSTEM_MAX_PATH ];
+	for ( unsigned int i = 0; i < package->table_size; ++i ) {
+		const char *key = GetPackageIndexKey( package, PlGetPackageFileName( package, i ), buf, sizeof( buf ) );
+		PlInsertHashTableNode( package->internal.index, key, strlen( key ), &package->table[ i ] );
+	}
+}
+
+static int LookupPackageIndex( PLPackage *package, const char *fileName ) {
+	if ( package->internal.LookupFile != NULL ) {
+		return package->internal.LookupFile( package, fileName );
+	}
+
+	/* handles don't know when their loader has finished with the
+	 * table, so the index is built on demand */
+	BuildPackageIndex( package );
+	if ( package->internal.index == NULL ) {
+		return -1;
+	}
+
+	char buf[ PL_SYSTEM_MAX_PATH ];
+	const char *key = GetPackageIndexKey( package, fileName, buf, sizeof( buf ) );
+	PLPackageIndex *index = PlLookupHashTableUserData( package->internal.index, key, strlen( key ) );
+	if ( index == NULL ) {
+		return -1;
+	}
+
+	return ( int ) ( index - package->table );
+}
+
+/**
+ * Reads the given range of the package into memory in a single read,
+ * so a loader can parse its table from there rather than field by field.
+ * Fails if the range falls outside of the file.
+ */
+uint8_t *PlReadPackageTable( PLFile *file, size_t offset, size_t size ) {
+	size_t fileSize = PlGetFileSize( file );
+	if ( offset > fileSize || size > fileSize - offset ) {
+		PlReportErrorF( PL_RESULT_FILESIZE, "table falls outside of package" );
+		return NULL;
+	}
+
+	uint8_t *table = pl_malloc( ( size > 0 ) ? size : 1 );
+	if ( table == NULL ) {
+		return NULL;
+	}
+
+	if ( PlReadFileAt( file, table, size, offset ) != size ) {
+		PlReportErrorF( PL_RESULT_FILEREAD, "failed to read package table" );
+		pl_free( table );
+		return NULL;
+	}
+
+	return table;
 }
 
 /**
  * Allocate a new package handle.
  */
 PLPackage *PlCreatePackageHandle( const char *path, unsigned int tableSize, uint8_t *( *OpenFile )( PLFile *filePtr, PLPackageIndex *index ) ) {
-	PLPackage *package = pl_malloc( sizeof( PLPackage ) );
+	PLPackage *package = pl_calloc( 1, sizeof( PLPackage ) );
 
 	if ( OpenFile == NULL ) {
 		package->internal.LoadFile = LoadGenericPackageFile;
@@ -57,6 +185,11 @@ PLPackage *PlCreatePackageHandle( const char *path, unsigned int tableSize, uint
 	package->table_size = tableSize;
 	package->table = pl_calloc( tableSize, sizeof( PLPackageIndex ) );
 
+	/* offset 0 is reserved for entries without a name */
+	package->internal.stringPoolCapacity = 1 + tableSize * 16;
+	package->internal.stringPool = pl_calloc( package->internal.stringPoolCapacity, sizeof( char ) );
+	package->internal.stringPoolSize = 1;
+
 	snprintf( package->path, sizeof( package->path ), "%s", path );
 
 	return package;
@@ -69,23 +202,28 @@ void PlDestroyPackage( PLPackage *package ) {
 		return;
 	}
 
-	pl_free( package->table );
-	pl_free( package );
-}
-#if 0// todo
-void plWritePackage(PLPackage *package) {
+	/* the cache is keyed by the handle, which could be reused */
+	PlFlushPackageCache( package );
+
+	PlCloseFile( package->internal.file );
+	PlDestroyHashTable( package->internal.index );
+	PlDestroyHashTable( package->internal.strings );
 
+	if ( package->internal.indexCache != NULL ) {
+		/* the table and strings are part of the cache's mapping */
+		PlCloseFile( package->internal.indexCache );
+	} else {
+		pl_free( package->internal.stringPool );
+		pl_free( package->table );
+	}
+
+	pl_free( package );
 }
-#endif
 /////////////////////////////////////////////////////////////////
 
-typedef struct PLPackageLoader {
-	const char *ext;
-	PLPackage *( *LoadFunction )( const char *path );
-} PLPackageLoader;
+typedef PLPackage *( *PLPackageLoadFunction )( const char *path );
 
-static PLPackageLoader package_loaders[ MAX_OBJECT_INTERFACES ];
-static unsigned int num_package_loaders = 0;
+static FSFormatRegistry package_loaders;
 
 void PlInitPackageSubSystem( void ) {
 	PlClearPackageLoaders();
@@ -98,35 +236,75 @@ void plQuerySupportedPackages(char **array, unsigned int *size) {
 #endif
 
 void PlClearPackageLoaders( void ) {
-	memset( package_loaders, 0, sizeof( PLPackageLoader ) * MAX_OBJECT_INTERFACES );
-	num_package_loaders = 0;
+	PlClearFormatLoaders( &package_loaders );
 }
 
 void PlRegisterPackageLoader( const char *ext, PLPackage *( *LoadFunction )( const char *path ) ) {
-	package_loaders[ num_package_loaders ].ext = ext;
-	package_loaders[ num_package_loaders ].LoadFunction = LoadFunction;
-	num_package_loaders++;
+	PlRegisterPackageSignature( ext, NULL, NULL, LoadFunction );
+}
+
+/**
+ * Registers a loader that can recognise its packages by their contents,
+ * so they're loaded regardless of what they're named. Either the
+ * signature or the probe may be NULL.
+ */
+void PlRegisterPackageSignature( const char *ext, const PLFileSignature *signature, PLFileProbeFunction Probe, PLPackage *( *LoadFunction )( const char *path ) ) {
+	PlRegisterFormatLoader( &package_loaders, ext, signature, Probe, ( FSLoadFunction ) LoadFunction );
+}
+
+static bool ProbeWadPackage( const uint8_t *header, size_t size ) {
+	/* first part of the ident varys between I (initial) and P (patch) */
+	return ( size > 0 && ( header[ 0 ] == 'I' || header[ 0 ] == 'P' ) );
 }
 
 void PlRegisterStandardPackageLoaders( void ) {
-	/* outwars */
-	PlRegisterPackageLoader( "ff", PlLoadFfPackage );
-	/* hogs of war */
-	PlRegisterPackageLoader( "mad", PlLoadMadPackage );
-	PlRegisterPackageLoader( "mtd", PlLoadMadPackage );
-	/* iron storm */
-	PlRegisterPackageLoader( "lst", PlLoadLstPackage );
-	/* starfox adventures */
-	PlRegisterPackageLoader( "tab", PlLoadTabPackage );
-	/* sentient */
-	PlRegisterPackageLoader( "vsr", PlLoadVsrPackage );
-	/* doom */
-	PlRegisterPackageLoader( "wad", PlLoadWadPackage );
-	/* eradicator */
-	PlRegisterPackageLoader( "rid", PlLoadRidbPackage );
-	PlRegisterPackageLoader( "rim", PlLoadRidbPackage );
-	/* mortyr */
-	PlRegisterPackageLoader( "hal", PlLoadApukPackage );
+	static const struct {
+		const char *ext;
+		PLFileSignature signature;
+		PLFileProbeFunction Probe;
+		PLPackageLoadFunction LoadFunction;
+	} loaders[] = {
+	        /* outwars */
+	        { "ff", { 0 }, NULL, PlLoadFfPackage },
+	        /* hogs of war */
+	        { "mad", { 0 }, NULL, PlLoadMadPackage },
+	        { "mtd", { 0 }, NULL, PlLoadMadPackage },
+	        /* iron storm */
+	        { "lst", { 0, 8, "_TSL1.0V" }, NULL, PlLoadLstPackage },
+	        /* starfox adventures */
+	        { "tab", { 0 }, NULL, PlLoadTabPackage },
+	        /* sentient */
+	        { "vsr", { 0, 4, "1RSV" }, NULL, PlLoadVsrPackage },
+	        /* doom */
+	        { "wad", { 1, 3, "WAD" }, ProbeWadPackage, PlLoadWadPackage },
+	        /* eradicator */
+	        { "rid", { 0, 4, "RIDB" }, NULL, PlLoadRidbPackage },
+	        { "rim", { 0, 4, "RIDB" }, NULL, PlLoadRidbPackage },
+	        /* mortyr */
+	        { "hal", { 0, 4, "APUK" }, NULL, PlLoadApukPackage },
+	        /* our own */
+	        { "pkg", { 0, 4, "PACK" }, NULL, PlLoadPackPackage },
+	};
+
+	for ( unsigned int i = 0; i < plArrayElements( loaders ); ++i ) {
+		const PLFileSignature *signature = ( loaders[ i ].signature.length > 0 ) ? &loaders[ i ].signature : NULL;
+		PlRegisterPackageSignature( loaders[ i ].ext, signature, loaders[ i ].Probe, loaders[ i ].LoadFunction );
+	}
+}
+
+/**
+ * Called once a loader has finished filling in the package.
+ */
+static void FinishPackage( PLPackage *package ) {
+	GetPackageFileHandle( package );
+	if ( package->internal.LookupFile == NULL ) {
+		BuildPackageIndex( package );
+	}
+
+	/* names won't typically be set after this point, so there's
+	 * no point hanging on to the table used for interning */
+	PlDestroyHashTable( package->internal.strings );
+	package->internal.strings = NULL;
 }
 
 PLPackage *PlLoadPackage( const char *path ) {
@@ -137,67 +315,182 @@ PLPackage *PlLoadPackage( const char *path ) {
 		return NULL;
 	}
 
-	const char *ext = PlGetFileExtension( path );
-	for ( unsigned int i = 0; i < num_package_loaders; ++i ) {
-		if ( package_loaders[ i ].LoadFunction == NULL ) {
-			break;
+	const FSFormatLoader *loaders[ FS_MAX_FORMAT_LOADERS ];
+	unsigned int numLoaders = PlGetFormatLoaders( &package_loaders, path, loaders, plArrayElements( loaders ) );
+
+	if ( PlIsPackageIndexCacheEnabled() ) {
+		const char *extensions[ FS_MAX_FORMAT_LOADERS ];
+		for ( unsigned int i = 0; i < numLoaders; ++i ) {
+			extensions[ i ] = loaders[ i ]->extension;
 		}
 
-		if ( !plIsEmptyString( ext ) && !plIsEmptyString( package_loaders[ i ].ext ) ) {
-			if ( pl_strncasecmp( ext, package_loaders[ i ].ext, sizeof( package_loaders[ i ].ext ) ) == 0 ) {
-				PLPackage *package = package_loaders[ i ].LoadFunction( path );
-				if ( package != NULL ) {
-					strncpy( package->path, path, sizeof( package->path ) );
-					return package;
-				}
-			}
-		} else if ( plIsEmptyString( ext ) && plIsEmptyString( package_loaders[ i ].ext ) ) {
-			PLPackage *package = package_loaders[ i ].LoadFunction( path );
-			if ( package != NULL ) {
-				strncpy( package->path, path, sizeof( package->path ) );
-				return package;
+		PLPackage *package = PlLoadCachedPackageIndex( path, extensions, numLoaders );
+		if ( package != NULL ) {
+			FinishPackage( package );
+			return package;
+		}
+	}
+
+	for ( unsigned int i = 0; i < numLoaders; ++i ) {
+		PLPackage *package = ( ( PLPackageLoadFunction ) loaders[ i ]->LoadFunction )( path );
+		if ( package != NULL ) {
+			strncpy( package->path, path, sizeof( package->path ) );
+			FinishPackage( package );
+
+			/* only tables that are read through the generic path can be
+			 * cached, anything else relies on the loader's own state */
+			if ( package->internal.LoadFile == LoadGenericPackageFile && package->internal.LookupFile == NULL ) {
+				PlWritePackageIndexCache( package, loaders[ i ]->extension );
 			}
+
+			return package;
 		}
 	}
 
+	if ( numLoaders == 0 ) {
+		PlReportErrorF( PL_RESULT_UNSUPPORTED, "no loader for package, \"%s\"", path );
+	}
+
 	return NULL;
 }
 
-PLFile *PlLoadPackageFile( PLPackage *package, const char *path ) {
+/**
+ * Opens a compressed entry so that it's inflated as it's read.
+ */
+static PLFile *OpenPackageStream( PLPackage *package, PLFile *packageFile, const PLPackageIndex *pi, const char *fileName ) {
+	/* mapped packages can share the mapping, otherwise each
+	 * stream needs its own handle to read from */
+	size_t offset = 0;
+	PLFile *source = PlCreateFileView( packageFile, fileName, pi->offset, pi->compressedSize );
+	if ( source == NULL ) {
+		source = PlOpenFile( package->path, false );
+		if ( source == NULL ) {
+			return NULL;
+		}
+		offset = pi->offset;
+	}
+
+	return PlCreateInflateStream( source, fileName, offset, pi->compressedSize, pi->fileSize );
+}
+
+static bool verify_package_entries = false;
+
+/**
+ * If enabled, entries with a checksum are checked against it as
+ * they're loaded, and fail to load if they don't match. Entries
+ * that are inflated as they're read aren't checked.
+ */
+void PlSetPackageVerification( bool enable ) {
+	verify_package_entries = enable;
+}
+
+static bool CheckPackageEntryCrc( const PLPackage *package, unsigned int index, uint32_t crc ) {
+	const PLPackageIndex *pi = &( package->table[ index ] );
+	if ( crc != pi->crc ) {
+		PlReportErrorF( PL_RESULT_FILEREAD, "checksum mismatch for \"%s\" (%08X, expected %08X)",
+		                PlGetPackageFileName( package, index ), crc, pi->crc );
+		return false;
+	}
+
+	return true;
+}
+
+static bool VerifyLoadedEntry( const PLPackage *package, unsigned int index, const uint8_t *data ) {
+	const PLPackageIndex *pi = &( package->table[ index ] );
+	if ( !verify_package_entries || !pi->hasCrc ) {
+		return true;
+	}
+
+	uint32_t crc = 0;
+	pl_crc32( data, pi->fileSize, &crc );
+	return CheckPackageEntryCrc( package, index, crc );
+}
+
+/**
+ * Wraps the loaded entry up in a handle, which takes ownership of it.
+ */
+static PLFile *CreatePackageFile( PLPackage *package, unsigned int index, uint8_t *dataPtr ) {
+	if ( !VerifyLoadedEntry( package, index, dataPtr ) ) {
+		pl_free( dataPtr );
+		return NULL;
+	}
+
+	const PLPackageIndex *pi = &( package->table[ index ] );
+	const char *fileName = PlGetPackageFileName( package, index );
+	if ( PlIsPackageCacheEnabled() ) {
+		return PlCachePackageFile( package, index, fileName, dataPtr, pi->fileSize );
+	}
+
+	PLFile *file = pl_calloc( 1, sizeof( PLFile ) );
+	snprintf( file->path, sizeof( file->path ), "%s", fileName );
+	file->size = pi->fileSize;
+	file->data = dataPtr;
+	file->pos = file->data;
+
+	return file;
+}
+
+static bool IsStreamedEntry( const PLPackage *package, const PLPackageIndex *pi, bool cache ) {
+	return ( !cache && package->internal.LoadFile == LoadGenericPackageFile && pi->compressionType == PL_COMPRESSION_ZLIB &&
+	         pi->fileSize >= FS_INFLATE_STREAM_THRESHOLD );
+}
+
+static PLFile *LoadPackageIndex( PLPackage *package, unsigned int index, bool cache ) {
 	if ( package->internal.LoadFile == NULL ) {
 		PlReportErrorF( PL_RESULT_FILEREAD, "package has not been initialized, no LoadFile function assigned, aborting" );
 		return NULL;
 	}
 
-	for ( unsigned int i = 0; i < package->table_size; ++i ) {
-		if ( strcmp( path, package->table[ i ].fileName ) != 0 ) {
-			continue;
-		}
+	PLFile *packageFile = GetPackageFileHandle( package );
+	if ( packageFile == NULL ) {
+		return NULL;
+	}
 
-		/* load in the package */
-		PLFile *packageFile = PlOpenFile( package->path, true );
-		if ( packageFile == NULL ) {
-			return NULL;
-		}
+	PLPackageIndex *pi = &( package->table[ index ] );
+	const char *fileName = PlGetPackageFileName( package, index );
 
-		PLFile *file = NULL;
+	/* uncompressed files in a mapped package can be handed out as-is */
+	if ( package->internal.LoadFile == LoadGenericPackageFile && pi->compressionType == PL_COMPRESSION_NONE ) {
+		PLFile *file = PlCreateFileView( packageFile, fileName, pi->offset, pi->fileSize );
+		if ( file != NULL ) {
+			if ( !VerifyLoadedEntry( package, index, file->data ) ) {
+				PlCloseFile( file );
+				return NULL;
+			}
 
-		uint8_t *dataPtr = package->internal.LoadFile( packageFile, &( package->table[ i ] ) );
-		if ( dataPtr != NULL ) {
-			file = pl_malloc( sizeof( PLFile ) );
-			snprintf( file->path, sizeof( file->path ), "%s", package->table[ i ].fileName );
-			file->size = package->table[ i ].fileSize;
-			file->data = dataPtr;
-			file->pos = file->data;
+			return file;
 		}
+	}
 
-		PlCloseFile( packageFile );
+	/* small entries are quicker to decompress in one go */
+	if ( IsStreamedEntry( package, pi, cache ) ) {
+		PLFile *file = OpenPackageStream( package, packageFile, pi, fileName );
+		if ( file != NULL ) {
+			return file;
+		}
+	}
 
+	PLFile *file = PlGetCachedPackageFile( package, index );
+	if ( file != NULL ) {
 		return file;
 	}
 
-	PlReportErrorF( PL_RESULT_INVALID_PARM2, "failed to find file in package" );
-	return NULL;
+	uint8_t *dataPtr = package->internal.LoadFile( packageFile, pi );
+	if ( dataPtr == NULL ) {
+		return NULL;
+	}
+
+	return CreatePackageFile( package, index, dataPtr );
+}
+
+PLFile *PlLoadPackageFile( PLPackage *package, const char *path ) {
+	int index = LookupPackageIndex( package, path );
+	if ( index == -1 ) {
+		PlReportErrorF( PL_RESULT_INVALID_PARM2, "failed to find file in package" );
+		return NULL;
+	}
+
+	return LoadPackageIndex( package, ( unsigned int ) index, true );
 }
 
 PLFile *PlLoadPackageFileByIndex( PLPackage *package, unsigned int index ) {
@@ -206,7 +499,665 @@ PLFile *PlLoadPackageFileByIndex( PLPackage *package, unsigned int index ) {
 		return NULL;
 	}
 
-	return PlLoadPackageFile( package, package->table[ index ].fileName );
+	return LoadPackageIndex( package, index, true );
+}
+
+/**
+ * Opens the given entry, much like PlLoadPackageFileByIndex. If cache
+ * is false then large compressed entries are inflated as they're read,
+ * so they're never held in memory all at once.
+ */
+PLFile *PlOpenPackageFileByIndex( PLPackage *package, unsigned int index, bool cache ) {
+	if ( index >= package->table_size ) {
+		PlReportBasicError( PL_RESULT_INVALID_PARM2 );
+		return NULL;
+	}
+
+	return LoadPackageIndex( package, index, cache );
+}
+
+#define PACKAGE_VERIFY_BLOCK_SIZE ( 256 * 1024 )
+
+/**
+ * Checks the given entry against its checksum, reading it through
+ * in blocks if it's too large to be held in memory.
+ * @return False if it didn't match or couldn't be read, true if it
+ * matched or has no checksum to check against.
+ */
+bool PlVerifyPackageFile( PLPackage *package, unsigned int index ) {
+	if ( index >= package->table_size ) {
+		PlReportBasicError( PL_RESULT_INVALID_PARM2 );
+		return false;
+	}
+
+	if ( !package->table[ index ].hasCrc ) {
+		return true;
+	}
+
+	PLFile *file = LoadPackageIndex( package, index, false );
+	if ( file == NULL ) {
+		return false;
+	}
+
+	uint32_t crc = 0;
+	size_t size = PlGetFileSize( file );
+	const uint8_t *data = PlGetFileData( file );
+	if ( data != NULL ) {
+		pl_crc32( data, size, &crc );
+	} else {
+		/* streamed, so read it through */
+		uint8_t *buf = pl_malloc( PACKAGE_VERIFY_BLOCK_SIZE );
+		size_t total = 0, length;
+		while ( buf != NULL && ( length = PlReadFile( file, buf, 1, PACKAGE_VERIFY_BLOCK_SIZE ) ) > 0 ) {
+			pl_crc32( buf, length, &crc );
+			total += length;
+		}
+		pl_free( buf );
+
+		if ( total != size ) {
+			PlReportErrorF( PL_RESULT_FILEREAD, "failed to read \"%s\" for verification", PlGetPackageFileName( package, index ) );
+			PlCloseFile( file );
+			return false;
+		}
+	}
+
+	PlCloseFile( file );
+
+	return CheckPackageEntryCrc( package, index, crc );
+}
+
+typedef struct PackageVerifyJob {
+	PLPackage *package;
+	unsigned int begin, end;
+	bool *failed;
+	volatile unsigned int *numFailed;
+} PackageVerifyJob;
+
+static void VerifyPackageJob( void *userData ) {
+	PackageVerifyJob *job = ( PackageVerifyJob * ) userData;
+	for ( unsigned int i = job->begin; i < job->end; ++i ) {
+		bool status = PlVerifyPackageFile( job->package, i );
+		if ( job->failed != NULL ) {
+			job->failed[ i ] = !status;
+		}
+		if ( !status ) {
+			PlAtomicIncrement( job->numFailed );
+		}
+	}
+}
+
+/**
+ * Checks every entry in the package against its checksum, with the
+ * work spread across the workers.
+ * @param failed Optional, one for each entry in the table, set to true
+ * for those that didn't match.
+ * @param numChecked Optional, set to the number of entries that had a
+ * checksum to check.
+ * @return The number of entries that didn't match or couldn't be read.
+ */
+unsigned int PlVerifyPackage( PLPackage *package, bool *failed, unsigned int *numChecked ) {
+	if ( numChecked != NULL ) {
+		*numChecked = 0;
+		for ( unsigned int i = 0; i < package->table_size; ++i ) {
+			*numChecked += package->table[ i ].hasCrc;
+		}
+	}
+
+	if ( package->table_size == 0 ) {
+		return 0;
+	}
+
+	/* a few batches per worker, so one with larger entries doesn't hold everything up */
+	unsigned int numJobs = PlGetNumWorkers() * 4;
+	if ( numJobs == 0 || numJobs > package->table_size ) {
+		numJobs = ( numJobs == 0 ) ? 1 : package->table_size;
+	}
+
+	volatile unsigned int numFailed = 0;
+	PackageVerifyJob *jobs = pl_calloc( numJobs, sizeof( PackageVerifyJob ) );
+	PLJobGroup *group = PlCreateJobGroup();
+	for ( unsigned int i = 0; i < numJobs; ++i ) {
+		jobs[ i ].package = package;
+		jobs[ i ].begin = ( unsigned int ) ( ( uint64_t ) package->table_size * i / numJobs );
+		jobs[ i ].end = ( unsigned int ) ( ( uint64_t ) package->table_size * ( i + 1 ) / numJobs );
+		jobs[ i ].failed = failed;
+		jobs[ i ].numFailed = &numFailed;
+		if ( group == NULL || !PlQueueJob( group, VerifyPackageJob, &jobs[ i ] ) ) {
+			VerifyPackageJob( &jobs[ i ] );
+		}
+	}
+
+	if ( group != NULL ) {
+		PlWaitJobGroup( group );
+		PlDestroyJobGroup( group );
+	}
+
+	pl_free( jobs );
+
+	return numFailed;
+}
+
+/* files are written out in blocks of this size, so large ones
+ * never need to be held in memory at once */
+#define PACKAGE_EXTRACT_BLOCK_SIZE ( 256 * 1024 )
+/* and this caps how much the workers may have loaded between them */
+#define PACKAGE_EXTRACT_MEMORY_BUDGET ( 64 * 1024 * 1024 )
+
+typedef struct PackageExtractEntry {
+	size_t offset; /* copied from the table, for sorting */
+	unsigned int index;
+} PackageExtractEntry;
+
+typedef struct PackageExtractState {
+	PLPackage *package;
+	const char *destination;
+	const PackageExtractEntry *order; /* entries to write, in the order they're stored */
+	unsigned int numFiles;
+	volatile unsigned int next;
+	volatile bool isCancelled;
+
+	PLMutex *mutex;
+	PLCondition *progress; /* signalled whenever a file is done */
+	PLCondition *memory;   /* signalled whenever memory is given back */
+	size_t inFlight;
+	unsigned int numRunning; /* jobs that have actually started */
+	unsigned int numExtracted;
+	unsigned int numFailed;
+	uint64_t numBytes;
+} PackageExtractState;
+
+static int CompareExtractEntries( const void *a, const void *b ) {
+	const PackageExtractEntry *x = ( const PackageExtractEntry * ) a;
+	const PackageExtractEntry *y = ( const PackageExtractEntry * ) b;
+	if ( x->offset != y->offset ) {
+		return ( x->offset < y->offset ) ? -1 : 1;
+	}
+
+	return ( x->index < y->index ) ? -1 : ( x->index > y->index );
+}
+
+/**
+ * Returns roughly how much memory the entry takes up while it's
+ * open; streamed entries and views onto a mapped package take
+ * next to nothing.
+ */
+static size_t GetEntryResidentSize( const PLPackage *package, const PLPackageIndex *pi ) {
+	if ( package->internal.LoadFile == LoadGenericPackageFile ) {
+		if ( IsStreamedEntry( package, pi, false ) ) {
+			return 0;
+		}
+
+		if ( pi->compressionType == PL_COMPRESSION_NONE && PlGetFileData( package->internal.file ) != NULL ) {
+			return 0;
+		}
+	}
+
+	return pi->fileSize + ( ( pi->compressionType != PL_COMPRESSION_NONE ) ? pi->compressedSize : 0 );
+}
+
+static void ReserveExtractMemory( PackageExtractState *state, size_t size ) {
+	if ( size == 0 ) {
+		return;
+	}
+
+	PlLockMutex( state->mutex );
+	/* anything larger than the whole budget waits until it has it to itself */
+	while ( state->inFlight > 0 && state->inFlight + size > PACKAGE_EXTRACT_MEMORY_BUDGET ) {
+		PlWaitCondition( state->memory, state->mutex );
+	}
+	state->inFlight += size;
+	PlUnlockMutex( state->mutex );
+}
+
+static void ReleaseExtractMemory( PackageExtractState *state, size_t size ) {
+	if ( size == 0 ) {
+		return;
+	}
+
+	PlLockMutex( state->mutex );
+	state->inFlight -= size;
+	PlBroadcastCondition( state->memory );
+	PlUnlockMutex( state->mutex );
+}
+
+static bool WritePackageEntry( PLFile *file, const char *path, uint8_t *buffer, uint64_t *numBytes ) {
+	FILE *out = fopen( path, "wb" );
+	if ( out == NULL ) {
+		return false;
+	}
+
+	bool status = true;
+	const uint8_t *data = PlGetFileData( file );
+	if ( data != NULL ) {
+		size_t size = PlGetFileSize( file );
+		status = ( fwrite( data, 1, size, out ) == size );
+		*numBytes += size;
+	} else {
+		size_t length;
+		while ( ( length = PlReadFile( file, buffer, 1, PACKAGE_EXTRACT_BLOCK_SIZE ) ) > 0 ) {
+			if ( fwrite( buffer, 1, length, out ) != length ) {
+				status = false;
+				break;
+			}
+			*numBytes += length;
+		}
+		status = ( status && PlIsEndOfFile( file ) );
+	}
+
+	if ( fclose( out ) != 0 ) {
+		status = false;
+	}
+
+	return status;
+}
+
+static bool ExtractPackageEntry( PackageExtractState *state, unsigned int index, uint8_t *buffer, uint64_t *numBytes ) {
+	char path[ PL_SYSTEM_MAX_PATH ];
+	snprintf( path, sizeof( path ), "%s/%s", state->destination, PlGetPackageFileName( state->package, index ) );
+
+	PLFile *file = PlOpenPackageFileByIndex( state->package, index, false );
+	if ( file == NULL ) {
+		return false;
+	}
+
+	bool status = WritePackageEntry( file, path, buffer, numBytes );
+	PlCloseFile( file );
+
+	return status;
+}
+
+/**
+ * Takes the next file that's yet to be written and writes it.
+ * @return False if there was nothing left to take.
+ */
+static bool ExtractNextPackageEntry( PackageExtractState *state, uint8_t *buffer ) {
+	if ( state->isCancelled ) {
+		return false;
+	}
+
+	unsigned int next = PlAtomicIncrement( &state->next ) - 1;
+	if ( next >= state->numFiles ) {
+		return false;
+	}
+
+	unsigned int index = state->order[ next ].index;
+	size_t residentSize = GetEntryResidentSize( state->package, &state->package->table[ index ] );
+	ReserveExtractMemory( state, residentSize );
+
+	uint64_t numBytes = 0;
+	bool status = ExtractPackageEntry( state, index, buffer, &numBytes );
+
+	ReleaseExtractMemory( state, residentSize );
+
+	PlLockMutex( state->mutex );
+	state->numExtracted += status;
+	state->numFailed += !status;
+	state->numBytes += numBytes;
+	PlSignalCondition( state->progress );
+	PlUnlockMutex( state->mutex );
+
+	return true;
+}
+
+static void ExtractPackageJob( void *userData ) {
+	PackageExtractState *state = ( PackageExtractState * ) userData;
+
+	PlLockMutex( state->mutex );
+	state->numRunning++;
+	PlUnlockMutex( state->mutex );
+
+	uint8_t *buffer = pl_malloc( PACKAGE_EXTRACT_BLOCK_SIZE );
+	while ( buffer != NULL && ExtractNextPackageEntry( state, buffer ) ) {}
+	pl_free( buffer );
+
+	PlLockMutex( state->mutex );
+	state->numRunning--;
+	PlSignalCondition( state->progress );
+	PlUnlockMutex( state->mutex );
+}
+
+static bool IsSafeEntryName( const char *name ) {
+	if ( *name == '\0' || *name == '/' || *name == '\\' || strchr( name, ':' ) != NULL ) {
+		return false;
+	}
+
+	/* nothing that would climb out of the destination */
+	for ( const char *p = name; *p != '\0'; ) {
+		size_t length = strcspn( p, "/\\" );
+		if ( length == 0 || ( length == 2 && p[ 0 ] == '.' && p[ 1 ] == '.' ) ) {
+			return false;
+		}
+		p += length;
+		if ( *p != '\0' ) {
+			p++;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Works out which entries need writing and creates the directories
+ * for them, so the workers are left with nothing but files to write.
+ * Where several entries share a name, only the last is written, to
+ * match what writing them all out in order would leave behind.
+ */
+static unsigned int PrepareExtractEntries( PLPackage *package, const char *destination, PackageExtractEntry *order, unsigned int *numFailed ) {
+	PLHashTable *seen = PlCreateHashTable();
+	if ( seen == NULL ) {
+		return 0;
+	}
+
+	unsigned int numFiles = 0;
+	for ( unsigned int i = package->table_size; i-- > 0; ) {
+		const char *name = PlGetPackageFileName( package, i );
+		if ( !PlInsertHashTableNode( seen, name, strlen( name ), NULL ) ) {
+			continue;
+		}
+
+		/* anything that would end up outside of the destination, or be cut short, counts as failed */
+		char path[ PL_SYSTEM_MAX_PATH ];
+		int length = snprintf( path, sizeof( path ), "%s/%s", destination, name );
+		if ( !IsSafeEntryName( name ) || length < 0 || ( size_t ) length >= sizeof( path ) ) {
+			( *numFailed )++;
+			continue;
+		}
+
+		order[ numFiles ].offset = package->table[ i ].offset;
+		order[ numFiles ].index = i;
+		numFiles++;
+	}
+
+	PlDestroyHashTable( seen );
+
+	/* in the order they're stored, so the package is read through front to back */
+	qsort( order, numFiles, sizeof( PackageExtractEntry ), CompareExtractEntries );
+
+	char lastDirectory[ PL_SYSTEM_MAX_PATH ] = { '\0' };
+	unsigned int numPrepared = 0;
+	for ( unsigned int i = 0; i < numFiles; ++i ) {
+		char directory[ PL_SYSTEM_MAX_PATH ];
+		snprintf( directory, sizeof( directory ), "%s/%s", destination, PlGetPackageFileName( package, order[ i ].index ) );
+		char *separator = directory + strlen( destination );
+		for ( char *p = separator; *p != '\0'; ++p ) {
+			if ( *p == '/' || *p == '\\' ) {
+				separator = p;
+			}
+		}
+		*separator = '\0';
+
+		if ( strcmp( directory, lastDirectory ) != 0 ) {
+			if ( !PlCreatePath( directory ) ) {
+				( *numFailed )++;
+				continue;
+			}
+			snprintf( lastDirectory, sizeof( lastDirectory ), "%s", directory );
+		}
+
+		order[ numPrepared++ ] = order[ i ];
+	}
+
+	return numPrepared;
+}
+
+/**
+ * Writes every file in the package out under the given directory,
+ * with the work spread across the workers, and this thread. The
+ * result is the same as writing each entry out in turn.
+ * @param Progress Optional, called on this thread as files are done.
+ * @return The number of files that couldn't be written.
+ */
+unsigned int PlExtractPackage( PLPackage *package, const char *destination, PLPackageExtractCallback Progress, void *userData ) {
+	if ( package->table_size == 0 ) {
+		return 0;
+	}
+
+	if ( !PlCreatePath( destination ) || GetPackageFileHandle( package ) == NULL ) {
+		return package->table_size;
+	}
+
+	PackageExtractState state;
+	memset( &state, 0, sizeof( PackageExtractState ) );
+	state.package = package;
+	state.destination = destination;
+
+	PackageExtractEntry *order = pl_malloc( sizeof( PackageExtractEntry ) * package->table_size );
+	state.mutex = PlCreateMutex();
+	state.progress = PlCreateCondition();
+	state.memory = PlCreateCondition();
+	if ( order == NULL || state.mutex == NULL || state.progress == NULL || state.memory == NULL ) {
+		state.numFailed = package->table_size;
+	} else {
+		state.numFiles = PrepareExtractEntries( package, destination, order, &state.numFailed );
+		state.order = order;
+	}
+
+	if ( state.numFiles > 0 ) {
+		unsigned int numJobs = PlGetNumWorkers();
+		if ( numJobs == 0 || numJobs > state.numFiles ) {
+			numJobs = ( numJobs == 0 ) ? 1 : state.numFiles;
+		}
+
+		PLJobGroup *group = PlCreateJobGroup();
+		for ( unsigned int i = 0; i < numJobs; ++i ) {
+			if ( group == NULL || !PlQueueJob( group, ExtractPackageJob, &state ) ) {
+				break;
+			}
+		}
+
+		/* we could be running on one of the workers, and the rest could
+		 * be tied up, so rather than waiting on jobs that may never start
+		 * we take on files ourselves, and only wait on those that have */
+		uint8_t *buffer = pl_malloc( PACKAGE_EXTRACT_BLOCK_SIZE );
+		bool isHelping = ( buffer != NULL );
+		unsigned int numReported = 0;
+		PlLockMutex( state.mutex );
+		for ( ;; ) {
+			unsigned int numDone = state.numExtracted + state.numFailed;
+			if ( Progress != NULL && numDone != numReported ) {
+				numReported = numDone;
+				unsigned int numExtracted = state.numExtracted;
+				uint64_t numBytes = state.numBytes;
+				PlUnlockMutex( state.mutex );
+				if ( !Progress( numExtracted, state.numFiles, numBytes, userData ) ) {
+					state.isCancelled = true;
+				}
+				PlLockMutex( state.mutex );
+				continue;
+			}
+
+			if ( isHelping ) {
+				PlUnlockMutex( state.mutex );
+				isHelping = ExtractNextPackageEntry( &state, buffer );
+				PlLockMutex( state.mutex );
+				continue;
+			}
+
+			if ( state.numRunning == 0 ) {
+				break;
+			}
+
+			PlWaitCondition( state.progress, state.mutex );
+		}
+		PlUnlockMutex( state.mutex );
+		pl_free( buffer );
+
+		/* anything still queued has nothing left to do, unless we
+		 * couldn't help out, in which case we run it here instead */
+		PlDestroyJobGroup( group );
+
+		/* nothing could be started at all */
+		if ( !state.isCancelled && state.next < state.numFiles ) {
+			state.numFailed += state.numFiles - state.next;
+		}
+
+		unsigned int numDone = state.numExtracted + state.numFailed;
+		if ( Progress != NULL && numDone != numReported ) {
+			Progress( state.numExtracted, state.numFiles, state.numBytes, userData );
+		}
+	}
+
+	PlDestroyCondition( state.memory );
+	PlDestroyCondition( state.progress );
+	PlDestroyMutex( state.mutex );
+	pl_free( order );
+
+	if ( state.numFailed > 0 ) {
+		PlReportErrorF( PL_RESULT_FILEWRITE, "failed to extract %u files from \"%s\"", state.numFailed, package->path );
+	}
+
+	return state.numFailed;
+}
+
+/* entries closer together than this are read in one go,
+ * since reading over the gap is cheaper than seeking past it */
+#define PACKAGE_BATCH_MERGE_GAP ( 64 * 1024 )
+/* but reads are capped at this, so they don't pull in the
+ * entire package at once */
+#define PACKAGE_BATCH_SPAN_SIZE ( 8 * 1024 * 1024 )
+
+typedef struct PackageBatchEntry {
+	size_t offset;      /* copied from the table, for sorting */
+	unsigned int index; /* into the package table */
+	unsigned int slot;  /* into the caller's array */
+} PackageBatchEntry;
+
+static int CompareBatchEntries( const void *a, const void *b ) {
+	const PackageBatchEntry *x = ( const PackageBatchEntry * ) a;
+	const PackageBatchEntry *y = ( const PackageBatchEntry * ) b;
+	if ( x->offset != y->offset ) {
+		return ( x->offset < y->offset ) ? -1 : 1;
+	}
+
+	return ( x->slot < y->slot ) ? -1 : ( x->slot > y->slot );
+}
+
+/**
+ * Reads the given run of entries from the package with a single
+ * read, and then splits it up between them.
+ */
+static void ReadPackageSpan( PLPackage *package, PLFile *packageFile, const PackageBatchEntry *entries, unsigned int numEntries, PLFile **out ) {
+	size_t start = package->table[ entries[ 0 ].index ].offset;
+	size_t end = start;
+	for ( unsigned int i = 0; i < numEntries; ++i ) {
+		const PLPackageIndex *pi = &package->table[ entries[ i ].index ];
+		if ( pi->offset + GetStoredEntrySize( pi ) > end ) {
+			end = pi->offset + GetStoredEntrySize( pi );
+		}
+	}
+
+	uint8_t *span = pl_malloc( end - start );
+	if ( span != NULL && PlReadFileAt( packageFile, span, end - start, start ) == end - start ) {
+		for ( unsigned int i = 0; i < numEntries; ++i ) {
+			const PLPackageIndex *pi = &package->table[ entries[ i ].index ];
+			uint8_t *dataPtr = DecodePackageEntry( span + ( pi->offset - start ), pi );
+			if ( dataPtr != NULL ) {
+				out[ entries[ i ].slot ] = CreatePackageFile( package, entries[ i ].index, dataPtr );
+			}
+		}
+	}
+
+	pl_free( span );
+}
+
+/**
+ * Opens several entries from the package at once. Rather than reading
+ * them in the order they're asked for, they're read in the order they're
+ * stored, with entries that sit next to each other read together. On
+ * slow or remote disks this is considerably quicker than seeking about.
+ * Entries that couldn't be opened are set to NULL.
+ * @return The number of entries that were opened.
+ */
+unsigned int PlOpenPackageFilesByIndex( PLPackage *package, const unsigned int *indices, unsigned int numIndices, bool cache, PLFile **out ) {
+	memset( out, 0, sizeof( PLFile * ) * numIndices );
+
+	PLFile *packageFile = GetPackageFileHandle( package );
+	if ( packageFile == NULL ) {
+		return 0;
+	}
+
+	PackageBatchEntry *entries = pl_malloc( sizeof( PackageBatchEntry ) * numIndices );
+	if ( entries == NULL ) {
+		return 0;
+	}
+
+	unsigned int numEntries = 0;
+	for ( unsigned int i = 0; i < numIndices; ++i ) {
+		if ( indices[ i ] >= package->table_size ) {
+			continue;
+		}
+
+		entries[ numEntries ].offset = package->table[ indices[ i ] ].offset;
+		entries[ numEntries ].index = indices[ i ];
+		entries[ numEntries ].slot = i;
+		numEntries++;
+	}
+
+	qsort( entries, numEntries, sizeof( PackageBatchEntry ), CompareBatchEntries );
+
+	/* only the generic loader reads through a handle we can batch up */
+	bool isReadable = ( package->internal.LoadFile == LoadGenericPackageFile && packageFile->fptr != NULL );
+
+	unsigned int runStart = 0;
+	while ( runStart < numEntries ) {
+		/* gather up everything close enough to be read along with the first */
+		const PLPackageIndex *pi = &package->table[ entries[ runStart ].index ];
+		size_t runOffset = pi->offset;
+		size_t runEnd = pi->offset + GetStoredEntrySize( pi );
+		unsigned int runLength = 1;
+		while ( runStart + runLength < numEntries ) {
+			pi = &package->table[ entries[ runStart + runLength ].index ];
+			size_t end = ( pi->offset + GetStoredEntrySize( pi ) > runEnd ) ? pi->offset + GetStoredEntrySize( pi ) : runEnd;
+			if ( pi->offset > runEnd + PACKAGE_BATCH_MERGE_GAP || end - runOffset > PACKAGE_BATCH_SPAN_SIZE ) {
+				break;
+			}
+
+			runEnd = end;
+			runLength++;
+		}
+
+		PackageBatchEntry *run = &entries[ runStart ];
+		runStart += runLength;
+
+		if ( !isReadable ) {
+			/* mapped packages are paged in as they're touched, so
+			 * let the system know what's coming in the meantime */
+			PlPrefetchFileRange( packageFile, runOffset, runEnd - runOffset );
+			for ( unsigned int i = 0; i < runLength; ++i ) {
+				out[ run[ i ].slot ] = LoadPackageIndex( package, run[ i ].index, cache );
+			}
+			continue;
+		}
+
+		/* anything that's cached or streamed is opened as it is */
+		unsigned int numRead = 0;
+		for ( unsigned int i = 0; i < runLength; ++i ) {
+			if ( IsStreamedEntry( package, &package->table[ run[ i ].index ], cache ) ) {
+				out[ run[ i ].slot ] = LoadPackageIndex( package, run[ i ].index, cache );
+			} else if ( ( out[ run[ i ].slot ] = PlGetCachedPackageFile( package, run[ i ].index ) ) == NULL ) {
+				run[ numRead++ ] = run[ i ];
+			}
+		}
+
+		if ( numRead > 0 ) {
+			ReadPackageSpan( package, packageFile, run, numRead, out );
+		}
+	}
+
+	pl_free( entries );
+
+	/* if a read failed, give the entries another go by themselves */
+	unsigned int numOpened = 0;
+	for ( unsigned int i = 0; i < numIndices; ++i ) {
+		if ( out[ i ] == NULL && indices[ i ] < package->table_size ) {
+			out[ i ] = LoadPackageIndex( package, indices[ i ], cache );
+		}
+		if ( out[ i ] != NULL ) {
+			numOpened++;
+		}
+	}
+
+	return numOpened;
 }
 
 const char *PlGetPackagePath( const PLPackage *package ) {
@@ -219,7 +1170,92 @@ const char *PlGetPackageFileName( const PLPackage *package, unsigned int index )
 		return NULL;
 	}
 
-	return package->table[ index ].fileName;
+	return &package->internal.stringPool[ package->table[ index ].nameOffset ];
+}
+
+static bool AddPackageString( PLPackage *package, const char *string, size_t length, uint32_t *offset ) {
+	size_t size = package->internal.stringPoolSize + length + 1;
+	if ( size > UINT32_MAX ) {
+		PlReportErrorF( PL_RESULT_MEMORY_ALLOCATION, "package string pool is full" );
+		return false;
+	}
+
+	if ( size > package->internal.stringPoolCapacity ) {
+		size_t capacity = package->internal.stringPoolCapacity * 2;
+		if ( capacity < size ) {
+			capacity = size;
+		}
+
+		char *stringPool = pl_realloc( package->internal.stringPool, capacity );
+		if ( stringPool == NULL ) {
+			return false;
+		}
+
+		package->internal.stringPool = stringPool;
+		package->internal.stringPoolCapacity = capacity;
+	}
+
+	*offset = ( uint32_t ) package->internal.stringPoolSize;
+	memcpy( &package->internal.stringPool[ *offset ], string, length );
+	package->internal.stringPool[ *offset + length ] = '\0';
+	package->internal.stringPoolSize = size;
+
+	return true;
+}
+
+/**
+ * Sets the name of the given entry. Names are stored in a pool
+ * owned by the package, and identical names share storage.
+ * Reads up to maxLength characters, so fixed-size fields from
+ * an archive don't need to be terminated.
+ */
+bool PlSetPackageFileName( PLPackage *package, unsigned int index, const char *fileName, size_t maxLength ) {
+	if ( index >= package->table_size ) {
+		PlReportBasicError( PL_RESULT_INVALID_PARM2 );
+		return false;
+	}
+
+	PlDetachPackageIndexCache( package );
+
+	size_t length = 0;
+	while ( length < maxLength && fileName[ length ] != '\0' ) {
+		length++;
+	}
+
+	if ( length >= PL_SYSTEM_MAX_PATH ) {
+		PlReportErrorF( PL_RESULT_INVALID_PARM3, "file name is too long" );
+		return false;
+	}
+
+	if ( package->internal.strings == NULL ) {
+		package->internal.strings = PlCreateHashTable();
+	}
+
+	/* the table holds the pool offset itself, plus one so an offset
+	 * of zero can be told apart from a miss, rather than the entry
+	 * that first used the name, which may since have been renamed */
+	uintptr_t pooled = 0;
+	if ( package->internal.strings != NULL ) {
+		pooled = ( uintptr_t ) PlLookupHashTableUserData( package->internal.strings, fileName, length );
+	}
+
+	if ( pooled != 0 ) {
+		package->table[ index ].nameOffset = ( uint32_t ) ( pooled - 1 );
+	} else {
+		if ( !AddPackageString( package, fileName, length, &package->table[ index ].nameOffset ) ) {
+			return false;
+		}
+
+		if ( package->internal.strings != NULL ) {
+			PlInsertHashTableNode( package->internal.strings, fileName, length, ( void * ) ( ( uintptr_t ) package->table[ index ].nameOffset + 1 ) );
+		}
+	}
+
+	/* rebuilt on the next lookup */
+	PlDestroyHashTable( package->internal.index );
+	package->internal.index = NULL;
+
+	return true;
 }
 
 unsigned int PlGetPackageTableSize( const PLPackage *package ) {
@@ -229,15 +1265,26 @@ unsigned int PlGetPackageTableSize( const PLPackage *package ) {
 int PlGetPackageTableIndex( const PLPackage *package, const char *indexName ) {
 	FunctionStart();
 
-	for ( unsigned int i = 0; i < package->table_size; ++i ) {
-		if ( strcmp( indexName, package->table[ i ].fileName ) != 0 ) {
-			continue;
-		}
+	int index = LookupPackageIndex( ( PLPackage * ) package, indexName );
+	if ( index == -1 ) {
+		PlReportBasicError( PL_RESULT_INVALID_PARM2 );
+	}
+
+	return index;
+}
 
-		return i;
+/**
+ * Sets whether or not files within the package are looked
+ * up by name case-insensitively. Off by default.
+ */
+void PlSetPackageCaseInsensitive( PLPackage *package, bool caseInsensitive ) {
+	if ( package->internal.caseInsensitive == caseInsensitive ) {
+		return;
 	}
 
-	PlReportBasicError( PL_RESULT_INVALID_PARM2 );
+	package->internal.caseInsensitive = caseInsensitive;
 
-	return -1;
+	/* rebuilt on the next lookup */
+	PlDestroyHashTable( package->internal.index );
+	package->internal.index = NULL;
 }
@@ -26,7 +26,8 @@ PLPackage *PlLoadLstPackage( const char *path ) {
 	char ibf_path[ PL_SYSTEM_MAX_PATH + 1 ];
 	strncpy( ibf_path, path, strlen( path ) - 3 );
 	strncat( ibf_path, "ibf", PL_SYSTEM_MAX_PATH );
-	if ( !PlFileExists( ibf_path ) ) {
+	PLFileInfo ibf_info;
+	if ( !PlStatFile( ibf_path, &ibf_info ) ) {
 		PlReportErrorF( PL_RESULT_FILEPATH, "failed to open ibf package at \"%s\", aborting", ibf_path );
 		goto ABORT;
 	}
@@ -35,30 +36,28 @@ PLPackage *PlLoadLstPackage( const char *path ) {
 	//DebugPrint("IBF %s\n", ibf_path);
 
 	/* grab the IBF size so we can do some sanity checking later */
-	size_t ibf_size = PlGetLocalFileSize( ibf_path );
+	size_t ibf_size = ibf_info.size;
 	if ( ibf_size == 0 ) {
 		PlReportErrorF( PL_RESULT_FILESIZE, "invalid ibf \"%s\" size of 0, aborting", ibf_path );
 		goto ABORT;
 	}
 
-	/* read in the ident */
-	char ident[ 8 ];
-	if ( PlReadFile( fh, ident, sizeof( char ), 8 ) != 8 ) {
+	/* read in the ident and the number of indices */
+	uint8_t *header = PlReadPackageTable( fh, 0, 12 );
+	if ( header == NULL ) {
 		PlReportErrorF( PL_RESULT_FILETYPE, "failed to read identification, aborting" );
 		goto ABORT;
 	}
 
-	if ( strncmp( ident, "_TSL1.0V", 8 ) != 0 ) {
-		PlReportErrorF( PL_RESULT_FILETYPE, "invalid file ident, \"%s\", aborting", ident );
+	if ( strncmp( ( const char * ) header, "_TSL1.0V", 8 ) != 0 ) {
+		PlReportErrorF( PL_RESULT_FILETYPE, "invalid file ident, \"%.8s\", aborting", header );
+		pl_free( header );
 		goto ABORT;
 	}
 
 	/* sanity checking */
-	uint32_t num_indices;
-	if ( PlReadFile( fh, &num_indices, sizeof( unsigned int ), 1 ) != 1 ) {
-		PlReportErrorF( PL_RESULT_FILEREAD, "failed to read in indices count from lst, aborting" );
-		goto ABORT;
-	}
+	uint32_t num_indices = PlGetPackageUInt32( &header[ 8 ] );
+	pl_free( header );
 
 	if ( num_indices > 4096 ) {
 		PlReportErrorF( PL_RESULT_FILESIZE, "larger than expected package, aborting" );
@@ -67,37 +66,46 @@ PLPackage *PlLoadLstPackage( const char *path ) {
 
 	//DebugPrint("LST INDICES %u\n", num_indices);
 
-	struct {
+	typedef struct LstIndex {
 		char name[ 64 ];
 		uint32_t data_offset;
 		uint32_t data_length;
-	} index;
+	} LstIndex;
+
+	/* the table may have been cut short, in which case we take what's there */
+	unsigned int num_read = num_indices;
+	size_t table_size = PlGetFileSize( fh ) - 12;
+	if ( table_size < num_read * sizeof( LstIndex ) ) {
+		printf( "Unexpected end of package in %s, ignoring!\n", path );
+		num_read = ( unsigned int ) ( table_size / sizeof( LstIndex ) );
+	}
 
-	package = PlCreatePackageHandle( path, num_indices, NULL );
-	for ( unsigned int i = 0; i < num_indices; ++i ) {
-		if ( PlIsEndOfFile( fh ) != 0 ) {
-			printf( "Unexpected end of package in %s, ignoring!\n", path );
-			break;
-		}
+	uint8_t *table = PlReadPackageTable( fh, 12, num_read * sizeof( LstIndex ) );
+	if ( table == NULL ) {
+		goto ABORT;
+	}
 
-		if ( PlReadFile( fh, &index, sizeof( index ), 1 ) != 1 ) {
-			PlReportErrorF( PL_RESULT_FILEREAD, "failed to read index at %d, aborting", PlGetFileOffset( fh ) );
-			goto ABORT;
-		}
+	package = PlCreatePackageHandle( path, num_indices, NULL );
+	for ( unsigned int i = 0; i < num_read; ++i ) {
+		const uint8_t *index = &table[ i * sizeof( LstIndex ) ];
+		uint32_t data_offset = PlGetPackageUInt32( &index[ 64 ] );
+		uint32_t data_length = PlGetPackageUInt32( &index[ 68 ] );
 
-		//DebugPrint("LST INDEX %s\n", index.name);
+		//DebugPrint("LST INDEX %s\n", index);
 
-		if ( index.data_offset >= ibf_size || ( uint64_t ) ( index.data_offset ) + ( uint64_t ) ( index.data_length ) > ibf_size ) {
+		if ( data_offset >= ibf_size || ( uint64_t ) ( data_offset ) + ( uint64_t ) ( data_length ) > ibf_size ) {
 			PlReportErrorF( PL_RESULT_FILESIZE, "offset/length falls beyond IBF size, aborting" );
+			pl_free( table );
 			goto ABORT;
 		}
 
-		strncpy( package->table[ i ].fileName, index.name, sizeof( package->table[ i ].fileName ) );
-		package->table[ i ].fileName[ sizeof( package->table[ i ].fileName ) - 1 ] = '\0';
-		package->table[ i ].fileSize = index.data_length;
-		package->table[ i ].offset = index.data_offset;
+		PlSetPackageFileName( package, i, ( const char * ) index, 64 );
+		package->table[ i ].fileSize = data_length;
+		package->table[ i ].offset = data_offset;
 	}
 
+	pl_free( table );
+
 	PlCloseFile( fh );
 
 	return package;
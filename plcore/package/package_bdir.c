@@ -24,86 +24,65 @@ PLPackage *PlLoadRidbPackage( const char *path ) {
 
 	/* read in the header */
 
-	char identifier[ 4 ];
-	if ( PlReadFile( filePtr, identifier, 1, sizeof( identifier ) ) != sizeof( identifier ) ) {
+	uint8_t *header = PlReadPackageTable( filePtr, 0, 12 );
+	if ( header == NULL ) {
 		PlCloseFile( filePtr );
 		return NULL;
 	}
 
 	if ( !(
-	             identifier[ 0 ] == 'R' &&
-	             identifier[ 1 ] == 'I' &&
-	             identifier[ 2 ] == 'D' &&
-	             identifier[ 3 ] == 'B' ) ) {
-		PlReportErrorF( PL_RESULT_FILETYPE, "invalid bdir header, \"%s\"", identifier );
+	             header[ 0 ] == 'R' &&
+	             header[ 1 ] == 'I' &&
+	             header[ 2 ] == 'D' &&
+	             header[ 3 ] == 'B' ) ) {
+		PlReportErrorF( PL_RESULT_FILETYPE, "invalid bdir header, \"%.4s\"", header );
+		pl_free( header );
 		PlCloseFile( filePtr );
 		return NULL;
 	}
 
-	bool status;
+	uint32_t numLumps = PlGetPackageUInt32( &header[ 4 ] );
+	uint32_t tableOffset = PlGetPackageUInt32( &header[ 8 ] );
+	pl_free( header );
 
-	uint32_t numLumps = PlReadInt32( filePtr, false, &status );
-	uint32_t tableOffset = PlReadInt32( filePtr, false, &status );
-	size_t tableSize = sizeof( BdirIndex ) * numLumps;
-	if ( tableOffset + tableSize > PlGetFileSize( filePtr ) ) {
-		PlReportErrorF( PL_RESULT_INVALID_PARM1, "invalid table offset" );
-		PlCloseFile( filePtr );
-		return NULL;
-	}
+	/* and now read in the file table */
 
-	if ( !status ) {
-		PlCloseFile( filePtr );
+	uint8_t *table = PlReadPackageTable( filePtr, tableOffset, sizeof( BdirIndex ) * ( size_t ) numLumps );
+	size_t fileSize = PlGetFileSize( filePtr );
+	PlCloseFile( filePtr );
+	if ( table == NULL ) {
 		return NULL;
 	}
 
-	/* and now read in the file table */
-
-	PlFileSeek( filePtr, tableOffset, PL_SEEK_SET );
-
-	BdirIndex *indices = pl_malloc( tableSize );
-	for ( unsigned int i = 0; i < numLumps; ++i ) {
-#define cleanup()       \
-	pl_free( indices ); \
-	PlCloseFile( filePtr )
-		if ( PlReadFile( filePtr, indices[ i ].name, 1, 12 ) != 12 ) {
-			cleanup();
-			return NULL;
-		}
-		indices[ i ].name[ 11 ] = '\0';
+	/* yay, we're finally done - now to setup the package object */
 
-		indices[ i ].offset = PlReadInt32( filePtr, false, &status );
-		if ( indices[ i ].offset >= tableOffset ) {
+	PLPackage *package = PlCreatePackageHandle( path, numLumps, NULL );
+	for ( unsigned int i = 0; i < package->table_size; ++i ) {
+		const uint8_t *lump = &table[ i * sizeof( BdirIndex ) ];
+		uint32_t offset = PlGetPackageUInt32( &lump[ 12 ] );
+		if ( offset >= tableOffset ) {
 			PlReportErrorF( PL_RESULT_INVALID_PARM1, "invalid file offset for index %d", i );
-			cleanup();
-			return NULL;
+			PlDestroyPackage( package );
+			package = NULL;
+			break;
 		}
 
-		indices[ i ].size = PlReadInt32( filePtr, false, &status );
-		if ( indices[ i ].size >= PlGetFileSize( filePtr ) ) {
+		uint32_t size = PlGetPackageUInt32( &lump[ 16 ] );
+		if ( size >= fileSize ) {
 			PlReportErrorF( PL_RESULT_INVALID_PARM1, "invalid file size for index %d", i );
-			cleanup();
-			return NULL;
+			PlDestroyPackage( package );
+			package = NULL;
+			break;
 		}
-	}
-
-	PlCloseFile( filePtr );
 
-	if ( !status ) {
-		pl_free( indices );
-		return NULL;
-	}
-
-	/* yay, we're finally done - now to setup the package object */
-
-	PLPackage *package = PlCreatePackageHandle( path, numLumps, NULL );
-	for ( unsigned int i = 0; i < package->table_size; ++i ) {
 		PLPackageIndex *index = &package->table[ i ];
-		index->offset = indices[ i ].offset;
-		index->fileSize = indices[ i ].size;
-		strncpy( index->fileName, indices[ i ].name, sizeof( index->fileName ) );
+		index->offset = offset;
+		index->fileSize = size;
+		/* names are only ever 11 characters */
+		PlSetPackageFileName( package, i, ( const char * ) &lump[ 0 ], 11 );
 	}
 
-	pl_free( indices );
+	pl_free( table );
 
 	return package;
 }
@@ -0,0 +1,239 @@
+/**
+ * Hei Platform Library
+ * Copyright (C) 2017-2021 Mark E Sowden <hogsy@oldtimes-software.com>
+ * This software is licensed under MIT. See LICENSE for more details.
+ */
+
+#include <plcore/pl_hashtable.h>
+
+#include "package_private.h"
+#include "filesystem_private.h"
+#include "thread_private.h"
+
+/*	Package Cache	*/
+
+/* Decompressed entries are held on to, so files that are opened
+ * over and over don't have to be read and decompressed each time.
+ * Callers are handed views of the cached copy, which keep it alive
+ * if it's evicted while they still have it open. */
+
+typedef struct PackageCacheKey {
+	const PLPackage *package;
+	unsigned int index;
+} PackageCacheKey;
+
+typedef struct PackageCacheEntry {
+	PackageCacheKey key;
+	PLFile *file;
+	struct PackageCacheEntry *prev, *next;
+} PackageCacheEntry;
+
+static struct {
+	PLMutex *mutex;
+	PLHashTable *entries;
+	PackageCacheEntry *head, *tail; /* most recently used first */
+	unsigned int numEntries;
+	size_t size;
+	size_t budget;
+
+	unsigned int hits, misses, evictions;
+} package_cache;
+
+static void MakeCacheKey( PackageCacheKey *key, const PLPackage *package, unsigned int index ) {
+	/* the key is hashed as-is, so the padding needs to be cleared */
+	memset( key, 0, sizeof( PackageCacheKey ) );
+	key->package = package;
+	key->index = index;
+}
+
+static void UnlinkCacheEntry( PackageCacheEntry *entry ) {
+	if ( entry->prev != NULL ) {
+		entry->prev->next = entry->next;
+	} else {
+		package_cache.head = entry->next;
+	}
+
+	if ( entry->next != NULL ) {
+		entry->next->prev = entry->prev;
+	} else {
+		package_cache.tail = entry->prev;
+	}
+
+	entry->prev = entry->next = NULL;
+}
+
+static void LinkCacheEntry( PackageCacheEntry *entry ) {
+	entry->next = package_cache.head;
+	if ( package_cache.head != NULL ) {
+		package_cache.head->prev = entry;
+	} else {
+		package_cache.tail = entry;
+	}
+	package_cache.head = entry;
+}
+
+static void RemoveCacheEntry( PackageCacheEntry *entry ) {
+	UnlinkCacheEntry( entry );
+	PlRemoveHashTableNode( package_cache.entries, &entry->key, sizeof( PackageCacheKey ) );
+
+	package_cache.size -= entry->file->size;
+	package_cache.numEntries--;
+
+	PlCloseFile( entry->file );
+	pl_free( entry );
+}
+
+/**
+ * Evicts the least recently used entries until the cache fits
+ * within the given size. Expects the lock to be held.
+ */
+static void EvictCacheEntries( size_t size ) {
+	while ( package_cache.size > size && package_cache.tail != NULL ) {
+		RemoveCacheEntry( package_cache.tail );
+		package_cache.evictions++;
+	}
+}
+
+/**
+ * Sets how much memory the cache can use, in bytes. Setting
+ * it to 0 disables the cache and frees everything held by it.
+ */
+void PlSetPackageCacheSize( size_t size ) {
+	if ( package_cache.mutex == NULL ) {
+		if ( size == 0 ) {
+			return;
+		}
+
+		package_cache.mutex = PlCreateMutex();
+		package_cache.entries = PlCreateHashTable();
+		if ( package_cache.mutex == NULL || package_cache.entries == NULL ) {
+			PlDestroyMutex( package_cache.mutex );
+			PlDestroyHashTable( package_cache.entries );
+			package_cache.mutex = NULL;
+			package_cache.entries = NULL;
+			return;
+		}
+	}
+
+	PlLockMutex( package_cache.mutex );
+	package_cache.budget = size;
+	EvictCacheEntries( size );
+	PlUnlockMutex( package_cache.mutex );
+}
+
+bool PlIsPackageCacheEnabled( void ) {
+	return ( package_cache.mutex != NULL && package_cache.budget > 0 );
+}
+
+/**
+ * Returns a view of the cached copy of the given entry, or
+ * NULL if it's not in the cache.
+ */
+PLFile *PlGetCachedPackageFile( const PLPackage *package, unsigned int index ) {
+	if ( !PlIsPackageCacheEnabled() ) {
+		return NULL;
+	}
+
+	PackageCacheKey key;
+	MakeCacheKey( &key, package, index );
+
+	PLFile *file = NULL;
+	PlLockMutex( package_cache.mutex );
+	PackageCacheEntry *entry = PlLookupHashTableUserData( package_cache.entries, &key, sizeof( PackageCacheKey ) );
+	if ( entry != NULL ) {
+		UnlinkCacheEntry( entry );
+		LinkCacheEntry( entry );
+		file = PlCreateFileView( entry->file, entry->file->path, 0, entry->file->size );
+		package_cache.hits++;
+	} else {
+		package_cache.misses++;
+	}
+	PlUnlockMutex( package_cache.mutex );
+
+	return file;
+}
+
+/**
+ * Hands the decompressed entry over to the cache, which takes
+ * ownership of the buffer, and returns a view of it. Entries that
+ * are larger than the entire budget are returned without caching.
+ */
+PLFile *PlCachePackageFile( const PLPackage *package, unsigned int index, const char *path, uint8_t *data, size_t size ) {
+	PLFile *file = PlCreateBufferFile( path, data, size );
+	if ( file == NULL || !PlIsPackageCacheEnabled() ) {
+		return file;
+	}
+
+	PackageCacheKey key;
+	MakeCacheKey( &key, package, index );
+
+	PlLockMutex( package_cache.mutex );
+	if ( package_cache.budget == 0 || size > package_cache.budget ) {
+		PlUnlockMutex( package_cache.mutex );
+		return file;
+	}
+
+	PackageCacheEntry *entry = pl_calloc( 1, sizeof( PackageCacheEntry ) );
+	if ( entry == NULL ) {
+		PlUnlockMutex( package_cache.mutex );
+		return file;
+	}
+
+	entry->key = key;
+	entry->file = file;
+
+	/* another thread may have beaten us to it, in which case
+	 * this copy is simply handed out as-is */
+	if ( !PlInsertHashTableNode( package_cache.entries, &entry->key, sizeof( PackageCacheKey ), entry ) ) {
+		PlUnlockMutex( package_cache.mutex );
+		pl_free( entry );
+		return file;
+	}
+
+	EvictCacheEntries( package_cache.budget - size );
+	LinkCacheEntry( entry );
+	package_cache.size += size;
+	package_cache.numEntries++;
+
+	file = PlCreateFileView( entry->file, path, 0, size );
+	PlUnlockMutex( package_cache.mutex );
+
+	return file;
+}
+
+/**
+ * Drops everything that's cached for the given package,
+ * or the entire cache if package is NULL.
+ */
+void PlFlushPackageCache( const PLPackage *package ) {
+	if ( package_cache.mutex == NULL ) {
+		return;
+	}
+
+	PlLockMutex( package_cache.mutex );
+	PackageCacheEntry *entry = package_cache.head;
+	while ( entry != NULL ) {
+		PackageCacheEntry *next = entry->next;
+		if ( package == NULL || entry->key.package == package ) {
+			RemoveCacheEntry( entry );
+		}
+		entry = next;
+	}
+	PlUnlockMutex( package_cache.mutex );
+}
+
+void PlGetPackageCacheStats( PLPackageCacheStats *stats ) {
+	memset( stats, 0, sizeof( PLPackageCacheStats ) );
+	if ( package_cache.mutex == NULL ) {
+		return;
+	}
+
+	PlLockMutex( package_cache.mutex );
+	stats->size = package_cache.size;
+	stats->budget = package_cache.budget;
+	stats->numEntries = package_cache.numEntries;
+	stats->hits = package_cache.hits;
+	stats->misses = package_cache.misses;
+	stats->evictions = package_cache.evictions;
+	PlUnlockMutex( package_cache.mutex );
+}
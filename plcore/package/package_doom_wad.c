@@ -24,84 +24,62 @@ PLPackage *PlLoadWadPackage( const char *path ) {
 
 	/* read in the header */
 
-	char identifier[ 4 ];
-	if ( PlReadFile( filePtr, identifier, 1, sizeof( identifier ) ) != sizeof( identifier ) ) {
+	uint8_t *header = PlReadPackageTable( filePtr, 0, 12 );
+	if ( header == NULL ) {
 		PlCloseFile( filePtr );
 		return NULL;
 	}
 
 	/* first part of the ident varys between I (initial) and P (patch) */
-	if ( ( identifier[ 0 ] != 'I' && identifier[ 0 ] != 'P' ) ||
-	     !( identifier[ 1 ] == 'W' && identifier[ 2 ] == 'A' && identifier[ 3 ] == 'D' ) ) {
-		PlReportErrorF( PL_RESULT_FILETYPE, "invalid wad header, \"%s\"", identifier );
+	if ( ( header[ 0 ] != 'I' && header[ 0 ] != 'P' ) ||
+	     !( header[ 1 ] == 'W' && header[ 2 ] == 'A' && header[ 3 ] == 'D' ) ) {
+		PlReportErrorF( PL_RESULT_FILETYPE, "invalid wad header, \"%.4s\"", header );
+		pl_free( header );
 		PlCloseFile( filePtr );
 		return NULL;
 	}
 
-	bool status;
+	uint32_t numLumps = PlGetPackageUInt32( &header[ 4 ] );
+	uint32_t tableOffset = PlGetPackageUInt32( &header[ 8 ] );
+	pl_free( header );
 
-	uint32_t numLumps = PlReadInt32( filePtr, false, &status );
-	uint32_t tableOffset = PlReadInt32( filePtr, false, &status );
-	size_t tableSize = sizeof( WadIndex ) * numLumps;
-	if ( tableOffset + tableSize > PlGetFileSize( filePtr ) ) {
-		PlReportErrorF( PL_RESULT_INVALID_PARM1, "invalid table offset" );
-		PlCloseFile( filePtr );
-		return NULL;
-	}
+	/* and now read in the file table */
 
-	if ( !status ) {
-		PlCloseFile( filePtr );
+	uint8_t *table = PlReadPackageTable( filePtr, tableOffset, sizeof( WadIndex ) * ( size_t ) numLumps );
+	size_t fileSize = PlGetFileSize( filePtr );
+	PlCloseFile( filePtr );
+	if ( table == NULL ) {
 		return NULL;
 	}
 
-	/* and now read in the file table */
-
-	PlFileSeek( filePtr, tableOffset, PL_SEEK_SET );
+	/* yay, we're finally done - now to setup the package object */
 
-	WadIndex *indices = pl_malloc( tableSize );
-	for ( unsigned int i = 0; i < numLumps; ++i ) {
-#define cleanup()       \
-	pl_free( indices ); \
-	PlCloseFile( filePtr )
-		indices[ i ].offset = PlReadInt32( filePtr, false, &status );
-		if ( indices[ i ].offset >= tableOffset ) {
+	PLPackage *package = PlCreatePackageHandle( path, numLumps, NULL );
+	for ( unsigned int i = 0; i < package->table_size; ++i ) {
+		const uint8_t *lump = &table[ i * sizeof( WadIndex ) ];
+		uint32_t offset = PlGetPackageUInt32( &lump[ 0 ] );
+		if ( offset >= tableOffset ) {
 			PlReportErrorF( PL_RESULT_INVALID_PARM1, "invalid file offset for index %d", i );
-			cleanup();
-			return NULL;
+			PlDestroyPackage( package );
+			package = NULL;
+			break;
 		}
 
-		indices[ i ].size = PlReadInt32( filePtr, false, &status );
-		if ( indices[ i ].size >= PlGetFileSize( filePtr ) ) {
+		uint32_t size = PlGetPackageUInt32( &lump[ 4 ] );
+		if ( size >= fileSize ) {
 			PlReportErrorF( PL_RESULT_INVALID_PARM1, "invalid file size for index %d", i );
-			cleanup();
-			return NULL;
+			PlDestroyPackage( package );
+			package = NULL;
+			break;
 		}
 
-		if ( PlReadFile( filePtr, indices[ i ].name, 1, 8 ) != 8 ) {
-			cleanup();
-			return NULL;
-		}
-	}
-
-	PlCloseFile( filePtr );
-
-	if ( !status ) {
-		pl_free( indices );
-		return NULL;
-	}
-
-	/* yay, we're finally done - now to setup the package object */
-
-	PLPackage *package = PlCreatePackageHandle( path, numLumps, NULL );
-	for ( unsigned int i = 0; i < package->table_size; ++i ) {
 		PLPackageIndex *index = &package->table[ i ];
-		index->offset = indices[ i ].offset;
-		index->fileSize = indices[ i ].size;
-		strncpy( index->fileName, indices[ i ].name, sizeof( index->fileName ) );
-		index->fileName[ 8 ] = '\0';
+		index->offset = offset;
+		index->fileSize = size;
+		PlSetPackageFileName( package, i, ( const char * ) &lump[ 8 ], 8 );
 	}
 
-	pl_free( indices );
+	pl_free( table );
 
 	return package;
 }
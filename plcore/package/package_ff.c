@@ -49,12 +49,12 @@ PLPackage *PlLoadFfPackage( const char *path ) {
 	}
 
 	PLPackage *package = PlCreatePackageHandle( path, num_indices - 1, NULL );
-	if ( ( package->table = pl_calloc( package->table_size, sizeof( struct PLPackageIndex ) ) ) != NULL ) {
+	if ( package->table != NULL ) {
 		for ( unsigned int i = 0; i < package->table_size; ++i ) {
 			PLPackageIndex *index = &package->table[ i ];
 			index->offset = indices[ i ].offset;
 			index->fileSize = sizes[ i ];
-			strncpy( index->fileName, indices[ i ].name, sizeof( index->fileName ) );
+			PlSetPackageFileName( package, i, indices[ i ].name, sizeof( indices[ i ].name ) );
 		}
 	} else {
 		PlDestroyPackage( package );
@@ -39,74 +39,80 @@ PLPackage *PlLoadMadPackage( const char *path ) {
 	}
 
 	PLPackage *package = NULL;
+	uint8_t *table = NULL;
 
-	size_t file_size = PlGetLocalFileSize( path );
-	if ( PlGetFunctionResult() != PL_RESULT_SUCCESS ) {
-		goto FAILED;
-	}
+	size_t file_size = PlGetFileSize( fh );
 
-	/* Figure out the number of headers in the MAD file by reading them in until we cross into the data region of one
-	 * we've previously loaded. Checks each header is valid.
+	/* There's no count, so the number of headers is figured out by reading them in until we cross into the
+	 * data region of one we've previously loaded. The table can't extend past where the first file's data starts,
+	 * so everything up to there is read in one go and the headers are checked from memory.
 	 */
 
-	size_t data_begin = file_size;
-	unsigned int num_indices = 0;
-
-	while ( ( num_indices + 1 ) * sizeof( MADIndex ) <= data_begin ) {
-		MADIndex index;
-		if ( PlReadFile( fh, &index, sizeof( MADIndex ), 1 ) != 1 ) {
-			/* EOF, or read error */
+	size_t data_begin = 0;
+	if ( file_size >= sizeof( MADIndex ) ) {
+		uint8_t *first = PlReadPackageTable( fh, 0, sizeof( MADIndex ) );
+		if ( first == NULL ) {
 			goto FAILED;
 		}
 
+		data_begin = PlGetPackageUInt32( &first[ 16 ] );
+		if ( data_begin > file_size ) {
+			data_begin = file_size;
+		}
+		pl_free( first );
+	}
+
+	table = PlReadPackageTable( fh, 0, data_begin );
+	if ( table == NULL ) {
+		goto FAILED;
+	}
+
+	unsigned int num_indices = 0;
+	while ( ( num_indices + 1 ) * sizeof( MADIndex ) <= data_begin ) {
+		const uint8_t *index = &table[ num_indices * sizeof( MADIndex ) ];
+
 		// ensure the file name is valid...
 		for ( unsigned int i = 0; i < 16; ++i ) {
-			if ( isprint( index.file[ i ] ) == 0 && index.file[ i ] != '\0' ) {
+			if ( isprint( index[ i ] ) == 0 && index[ i ] != '\0' ) {
 				PlReportErrorF( PL_RESULT_FILEREAD, "received invalid filename for index" );
 				goto FAILED;
 			}
 		}
 
-		if ( index.offset >= file_size || ( uint64_t ) ( index.offset ) + ( uint64_t ) ( index.length ) > file_size ) {
+		uint32_t offset = PlGetPackageUInt32( &index[ 16 ] );
+		uint32_t length = PlGetPackageUInt32( &index[ 20 ] );
+		if ( offset >= file_size || ( uint64_t ) ( offset ) + ( uint64_t ) ( length ) > file_size ) {
 			/* File offset/length falls beyond end of file */
 			PlReportErrorF( PL_RESULT_FILEREAD, "file offset/length falls beyond end of file" );
 			goto FAILED;
 		}
 
-		if ( index.offset < data_begin ) {
-			data_begin = index.offset;
+		if ( offset < data_begin ) {
+			data_begin = offset;
 		}
 
 		++num_indices;
 	}
 
-	/* Allocate the basic package structure now we know how many files are in the archive. */
+	/* Allocate the basic package structure now we know how many files are in the archive, and populate
+	 * package->table with the metadata from the headers. */
 	package = PlCreatePackageHandle( path, num_indices, NULL );
-
-	/* Rewind the file handle and populate package->table with the metadata from the headers. */
-
-	PlRewindFile( fh );
-
 	for ( unsigned int i = 0; i < num_indices; ++i ) {
-		MADIndex index;
-		if ( PlReadFile( fh, &index, sizeof( MADIndex ), 1 ) != 1 ) {
-			/* EOF, or read error */
-			PlReportErrorF( PL_RESULT_FILEREAD, "failed to read MAD index %d", i );
-			goto FAILED;
-		}
-
-		strncpy( package->table[ i ].fileName, index.file, sizeof( package->table[ i ].fileName ) );
-		package->table[ i ].fileName[ sizeof( index.file ) - 1 ] = '\0';
-		package->table[ i ].fileSize = index.length;
-		package->table[ i ].offset = index.offset;
+		const uint8_t *index = &table[ i * sizeof( MADIndex ) ];
+		PlSetPackageFileName( package, i, ( const char * ) index, 16 );
+		package->table[ i ].offset = PlGetPackageUInt32( &index[ 16 ] );
+		package->table[ i ].fileSize = PlGetPackageUInt32( &index[ 20 ] );
 	}
 
+	pl_free( table );
+
 	PlCloseFile( fh );
 
 	return package;
 
 FAILED:
 
+	pl_free( table );
 	PlDestroyPackage( package );
 
 	PlCloseFile( fh );
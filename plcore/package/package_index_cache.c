@@ -0,0 +1,329 @@
+/**
+ * Hei Platform Library
+ * Copyright (C) 2017-2021 Mark E Sowden <hogsy@oldtimes-software.com>
+ * This software is licensed under MIT. See LICENSE for more details.
+ */
+
+#include <plcore/pl_hashtable.h>
+
+#include "package_private.h"
+#include "filesystem_private.h"
+
+#include <inttypes.h>
+
+#if defined( _WIN32 ) || defined( __APPLE__ )
+#include "3rdparty/portable_endian.h"
+#else
+#include <endian.h>
+#endif
+
+/*	Package Index Cache	*/
+
+/* Some loaders need thousands of small reads to build their table, so
+ * once built, tables can be kept in a directory alongside one another,
+ * one file per package, and used from there the next time round. The
+ * files are mapped and used as-is, so the table is stored exactly as
+ * it is in memory, and a file is only any good to the build that wrote
+ * it. They're ignored whenever the package's size or timestamp change,
+ * or the loader that built them is no longer the one that'd be used.
+ *
+ *  header
+ *  table[ numEntries ]  as PLPackageIndex
+ *  hashes[ numEntries ] sorted, the same as in the native format
+ *  strings              the package's string pool
+ *  path                 of the package, NUL-terminated */
+
+#define PACKAGE_INDEX_CACHE_VERSION   1
+#define PACKAGE_INDEX_CACHE_ALIGNMENT 16
+
+#define AlignIndexCacheOffset( a ) ( ( ( a ) + ( PACKAGE_INDEX_CACHE_ALIGNMENT - 1 ) ) & ~( ( uint64_t ) PACKAGE_INDEX_CACHE_ALIGNMENT - 1 ) )
+
+typedef struct PackageIndexCacheHeader {
+	char identity[ 4 ]; /* "PIDX" */
+	uint32_t version;
+	uint32_t loaderVersion;
+	uint32_t indexSize; /* of PLPackageIndex, as a guard against its layout changing */
+	uint32_t numEntries;
+	uint32_t pathLength;
+	uint64_t packageSize;
+	int64_t packageTimeStamp;
+	char loader[ 16 ]; /* extension the loader was registered under */
+	uint64_t tableOffset;
+	uint64_t hashesOffset;
+	uint64_t stringsOffset;
+	uint64_t stringsSize;
+	uint64_t pathOffset;
+} PackageIndexCacheHeader;
+
+static char index_cache_path[ PL_SYSTEM_MAX_PATH ];
+
+/**
+ * Sets the directory that package tables are cached in.
+ * NULL or an empty string disables the cache.
+ */
+void PlSetPackageIndexCachePath( const char *path ) {
+	snprintf( index_cache_path, sizeof( index_cache_path ), "%s", ( path != NULL ) ? path : "" );
+}
+
+bool PlIsPackageIndexCacheEnabled( void ) {
+	return ( index_cache_path[ 0 ] != '\0' );
+}
+
+static bool GetIndexCacheFilePath( const char *packagePath, char *out, size_t size ) {
+	/* there's nothing to tell one buffer from another under the same name */
+	if ( strncmp( FS_MEMORY_HINT, packagePath, FS_MEMORY_HINT_LENGTH ) == 0 ) {
+		return false;
+	}
+
+	uint64_t hash = PlGenerateHash( packagePath, strlen( packagePath ) );
+	int length = snprintf( out, size, "%s/%016" PRIx64 ".pidx", index_cache_path, hash );
+	return ( length > 0 && ( size_t ) length < size );
+}
+
+static bool IsWithinIndexCache( uint64_t offset, uint64_t size, size_t cacheSize ) {
+	return ( offset <= cacheSize && size <= cacheSize - offset );
+}
+
+static int LookupCachedPackageFile( const PLPackage *package, const char *fileName ) {
+	const uint8_t *base = PlGetFileData( package->internal.indexCache );
+	const PackageIndexCacheHeader *header = ( const PackageIndexCacheHeader * ) base;
+	const PLPackageHash *hashes = ( const PLPackageHash * ) ( base + header->hashesOffset );
+
+	return PlFindPackageHash( package, hashes, header->numEntries, fileName );
+}
+
+/**
+ * Checks the cached table is intact, and that it was built for
+ * this package by one of the loaders that would be used for it.
+ */
+static const PackageIndexCacheHeader *ValidateIndexCache( PLFile *cache, const char *path, const char **loaders, unsigned int numLoaders ) {
+	const uint8_t *base = PlGetFileData( cache );
+	size_t cacheSize = PlGetFileSize( cache );
+	if ( base == NULL || cacheSize < sizeof( PackageIndexCacheHeader ) ) {
+		return NULL;
+	}
+
+	const PackageIndexCacheHeader *header = ( const PackageIndexCacheHeader * ) base;
+	if ( memcmp( header->identity, "PIDX", 4 ) != 0 || header->version != PACKAGE_INDEX_CACHE_VERSION ||
+	     header->loaderVersion != PL_PACKAGE_LOADER_VERSION || header->indexSize != sizeof( PLPackageIndex ) ) {
+		return NULL;
+	}
+
+	uint64_t numEntries = header->numEntries;
+	if ( ( header->tableOffset % PACKAGE_INDEX_CACHE_ALIGNMENT ) != 0 ||
+	     !IsWithinIndexCache( header->tableOffset, numEntries * sizeof( PLPackageIndex ), cacheSize ) ||
+	     !IsWithinIndexCache( header->hashesOffset, numEntries * sizeof( PLPackageHash ), cacheSize ) ||
+	     !IsWithinIndexCache( header->stringsOffset, header->stringsSize, cacheSize ) ||
+	     !IsWithinIndexCache( header->pathOffset, ( uint64_t ) header->pathLength + 1, cacheSize ) ||
+	     header->stringsSize == 0 || base[ header->stringsOffset + header->stringsSize - 1 ] != '\0' ) {
+		return NULL;
+	}
+
+	/* files are only named after a hash of the path */
+	if ( header->pathLength != strlen( path ) || memcmp( base + header->pathOffset, path, header->pathLength ) != 0 ) {
+		return NULL;
+	}
+
+	bool isLoader = false;
+	for ( unsigned int i = 0; i < numLoaders && !isLoader; ++i ) {
+		isLoader = ( strncmp( header->loader, loaders[ i ], sizeof( header->loader ) ) == 0 );
+	}
+	if ( !isLoader ) {
+		return NULL;
+	}
+
+	const PLPackageIndex *table = ( const PLPackageIndex * ) ( base + header->tableOffset );
+	const PLPackageHash *hashes = ( const PLPackageHash * ) ( base + header->hashesOffset );
+	for ( uint32_t i = 0; i < header->numEntries; ++i ) {
+		const PLPackageIndex *pi = &table[ i ];
+		uint64_t size = ( pi->compressionType != PL_COMPRESSION_NONE ) ? pi->compressedSize : pi->fileSize;
+		if ( pi->nameOffset >= header->stringsSize || pi->compressionType >= PL_MAX_COMPRESSION_FORMATS ||
+		     pi->offset > header->packageSize || size > header->packageSize - pi->offset ||
+		     le32toh( hashes[ i ].index ) >= header->numEntries ) {
+			return NULL;
+		}
+	}
+
+	return header;
+}
+
+/**
+ * Returns the package with its table taken from the cache, or NULL
+ * if there's nothing cached for it that can still be used.
+ * @param loaders Extensions of the loaders that would be tried.
+ */
+PLPackage *PlLoadCachedPackageIndex( const char *path, const char **loaders, unsigned int numLoaders ) {
+	char cachePath[ PL_SYSTEM_MAX_PATH ];
+	if ( !PlIsPackageIndexCacheEnabled() || !GetIndexCacheFilePath( path, cachePath, sizeof( cachePath ) ) ||
+	     !PlLocalFileExists( cachePath ) ) {
+		return NULL;
+	}
+
+	PLFile *cache = PlMapLocalFile( cachePath, PL_FILE_ACCESS_RANDOM );
+	if ( cache == NULL ) {
+		return NULL;
+	}
+
+	const PackageIndexCacheHeader *header = ValidateIndexCache( cache, path, loaders, numLoaders );
+	if ( header == NULL ) {
+		PlCloseFile( cache );
+		return NULL;
+	}
+
+	/* the package is going to be needed either way, so the handle is kept */
+	PLFile *file = PlMapFile( path, PL_FILE_ACCESS_RANDOM );
+	if ( file == NULL ) {
+		file = PlOpenFile( path, false );
+	}
+
+	if ( file == NULL || PlGetFileSize( file ) != header->packageSize ||
+	     ( int64_t ) PlGetFileTimeStamp( file ) != header->packageTimeStamp ) {
+		PlCloseFile( file );
+		PlCloseFile( cache );
+		return NULL;
+	}
+
+	PLPackage *package = PlCreatePackageHandle( path, 0, NULL );
+	pl_free( package->table );
+	pl_free( package->internal.stringPool );
+
+	/* these are read-only, see PlDetachPackageIndexCache */
+	uint8_t *base = ( uint8_t * ) PlGetFileData( cache );
+	package->table_size = header->numEntries;
+	package->table = ( PLPackageIndex * ) ( base + header->tableOffset );
+	package->internal.stringPool = ( char * ) ( base + header->stringsOffset );
+	package->internal.stringPoolSize = package->internal.stringPoolCapacity = header->stringsSize;
+	package->internal.file = file;
+	package->internal.indexCache = cache;
+	package->internal.LookupFile = LookupCachedPackageFile;
+
+	return package;
+}
+
+static bool WriteIndexCachePadding( FILE *fp, uint64_t *offset, uint64_t alignedOffset ) {
+	static const uint8_t zeros[ PACKAGE_INDEX_CACHE_ALIGNMENT ] = { 0 };
+	size_t length = ( size_t ) ( alignedOffset - *offset );
+	*offset = alignedOffset;
+	return ( length == 0 || fwrite( zeros, 1, length, fp ) == length );
+}
+
+/**
+ * Writes the package's table out to the cache, replacing whatever
+ * was there before. Loader is the extension the loader that built
+ * the table was registered under.
+ */
+bool PlWritePackageIndexCache( PLPackage *package, const char *loader ) {
+	if ( !PlIsPackageIndexCacheEnabled() || package->internal.file == NULL ) {
+		return false;
+	}
+
+	PackageIndexCacheHeader header;
+	memset( &header, 0, sizeof( PackageIndexCacheHeader ) );
+	if ( strlen( loader ) >= sizeof( header.loader ) ) {
+		return false;
+	}
+
+	char cachePath[ PL_SYSTEM_MAX_PATH ], tempPath[ PL_SYSTEM_MAX_PATH + 4 ];
+	if ( !GetIndexCacheFilePath( package->path, cachePath, sizeof( cachePath ) ) || !PlCreatePath( index_cache_path ) ) {
+		return false;
+	}
+	snprintf( tempPath, sizeof( tempPath ), "%s.tmp", cachePath );
+
+	unsigned int numEntries = package->table_size;
+	uint64_t stringsSize = package->internal.stringPoolSize;
+
+	memcpy( header.identity, "PIDX", 4 );
+	header.version = PACKAGE_INDEX_CACHE_VERSION;
+	header.loaderVersion = PL_PACKAGE_LOADER_VERSION;
+	header.indexSize = sizeof( PLPackageIndex );
+	header.numEntries = numEntries;
+	header.pathLength = ( uint32_t ) strlen( package->path );
+	header.packageSize = PlGetFileSize( package->internal.file );
+	header.packageTimeStamp = ( int64_t ) PlGetFileTimeStamp( package->internal.file );
+	snprintf( header.loader, sizeof( header.loader ), "%s", loader );
+	header.tableOffset = AlignIndexCacheOffset( sizeof( PackageIndexCacheHeader ) );
+	header.hashesOffset = AlignIndexCacheOffset( header.tableOffset + ( uint64_t ) numEntries * sizeof( PLPackageIndex ) );
+	header.stringsOffset = header.hashesOffset + ( uint64_t ) numEntries * sizeof( PLPackageHash );
+	header.stringsSize = stringsSize;
+	header.pathOffset = header.stringsOffset + stringsSize;
+
+	PLPackageHash *hashes = pl_calloc( ( numEntries > 0 ) ? numEntries : 1, sizeof( PLPackageHash ) );
+	if ( hashes == NULL ) {
+		return false;
+	}
+
+	for ( unsigned int i = 0; i < numEntries; ++i ) {
+		hashes[ i ].hash = PlHashPackageFileName( PlGetPackageFileName( package, i ) );
+		hashes[ i ].index = i;
+	}
+
+	qsort( hashes, numEntries, sizeof( PLPackageHash ), PlComparePackageHashes );
+	for ( unsigned int i = 0; i < numEntries; ++i ) {
+		hashes[ i ].hash = htole64( hashes[ i ].hash );
+		hashes[ i ].index = htole32( hashes[ i ].index );
+	}
+
+	FILE *fp = fopen( tempPath, "wb" );
+	if ( fp == NULL ) {
+		pl_free( hashes );
+		PlReportErrorF( PL_RESULT_FILEWRITE, "failed to open %s for write", tempPath );
+		return false;
+	}
+
+	uint64_t offset = sizeof( PackageIndexCacheHeader );
+	bool status = fwrite( &header, sizeof( PackageIndexCacheHeader ), 1, fp ) == 1 &&
+	              WriteIndexCachePadding( fp, &offset, header.tableOffset ) &&
+	              fwrite( package->table, sizeof( PLPackageIndex ), numEntries, fp ) == numEntries;
+	offset += ( uint64_t ) numEntries * sizeof( PLPackageIndex );
+	status = status && WriteIndexCachePadding( fp, &offset, header.hashesOffset ) &&
+	         fwrite( hashes, sizeof( PLPackageHash ), numEntries, fp ) == numEntries &&
+	         fwrite( package->internal.stringPool, 1, stringsSize, fp ) == stringsSize &&
+	         fwrite( package->path, 1, header.pathLength + 1, fp ) == header.pathLength + 1;
+
+	pl_free( hashes );
+
+	if ( fclose( fp ) != 0 ) {
+		status = false;
+	}
+
+	/* written to the side first, so nothing ever maps half of one */
+	if ( status ) {
+#if defined( _WIN32 )
+		remove( cachePath );
+#endif
+		status = ( rename( tempPath, cachePath ) == 0 );
+	}
+
+	if ( !status ) {
+		remove( tempPath );
+		PlReportErrorF( PL_RESULT_FILEWRITE, "failed to write package index cache, %s", cachePath );
+	}
+
+	return status;
+}
+
+/**
+ * Copies the table and strings out of the cache, so they can be
+ * changed. Does nothing if the package wasn't loaded from the cache.
+ */
+void PlDetachPackageIndexCache( PLPackage *package ) {
+	if ( package->internal.indexCache == NULL ) {
+		return;
+	}
+
+	size_t tableSize = sizeof( PLPackageIndex ) * package->table_size;
+	PLPackageIndex *table = pl_malloc( ( tableSize > 0 ) ? tableSize : 1 );
+	memcpy( table, package->table, tableSize );
+	package->table = table;
+
+	char *stringPool = pl_malloc( package->internal.stringPoolSize );
+	memcpy( stringPool, package->internal.stringPool, package->internal.stringPoolSize );
+	package->internal.stringPool = stringPool;
+	package->internal.stringPoolCapacity = package->internal.stringPoolSize;
+
+	/* looked up through the usual index from here on */
+	package->internal.LookupFile = NULL;
+
+	PlCloseFile( package->internal.indexCache );
+	package->internal.indexCache = NULL;
+}
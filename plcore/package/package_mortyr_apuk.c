@@ -16,20 +16,22 @@ PLPackage *PlLoadApukPackage( const char *path ) {
 		return NULL;
 	}
 
-	/* read in the header */
+	/* read in the header, which is followed by 24 bytes of
+	 * nothing, can't think what this was intended for... */
 
-	char identifier[ 4 ];
-	if ( PlReadFile( filePtr, identifier, 1, sizeof( identifier ) ) != sizeof( identifier ) ) {
+	uint8_t *header = PlReadPackageTable( filePtr, 0, 32 );
+	if ( header == NULL ) {
 		PlCloseFile( filePtr );
 		return NULL;
 	}
 
 	if ( !(
-	             identifier[ 0 ] == 'A' &&
-	             identifier[ 1 ] == 'P' &&
-	             identifier[ 2 ] == 'U' &&
-	             identifier[ 3 ] == 'K' ) ) {
-		PlReportErrorF( PL_RESULT_FILETYPE, "invalid package identifier, \"%s\"", identifier );
+	             header[ 0 ] == 'A' &&
+	             header[ 1 ] == 'P' &&
+	             header[ 2 ] == 'U' &&
+	             header[ 3 ] == 'K' ) ) {
+		PlReportErrorF( PL_RESULT_FILETYPE, "invalid package identifier, \"%.4s\"", header );
+		pl_free( header );
 		PlCloseFile( filePtr );
 		return NULL;
 	}
@@ -41,43 +43,14 @@ PLPackage *PlLoadApukPackage( const char *path ) {
 		char name[ 16 ];
 	} FileIndex;
 
-	bool status;
-	uint32_t numFiles = PlReadInt32( filePtr, false, &status );
-	if ( !status ) {
-		PlCloseFile( filePtr );
-		return NULL;
-	}
+	uint32_t numFiles = PlGetPackageUInt32( &header[ 4 ] );
+	pl_free( header );
 
 	/* make sure the file table is valid */
-	size_t tableSize = sizeof( FileIndex ) * numFiles;
-	if ( tableSize + 32 > PlGetFileSize( filePtr ) ) {
-		PlReportErrorF( PL_RESULT_INVALID_PARM1, "invalid file table" );
-		PlCloseFile( filePtr );
-		return NULL;
-	}
-
-	/* 24 bytes of nothing, can't think what this was intended for... */
-	if ( !PlFileSeek( filePtr, 24, PL_SEEK_CUR ) ) {
-		PlCloseFile( filePtr );
-		return NULL;
-	}
-
-	FileIndex *indices = pl_malloc( sizeof( FileIndex ) * numFiles );
-	for ( unsigned int i = 0; i < numFiles; ++i ) {
-		indices[ i ].size = PlReadInt32( filePtr, false, &status );
-		indices[ i ].offset = PlReadInt32( filePtr, false, &status );
-		indices[ i ].unknown[ 0 ] = PlReadInt32( filePtr, false, &status );
-		indices[ i ].unknown[ 1 ] = PlReadInt32( filePtr, false, &status );
-
-		if ( PlReadFile( filePtr, indices[ i ].name, 1, 16 ) != 16 ) {
-			status = false;
-		}
-	}
-
+	uint8_t *table = PlReadPackageTable( filePtr, 32, sizeof( FileIndex ) * ( size_t ) numFiles );
 	PlCloseFile( filePtr );
-
-	if ( !status ) {
-		pl_free( indices );
+	if ( table == NULL ) {
+		PlReportErrorF( PL_RESULT_INVALID_PARM1, "invalid file table" );
 		return NULL;
 	}
 
@@ -85,13 +58,14 @@ PLPackage *PlLoadApukPackage( const char *path ) {
 
 	PLPackage *package = PlCreatePackageHandle( path, numFiles, NULL );
 	for ( unsigned int i = 0; i < package->table_size; ++i ) {
+		const uint8_t *file = &table[ i * sizeof( FileIndex ) ];
 		PLPackageIndex *index = &package->table[ i ];
-		index->offset = indices[ i ].offset;
-		index->fileSize = indices[ i ].size;
-		strncpy( index->fileName, indices[ i ].name, sizeof( index->fileName ) );
+		index->fileSize = PlGetPackageUInt32( &file[ 0 ] );
+		index->offset = PlGetPackageUInt32( &file[ 4 ] );
+		PlSetPackageFileName( package, i, ( const char * ) &file[ 16 ], 16 );
 	}
 
-	pl_free( indices );
+	pl_free( table );
 
 	return package;
 }
@@ -0,0 +1,356 @@
+/**
+ * Hei Platform Library
+ * Copyright (C) 2017-2021 Mark E Sowden <hogsy@oldtimes-software.com>
+ * This software is licensed under MIT. See LICENSE for more details.
+ */
+
+#include <plcore/pl_hashtable.h>
+
+#include "package_private.h"
+#include "filesystem_private.h"
+
+#include "miniz/miniz.h"
+
+#include <sys/stat.h>
+
+#if defined( _WIN32 ) || defined( __APPLE__ )
+#include "3rdparty/portable_endian.h"
+#else
+#include <endian.h>
+#endif
+
+/* Our own package format, see package_private.h for the layout. The
+ * package is mapped and the tables are used straight from the mapping,
+ * with lookups done by a binary search over the sorted hashes. */
+
+uint64_t PlHashPackageFileName( const char *fileName ) {
+	char buf[ PL_SYSTEM_MAX_PATH ];
+	snprintf( buf, sizeof( buf ), "%s", fileName );
+	pl_strtolower( buf );
+	return PlGenerateHash( buf, strlen( buf ) );
+}
+
+static bool IsWithinPack( uint64_t offset, uint64_t size, size_t fileSize ) {
+	return ( offset <= fileSize && size <= fileSize - offset );
+}
+
+/**
+ * Finds the first entry with the given name from a set of hashes
+ * sorted by PlComparePackageHashes, or -1 if there isn't one.
+ */
+int PlFindPackageHash( const PLPackage *package, const PLPackageHash *hashes, uint32_t numHashes, const char *fileName ) {
+	uint64_t hash = PlHashPackageFileName( fileName );
+
+	/* find the first entry with a matching hash, they're sorted
+	 * by index after that, so the first match wins like elsewhere */
+	uint32_t lower = 0, upper = numHashes;
+	while ( lower < upper ) {
+		uint32_t middle = lower + ( upper - lower ) / 2;
+		if ( le64toh( hashes[ middle ].hash ) < hash ) {
+			lower = middle + 1;
+		} else {
+			upper = middle;
+		}
+	}
+
+	for ( uint32_t i = lower; i < numHashes && le64toh( hashes[ i ].hash ) == hash; ++i ) {
+		unsigned int index = le32toh( hashes[ i ].index );
+		const char *name = &package->internal.stringPool[ package->table[ index ].nameOffset ];
+		if ( package->internal.caseInsensitive ? ( pl_strcasecmp( name, fileName ) == 0 ) : ( strcmp( name, fileName ) == 0 ) ) {
+			return ( int ) index;
+		}
+	}
+
+	return -1;
+}
+
+static int LookupPackFile( const PLPackage *package, const char *fileName ) {
+	const uint8_t *base = PlGetFileData( package->internal.file );
+	const PLPackageHeader *header = ( const PLPackageHeader * ) base;
+	const PLPackageHash *hashes = ( const PLPackageHash * ) ( base + le64toh( header->hashesOffset ) );
+
+	return PlFindPackageHash( package, hashes, le32toh( header->numEntries ), fileName );
+}
+
+PLPackage *PlLoadPackPackage( const char *path ) {
+	FunctionStart();
+
+	PLFile *file = PlMapFile( path, PL_FILE_ACCESS_RANDOM );
+	if ( file == NULL ) {
+		/* might be on a filesystem that can't be mapped */
+		file = PlOpenFile( path, true );
+		if ( file == NULL ) {
+			return NULL;
+		}
+	}
+
+	const uint8_t *base = PlGetFileData( file );
+	size_t fileSize = PlGetFileSize( file );
+	const PLPackageHeader *header = ( const PLPackageHeader * ) base;
+	if ( fileSize < sizeof( PLPackageHeader ) || memcmp( header->identity, "PACK", 4 ) != 0 ) {
+		PlReportErrorF( PL_RESULT_FILETYPE, "invalid pack header" );
+		PlCloseFile( file );
+		return NULL;
+	}
+
+	if ( header->version[ 0 ] != PLPACKAGE_VERSION_MAJOR ) {
+		PlReportErrorF( PL_RESULT_FILEVERSION, "unsupported pack version, %u.%u", header->version[ 0 ], header->version[ 1 ] );
+		PlCloseFile( file );
+		return NULL;
+	}
+
+	uint32_t numEntries = le32toh( header->numEntries );
+	uint64_t entriesOffset = le64toh( header->entriesOffset );
+	uint64_t hashesOffset = le64toh( header->hashesOffset );
+	uint64_t stringsOffset = le64toh( header->stringsOffset );
+	uint64_t stringsSize = le64toh( header->stringsSize );
+	bool hasChecksums = ( le16toh( header->flags ) & PLPACKAGE_FLAG_CHECKSUMS ) != 0;
+	if ( !IsWithinPack( entriesOffset, ( uint64_t ) numEntries * sizeof( PLPackageEntry ), fileSize ) ||
+	     !IsWithinPack( hashesOffset, ( uint64_t ) numEntries * sizeof( PLPackageHash ), fileSize ) ||
+	     !IsWithinPack( stringsOffset, stringsSize, fileSize ) ||
+	     ( hasChecksums && !IsWithinPack( stringsOffset + stringsSize, ( uint64_t ) numEntries * sizeof( uint32_t ), fileSize ) ) ||
+	     stringsSize == 0 || stringsSize > UINT32_MAX || base[ stringsOffset + stringsSize - 1 ] != '\0' ) {
+		PlReportErrorF( PL_RESULT_FILESIZE, "invalid pack tables" );
+		PlCloseFile( file );
+		return NULL;
+	}
+
+	const PLPackageEntry *entries = ( const PLPackageEntry * ) ( base + entriesOffset );
+	const PLPackageHash *hashes = ( const PLPackageHash * ) ( base + hashesOffset );
+	const uint8_t *checksums = hasChecksums ? ( base + stringsOffset + stringsSize ) : NULL;
+
+	PLPackage *package = PlCreatePackageHandle( path, numEntries, NULL );
+	for ( unsigned int i = 0; i < numEntries; ++i ) {
+		PLPackageIndex *index = &package->table[ i ];
+		index->offset = le64toh( entries[ i ].offset );
+		index->fileSize = le64toh( entries[ i ].size );
+		index->compressedSize = le64toh( entries[ i ].compressedSize );
+		index->nameOffset = le32toh( entries[ i ].nameOffset );
+		index->compressionType = entries[ i ].compressionType;
+		if ( checksums != NULL ) {
+			index->crc = PlGetPackageUInt32( &checksums[ i * sizeof( uint32_t ) ] );
+			index->hasCrc = true;
+		}
+
+		uint64_t size = ( index->compressionType != PL_COMPRESSION_NONE ) ? index->compressedSize : index->fileSize;
+		if ( !IsWithinPack( index->offset, size, fileSize ) || index->nameOffset >= stringsSize ||
+		     index->compressionType >= PL_MAX_COMPRESSION_FORMATS || le32toh( hashes[ i ].index ) >= numEntries ) {
+			PlReportErrorF( PL_RESULT_FILESIZE, "invalid pack entry %u", i );
+			PlDestroyPackage( package );
+			PlCloseFile( file );
+			return NULL;
+		}
+	}
+
+	/* the string table is laid out the same as the pool */
+	pl_free( package->internal.stringPool );
+	package->internal.stringPool = pl_malloc( stringsSize );
+	memcpy( package->internal.stringPool, base + stringsOffset, stringsSize );
+	package->internal.stringPoolSize = package->internal.stringPoolCapacity = stringsSize;
+
+	package->internal.file = file;
+	package->internal.LookupFile = LookupPackFile;
+
+	return package;
+}
+
+/****/
+
+int PlComparePackageHashes( const void *a, const void *b ) {
+	const PLPackageHash *hashA = ( const PLPackageHash * ) a;
+	const PLPackageHash *hashB = ( const PLPackageHash * ) b;
+	if ( hashA->hash != hashB->hash ) {
+		return ( hashA->hash < hashB->hash ) ? -1 : 1;
+	}
+
+	return ( hashA->index < hashB->index ) ? -1 : ( hashA->index > hashB->index );
+}
+
+static bool WritePackPadding( FILE *fp, uint64_t *offset, uint64_t alignedOffset ) {
+	static const uint8_t zeros[ 4096 ] = { 0 };
+	while ( *offset < alignedOffset ) {
+		size_t length = ( alignedOffset - *offset > sizeof( zeros ) ) ? sizeof( zeros ) : ( size_t ) ( alignedOffset - *offset );
+		if ( fwrite( zeros, 1, length, fp ) != length ) {
+			return false;
+		}
+		*offset += length;
+	}
+
+	return true;
+}
+
+#define AlignPackOffset( a ) ( ( ( a ) + ( PLPACKAGE_ALIGNMENT - 1 ) ) & ~( ( uint64_t ) PLPACKAGE_ALIGNMENT - 1 ) )
+
+/**
+ * Returns true if the given local path is the file the package
+ * is being read from, which can't be written over while it is.
+ */
+static bool IsPackageSourceFile( const PLPackage *package, const char *path ) {
+	if ( package->internal.file == NULL ) {
+		return false;
+	}
+
+#if defined( _WIN32 )
+	char sourcePath[ PL_SYSTEM_MAX_PATH ], destinationPath[ PL_SYSTEM_MAX_PATH ];
+	return _fullpath( sourcePath, package->internal.file->path, sizeof( sourcePath ) ) != NULL &&
+	       _fullpath( destinationPath, path, sizeof( destinationPath ) ) != NULL &&
+	       pl_strcasecmp( sourcePath, destinationPath ) == 0;
+#else
+	struct stat source, destination;
+	return stat( package->internal.file->path, &source ) == 0 && stat( path, &destination ) == 0 &&
+	       source.st_dev == destination.st_dev && source.st_ino == destination.st_ino;
+#endif
+}
+
+/**
+ * Writes out every file in the given package into our own
+ * format, which can then be loaded by the "pkg" loader.
+ * @param compressionType If set, each file is compressed unless
+ * doing so wouldn't make it any smaller.
+ */
+bool PlWritePackage( PLPackage *package, const char *path, PLCompressionType compressionType ) {
+	FunctionStart();
+
+	if ( compressionType != PL_COMPRESSION_NONE && compressionType != PL_COMPRESSION_ZLIB ) {
+		PlReportBasicError( PL_RESULT_INVALID_PARM3 );
+		return false;
+	}
+
+	if ( IsPackageSourceFile( package, path ) ) {
+		PlReportErrorF( PL_RESULT_INVALID_PARM2, "can't write package over its own source, %s", path );
+		return false;
+	}
+
+	/* written to the side first, so a failed write never leaves a
+	 * truncated package behind, or pulls one out from under a mapping */
+	char tempPath[ PL_SYSTEM_MAX_PATH + 4 ];
+	snprintf( tempPath, sizeof( tempPath ), "%s.tmp", path );
+
+	unsigned int numEntries = package->table_size;
+
+	/* the pool is already compact, since names are interned */
+	uint64_t stringsSize = package->internal.stringPoolSize;
+
+	PLPackageHeader header;
+	memset( &header, 0, sizeof( PLPackageHeader ) );
+	memcpy( header.identity, "PACK", 4 );
+	header.version[ 0 ] = PLPACKAGE_VERSION_MAJOR;
+	header.version[ 1 ] = PLPACKAGE_VERSION_MINOR;
+	header.flags = htole16( PLPACKAGE_FLAG_CHECKSUMS );
+	header.numEntries = htole32( numEntries );
+	header.alignment = htole32( PLPACKAGE_ALIGNMENT );
+
+	uint64_t entriesOffset = sizeof( PLPackageHeader );
+	uint64_t hashesOffset = entriesOffset + ( uint64_t ) numEntries * sizeof( PLPackageEntry );
+	uint64_t stringsOffset = hashesOffset + ( uint64_t ) numEntries * sizeof( PLPackageHash );
+	uint64_t checksumsOffset = stringsOffset + stringsSize;
+	header.entriesOffset = htole64( entriesOffset );
+	header.hashesOffset = htole64( hashesOffset );
+	header.stringsOffset = htole64( stringsOffset );
+	header.stringsSize = htole64( stringsSize );
+
+	PLPackageEntry *entries = pl_calloc( numEntries, sizeof( PLPackageEntry ) );
+	PLPackageHash *hashes = pl_calloc( numEntries, sizeof( PLPackageHash ) );
+	uint32_t *checksums = pl_calloc( numEntries, sizeof( uint32_t ) );
+	if ( numEntries > 0 && ( entries == NULL || hashes == NULL || checksums == NULL ) ) {
+		pl_free( entries );
+		pl_free( hashes );
+		pl_free( checksums );
+		return false;
+	}
+
+	FILE *fp = fopen( tempPath, "wb" );
+	if ( fp == NULL ) {
+		PlReportErrorF( PL_RESULT_FILEWRITE, "failed to open %s", tempPath );
+		pl_free( entries );
+		pl_free( hashes );
+		pl_free( checksums );
+		return false;
+	}
+
+	/* the tables are written last, once we know where everything went */
+	uint64_t offset = 0;
+	bool status = WritePackPadding( fp, &offset, AlignPackOffset( checksumsOffset + ( uint64_t ) numEntries * sizeof( uint32_t ) ) );
+	for ( unsigned int i = 0; i < numEntries && status; ++i ) {
+		PLFile *file = PlLoadPackageFileByIndex( package, i );
+		if ( file == NULL ) {
+			status = false;
+			break;
+		}
+
+		const uint8_t *data = PlGetFileData( file );
+		size_t size = PlGetFileSize( file );
+
+		uint32_t crc = 0;
+		pl_crc32( data, size, &crc );
+		checksums[ i ] = htole32( crc );
+
+		uint8_t *compressedData = NULL;
+		mz_ulong compressedSize = 0;
+		if ( compressionType == PL_COMPRESSION_ZLIB && size > 0 ) {
+			compressedSize = mz_compressBound( ( mz_ulong ) size );
+			compressedData = pl_malloc( compressedSize );
+			if ( mz_compress( compressedData, &compressedSize, data, ( mz_ulong ) size ) != MZ_OK || compressedSize >= size ) {
+				pl_free( compressedData );
+				compressedData = NULL;
+			}
+		}
+
+		const uint8_t *outData = ( compressedData != NULL ) ? compressedData : data;
+		size_t outSize = ( compressedData != NULL ) ? compressedSize : size;
+		if ( outSize > 0 ) {
+			status = WritePackPadding( fp, &offset, AlignPackOffset( offset ) ) && fwrite( outData, 1, outSize, fp ) == outSize;
+		}
+
+		entries[ i ].offset = htole64( offset );
+		entries[ i ].size = htole64( size );
+		entries[ i ].compressedSize = htole64( ( compressedData != NULL ) ? outSize : 0 );
+		entries[ i ].nameOffset = htole32( package->table[ i ].nameOffset );
+		entries[ i ].compressionType = ( compressedData != NULL ) ? PL_COMPRESSION_ZLIB : PL_COMPRESSION_NONE;
+		offset += outSize;
+
+		hashes[ i ].hash = PlHashPackageFileName( PlGetPackageFileName( package, i ) );
+		hashes[ i ].index = i;
+
+		pl_free( compressedData );
+		PlCloseFile( file );
+	}
+
+	if ( status ) {
+		qsort( hashes, numEntries, sizeof( PLPackageHash ), PlComparePackageHashes );
+		for ( unsigned int i = 0; i < numEntries; ++i ) {
+			hashes[ i ].hash = htole64( hashes[ i ].hash );
+			hashes[ i ].index = htole32( hashes[ i ].index );
+		}
+
+		status = fseek( fp, 0, SEEK_SET ) == 0 &&
+		         fwrite( &header, sizeof( PLPackageHeader ), 1, fp ) == 1 &&
+		         fwrite( entries, sizeof( PLPackageEntry ), numEntries, fp ) == numEntries &&
+		         fwrite( hashes, sizeof( PLPackageHash ), numEntries, fp ) == numEntries &&
+		         fwrite( package->internal.stringPool, 1, stringsSize, fp ) == stringsSize &&
+		         fwrite( checksums, sizeof( uint32_t ), numEntries, fp ) == numEntries;
+	}
+
+	pl_free( entries );
+	pl_free( hashes );
+	pl_free( checksums );
+
+	if ( fclose( fp ) != 0 ) {
+		status = false;
+	}
+
+	if ( status ) {
+#if defined( _WIN32 )
+		remove( path );
+#endif
+		status = ( rename( tempPath, path ) == 0 );
+	}
+
+	if ( !status ) {
+		PlReportErrorF( PL_RESULT_FILEWRITE, "failed to write package, %s", path );
+		remove( tempPath );
+		return false;
+	}
+
+	return true;
+}
@@ -11,68 +11,100 @@
 #include <plcore/pl_filesystem.h>
 #include <plcore/pl_package.h>
 
-#define PLPACKAGE_VERSION_MAJOR     1
-#define PLPACKAGE_VERSION_MINOR     0
+/* Native package format, which is laid out so it can be mapped and
+ * used as-is. Everything is little-endian, and offsets are from the
+ * start of the file.
+ *
+ *  header
+ *  entries[ numEntries ]   in the order they were written
+ *  hashes[ numEntries ]    sorted by hash, for looking up entries by name
+ *  strings                 NUL-terminated names, starting with an empty one
+ *  checksums[ numEntries ] crc32 of each entry once decompressed, only
+ *                          present if PLPACKAGE_FLAG_CHECKSUMS is set
+ *  data                    each entry starts on an alignment boundary */
+
+#define PLPACKAGE_VERSION_MAJOR     2
+#define PLPACKAGE_VERSION_MINOR     1
+
+#define PLPACKAGE_FLAG_CHECKSUMS    ( 1 << 0 )
+
+#define PLPACKAGE_ALIGNMENT         4096
+
+PL_PACKED_STRUCT_START( PLPackageHeader )
+char identity[ 4 ]; /* "PACK" */
+uint8_t version[ 2 ];
+uint16_t flags;
+uint32_t numEntries;
+uint32_t alignment;
+uint64_t entriesOffset;
+uint64_t hashesOffset;
+uint64_t stringsOffset;
+uint64_t stringsSize;
+PL_PACKED_STRUCT_END( PLPackageHeader )
+
+PL_PACKED_STRUCT_START( PLPackageEntry )
+uint64_t offset;
+uint64_t size;
+uint64_t compressedSize;
+uint32_t nameOffset; /* into the string table */
+uint8_t compressionType;
+uint8_t reserved[ 3 ];
+PL_PACKED_STRUCT_END( PLPackageEntry )
+
+PL_PACKED_STRUCT_START( PLPackageHash )
+uint64_t hash; /* of the lowercase name */
+uint32_t index;
+uint32_t reserved;
+PL_PACKED_STRUCT_END( PLPackageHash )
 
-enum {
-	PLPACKAGE_LEVEL_INDEX,
-	PLPACKAGE_MODEL_INDEX,
-	PLPACKAGE_TEXTURE_INDEX,
-	PLPACKAGE_MATERIAL_INDEX,
+PL_EXTERN_C
 
-	PLPACKAGE_VERTICES_INDEX,
-	PLPACKAGE_TRIANGLES_INDEX,
+/////////////////////////////////////////////////////////////////
 
-	// Level
+/* decompressed entries can optionally be cached, see package_cache.c */
 
-	PLPACKAGE_LEVEL_SECTORS_INDEX, // aka 'rooms', links in with triangles?
-	PLPACKAGE_LEVEL_PORTALS_INDEX, // aka 'doors', links in with triangles and sectors?
-	PLPACKAGE_LEVEL_OBJECTS_INDEX, // list of objects within the level
+typedef struct PLPackageCacheStats {
+	size_t size;
+	size_t budget;
+	unsigned int numEntries;
+	unsigned int hits, misses, evictions;
+} PLPackageCacheStats;
 
-	// Model
+void PlSetPackageCacheSize( size_t size );
+bool PlIsPackageCacheEnabled( void );
+PLFile *PlGetCachedPackageFile( const PLPackage *package, unsigned int index );
+PLFile *PlCachePackageFile( const PLPackage *package, unsigned int index, const char *path, uint8_t *data, size_t size );
+void PlFlushPackageCache( const PLPackage *package );
+void PlGetPackageCacheStats( PLPackageCacheStats *stats );
 
-	// Texture
+/* entries with a checksum can be checked as they're loaded */
 
-	PLPACKAGE_UNKNOWN_INDEX,
+void PlSetPackageVerification( bool enable );
 
-	PLPACKAGE_LAST_INDEX
-};
+/* the native format's hashes are also used for the index cache */
 
-typedef struct PLPackageHeader { // (PACKAGE)
-	uint8_t identity[4];    // Descriptor/name of the data type. "PACK"
-	uint8_t version[2];     // Version of this type.
+uint64_t PlHashPackageFileName( const char *fileName );
+int PlComparePackageHashes( const void *a, const void *b );
+int PlFindPackageHash( const PLPackage *package, const PLPackageHash *hashes, uint32_t numHashes, const char *fileName );
 
-	uint32_t num_indexes;    // Number of data indexes (each _should_ be a fixed size?)
+/* tables built by the loaders can be kept on disk, see package_index_cache.c.
+ * Bump the loader version whenever a loader changes what it puts into the
+ * table, so anything cached from before is thrown out. */
 
-	// followed by num_indexes + length
-	// then followed by rest of data
-} PLPackageHeader;
+#define PL_PACKAGE_LOADER_VERSION 1
 
-typedef struct PLPackageIndexHeader {
-	uint16_t type;
-	uint32_t length;
+void PlSetPackageIndexCachePath( const char *path );
+bool PlIsPackageIndexCacheEnabled( void );
+PLPackage *PlLoadCachedPackageIndex( const char *path, const char **loaders, unsigned int numLoaders );
+bool PlWritePackageIndexCache( PLPackage *package, const char *loader );
+void PlDetachPackageIndexCache( PLPackage *package );
 
-	// followed by type-specific index information
-} PLPackageIndexHeader;
+/* loaders read their tables in one go and then parse them from memory */
 
-PL_EXTERN_C
-
-inline static void WritePackageHeader( FILE* handle, uint32_t num_indexes ) {
-	plAssert( handle );
-	uint8_t identity[4] = { 'P', 'A', 'C', 'K' };
-	fwrite( identity, sizeof( char ), sizeof( identity ), handle );
-	uint8_t version[2] = {
-		PLPACKAGE_VERSION_MAJOR,
-		PLPACKAGE_VERSION_MINOR
-	};
-	fwrite( version, sizeof( uint8_t ), sizeof( version ), handle );
-	fwrite( &num_indexes, sizeof( uint32_t ), 1, handle );
-}
+uint8_t *PlReadPackageTable( PLFile *file, size_t offset, size_t size );
 
-inline static void WritePackageIndexHeader( FILE* handle, uint16_t type, uint32_t length ) {
-	plAssert( handle );
-	fwrite( &type, sizeof( uint16_t ), 1, handle );
-	fwrite( &length, sizeof( uint32_t ), 1, handle );
+static inline uint32_t PlGetPackageUInt32( const uint8_t *p ) {
+	return ( uint32_t ) p[ 0 ] | ( ( uint32_t ) p[ 1 ] << 8 ) | ( ( uint32_t ) p[ 2 ] << 16 ) | ( ( uint32_t ) p[ 3 ] << 24 );
 }
 
 /////////////////////////////////////////////////////////////////
@@ -86,5 +118,6 @@ PLPackage *PlLoadFfPackage( const char *path );
 PLPackage *PlLoadWadPackage( const char *path );
 PLPackage *PlLoadRidbPackage( const char *path );
 PLPackage *PlLoadApukPackage( const char *path );
+PLPackage *PlLoadPackPackage( const char *path );
 
 PL_EXTERN_C_END
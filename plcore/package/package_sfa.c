@@ -6,8 +6,6 @@
 
 #include "package_private.h"
 
-#include "3rdparty/portable_endian.h"
-
 /* Loader for SFA TAB/BIN format */
 
 PLPackage *PlLoadTabPackage( const char *path ) {
@@ -19,12 +17,14 @@ PLPackage *PlLoadTabPackage( const char *path ) {
 		return NULL;
 	}
 
-	size_t tab_size = PlGetLocalFileSize( path );
-	if ( tab_size == 0 ) {
+	PLFileInfo tab_info;
+	if ( !PlStatFile( path, &tab_info ) || tab_info.size == 0 ) {
 		PlReportErrorF( PL_RESULT_FILESIZE, PlGetResultString( PL_RESULT_FILESIZE ) );
 		return NULL;
 	}
 
+	size_t tab_size = tab_info.size;
+
 	PLFile *fp = PlOpenFile( path, false );
 	if ( fp == NULL ) {
 		return NULL;
@@ -37,31 +37,30 @@ PLPackage *PlLoadTabPackage( const char *path ) {
 
 	unsigned int num_indices = ( unsigned int ) ( tab_size / sizeof( TabIndex ) );
 
+	/* the table is just pairs of big-endian offsets */
 	TabIndex *indices = pl_malloc( num_indices * sizeof( TabIndex ) );
-	size_t ret = PlReadFile( fp, indices, sizeof( TabIndex ), num_indices );
+	size_t ret = PlReadInt32Array( fp, ( int32_t * ) indices, num_indices * 2, true );
 	PlCloseFile( fp );
 
-	if ( ret != num_indices ) {
+	if ( ret != num_indices * 2 ) {
 		pl_free( indices );
 		return NULL;
 	}
 
-	/* swap be to le */
 	for ( unsigned int i = 0; i < num_indices; ++i ) {
 		if ( indices[ i ].start > tab_size || indices[ i ].end > tab_size ) {
 			pl_free( indices );
 			PlReportErrorF( PL_RESULT_FILESIZE, "offset outside of file bounds" );
 			return NULL;
 		}
-
-		indices[ i ].start = be32toh( indices[ i ].start );
-		indices[ i ].end = be32toh( indices[ i ].end );
 	}
 
 	PLPackage *package = PlCreatePackageHandle( path, num_indices, NULL );
 	for ( unsigned int i = 0; i < num_indices; ++i ) {
 		PLPackageIndex *index = &package->table[ i ];
-		snprintf( index->fileName, sizeof( index->fileName ), "%u", i );
+		char fileName[ 16 ];
+		snprintf( fileName, sizeof( fileName ), "%u", i );
+		PlSetPackageFileName( package, i, fileName, sizeof( fileName ) );
 		index->fileSize = indices[ i ].end - indices[ i ].start;
 		index->offset = indices[ i ].start;
 	}
@@ -80,13 +80,29 @@ PLPackage *PlLoadVsrPackage( const char *path ) {
 
 				/* fuck this, let's do this the lazy way */
 				PlFileSeek( fp, sizeof( uint32_t ) * chunk_strings.num_indices, PL_SEEK_CUR );
-				strings = pl_calloc( sizeof( VSRStringIndex ), chunk_strings.num_indices );
-				for ( unsigned int i = 0; i < chunk_strings.num_indices; ++i ) {
-					for ( unsigned int j = 0; j < 256; ++j ) {
-						strings[ i ].file_name[ j ] = PlReadInt8( fp, NULL );
-						if ( strings[ i ].file_name[ j ] == '\0' ) {
-							break;
+
+				/* names are packed back to back, so pull in as much as
+				 * they could possibly take up and split them in memory */
+				size_t block_offset = PlGetFileOffset( fp );
+				size_t file_size = PlGetFileSize( fp );
+				size_t block_size = ( block_offset < file_size ) ? file_size - block_offset : 0;
+				if ( block_size > ( size_t ) chunk_strings.num_indices * sizeof( VSRStringIndex ) ) {
+					block_size = ( size_t ) chunk_strings.num_indices * sizeof( VSRStringIndex );
+				}
+
+				if ( chunk_strings.num_indices < chunk_directory.num_indices ) {
+					PlReportErrorF( PL_RESULT_FILEERR, "fewer names than files (%u < %u)", chunk_strings.num_indices, chunk_directory.num_indices );
+				} else {
+					uint8_t *block = PlReadPackageTable( fp, block_offset, block_size );
+					if ( block != NULL ) {
+						strings = pl_calloc( sizeof( VSRStringIndex ), chunk_strings.num_indices );
+						size_t pos = 0;
+						for ( unsigned int i = 0; i < chunk_strings.num_indices && pos < block_size; ++i ) {
+							size_t length = strnlen( ( const char * ) &block[ pos ], block_size - pos );
+							memcpy( strings[ i ].file_name, &block[ pos ], ( length < sizeof( strings[ i ].file_name ) ) ? length : sizeof( strings[ i ].file_name ) - 1 );
+							pos += length + 1;
 						}
+						pl_free( block );
 					}
 				}
 			} else {
@@ -114,7 +130,7 @@ PLPackage *PlLoadVsrPackage( const char *path ) {
 		PLPackageIndex *index = &package->table[ i ];
 		index->offset = directories[ i ].offset;
 		index->fileSize = directories[ i ].length;
-		strncpy( index->fileName, strings[ i ].file_name, sizeof( index->fileName ) );
+		PlSetPackageFileName( package, i, strings[ i ].file_name, sizeof( strings[ i ].file_name ) );
 	}
 
 	pl_free( directories );
@@ -8,6 +8,7 @@
 #include <plcore/pl_linkedlist.h>
 #include <plcore/pl_parse.h>
 #include <plcore/pl_image.h>
+#include <plcore/pl_package.h>
 
 #if defined( _WIN32 )
 #include <Windows.h>
@@ -22,6 +23,7 @@
 #include <errno.h>
 
 #include "pl_private.h"
+#include "thread_private.h"
 
 /*	Generic functions for platform, such as	error handling.	*/
 
@@ -189,6 +191,11 @@ void PlShutdown( void ) {
 		pl_subsystems[ i ].active = false;
 	}
 
+	PlClearPackageLoaders();
+	PlClearImageLoaders();
+
+	PlShutdownWorkers();
+
 	PlShutdownConsole();
 }
 
@@ -308,11 +315,12 @@ const char *GetLastError_strerror( int errnum ) {
 #define MAX_FUNCTION_LENGTH 64
 #define MAX_ERROR_LENGTH 2048
 
-char
-        loc_error[ MAX_ERROR_LENGTH ] = { '\0' },
-                                    loc_function[ MAX_FUNCTION_LENGTH ] = { '\0' };
+/* errors are per-thread, so jobs running on the workers
+ * don't stomp over whatever the caller is looking at */
+static PL_THREAD_LOCAL char loc_error[ MAX_ERROR_LENGTH ] = { '\0' };
+static PL_THREAD_LOCAL char loc_function[ MAX_FUNCTION_LENGTH ] = { '\0' };
 
-PLFunctionResult global_result = PL_RESULT_SUCCESS;
+static PL_THREAD_LOCAL PLFunctionResult global_result = PL_RESULT_SUCCESS;
 
 // Returns locally generated error message.
 const char *PlGetError( void ) {
@@ -443,6 +451,26 @@ const char *PlGetFormattedTime( void ) {
 	return time_out;
 }
 
+/**
+ * Returns seconds from a monotonic clock, for timing.
+ */
+double PlGetCurrentSeconds( void ) {
+#if defined( _WIN32 )
+	static LARGE_INTEGER frequency = { 0 };
+	if ( frequency.QuadPart == 0 ) {
+		QueryPerformanceFrequency( &frequency );
+	}
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter( &counter );
+	return ( double ) counter.QuadPart / ( double ) frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ( double ) ts.tv_sec + ( double ) ts.tv_nsec / 1000000000.0;
+#endif
+}
+
 /**
  * Converts the given string to time.
  * http://stackoverflow.com/questions/1765014/convert-string-from-date-into-a-time-t
@@ -522,6 +550,7 @@ static PLPluginExportTable exportTable = {
         .GetPackageTableSize = PlGetPackageTableSize,
         .GetPackageTableIndex = PlGetPackageTableIndex,
         .GetPackageFileName = PlGetPackageFileName,
+        .SetPackageFileName = PlSetPackageFileName,
 
         .AddLogLevel = PlAddLogLevel,
         .SetLogLevelStatus = PlSetLogLevelStatus,
@@ -540,6 +569,12 @@ static PLPluginExportTable exportTable = {
         .ParseToken = PlParseToken,
         .ParseInteger = PlParseInteger,
         .ParseFloat = PlParseFloat,
+
+        .ReadInt16Array = PlReadInt16Array,
+        .ReadInt32Array = PlReadInt32Array,
+        .ReadInt64Array = PlReadInt64Array,
+        .ReadFloat32Array = PlReadFloat32Array,
+        .ReadFloat64Array = PlReadFloat64Array,
 };
 
 const PLPluginExportTable *PlGetExportTable( void ) {
@@ -0,0 +1,172 @@
+/**
+ * Hei Platform Library
+ * Copyright (C) 2017-2021 Mark E Sowden <hogsy@oldtimes-software.com>
+ * This software is licensed under MIT. See LICENSE for more details.
+ */
+
+#include "pl_private.h"
+
+/* Byte-swapping for arrays of 16, 32 and 64-bit values, used
+ * when bulk reading data that doesn't match the host's byte
+ * order. AVX2 is picked at runtime where the compiler lets us,
+ * otherwise we fall back to SSE2/NEON if they're available at
+ * compile time, and finally to plain C for whatever's left. */
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#	define BYTESWAP_SSE2
+#	include <emmintrin.h>
+#endif
+
+#if ( defined( __GNUC__ ) || defined( __clang__ ) ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#	define BYTESWAP_AVX2
+#	include <immintrin.h>
+#endif
+
+#if defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#	define BYTESWAP_NEON
+#	include <arm_neon.h>
+#endif
+
+bool _plIsHostBigEndian( void ) {
+	const uint16_t v = 1;
+	return ( *( const uint8_t * ) &v == 0 );
+}
+
+#if defined( BYTESWAP_AVX2 )
+
+static const uint8_t avx2SwapMask16[ 32 ] = {
+        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 };
+static const uint8_t avx2SwapMask32[ 32 ] = {
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 };
+static const uint8_t avx2SwapMask64[ 32 ] = {
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 };
+
+/**
+ * Swaps as many whole 32 byte blocks as possible, returning
+ * the number of bytes that were swapped.
+ */
+__attribute__( ( target( "avx2" ) ) ) static size_t SwapBytesAVX2( uint8_t *p, size_t numBytes, const uint8_t *swapMask ) {
+	__m256i mask = _mm256_loadu_si256( ( const __m256i * ) swapMask );
+	size_t i = 0;
+	for ( ; i + 32 <= numBytes; i += 32 ) {
+		__m256i v = _mm256_loadu_si256( ( const __m256i * ) ( p + i ) );
+		_mm256_storeu_si256( ( __m256i * ) ( p + i ), _mm256_shuffle_epi8( v, mask ) );
+	}
+
+	return i;
+}
+
+static bool HasAVX2( void ) {
+	return __builtin_cpu_supports( "avx2" );
+}
+
+#endif
+
+/* SSE2 doesn't have a byte shuffle, so words are shuffled
+ * into place first and then the bytes within them swapped */
+
+#if defined( BYTESWAP_SSE2 )
+static inline __m128i SwapWordBytesSSE2( __m128i v ) {
+	return _mm_or_si128( _mm_slli_epi16( v, 8 ), _mm_srli_epi16( v, 8 ) );
+}
+#endif
+
+static size_t SwapBytes16SIMD( uint8_t *p, size_t numBytes ) {
+	size_t i = 0;
+#if defined( BYTESWAP_AVX2 )
+	if ( HasAVX2() ) {
+		i = SwapBytesAVX2( p, numBytes, avx2SwapMask16 );
+	}
+#endif
+#if defined( BYTESWAP_SSE2 )
+	for ( ; i + 16 <= numBytes; i += 16 ) {
+		__m128i v = _mm_loadu_si128( ( const __m128i * ) ( p + i ) );
+		_mm_storeu_si128( ( __m128i * ) ( p + i ), SwapWordBytesSSE2( v ) );
+	}
+#elif defined( BYTESWAP_NEON )
+	for ( ; i + 16 <= numBytes; i += 16 ) {
+		vst1q_u8( p + i, vrev16q_u8( vld1q_u8( p + i ) ) );
+	}
+#endif
+	return i;
+}
+
+static size_t SwapBytes32SIMD( uint8_t *p, size_t numBytes ) {
+	size_t i = 0;
+#if defined( BYTESWAP_AVX2 )
+	if ( HasAVX2() ) {
+		i = SwapBytesAVX2( p, numBytes, avx2SwapMask32 );
+	}
+#endif
+#if defined( BYTESWAP_SSE2 )
+	for ( ; i + 16 <= numBytes; i += 16 ) {
+		__m128i v = _mm_loadu_si128( ( const __m128i * ) ( p + i ) );
+		v = _mm_shufflelo_epi16( v, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+		v = _mm_shufflehi_epi16( v, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+		_mm_storeu_si128( ( __m128i * ) ( p + i ), SwapWordBytesSSE2( v ) );
+	}
+#elif defined( BYTESWAP_NEON )
+	for ( ; i + 16 <= numBytes; i += 16 ) {
+		vst1q_u8( p + i, vrev32q_u8( vld1q_u8( p + i ) ) );
+	}
+#endif
+	return i;
+}
+
+static size_t SwapBytes64SIMD( uint8_t *p, size_t numBytes ) {
+	size_t i = 0;
+#if defined( BYTESWAP_AVX2 )
+	if ( HasAVX2() ) {
+		i = SwapBytesAVX2( p, numBytes, avx2SwapMask64 );
+	}
+#endif
+#if defined( BYTESWAP_SSE2 )
+	for ( ; i + 16 <= numBytes; i += 16 ) {
+		__m128i v = _mm_loadu_si128( ( const __m128i * ) ( p + i ) );
+		v = _mm_shufflelo_epi16( v, _MM_SHUFFLE( 0, 1, 2, 3 ) );
+		v = _mm_shufflehi_epi16( v, _MM_SHUFFLE( 0, 1, 2, 3 ) );
+		_mm_storeu_si128( ( __m128i * ) ( p + i ), SwapWordBytesSSE2( v ) );
+	}
+#elif defined( BYTESWAP_NEON )
+	for ( ; i + 16 <= numBytes; i += 16 ) {
+		vst1q_u8( p + i, vrev64q_u8( vld1q_u8( p + i ) ) );
+	}
+#endif
+	return i;
+}
+
+void _plSwapArray16( void *data, size_t count ) {
+	uint8_t *p = data;
+	size_t numBytes = count * sizeof( uint16_t );
+	for ( size_t i = SwapBytes16SIMD( p, numBytes ); i < numBytes; i += sizeof( uint16_t ) ) {
+		uint8_t t = p[ i ];
+		p[ i ] = p[ i + 1 ];
+		p[ i + 1 ] = t;
+	}
+}
+
+void _plSwapArray32( void *data, size_t count ) {
+	uint8_t *p = data;
+	size_t numBytes = count * sizeof( uint32_t );
+	for ( size_t i = SwapBytes32SIMD( p, numBytes ); i < numBytes; i += sizeof( uint32_t ) ) {
+		uint32_t v;
+		memcpy( &v, p + i, sizeof( v ) );
+		v = ( v >> 24 ) | ( ( v >> 8 ) & 0xFF00 ) | ( ( v << 8 ) & 0xFF0000 ) | ( v << 24 );
+		memcpy( p + i, &v, sizeof( v ) );
+	}
+}
+
+void _plSwapArray64( void *data, size_t count ) {
+	uint8_t *p = data;
+	size_t numBytes = count * sizeof( uint64_t );
+	for ( size_t i = SwapBytes64SIMD( p, numBytes ); i < numBytes; i += sizeof( uint64_t ) ) {
+		for ( unsigned int j = 0; j < sizeof( uint64_t ) / 2; ++j ) {
+			uint8_t t = p[ i + j ];
+			p[ i + j ] = p[ i + 7 - j ];
+			p[ i + 7 - j ] = t;
+		}
+	}
+}
@@ -4,6 +4,10 @@
  * This software is licensed under MIT. See LICENSE for more details.
  */
 
+#if defined( __linux__ )
+#define _GNU_SOURCE /* copy_file_range */
+#endif
+
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <errno.h>
@@ -11,12 +15,25 @@
 #include <unistd.h>
 #include <dirent.h>
 #endif
+#if !defined( _WIN32 )
+#include <sys/mman.h>
+#include <fcntl.h>
+#endif
+#if defined( __linux__ )
+#include <sys/sendfile.h>
+#endif
 
 #include <plcore/pl_console.h>
+#include <plcore/pl_hashtable.h>
 #include <plcore/pl_package.h>
 
 #include "filesystem_private.h"
 #include "pl_private.h"
+#include "thread_private.h"
+
+#include "package/package_private.h"
+
+#include "package/miniz/miniz.h"
 
 #if defined( _WIN32 )
 #include "3rdparty/portable_endian.h"
@@ -52,18 +69,569 @@ typedef enum FSMountType {
 	FS_MOUNT_PACKAGE,
 } FSMountType;
 
+/* Every file provided by a mount gets an entry in the path index,
+ * so resolving a path doesn't mean probing each mount in turn.
+ * Entries sharing a path are chained in the order their mounts
+ * are searched in, however late they were added to the index. */
+typedef struct FSIndexEntry {
+	struct PLFileSystemMount *mount;
+	char *path;                      /* normalized, relative to the mount */
+	int packageIndex;                /* FS_MOUNT_PACKAGE, otherwise -1 */
+	struct FSIndexEntry *next;       /* next entry with the same path */
+	struct FSIndexEntry *nextFolded; /* next entry with the same case-folded path */
+	struct FSIndexEntry *nextAdded;  /* added after the mount was indexed */
+	bool isRemoved;                  /* no longer in the index, but still owned by the mount */
+} FSIndexEntry;
+
+/* Packages don't have directories of their own, so a tree is
+ * built from the table when they're mounted. Scans and path
+ * checks then only touch the directories they're asking about. */
+typedef struct FSPackageDirectory {
+	unsigned int *files; /* indices into the package table */
+	unsigned int numFiles, maxFiles;
+	struct FSPackageDirectory **children;
+	unsigned int numChildren, maxChildren;
+} FSPackageDirectory;
+
 typedef struct PLFileSystemMount {
 	FSMountType type;
 	union {
 		PLPackage *pkg;                  /* FS_MOUNT_PACKAGE */
 		char path[ PL_SYSTEM_MAX_PATH ]; /* FS_MOUNT_DIR */
 	};
+	FSIndexEntry *indexEntries;
+	unsigned int numIndexEntries;
+	FSIndexEntry *addedEntries; /* FS_MOUNT_DIR, picked up by the watch since */
+	PLFileWatch *watch;         /* FS_MOUNT_DIR */
+	time_t timeStamp;          /* FS_MOUNT_PACKAGE */
+	PLHashTable *directories; /* FS_MOUNT_PACKAGE, normalized path to FSPackageDirectory */
+	PLHashTable *localDirectories; /* FS_MOUNT_DIR, normalized path of every directory beneath it */
+	unsigned int order;        /* position in the search order, higher is searched later */
 	struct PLFileSystemMount *next, *prev;
 } PLFileSystemMount;
 static PLFileSystemMount *fs_mount_root = NULL;
 static PLFileSystemMount *fs_mount_ceiling = NULL;
+static unsigned int fs_mount_order = 0;
+/* directories that aren't watched, so can't be answered by the index alone */
+static unsigned int fs_num_unwatched_mounts = 0;
+
+static PLHashTable *fs_index = NULL;
+static PLHashTable *fs_index_folded = NULL;
+/* watched mounts change the index as files come and go, while
+ * lookups can be made from any of the workers */
+static PLReadWriteLock *fs_index_lock = NULL;
+
+static PLConsoleVariable *fs_casefold = NULL;
+static PLConsoleVariable *fs_buffer_size = NULL;
+static PLConsoleVariable *fs_cache_size = NULL;
+static PLConsoleVariable *fs_watch_mounts = NULL;
+static PLConsoleVariable *fs_miss_cache_size = NULL;
+static PLConsoleVariable *fs_verify_packages = NULL;
+static PLConsoleVariable *fs_package_index_cache = NULL;
 
 #define FS_LOCAL_HINT "local://"
+#define FS_LOCAL_HINT_LENGTH ( sizeof( FS_LOCAL_HINT ) - 1 )
+
+static void IndexLocalDirectory( struct PLFileSystemMount *mount, unsigned int *maxEntries );
+static bool WriteFileChunked( PLFile *ptr, FILE *out );
+static void FinishDirectoryMount( struct PLFileSystemMount *mount );
+static void AddWrittenLocalPath( const char *path, bool isDirectory );
+
+/**
+ * Converts the given path into the form used by the path index;
+ * forward slashes only, with no leading, trailing or repeated
+ * separators and no "./" components.
+ */
+static const char *NormalizePath( const char *path, char *out, size_t size ) {
+	size_t n = 0;
+	for ( const char *p = path; *p != '\0' && n + 1 < size; ++p ) {
+		char c = ( *p == '\\' ) ? '/' : *p;
+		if ( c == '/' && ( n == 0 || out[ n - 1 ] == '/' ) ) {
+			continue;
+		} else if ( c == '.' && ( n == 0 || out[ n - 1 ] == '/' ) &&
+		            ( p[ 1 ] == '/' || p[ 1 ] == '\\' || p[ 1 ] == '\0' ) ) {
+			continue;
+		}
+
+		out[ n++ ] = c;
+	}
+
+	if ( n > 0 && out[ n - 1 ] == '/' ) {
+		n--;
+	}
+	out[ n ] = '\0';
+
+	return out;
+}
+
+static const char *FoldPath( const char *path, char *out, size_t size ) {
+	size_t n = 0;
+	for ( ; path[ n ] != '\0' && n + 1 < size; ++n ) {
+		out[ n ] = ( char ) tolower( ( unsigned char ) path[ n ] );
+	}
+	out[ n ] = '\0';
+
+	return out;
+}
+
+static void LinkIndexEntry( PLHashTable *table, const char *key, FSIndexEntry *entry, bool folded ) {
+	size_t keyLength = strlen( key );
+	FSIndexEntry *head = PlLookupHashTableUserData( table, key, keyLength );
+	if ( head == NULL ) {
+		PlInsertHashTableNode( table, key, keyLength, entry );
+		return;
+	}
+
+	/* entries can be added by the watch, or a remount, well after
+	 * later mounts, so they're slotted in by the mount's position */
+	if ( head->mount->order > entry->mount->order ) {
+		if ( folded ) {
+			entry->nextFolded = head;
+		} else {
+			entry->next = head;
+		}
+		PlRemoveHashTableNode( table, key, keyLength );
+		PlInsertHashTableNode( table, key, keyLength, entry );
+		return;
+	}
+
+	FSIndexEntry **link = &head;
+	while ( *link != NULL && ( *link )->mount->order <= entry->mount->order ) {
+		link = folded ? &( *link )->nextFolded : &( *link )->next;
+	}
+	if ( folded ) {
+		entry->nextFolded = *link;
+	} else {
+		entry->next = *link;
+	}
+	*link = entry;
+}
+
+static void UnlinkIndexEntry( PLHashTable *table, const char *key, FSIndexEntry *entry, bool folded ) {
+	size_t keyLength = strlen( key );
+	FSIndexEntry *head = PlLookupHashTableUserData( table, key, keyLength );
+	if ( head == entry ) {
+		PlRemoveHashTableNode( table, key, keyLength );
+
+		FSIndexEntry *next = folded ? entry->nextFolded : entry->next;
+		if ( next != NULL ) {
+			PlInsertHashTableNode( table, key, keyLength, next );
+		}
+		return;
+	}
+
+	FSIndexEntry **link = &head;
+	while ( *link != NULL ) {
+		if ( *link == entry ) {
+			*link = folded ? entry->nextFolded : entry->next;
+			return;
+		}
+		link = folded ? &( *link )->nextFolded : &( *link )->next;
+	}
+}
+
+static FSIndexEntry *AddIndexEntry( PLFileSystemMount *mount, unsigned int *maxEntries, const char *path, int packageIndex ) {
+	if ( mount->numIndexEntries >= *maxEntries ) {
+		*maxEntries = ( *maxEntries == 0 ) ? 256 : *maxEntries * 2;
+		FSIndexEntry *entries = pl_realloc( mount->indexEntries, sizeof( FSIndexEntry ) * *maxEntries );
+		if ( entries == NULL ) {
+			return NULL;
+		}
+		mount->indexEntries = entries;
+	}
+
+	char buf[ PL_SYSTEM_MAX_PATH ];
+	NormalizePath( path, buf, sizeof( buf ) );
+	size_t length = strlen( buf ) + 1;
+
+	FSIndexEntry *entry = &mount->indexEntries[ mount->numIndexEntries++ ];
+	memset( entry, 0, sizeof( FSIndexEntry ) );
+	entry->mount = mount;
+	entry->packageIndex = packageIndex;
+	entry->path = pl_malloc( length );
+	memcpy( entry->path, buf, length );
+
+	return entry;
+}
+
+static bool AppendToArray( void **array, unsigned int *num, unsigned int *max, size_t size, const void *element ) {
+	if ( *num >= *max ) {
+		unsigned int newMax = ( *max == 0 ) ? 8 : *max * 2;
+		void *newArray = pl_realloc( *array, size * newMax );
+		if ( newArray == NULL ) {
+			return false;
+		}
+		*array = newArray;
+		*max = newMax;
+	}
+
+	memcpy( ( uint8_t * ) *array + size * ( *num )++, element, size );
+	return true;
+}
+
+/**
+ * Returns the directory for the given normalized path, creating
+ * it along with any missing parents if requested.
+ */
+static FSPackageDirectory *GetPackageDirectory( PLFileSystemMount *mount, const char *path, bool create ) {
+	size_t length = strlen( path );
+	FSPackageDirectory *directory = PlLookupHashTableUserData( mount->directories, path, length );
+	if ( directory != NULL || !create ) {
+		return directory;
+	}
+
+	directory = pl_calloc( 1, sizeof( FSPackageDirectory ) );
+	if ( directory == NULL || !PlInsertHashTableNode( mount->directories, path, length, directory ) ) {
+		pl_free( directory );
+		return NULL;
+	}
+
+	/* the root is the only one without a parent */
+	if ( length > 0 ) {
+		char parentPath[ PL_SYSTEM_MAX_PATH ];
+		snprintf( parentPath, sizeof( parentPath ), "%s", path );
+		char *c = strrchr( parentPath, '/' );
+		*( c != NULL ? c : parentPath ) = '\0';
+
+		FSPackageDirectory *parent = GetPackageDirectory( mount, parentPath, true );
+		if ( parent != NULL ) {
+			AppendToArray( ( void ** ) &parent->children, &parent->numChildren, &parent->maxChildren, sizeof( FSPackageDirectory * ), &directory );
+		}
+	}
+
+	return directory;
+}
+
+static void BuildPackageDirectories( PLFileSystemMount *mount ) {
+	mount->directories = PlCreateHashTable();
+	if ( mount->directories == NULL ) {
+		return;
+	}
+
+	GetPackageDirectory( mount, "", true );
+
+	char path[ PL_SYSTEM_MAX_PATH ];
+	for ( unsigned int i = 0; i < mount->pkg->table_size; ++i ) {
+		NormalizePath( PlGetPackageFileName( mount->pkg, i ), path, sizeof( path ) );
+		char *c = strrchr( path, '/' );
+		*( c != NULL ? c : path ) = '\0';
+
+		FSPackageDirectory *directory = GetPackageDirectory( mount, path, true );
+		if ( directory != NULL ) {
+			AppendToArray( ( void ** ) &directory->files, &directory->numFiles, &directory->maxFiles, sizeof( unsigned int ), &i );
+		}
+	}
+}
+
+static void FreePackageDirectory( void *value, void *userData ) {
+	PlUnused( userData );
+
+	FSPackageDirectory *directory = ( FSPackageDirectory * ) value;
+	pl_free( directory->files );
+	pl_free( directory->children );
+	pl_free( directory );
+}
+
+static void DestroyPackageDirectories( PLFileSystemMount *mount ) {
+	if ( mount->directories == NULL ) {
+		return;
+	}
+
+	PlIterateHashTable( mount->directories, FreePackageDirectory, NULL );
+	PlDestroyHashTable( mount->directories );
+	mount->directories = NULL;
+}
+
+/* The directories under a mounted directory are kept alongside its
+ * files, so checking whether a path exists doesn't need the disk. */
+
+static void AddLocalDirectory( PLHashTable *directories, const char *path ) {
+	char buf[ PL_SYSTEM_MAX_PATH ];
+	NormalizePath( path, buf, sizeof( buf ) );
+	size_t length = strlen( buf );
+	if ( PlLookupHashTableUserData( directories, buf, length ) != NULL ) {
+		return;
+	}
+
+	/* the key is kept as the value, so it can be matched against later */
+	char *key = pl_malloc( length + 1 );
+	memcpy( key, buf, length + 1 );
+	if ( !PlInsertHashTableNode( directories, key, length, key ) ) {
+		pl_free( key );
+	}
+}
+
+typedef struct FSDirectoryMatch {
+	const char *path;
+	char **matches;
+	unsigned int numMatches, maxMatches;
+} FSDirectoryMatch;
+
+static void MatchLocalDirectory( void *value, void *userData ) {
+	FSDirectoryMatch *match = ( FSDirectoryMatch * ) userData;
+	char *directory = ( char * ) value;
+
+	size_t length = strlen( match->path );
+	if ( length == 0 || ( strncmp( directory, match->path, length ) == 0 && ( directory[ length ] == '\0' || directory[ length ] == '/' ) ) ) {
+		AppendToArray( ( void ** ) &match->matches, &match->numMatches, &match->maxMatches, sizeof( char * ), &directory );
+	}
+}
+
+/**
+ * Removes the given normalized path from the mount's directories,
+ * along with everything beneath it.
+ */
+static void RemoveLocalDirectories( PLHashTable *directories, const char *path ) {
+	/* can't remove anything while it's being iterated over */
+	FSDirectoryMatch match = { .path = path };
+	PlIterateHashTable( directories, MatchLocalDirectory, &match );
+
+	for ( unsigned int i = 0; i < match.numMatches; ++i ) {
+		PlRemoveHashTableNode( directories, match.matches[ i ], strlen( match.matches[ i ] ) );
+		pl_free( match.matches[ i ] );
+	}
+
+	pl_free( match.matches );
+}
+
+static void FreeLocalDirectory( void *value, void *userData ) {
+	PlUnused( userData );
+	pl_free( value );
+}
+
+static void DestroyLocalDirectories( PLFileSystemMount *mount ) {
+	if ( mount->localDirectories == NULL ) {
+		return;
+	}
+
+	PlIterateHashTable( mount->localDirectories, FreeLocalDirectory, NULL );
+	PlDestroyHashTable( mount->localDirectories );
+	mount->localDirectories = NULL;
+}
+
+/**
+ * Adds everything provided by the given mount into the path index.
+ */
+static void AddMountToIndex( PLFileSystemMount *mount ) {
+	if ( fs_index == NULL ) {
+		fs_index = PlCreateHashTable();
+		fs_index_folded = PlCreateHashTable();
+		fs_index_lock = PlCreateReadWriteLock();
+	}
+
+	/* entries share the timestamp of their package, which saves
+	 * us from hitting the disk for every stat */
+	if ( mount->type == FS_MOUNT_PACKAGE && mount->pkg->internal.file != NULL ) {
+		mount->timeStamp = PlGetFileTimeStamp( mount->pkg->internal.file );
+	}
+
+	unsigned int maxEntries = 0;
+	if ( mount->type == FS_MOUNT_DIR ) {
+		IndexLocalDirectory( mount, &maxEntries );
+	} else {
+		for ( unsigned int i = 0; i < mount->pkg->table_size; ++i ) {
+			AddIndexEntry( mount, &maxEntries, PlGetPackageFileName( mount->pkg, i ), ( int ) i );
+		}
+
+		BuildPackageDirectories( mount );
+	}
+
+	/* entries can't be linked until the array has stopped moving about */
+	char folded[ PL_SYSTEM_MAX_PATH ];
+	PlLockWrite( fs_index_lock );
+	for ( unsigned int i = 0; i < mount->numIndexEntries; ++i ) {
+		FSIndexEntry *entry = &mount->indexEntries[ i ];
+		LinkIndexEntry( fs_index, entry->path, entry, false );
+		LinkIndexEntry( fs_index_folded, FoldPath( entry->path, folded, sizeof( folded ) ), entry, true );
+	}
+	PlUnlockWrite( fs_index_lock );
+
+	PlFlushMissCache();
+
+	FSLog( "Indexed %u files\n", mount->numIndexEntries );
+}
+
+static void UnlinkMountIndexEntry( FSIndexEntry *entry ) {
+	char folded[ PL_SYSTEM_MAX_PATH ];
+	UnlinkIndexEntry( fs_index, entry->path, entry, false );
+	UnlinkIndexEntry( fs_index_folded, FoldPath( entry->path, folded, sizeof( folded ) ), entry, true );
+	entry->isRemoved = true;
+}
+
+static void RemoveMountFromIndex( PLFileSystemMount *mount ) {
+	PlLockWrite( fs_index_lock );
+	for ( unsigned int i = 0; i < mount->numIndexEntries; ++i ) {
+		FSIndexEntry *entry = &mount->indexEntries[ i ];
+		if ( !entry->isRemoved ) {
+			UnlinkMountIndexEntry( entry );
+		}
+		pl_free( entry->path );
+	}
+
+	pl_free( mount->indexEntries );
+	mount->indexEntries = NULL;
+	mount->numIndexEntries = 0;
+
+	while ( mount->addedEntries != NULL ) {
+		FSIndexEntry *entry = mount->addedEntries;
+		mount->addedEntries = entry->nextAdded;
+		UnlinkMountIndexEntry( entry );
+		pl_free( entry->path );
+		pl_free( entry );
+	}
+	DestroyLocalDirectories( mount );
+	PlUnlockWrite( fs_index_lock );
+
+	DestroyPackageDirectories( mount );
+	PlFlushMissCache();
+}
+
+/* opening a packaged file can mean opening the package again by
+ * path, so readers only take the lock on the way in */
+static PL_THREAD_LOCAL unsigned int fs_index_read_depth = 0;
+
+static void LockIndexForRead( void ) {
+	if ( fs_index_lock != NULL && fs_index_read_depth++ == 0 ) {
+		PlLockRead( fs_index_lock );
+	}
+}
+
+static void UnlockIndexForRead( void ) {
+	if ( fs_index_lock != NULL && --fs_index_read_depth == 0 ) {
+		PlUnlockRead( fs_index_lock );
+	}
+}
+
+/**
+ * Returns the first entry in the index for the given path. If
+ * case folding is enabled and there's no exact match, the
+ * case-folded index is checked instead, in which case the
+ * entries need to be walked via nextFolded. The index needs
+ * to be locked for as long as the entries are in use.
+ */
+static const FSIndexEntry *LookupIndex( const char *path, bool *folded ) {
+	*folded = false;
+	if ( fs_index == NULL ) {
+		return NULL;
+	}
+
+	char buf[ PL_SYSTEM_MAX_PATH ];
+	NormalizePath( path, buf, sizeof( buf ) );
+
+	const FSIndexEntry *entry = PlLookupHashTableUserData( fs_index, buf, strlen( buf ) );
+	if ( entry != NULL || fs_casefold == NULL || !fs_casefold->b_value ) {
+		return entry;
+	}
+
+	*folded = true;
+	FoldPath( buf, buf, sizeof( buf ) );
+	return PlLookupHashTableUserData( fs_index_folded, buf, strlen( buf ) );
+}
+
+/**
+ * Remembers that the given normalized path couldn't be found. That's
+ * only safe if every mounted directory is being watched, otherwise
+ * there'd be no telling when the file turns up.
+ */
+static void CacheMissedPath( const char *path ) {
+	if ( fs_num_unwatched_mounts > 0 ) {
+		return;
+	}
+
+	PlCacheMiss( path );
+}
+
+static bool IsUnwatchedMount( const PLFileSystemMount *mount ) {
+	return ( mount->type == FS_MOUNT_DIR && mount->watch == NULL );
+}
+
+static PLFileSystemMount *FindUnwatchedMount( PLFileSystemMount *location ) {
+	if ( fs_num_unwatched_mounts == 0 ) {
+		return NULL;
+	}
+
+	while ( location != NULL && !IsUnwatchedMount( location ) ) {
+		location = location->next;
+	}
+
+	return location;
+}
+
+/* Unwatched directories are only indexed when they're mounted, so
+ * anything created since wouldn't be found. Rather than trusting the
+ * index for them, they're checked on disk at their place in the search
+ * order, while everything else is answered from the index. */
+typedef struct FSMountedLookup {
+	const FSIndexEntry *entry;      /* next entry in the index to try */
+	bool folded;
+	PLFileSystemMount *unwatched;   /* next unwatched directory to check */
+	bool isIndexed;
+} FSMountedLookup;
+
+/**
+ * Starts looking up the given normalized path. The index needs
+ * to be locked for as long as the lookup is in use.
+ */
+static void BeginMountedLookup( FSMountedLookup *lookup, const char *key ) {
+	lookup->entry = LookupIndex( key, &lookup->folded );
+	lookup->unwatched = FindUnwatchedMount( fs_mount_root );
+	lookup->isIndexed = ( lookup->entry != NULL );
+}
+
+/**
+ * Fetches whatever should be tried next for the path, in the order
+ * mounts are searched, which is either an entry from the index or
+ * an unwatched directory to check for it.
+ * @return False once there's nothing left to try.
+ */
+static bool NextMountedLookup( FSMountedLookup *lookup, const FSIndexEntry **entry, PLFileSystemMount **location ) {
+	while ( lookup->entry != NULL && IsUnwatchedMount( lookup->entry->mount ) ) {
+		lookup->entry = lookup->folded ? lookup->entry->nextFolded : lookup->entry->next;
+	}
+
+	*entry = NULL;
+	*location = NULL;
+
+	if ( lookup->unwatched != NULL && ( lookup->entry == NULL || lookup->unwatched->order < lookup->entry->mount->order ) ) {
+		*location = lookup->unwatched;
+		lookup->unwatched = FindUnwatchedMount( lookup->unwatched->next );
+		return true;
+	}
+
+	if ( lookup->entry != NULL ) {
+		*entry = lookup->entry;
+		lookup->entry = lookup->folded ? lookup->entry->nextFolded : lookup->entry->next;
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Writes out where the normalized path would be under the given
+ * directory mount. Returns false if it doesn't fit.
+ */
+static bool GetMountedLocalPath( const PLFileSystemMount *location, const char *key, char *out, size_t size ) {
+	/* todo: don't allow path to search outside of mounted path */
+	int length = snprintf( out, size, "%s/%s", location->path, key );
+	return ( length > 0 && ( size_t ) length < size );
+}
+
+static void GetIndexEntryLocalPath( const FSIndexEntry *entry, char *out, size_t size ) {
+	snprintf( out, size, "%s/%s", entry->mount->path, entry->path );
+}
+
+static bool ExtractPackageProgress( unsigned int numExtracted, unsigned int numFiles, uint64_t numBytes, void *userData ) {
+	/* just often enough to show it's still going */
+	double *lastReport = ( double * ) userData;
+	double time = PlGetCurrentSeconds();
+	if ( time - *lastReport >= 1.0 ) {
+		Print( "Extracted %u/%u files, %.1f MB\n", numExtracted, numFiles, ( double ) numBytes / ( 1024.0 * 1024.0 ) );
+		*lastReport = time;
+	}
+
+	return true;
+}
 
 IMPLEMENT_COMMAND( fsExtractPkg, "Extract the contents of a package." ) {
 	if ( argc == 1 ) {
@@ -83,37 +651,15 @@ IMPLEMENT_COMMAND( fsExtractPkg, "Extract the contents of a package." ) {
 		return;
 	}
 
-	for ( unsigned int i = 0; i < pkg->table_size; ++i ) {
-		PLFile *file = PlLoadPackageFileByIndex( pkg, i );
-		if ( file == NULL ) {
-			PrintWarning( "Failed to load file at index %d, \"%s\"!\nPL: %s\n", i, pkg->table[ i ].fileName, PlGetError() );
-			continue;
-		}
-
-		char pkgPath[ PL_SYSTEM_MAX_PATH ];
-		memset( pkgPath, 0, sizeof( pkgPath ) );
-		strncpy( pkgPath, file->path, strlen( file->path ) - strlen( PlGetFileName( file->path ) ) );
-
-		char outPath[ PL_SYSTEM_MAX_PATH ];
-		snprintf( outPath, sizeof( outPath ), "extracted/%s", pkgPath );
-		if ( !PlCreatePath( outPath ) ) {
-			PrintWarning( "Failed to create path, \"%s\"!\nPL: %s\n", outPath, PlGetError() );
-			break;
-		}
-
-		snprintf( outPath, sizeof( outPath ), "extracted/%s", file->path );
-
-		FILE *fout = fopen( outPath, "wb" );
-		if ( fout == NULL ) {
-			PrintWarning( "Failed to write file to destination, \"%s\"!\n", outPath );
-			break;
-		}
-		fwrite( PlGetFileData( file ), sizeof( uint8_t ), PlGetFileSize( file ), fout );
-		fclose( fout );
-
-		Print( "Wrote \"%s\"\n", outPath );
+	double startTime = PlGetCurrentSeconds();
+	double lastReport = startTime;
+	unsigned int numFailed = PlExtractPackage( pkg, "extracted", ExtractPackageProgress, &lastReport );
+	double seconds = PlGetCurrentSeconds() - startTime;
+	if ( numFailed > 0 ) {
+		PrintWarning( "Failed to extract %u files!\nPL: %s\n", numFailed, PlGetError() );
 	}
-	Print( "End\n" );
+
+	Print( "Finished extracting \"%s\" in %.2f seconds\n", path, seconds );
 
 	PlDestroyPackage( pkg );
 }
@@ -146,7 +692,7 @@ IMPLEMENT_COMMAND( fsLstPkg, "List all the files in a particular package." ) {
 		       " ctype:  %d\n"
 		       " offset: %u\n",
 		       i,
-		       pkg->table[ i ].fileName,
+		       PlGetPackageFileName( pkg, i ),
 		       pkg->table[ i ].fileSize,
 		       pkg->table[ i ].compressedSize,
 		       pkg->table[ i ].compressionType,
@@ -215,30 +761,140 @@ IMPLEMENT_COMMAND( fsMount, "Mount the specified directory." ) {
 	PlMountLocation( path );
 }
 
-static void _plRegisterFSCommands( void ) {
-	PLConsoleCommand fsCommands[] = {
-	        fsExtractPkg_var,
-	        fsLstPkg_var,
-	        fsListMounted_var,
-	        fsUnmount_var,
-	        fsMount_var,
-	};
-	for ( unsigned int i = 0; i < plArrayElements( fsCommands ); ++i ) {
-		PlRegisterConsoleCommand( fsCommands[ i ].cmd, fsCommands[ i ].Callback, fsCommands[ i ].description );
-	}
+IMPLEMENT_COMMAND( fsCacheStats, "Prints out statistics for the package cache." ) {
+	PlUnused( argc );
+	PlUnused( argv );
+
+	PLPackageCacheStats stats;
+	PlGetPackageCacheStats( &stats );
+
+	unsigned int numLookups = stats.hits + stats.misses;
+	Print( "%u entries, %.2f/%.2f MiB\n", stats.numEntries, PlBytesToMebibytes( stats.size ), PlBytesToMebibytes( stats.budget ) );
+	Print( "%u hits, %u misses (%.1f%% hit rate), %u evictions\n",
+	       stats.hits, stats.misses, ( numLookups > 0 ) ? ( stats.hits * 100.0 ) / numLookups : 0.0, stats.evictions );
 }
 
-void PlClearMountedLocation( PLFileSystemMount *location ) {
-	if ( location->type == FS_MOUNT_PACKAGE ) {
-		PlDestroyPackage( location->pkg );
-		location->pkg = NULL;
-	}
+IMPLEMENT_COMMAND( fsMissCacheStats, "Prints out statistics for the cache of paths that weren't found." ) {
+	PlUnused( argc );
+	PlUnused( argv );
 
-	if ( location->prev != NULL ) {
-		location->prev->next = location->next;
+	PLMissCacheStats stats;
+	PlGetMissCacheStats( &stats );
+
+	unsigned int numLookups = stats.hits + stats.misses;
+	Print( "%u/%u entries\n", stats.numEntries, stats.maxEntries );
+	Print( "%u hits, %u misses (%.1f%% hit rate), %u evictions, %u flushes\n",
+	       stats.hits, stats.misses, ( numLookups > 0 ) ? ( stats.hits * 100.0 ) / numLookups : 0.0, stats.evictions, stats.flushes );
+}
+
+IMPLEMENT_COMMAND( fsTraceStart, "Records every file opened from a mounted location to the given trace." ) {
+	if ( argc < 2 ) {
+		Print( "%s", fsTraceStart_var.description );
+		return;
 	}
-	if ( location->next != NULL ) {
-		location->next->prev = location->prev;
+
+	if ( !PlStartAccessTrace( argv[ 1 ] ) ) {
+		PrintWarning( "Failed to start trace: %s\n", PlGetError() );
+	}
+}
+
+IMPLEMENT_COMMAND( fsTraceStop, "Stops recording the current trace." ) {
+	PlUnused( argc );
+	PlUnused( argv );
+
+	PlStopAccessTrace();
+}
+
+IMPLEMENT_COMMAND( fsTraceReplay, "Prefetches everything opened by the given trace, in the background." ) {
+	if ( argc < 2 ) {
+		Print( "%s", fsTraceReplay_var.description );
+		return;
+	}
+
+	if ( !PlReplayAccessTrace( argv[ 1 ] ) ) {
+		PrintWarning( "Failed to replay trace: %s\n", PlGetError() );
+	}
+}
+
+static void FSCacheSizeCallback( const PLConsoleVariable *variable ) {
+	PlSetPackageCacheSize( ( variable->i_value > 0 ) ? ( size_t ) variable->i_value * 1024 : 0 );
+}
+
+static void FSMissCacheSizeCallback( const PLConsoleVariable *variable ) {
+	PlSetMissCacheSize( ( variable->i_value > 0 ) ? ( unsigned int ) variable->i_value : 0 );
+}
+
+static void FSPackageIndexCacheCallback( const PLConsoleVariable *variable ) {
+	PlSetPackageIndexCachePath( variable->value );
+}
+
+static void FSVerifyPackagesCallback( const PLConsoleVariable *variable ) {
+	PlSetPackageVerification( variable->b_value );
+}
+
+static void FSCaseFoldCallback( const PLConsoleVariable *variable ) {
+	PlUnused( variable );
+
+	/* paths that missed before may match now */
+	PlFlushMissCache();
+}
+
+static void _plRegisterFSCommands( void ) {
+	PLConsoleCommand fsCommands[] = {
+	        fsExtractPkg_var,
+	        fsLstPkg_var,
+	        fsListMounted_var,
+	        fsUnmount_var,
+	        fsMount_var,
+	        fsCacheStats_var,
+	        fsMissCacheStats_var,
+	        fsTraceStart_var,
+	        fsTraceStop_var,
+	        fsTraceReplay_var,
+	};
+	for ( unsigned int i = 0; i < plArrayElements( fsCommands ); ++i ) {
+		PlRegisterConsoleCommand( fsCommands[ i ].cmd, fsCommands[ i ].Callback, fsCommands[ i ].description );
+	}
+
+	fs_casefold = PlRegisterConsoleVariable( "fs.casefold", "0", pl_bool_var, FSCaseFoldCallback,
+	                                         "If enabled, paths that aren't found in any mounted location are matched case-insensitively." );
+	fs_buffer_size = PlRegisterConsoleVariable( "fs.bufferSize", "32768", pl_int_var, NULL,
+	                                            "Size of the read-ahead buffer for uncached files, in bytes. 0 disables buffering." );
+	fs_cache_size = PlRegisterConsoleVariable( "fs.cacheSize", "0", pl_int_var, FSCacheSizeCallback,
+	                                           "Memory set aside for caching decompressed package files, in KiB. 0 disables the cache." );
+	fs_watch_mounts = PlRegisterConsoleVariable( "fs.watchMounts", "1", pl_bool_var, NULL,
+	                                             "If enabled, mounted directories are watched so files added or removed are picked up. Changes are applied by PlPollWatchedPaths." );
+	fs_miss_cache_size = PlRegisterConsoleVariable( "fs.missCacheSize", "0", pl_int_var, FSMissCacheSizeCallback,
+	                                                "Number of paths that weren't found to remember, so probing for them again is cheap. 0 disables the cache. "
+	                                                "Files created outside the library aren't found until PlPollWatchedPaths is called, so only enable it when mounts are watched and polled." );
+	FSMissCacheSizeCallback( fs_miss_cache_size );
+	fs_verify_packages = PlRegisterConsoleVariable( "fs.verifyPackages", "0", pl_bool_var, FSVerifyPackagesCallback,
+	                                                "If enabled, packaged files are checked against their checksum, where they have one, as they're loaded." );
+	fs_package_index_cache = PlRegisterConsoleVariable( "fs.packageIndexCache", "", pl_string_var, FSPackageIndexCacheCallback,
+	                                                    "Local directory that package tables are cached in, so they don't need to be parsed again. Empty disables the cache." );
+}
+
+void PlClearMountedLocation( PLFileSystemMount *location ) {
+	/* replays work from the mounts */
+	PlWaitAccessTraceReplay();
+
+	if ( IsUnwatchedMount( location ) ) {
+		fs_num_unwatched_mounts--;
+	}
+
+	PlUnwatchPath( location->watch );
+	RemoveMountFromIndex( location );
+
+	if ( location->type == FS_MOUNT_PACKAGE ) {
+		PlDestroyPackage( location->pkg );
+		location->pkg = NULL;
+	}
+
+	if ( location->prev != NULL ) {
+		location->prev->next = location->next;
+	}
+	if ( location->next != NULL ) {
+		location->next->prev = location->prev;
 	}
 
 	/* ensure root and ceiling are always pointing to a valid location */
@@ -270,14 +926,17 @@ static void _plInsertMountLocation( PLFileSystemMount *location ) {
 	}
 	fs_mount_ceiling = location;
 	location->next = NULL;
+	location->order = fs_mount_order++;
 }
 
 PLFileSystemMount *PlMountLocalLocation( const char *path ) {
-	PLFileSystemMount *location = pl_malloc( sizeof( PLFileSystemMount ) );
+	PLFileSystemMount *location = pl_calloc( 1, sizeof( PLFileSystemMount ) );
 	if ( PlLocalPathExists( path ) ) { /* attempt to mount it as a path */
 		_plInsertMountLocation( location );
 		location->type = FS_MOUNT_DIR;
 		snprintf( location->path, sizeof( location->path ), "%s", path );
+		AddMountToIndex( location );
+		FinishDirectoryMount( location );
 
 		Print( "Mounted directory %s successfully!\n", path );
 
@@ -287,7 +946,7 @@ PLFileSystemMount *PlMountLocalLocation( const char *path ) {
 		// path here, so the only reasonable solution right now is to prefix
 		// it with the local dir hint
 		char localPath[ PL_SYSTEM_MAX_PATH ];
-		if ( strncmp( FS_LOCAL_HINT, path, sizeof( FS_LOCAL_HINT ) ) != 0 ) {
+		if ( strncmp( FS_LOCAL_HINT, path, FS_LOCAL_HINT_LENGTH ) != 0 ) {
 			snprintf( localPath, sizeof( localPath ), FS_LOCAL_HINT "%s", path );
 		} else {
 			snprintf( localPath, sizeof( localPath ), "%s", path );
@@ -298,6 +957,7 @@ PLFileSystemMount *PlMountLocalLocation( const char *path ) {
 			_plInsertMountLocation( location );
 			location->type = FS_MOUNT_PACKAGE;
 			location->pkg = pkg;
+			AddMountToIndex( location );
 
 			Print( "Mounted package %s successfully!\n", path );
 
@@ -315,16 +975,18 @@ PLFileSystemMount *PlMountLocalLocation( const char *path ) {
  * Mount the given location. On failure returns -1.
  */
 PLFileSystemMount *PlMountLocation( const char *path ) {
-	if ( strncmp( FS_LOCAL_HINT, path, sizeof( FS_LOCAL_HINT ) ) == 0 ) {
-		path += sizeof( FS_LOCAL_HINT );
+	if ( strncmp( FS_LOCAL_HINT, path, FS_LOCAL_HINT_LENGTH ) == 0 ) {
+		path += FS_LOCAL_HINT_LENGTH;
 		return PlMountLocalLocation( path );
 	}
 
-	PLFileSystemMount *location = pl_malloc( sizeof( PLFileSystemMount ) );
+	PLFileSystemMount *location = pl_calloc( 1, sizeof( PLFileSystemMount ) );
 	if ( PlPathExists( path ) ) { /* attempt to mount it as a path */
 		_plInsertMountLocation( location );
 		location->type = FS_MOUNT_DIR;
 		snprintf( location->path, sizeof( location->path ), "%s", path );
+		AddMountToIndex( location );
+		FinishDirectoryMount( location );
 
 		Print( "Mounted directory %s successfully!\n", path );
 
@@ -335,6 +997,7 @@ PLFileSystemMount *PlMountLocation( const char *path ) {
 			_plInsertMountLocation( location );
 			location->type = FS_MOUNT_PACKAGE;
 			location->pkg = pkg;
+			AddMountToIndex( location );
 
 			Print( "Mounted package %s successfully!\n", path );
 
@@ -352,13 +1015,19 @@ PLFileSystemMount *PlMountLocation( const char *path ) {
 
 PLFunctionResult PlInitFileSystem( void ) {
 	_plRegisterFSCommands();
+	PlInitFileRequests();
 
 	PlClearMountedLocations();
 	return PL_RESULT_SUCCESS;
 }
 
 void PlShutdownFileSystem( void ) {
+	PlCancelAccessTraceReplay();
+	PlStopAccessTrace();
+
 	PlClearMountedLocations();
+	PlClearMemoryFiles();
+	PlSetMissCacheSize( 0 );
 }
 
 // Checks whether a file has been modified or not.
@@ -403,7 +1072,7 @@ time_t PlGetLocalFileTimeStamp( const char *path ) {
 time_t PlGetFileTimeStamp( PLFile *ptr ) {
 	/* timestamp defaults to -1 for files loaded locally */
 	if ( ptr->timeStamp < 0 ) {
-		PlGetLocalFileTimeStamp( ptr->path );
+		ptr->timeStamp = PlGetLocalFileTimeStamp( ptr->path );
 	}
 
 	return ptr->timeStamp;
@@ -416,6 +1085,7 @@ bool PlCreateDirectory( const char *path ) {
 	}
 
 	if ( _pl_mkdir( path ) == 0 ) {
+		AddWrittenLocalPath( path, true );
 		return true;
 	}
 
@@ -556,399 +1226,1687 @@ static bool PathEndsInSlash( const char *p ) {
 	return ( l > 0 && ( p[ l - 1 ] == '/' || p[ l - 1 ] == '\\' ) );
 }
 
-typedef struct FSScanInstance {
+/* Directory scans are split up so that each directory is read
+ * by its own job on the workers. Results are only handed back
+ * once every job has finished, so callbacks are always called
+ * from the thread that started the scan. */
+
+typedef struct FSScanEntry {
+	size_t pathOffset; /* into the batch's string buffer */
+	size_t size;
+	time_t timeStamp;
+	bool isDirectory;  /* only if the scan asked for them */
+} FSScanEntry;
+
+typedef struct FSScanBatch {
+	FSScanEntry *entries;
+	unsigned int numEntries;
+	unsigned int maxEntries;
+	char *strings;
+	size_t stringsSize;
+	size_t stringsCapacity;
+} FSScanBatch;
+
+typedef struct FSScan {
+	PLMutex *mutex;
+	PLJobGroup *group;
+	const char *extension;
+	bool recursive;
+	bool wantInfo; /* if false, files are only stat'd when the type is unknown */
+	bool wantDirectories;
+	bool failed;   /* set if the root couldn't be opened */
+	FSScanBatch results;
+} FSScan;
+
+typedef struct FSScanJob {
+	FSScan *scan;
+	bool isRoot;
 	char path[ PL_SYSTEM_MAX_PATH ];
-	struct FSScanInstance *next;
-} FSScanInstance;
+} FSScanJob;
+
+static bool AddScanEntry( FSScanBatch *batch, const char *path, size_t size, time_t timeStamp ) {
+	if ( batch->numEntries >= batch->maxEntries ) {
+		unsigned int maxEntries = ( batch->maxEntries == 0 ) ? 64 : batch->maxEntries * 2;
+		FSScanEntry *entries = pl_realloc( batch->entries, sizeof( FSScanEntry ) * maxEntries );
+		if ( entries == NULL ) {
+			return false;
+		}
+		batch->entries = entries;
+		batch->maxEntries = maxEntries;
+	}
+
+	size_t length = strlen( path ) + 1;
+	if ( batch->stringsSize + length > batch->stringsCapacity ) {
+		size_t capacity = ( batch->stringsCapacity == 0 ) ? 4096 : batch->stringsCapacity * 2;
+		while ( capacity < batch->stringsSize + length ) {
+			capacity *= 2;
+		}
+
+		char *strings = pl_realloc( batch->strings, capacity );
+		if ( strings == NULL ) {
+			return false;
+		}
+		batch->strings = strings;
+		batch->stringsCapacity = capacity;
+	}
+
+	FSScanEntry *entry = &batch->entries[ batch->numEntries++ ];
+	entry->pathOffset = batch->stringsSize;
+	entry->size = size;
+	entry->timeStamp = timeStamp;
+	entry->isDirectory = false;
+
+	memcpy( &batch->strings[ batch->stringsSize ], path, length );
+	batch->stringsSize += length;
+
+	return true;
+}
+
+static void AddScanDirectoryEntry( FSScanBatch *batch, const char *path ) {
+	if ( AddScanEntry( batch, path, 0, 0 ) ) {
+		batch->entries[ batch->numEntries - 1 ].isDirectory = true;
+	}
+}
+
+static void ClearScanBatch( FSScanBatch *batch ) {
+	pl_free( batch->entries );
+	pl_free( batch->strings );
+	memset( batch, 0, sizeof( FSScanBatch ) );
+}
+
+#define GetScanEntryPath( BATCH, INDEX ) ( &( BATCH )->strings[ ( BATCH )->entries[ ( INDEX ) ].pathOffset ] )
+
+static void ScanDirectoryJob( void *userData );
+
+static void QueueScanDirectory( FSScan *scan, const char *path, bool isRoot ) {
+	FSScanJob *job = pl_malloc( sizeof( FSScanJob ) );
+	if ( job == NULL ) {
+		return;
+	}
+
+	job->scan = scan;
+	job->isRoot = isRoot;
+	snprintf( job->path, sizeof( job->path ), "%s", path );
+
+	/* if the workers aren't available, just do it here */
+	if ( scan->group == NULL || !PlQueueJob( scan->group, ScanDirectoryJob, job ) ) {
+		ScanDirectoryJob( job );
+	}
+}
+
+static bool MatchScanExtension( const FSScan *scan, const char *fileName ) {
+	return ( scan->extension == NULL || pl_strcasecmp( PlGetFileExtension( fileName ), scan->extension ) == 0 );
+}
+
+static void ScanDirectoryJob( void *userData ) {
+	FSScanJob *job = ( FSScanJob * ) userData;
+	FSScan *scan = job->scan;
+
+	/* gathered locally, so the lock is only taken once per directory */
+	FSScanBatch batch;
+	memset( &batch, 0, sizeof( FSScanBatch ) );
+
+	char filestring[ PL_SYSTEM_MAX_PATH + 1 ];
+	const char *separator = PathEndsInSlash( job->path ) ? "" : "/";
 
-static void ScanLocalDirectory( const PLFileSystemMount *mount, FSScanInstance **fileList, const char *path,
-                                const char *extension, void ( *Function )( const char *, void * ), bool recursive, void *userData ) {
 #if !defined( _MSC_VER )
-	DIR *directory = opendir( path );
-	if ( directory ) {
-		struct dirent *entry;
-		while ( ( entry = readdir( directory ) ) ) {
-			if ( strcmp( entry->d_name, "." ) == 0 || strcmp( entry->d_name, ".." ) == 0 ) {
-				continue;
-			}
+	DIR *directory = opendir( job->path );
+	if ( directory == NULL ) {
+		if ( job->isRoot ) {
+			scan->failed = true;
+		}
+		pl_free( job );
+		return;
+	}
 
-			char filestring[ PL_SYSTEM_MAX_PATH + 1 ];
-			if ( PathEndsInSlash( path ) ) {
-				snprintf( filestring, sizeof( filestring ), "%s%s", path, entry->d_name );
-			} else {
-				snprintf( filestring, sizeof( filestring ), "%s/%s", path, entry->d_name );
-			}
+	int fd = dirfd( directory );
+
+	struct dirent *entry;
+	while ( ( entry = readdir( directory ) ) ) {
+		if ( strcmp( entry->d_name, "." ) == 0 || strcmp( entry->d_name, ".." ) == 0 ) {
+			continue;
+		}
 
+		bool isFile = false, isDirectory = false;
+		size_t size = 0;
+		time_t timeStamp = 0;
+
+#if defined( DT_UNKNOWN )
+		/* the type is usually known without needing to stat, but
+		 * links and some filesystems still need to be checked */
+		isFile = ( entry->d_type == DT_REG );
+		isDirectory = ( entry->d_type == DT_DIR );
+		bool needsStat = ( entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK ) ||
+		                 ( isFile && scan->wantInfo && MatchScanExtension( scan, entry->d_name ) );
+#else
+		bool needsStat = true;
+#endif
+		if ( needsStat ) {
 			struct stat st;
-			if ( stat( filestring, &st ) == 0 ) {
-				if ( S_ISREG( st.st_mode ) ) {
-					if ( extension == NULL || pl_strcasecmp( PlGetFileExtension( entry->d_name ), extension ) == 0 ) {
-						if ( mount == NULL ) {
-							Function( filestring, userData );
-							continue;
-						}
-
-						size_t pos = strlen( mount->path );
-						if ( pos >= sizeof( filestring ) ) {
-							PrintWarning( "pos >= %d!\n", pos );
-							continue;
-						}
-						const char *filePath = &filestring[ pos ];
-
-						// Ensure it's not already in the list
-						FSScanInstance *cur = *fileList;
-						while ( cur != NULL ) {
-							if ( strcmp( filePath, cur->path ) == 0 ) {
-								// File was already passed back
-								break;
-							}
-
-							cur = cur->next;
-						}
-
-						// Jumped the list early, so abort here
-						if ( cur != NULL ) {
-							continue;
-						}
-
-						Function( filePath, userData );
-
-						// Tack it onto the list
-						cur = pl_calloc( 1, sizeof( FSScanInstance ) );
-						strncpy( cur->path, filePath, sizeof( cur->path ) );
-						cur->next = *fileList;
-						*fileList = cur;
-					}
-				} else if ( S_ISDIR( st.st_mode ) && recursive ) {
-					ScanLocalDirectory( mount, fileList, filestring, extension, Function, recursive, userData );
-				}
+			if ( fstatat( fd, entry->d_name, &st, 0 ) != 0 ) {
+				continue;
 			}
+
+			isFile = S_ISREG( st.st_mode );
+			isDirectory = S_ISDIR( st.st_mode );
+			size = ( size_t ) st.st_size;
+			timeStamp = st.st_mtime;
 		}
 
-		closedir( directory );
-	} else {
-		PlReportErrorF( PL_RESULT_FILEPATH, "opendir failed!" );
-	}
-#else /* assumed win32 impl */
-	if ( extension == NULL ) {
-		extension = "*";
+		/* can't be opened by the path we'd hand back anyway */
+		int length = snprintf( filestring, sizeof( filestring ), "%s%s%s", job->path, separator, entry->d_name );
+		if ( length < 0 || ( size_t ) length >= sizeof( filestring ) ) {
+			continue;
+		}
+
+		if ( isFile ) {
+			if ( MatchScanExtension( scan, entry->d_name ) ) {
+				AddScanEntry( &batch, filestring, size, timeStamp );
+			}
+		} else if ( isDirectory && scan->recursive ) {
+			if ( scan->wantDirectories ) {
+				AddScanDirectoryEntry( &batch, filestring );
+			}
+			QueueScanDirectory( scan, filestring, false );
+		}
 	}
 
+	closedir( directory );
+#else /* assumed win32 impl */
 	char selectorPath[ PL_SYSTEM_MAX_PATH ];
-	snprintf( selectorPath, sizeof( selectorPath ), PathEndsInSlash( path ) ? "%s*.%s" : "%s/*.%s", path, extension );
+	snprintf( selectorPath, sizeof( selectorPath ), "%s%s*", job->path, separator );
 
 	WIN32_FIND_DATA ffd;
 	HANDLE find = FindFirstFile( selectorPath, &ffd );
 	if ( find == INVALID_HANDLE_VALUE ) {
+		if ( job->isRoot ) {
+			scan->failed = true;
+		}
+		pl_free( job );
 		return;
 	}
 
 	do {
-		snprintf( selectorPath, sizeof( selectorPath ), PathEndsInSlash( path ) ? "%s%s" : "%s/%s", path, ffd.cFileName );
+		if ( strcmp( ffd.cFileName, "." ) == 0 || strcmp( ffd.cFileName, ".." ) == 0 ) {
+			continue;
+		}
+
+		/* can't be opened by the path we'd hand back anyway */
+		int length = snprintf( filestring, sizeof( filestring ), "%s%s%s", job->path, separator, ffd.cFileName );
+		if ( length < 0 || ( size_t ) length >= sizeof( filestring ) ) {
+			continue;
+		}
 
 		if ( ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) {
-			if ( recursive && !( strcmp( ffd.cFileName, "." ) == 0 || strcmp( ffd.cFileName, ".." ) == 0 ) ) {
-				ScanLocalDirectory( mount, fileList, selectorPath, extension, Function, recursive, userData );
+			if ( scan->recursive ) {
+				if ( scan->wantDirectories ) {
+					AddScanDirectoryEntry( &batch, filestring );
+				}
+				QueueScanDirectory( scan, filestring, false );
 			}
 			continue;
 		}
 
-		const char *rp = selectorPath;
-		if (mount != NULL) {
-			size_t pos = strlen( mount->path );
-			if ( pos >= sizeof( selectorPath ) ) {
-				PrintWarning( "pos >= %d!\n", pos );
-				continue;
-			}
-			rp = &selectorPath[ pos ];
+		if ( !MatchScanExtension( scan, ffd.cFileName ) ) {
+			continue;
 		}
 
-		Function( rp, userData );
+		/* FILETIME is in 100ns intervals from 1601 */
+		uint64_t writeTime = ( ( uint64_t ) ffd.ftLastWriteTime.dwHighDateTime << 32 ) | ffd.ftLastWriteTime.dwLowDateTime;
+		time_t timeStamp = ( time_t ) ( ( writeTime - 116444736000000000ULL ) / 10000000ULL );
+		size_t size = ( size_t ) ( ( ( uint64_t ) ffd.nFileSizeHigh << 32 ) | ffd.nFileSizeLow );
+
+		AddScanEntry( &batch, filestring, size, timeStamp );
 	} while ( FindNextFile( find, &ffd ) != FALSE );
 
 	FindClose( find );
 #endif
+
+	if ( batch.numEntries > 0 ) {
+		PlLockMutex( scan->mutex );
+		for ( unsigned int i = 0; i < batch.numEntries; ++i ) {
+			if ( batch.entries[ i ].isDirectory ) {
+				AddScanDirectoryEntry( &scan->results, GetScanEntryPath( &batch, i ) );
+				continue;
+			}
+			AddScanEntry( &scan->results, GetScanEntryPath( &batch, i ), batch.entries[ i ].size, batch.entries[ i ].timeStamp );
+		}
+		PlUnlockMutex( scan->mutex );
+	}
+
+	ClearScanBatch( &batch );
+	pl_free( job );
+}
+
+static bool RunLocalScan( FSScan *scan, const char *path, FSScanBatch *out ) {
+	scan->mutex = PlCreateMutex();
+	if ( scan->mutex == NULL ) {
+		return false;
+	}
+
+	/* no point spreading it out if there's nothing to recurse into */
+	if ( scan->recursive ) {
+		scan->group = PlCreateJobGroup();
+	}
+
+	QueueScanDirectory( scan, path, true );
+
+	PlDestroyJobGroup( scan->group );
+	PlDestroyMutex( scan->mutex );
+
+	if ( scan->failed ) {
+		ClearScanBatch( &scan->results );
+		PlReportErrorF( PL_RESULT_FILEPATH, "opendir failed!" );
+		return false;
+	}
+
+	*out = scan->results;
+	return true;
 }
 
 /**
- * Scans the given directory.
- *
- * @param path path to directory.
- * @param extension the extension to scan for (exclude '.').
- * @param Function callback function to deal with the file.
- * @param recursive if true, also scans the contents of each sub-directory.
+ * Scans the given local directory across the workers, returning
+ * the full path of every file found. Order isn't guaranteed.
  */
-void PlScanDirectory( const char *path, const char *extension, void ( *Function )( const char *, void * ), bool recursive, void *userData ) {
-	if ( strncmp( FS_LOCAL_HINT, path, sizeof( FS_LOCAL_HINT ) ) == 0 ) {
-		ScanLocalDirectory( NULL, NULL, path + sizeof( FS_LOCAL_HINT ), extension, Function, recursive, userData );
+static bool ScanLocalDirectory( const char *path, const char *extension, bool recursive, bool wantInfo, FSScanBatch *out ) {
+	FSScan scan;
+	memset( &scan, 0, sizeof( FSScan ) );
+	scan.extension = extension;
+	scan.recursive = recursive;
+	scan.wantInfo = wantInfo;
+
+	return RunLocalScan( &scan, path, out );
+}
+
+/**
+ * Scans everything beneath the given local directory for indexing,
+ * which unlike ScanLocalDirectory includes the directories too.
+ */
+static bool ScanLocalTree( const char *path, FSScanBatch *out ) {
+	FSScan scan;
+	memset( &scan, 0, sizeof( FSScan ) );
+	scan.recursive = true;
+	scan.wantDirectories = true;
+
+	return RunLocalScan( &scan, path, out );
+}
+
+static void IndexLocalDirectory( PLFileSystemMount *mount, unsigned int *maxEntries ) {
+	PLHashTable *directories = PlCreateHashTable();
+	if ( directories == NULL ) {
 		return;
 	}
 
-	// If no mounted locations, assume local scan
-	if ( fs_mount_root == NULL ) {
-		ScanLocalDirectory( NULL, NULL, path, extension, Function, recursive, userData );
+	FSScanBatch batch;
+	if ( !ScanLocalTree( mount->path, &batch ) ) {
+		PlDestroyHashTable( directories );
 		return;
 	}
 
-	FSScanInstance *fileList = NULL;
-	PLFileSystemMount *location = fs_mount_root;
-	while ( location != NULL ) {
-		if ( location->type == FS_MOUNT_PACKAGE ) {
-			// Only works for directories for now
-		} else if ( location->type == FS_MOUNT_DIR ) {
-			char mounted_path[ PL_SYSTEM_MAX_PATH + 1 ];
-			if ( PathEndsInSlash( location->path ) ) {
-				snprintf( mounted_path, sizeof( mounted_path ), "%s%s", location->path, path );
-			} else {
-				snprintf( mounted_path, sizeof( mounted_path ), "%s/%s", location->path, path );
-			}
+	AddLocalDirectory( directories, "" );
 
-			ScanLocalDirectory( location, &fileList, mounted_path, extension, Function, recursive, userData );
+	size_t pos = strlen( mount->path );
+	for ( unsigned int i = 0; i < batch.numEntries; ++i ) {
+		if ( batch.entries[ i ].isDirectory ) {
+			AddLocalDirectory( directories, GetScanEntryPath( &batch, i ) + pos );
+			continue;
 		}
+		AddIndexEntry( mount, maxEntries, GetScanEntryPath( &batch, i ) + pos, -1 );
+	}
 
-		location = location->next;
+	ClearScanBatch( &batch );
+
+	PlLockWrite( fs_index_lock );
+	mount->localDirectories = directories;
+	PlUnlockWrite( fs_index_lock );
+}
+
+/* Mounted directories are watched, so the index can be kept up to
+ * date as files come and go, rather than being rebuilt each time. */
+
+static FSIndexEntry *FindMountIndexEntry( const PLFileSystemMount *mount, const char *path ) {
+	if ( fs_index == NULL ) {
+		return NULL;
 	}
 
-	// Clean up the list
-	FSScanInstance *current = fileList;
-	while ( current != NULL ) {
-		FSScanInstance *prev = current;
-		current = current->next;
-		pl_free( prev );
+	FSIndexEntry *entry = PlLookupHashTableUserData( fs_index, path, strlen( path ) );
+	while ( entry != NULL && entry->mount != mount ) {
+		entry = entry->next;
 	}
+
+	return entry;
 }
 
-const char *PlGetWorkingDirectory( void ) {
-	static char out[ PL_SYSTEM_MAX_PATH ] = { '\0' };
-	if ( getcwd( out, PL_SYSTEM_MAX_PATH ) == NULL ) {
-		/* The MSDN documentation for getcwd() is gone, but it proooobably uses
-		 * errno and friends.
-		 */
-		PlReportErrorF( PL_RESULT_SYSERR, "%s", strerror( errno ) );
-		return NULL;
+static void AddWatchedIndexEntry( PLFileSystemMount *mount, const char *path ) {
+	char buf[ PL_SYSTEM_MAX_PATH ];
+	NormalizePath( path, buf, sizeof( buf ) );
+	if ( fs_index == NULL ) {
+		return;
 	}
-	return out;
+
+	PlLockWrite( fs_index_lock );
+	if ( FindMountIndexEntry( mount, buf ) != NULL ) {
+		PlUnlockWrite( fs_index_lock );
+		return;
+	}
+
+	size_t length = strlen( buf ) + 1;
+	FSIndexEntry *entry = pl_calloc( 1, sizeof( FSIndexEntry ) );
+	entry->mount = mount;
+	entry->packageIndex = -1;
+	entry->path = pl_malloc( length );
+	memcpy( entry->path, buf, length );
+
+	entry->nextAdded = mount->addedEntries;
+	mount->addedEntries = entry;
+
+	char folded[ PL_SYSTEM_MAX_PATH ];
+	LinkIndexEntry( fs_index, entry->path, entry, false );
+	LinkIndexEntry( fs_index_folded, FoldPath( entry->path, folded, sizeof( folded ) ), entry, true );
+	PlUnlockWrite( fs_index_lock );
+
+	PlFlushMissCache();
 }
 
-void PlSetWorkingDirectory( const char *path ) {
-	if ( chdir( path ) != 0 ) {
-		PlReportErrorF( PL_RESULT_SYSERR, "%s", strerror( errno ) );
+static void AddWatchedDirectory( PLFileSystemMount *mount, const char *path ) {
+	if ( fs_index_lock == NULL ) {
+		return;
+	}
+
+	PlLockWrite( fs_index_lock );
+	if ( mount->localDirectories != NULL ) {
+		AddLocalDirectory( mount->localDirectories, path );
 	}
+	PlUnlockWrite( fs_index_lock );
 }
 
-/////////////////////////////////////////////////////////////////////////////////////
-// FILE I/O
+/**
+ * Called when we've written the given local file, or created the
+ * given local directory, so that it's found straight away if it's
+ * under a watched mount, rather than only once the watch has been
+ * polled.
+ */
+static void AddWrittenLocalPath( const char *path, bool isDirectory ) {
+	PlFlushMissCache();
 
-bool PlLocalFileExists( const char *path ) {
-	struct stat buffer;
-	return ( bool ) ( stat( path, &buffer ) == 0 );
+	char buf[ PL_SYSTEM_MAX_PATH ];
+	NormalizePath( path, buf, sizeof( buf ) );
+
+	for ( PLFileSystemMount *location = fs_mount_root; location != NULL; location = location->next ) {
+		if ( location->type != FS_MOUNT_DIR || location->watch == NULL ) {
+			continue;
+		}
+
+		char mountPath[ PL_SYSTEM_MAX_PATH ];
+		NormalizePath( location->path, mountPath, sizeof( mountPath ) );
+		size_t length = strlen( mountPath );
+		const char *relativePath;
+		if ( length == 0 ) {
+			relativePath = buf;
+		} else if ( strncmp( buf, mountPath, length ) == 0 && buf[ length ] == '/' ) {
+			relativePath = &buf[ length + 1 ];
+		} else {
+			continue;
+		}
+
+		if ( isDirectory ) {
+			AddWatchedDirectory( location, relativePath );
+		} else {
+			AddWatchedIndexEntry( location, relativePath );
+		}
+	}
 }
 
 /**
- * Checks whether or not the given file is accessible or exists.
- * @param path
- * @return False if the file wasn't accessible.
+ * Removes the given path from the mount, along with everything
+ * beneath it if it's a directory.
  */
-bool PlFileExists( const char *path ) {
-	if ( fs_mount_root == NULL ) {
-		return PlLocalFileExists( path );
-	} else if ( strncmp( FS_LOCAL_HINT, path, sizeof( FS_LOCAL_HINT ) ) == 0 ) {
-		path += sizeof( FS_LOCAL_HINT );
-		return PlLocalFileExists( path );
+static void RemoveWatchedIndexEntries( PLFileSystemMount *mount, const char *path ) {
+	char buf[ PL_SYSTEM_MAX_PATH ];
+	NormalizePath( path, buf, sizeof( buf ) );
+	size_t length = strlen( buf );
+
+#define IsWatchedPathMatch( ENTRY ) \
+	( strncmp( ( ENTRY )->path, buf, length ) == 0 && ( ( ENTRY )->path[ length ] == '\0' || ( ENTRY )->path[ length ] == '/' ) )
+
+	if ( fs_index_lock == NULL ) {
+		return;
 	}
 
-	PLFileSystemMount *location = fs_mount_root;
-	while ( location != NULL ) {
-		if ( location->type == FS_MOUNT_DIR ) {
-			/* todo: don't allow path to search outside of mounted path */
-			char buf[ PL_SYSTEM_MAX_PATH + 1 ];
-			snprintf( buf, sizeof( buf ), "%s/%s", location->path, path );
-			if ( PlLocalFileExists( buf ) ) {
-				return true;
-			}
-		} else {
-			PLFile *fp = PlLoadPackageFile( location->pkg, path );
-			if ( fp != NULL ) {
-				PlCloseFile( fp );
-				return true;
-			}
+	PlLockWrite( fs_index_lock );
+	for ( unsigned int i = 0; i < mount->numIndexEntries; ++i ) {
+		FSIndexEntry *entry = &mount->indexEntries[ i ];
+		if ( !entry->isRemoved && IsWatchedPathMatch( entry ) ) {
+			UnlinkMountIndexEntry( entry );
 		}
+	}
 
-		location = location->next;
+	/* entries added since can be freed, the rest belong to the array */
+	FSIndexEntry **link = &mount->addedEntries;
+	while ( *link != NULL ) {
+		FSIndexEntry *entry = *link;
+		if ( IsWatchedPathMatch( entry ) ) {
+			*link = entry->nextAdded;
+			UnlinkMountIndexEntry( entry );
+			pl_free( entry->path );
+			pl_free( entry );
+			continue;
+		}
+		link = &entry->nextAdded;
 	}
 
-	return false;
+	if ( mount->localDirectories != NULL ) {
+		RemoveLocalDirectories( mount->localDirectories, buf );
+	}
+	PlUnlockWrite( fs_index_lock );
 }
 
-bool PlLocalPathExists( const char *path ) {
-#if defined( _MSC_VER )
-	errno_t err = _access_s( path, 0 );
-	if ( err != 0 )
-		return false;
-	
-	struct _stat s;
-	_stat( path, &s );
-	return ( s.st_mode & S_IFDIR );
-#else
-	DIR *dir = opendir( path );
-	if ( dir ) {
-		closedir( dir );
-		return true;
+/**
+ * Loads the mount's package again, after its archive has changed.
+ * If it can no longer be loaded, the mount is left empty, as the
+ * handle may still be held on to.
+ */
+static void RemountPackage( PLFileSystemMount *mount ) {
+	/* replays work from the mounts */
+	PlWaitAccessTraceReplay();
+
+	RemoveMountFromIndex( mount );
+
+	char path[ PL_SYSTEM_MAX_PATH ];
+	snprintf( path, sizeof( path ), "%s", mount->pkg->path );
+	PlDestroyPackage( mount->pkg );
+
+	mount->pkg = PlLoadPackage( path );
+	if ( mount->pkg == NULL ) {
+		PrintWarning( "Failed to reload package \"%s\", it's been left empty!\nPL: %s\n", path, PlGetError() );
+		mount->pkg = PlCreatePackageHandle( path, 0, NULL );
+	}
+
+	AddMountToIndex( mount );
+
+	FSLog( "Reloaded package %s\n", path );
+}
+
+/**
+ * Reloads any mounted packages that were read from the given local file.
+ */
+static void RemountChangedPackages( const char *path ) {
+	char buf[ PL_SYSTEM_MAX_PATH ];
+	NormalizePath( path, buf, sizeof( buf ) );
+
+	for ( PLFileSystemMount *location = fs_mount_root; location != NULL; location = location->next ) {
+		if ( location->type != FS_MOUNT_PACKAGE || location->pkg->internal.file == NULL ) {
+			continue;
+		}
+
+		char packagePath[ PL_SYSTEM_MAX_PATH ];
+		NormalizePath( location->pkg->internal.file->path, packagePath, sizeof( packagePath ) );
+		if ( strcmp( buf, packagePath ) == 0 ) {
+			RemountPackage( location );
+		}
+	}
+}
+
+static void MountWatchCallback( const char *path, PLWatchEvent event, bool isDirectory, void *userData ) {
+	PLFileSystemMount *mount = ( PLFileSystemMount * ) userData;
+
+	/* the watch drops any trailing slashes from the mount's path */
+	size_t length = strlen( mount->path );
+	while ( length > 1 && mount->path[ length - 1 ] == '/' ) {
+		length--;
+	}
+	const char *relativePath = path + length;
+
+	if ( event == PL_WATCH_DELETED ) {
+		RemoveWatchedIndexEntries( mount, relativePath );
+	} else if ( event == PL_WATCH_CREATED && isDirectory ) {
+		AddWatchedDirectory( mount, relativePath );
+
+		/* anything that was put in there before we started watching it */
+		FSScanBatch batch;
+		if ( ScanLocalTree( path, &batch ) ) {
+			for ( unsigned int i = 0; i < batch.numEntries; ++i ) {
+				if ( batch.entries[ i ].isDirectory ) {
+					AddWatchedDirectory( mount, GetScanEntryPath( &batch, i ) + length );
+				} else {
+					AddWatchedIndexEntry( mount, GetScanEntryPath( &batch, i ) + length );
+				}
+			}
+			ClearScanBatch( &batch );
+		}
+	} else if ( event == PL_WATCH_CREATED ) {
+		AddWatchedIndexEntry( mount, relativePath );
+		/* might have been moved over a package */
+		RemountChangedPackages( path );
+	} else if ( event == PL_WATCH_MODIFIED && !isDirectory ) {
+		/* misses could've come from a package that's since changed */
+		PlFlushMissCache();
+		RemountChangedPackages( path );
+	}
+}
+
+static void WatchMount( PLFileSystemMount *mount ) {
+	if ( fs_watch_mounts == NULL || !fs_watch_mounts->b_value ) {
+		return;
+	}
+
+	mount->watch = PlWatchPath( mount->path, MountWatchCallback, mount );
+	if ( mount->watch == NULL ) {
+		FSLog( "Failed to watch %s, changes won't be picked up: %s\n", mount->path, PlGetError() );
+	}
+}
+
+/**
+ * Called once a directory's been mounted, to start watching it.
+ */
+static void FinishDirectoryMount( PLFileSystemMount *mount ) {
+	WatchMount( mount );
+	if ( mount->watch == NULL ) {
+		fs_num_unwatched_mounts++;
+	}
+}
+
+typedef struct FSPackageScan {
+	const PLFileSystemMount *mount;
+	const char *extension;
+	bool recursive;
+	PLHashTable *fileList;
+	FSScanBatch *out;
+} FSPackageScan;
+
+/**
+ * Adds a file to the results of a scan across mounts, unless
+ * an earlier mount has already provided it. Paths are handed
+ * back normalized, so they're the same whichever sort of mount
+ * they came from.
+ */
+static void AddMountedScanEntry( PLHashTable *fileList, const PLFileSystemMount *mount, FSScanBatch *out, const char *path, size_t size, time_t timeStamp ) {
+	char key[ PL_SYSTEM_MAX_PATH ];
+	NormalizePath( path, key, sizeof( key ) );
+
+	size_t length = strlen( key );
+	if ( PlLookupHashTableUserData( fileList, key, length ) != NULL ) {
+		return;
+	}
+
+	PlInsertHashTableNode( fileList, key, length, ( void * ) mount );
+	AddScanEntry( out, key, size, timeStamp );
+}
+
+static void ScanPackageDirectory( const FSPackageScan *scan, const FSPackageDirectory *directory ) {
+	const PLPackage *package = scan->mount->pkg;
+	for ( unsigned int i = 0; i < directory->numFiles; ++i ) {
+		const char *fileName = PlGetPackageFileName( package, directory->files[ i ] );
+		if ( scan->extension != NULL && pl_strcasecmp( PlGetFileExtension( fileName ), scan->extension ) != 0 ) {
+			continue;
+		}
+
+		AddMountedScanEntry( scan->fileList, scan->mount, scan->out, fileName,
+		                     package->table[ directory->files[ i ] ].fileSize, scan->mount->timeStamp );
+	}
+
+	if ( !scan->recursive ) {
+		return;
+	}
+
+	for ( unsigned int i = 0; i < directory->numChildren; ++i ) {
+		ScanPackageDirectory( scan, directory->children[ i ] );
+	}
+}
+
+/**
+ * Scans the given path across all mounted locations. Files that are
+ * provided by more than one location are only returned once, from
+ * whichever was mounted first. Paths are relative to their mount,
+ * without a leading slash.
+ */
+static bool ScanDirectory( const char *path, const char *extension, bool recursive, bool wantInfo, FSScanBatch *out ) {
+	memset( out, 0, sizeof( FSScanBatch ) );
+
+	if ( strncmp( FS_LOCAL_HINT, path, FS_LOCAL_HINT_LENGTH ) == 0 ) {
+		return ScanLocalDirectory( path + FS_LOCAL_HINT_LENGTH, extension, recursive, wantInfo, out );
+	}
+
+	// If no mounted locations, assume local scan
+	if ( fs_mount_root == NULL ) {
+		return ScanLocalDirectory( path, extension, recursive, wantInfo, out );
+	}
+
+	PLHashTable *fileList = PlCreateHashTable();
+	if ( fileList == NULL ) {
+		return false;
+	}
+
+	PLFileSystemMount *location = fs_mount_root;
+	while ( location != NULL ) {
+		if ( location->type == FS_MOUNT_PACKAGE ) {
+			char buf[ PL_SYSTEM_MAX_PATH ];
+			NormalizePath( path, buf, sizeof( buf ) );
+
+			const FSPackageDirectory *directory = ( location->directories != NULL ) ? GetPackageDirectory( location, buf, false ) : NULL;
+			if ( directory != NULL ) {
+				FSPackageScan scan = { location, extension, recursive, fileList, out };
+				ScanPackageDirectory( &scan, directory );
+			}
+		} else if ( location->type == FS_MOUNT_DIR ) {
+			char mounted_path[ PL_SYSTEM_MAX_PATH + 1 ];
+			if ( PathEndsInSlash( location->path ) ) {
+				snprintf( mounted_path, sizeof( mounted_path ), "%s%s", location->path, path );
+			} else {
+				snprintf( mounted_path, sizeof( mounted_path ), "%s/%s", location->path, path );
+			}
+
+			FSScanBatch batch;
+			if ( ScanLocalDirectory( mounted_path, extension, recursive, wantInfo, &batch ) ) {
+				size_t pos = strlen( location->path );
+				for ( unsigned int i = 0; i < batch.numEntries; ++i ) {
+					AddMountedScanEntry( fileList, location, out, GetScanEntryPath( &batch, i ) + pos,
+					                     batch.entries[ i ].size, batch.entries[ i ].timeStamp );
+				}
+				ClearScanBatch( &batch );
+			}
+		}
+
+		location = location->next;
+	}
+
+	PlDestroyHashTable( fileList );
+
+	return true;
+}
+
+/**
+ * Scans the given directory.
+ *
+ * @param path path to directory.
+ * @param extension the extension to scan for (exclude '.').
+ * @param Function callback function to deal with the file.
+ * @param recursive if true, also scans the contents of each sub-directory.
+ */
+void PlScanDirectory( const char *path, const char *extension, void ( *Function )( const char *, void * ), bool recursive, void *userData ) {
+	FSScanBatch batch;
+	if ( !ScanDirectory( path, extension, recursive, false, &batch ) ) {
+		return;
+	}
+
+	for ( unsigned int i = 0; i < batch.numEntries; ++i ) {
+		Function( GetScanEntryPath( &batch, i ), userData );
+	}
+
+	ClearScanBatch( &batch );
+}
+
+/**
+ * Scans the given directory, returning every file found along
+ * with its size and timestamp, so there's no need to stat them
+ * again afterwards. Order isn't guaranteed.
+ *
+ * @param numEntries Number of entries returned.
+ * @return Array of entries, to be freed with PlDestroyDirectoryEntries.
+ */
+PLDirectoryEntry *PlScanDirectoryEntries( const char *path, const char *extension, bool recursive, unsigned int *numEntries ) {
+	*numEntries = 0;
+
+	FSScanBatch batch;
+	if ( !ScanDirectory( path, extension, recursive, true, &batch ) ) {
+		return NULL;
+	}
+
+	/* entries and their paths are packed into one block */
+	size_t tableSize = sizeof( PLDirectoryEntry ) * batch.numEntries;
+	PLDirectoryEntry *entries = pl_malloc( tableSize + batch.stringsSize + 1 );
+	if ( entries == NULL ) {
+		ClearScanBatch( &batch );
+		return NULL;
+	}
+
+	char *strings = ( char * ) entries + tableSize;
+	if ( batch.stringsSize > 0 ) {
+		memcpy( strings, batch.strings, batch.stringsSize );
+	}
+
+	for ( unsigned int i = 0; i < batch.numEntries; ++i ) {
+		entries[ i ].path = strings + batch.entries[ i ].pathOffset;
+		entries[ i ].size = batch.entries[ i ].size;
+		entries[ i ].timeStamp = batch.entries[ i ].timeStamp;
+	}
+
+	*numEntries = batch.numEntries;
+	ClearScanBatch( &batch );
+
+	return entries;
+}
+
+void PlDestroyDirectoryEntries( PLDirectoryEntry *entries ) {
+	pl_free( entries );
+}
+
+const char *PlGetWorkingDirectory( void ) {
+	static char out[ PL_SYSTEM_MAX_PATH ] = { '\0' };
+	if ( getcwd( out, PL_SYSTEM_MAX_PATH ) == NULL ) {
+		/* The MSDN documentation for getcwd() is gone, but it proooobably uses
+		 * errno and friends.
+		 */
+		PlReportErrorF( PL_RESULT_SYSERR, "%s", strerror( errno ) );
+		return NULL;
+	}
+	return out;
+}
+
+void PlSetWorkingDirectory( const char *path ) {
+	if ( chdir( path ) != 0 ) {
+		PlReportErrorF( PL_RESULT_SYSERR, "%s", strerror( errno ) );
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// FILE I/O
+
+bool PlLocalFileExists( const char *path ) {
+	struct stat buffer;
+	return ( bool ) ( stat( path, &buffer ) == 0 );
+}
+
+static bool StatLocalFile( const char *path, PLFileInfo *info ) {
+	struct stat buffer;
+	if ( stat( path, &buffer ) != 0 ) {
+		return false;
+	}
+
+	info->size = ( size_t ) buffer.st_size;
+	info->timeStamp = buffer.st_mtime;
+	return true;
+}
+
+/**
+ * Checks whether or not the given file is accessible or exists.
+ * @param path
+ * @return False if the file wasn't accessible.
+ */
+bool PlFileExists( const char *path ) {
+	PLFileInfo info;
+	return PlStatFile( path, &info );
+}
+
+/**
+ * Fetches information about the given file without opening it.
+ * Packaged files are answered from the package table, so this
+ * is much cheaper than loading them.
+ * @return False if the file couldn't be found.
+ */
+bool PlStatFile( const char *path, PLFileInfo *info ) {
+	memset( info, 0, sizeof( PLFileInfo ) );
+
+	if ( strncmp( FS_LOCAL_HINT, path, FS_LOCAL_HINT_LENGTH ) == 0 ) {
+		path += FS_LOCAL_HINT_LENGTH;
+		return StatLocalFile( path, info );
+	} else if ( strncmp( FS_MEMORY_HINT, path, FS_MEMORY_HINT_LENGTH ) == 0 ) {
+		return PlStatMemoryFile( path + FS_MEMORY_HINT_LENGTH, info );
+	} else if ( fs_mount_root == NULL ) {
+		return StatLocalFile( path, info );
+	}
+
+	char key[ PL_SYSTEM_MAX_PATH ];
+	NormalizePath( path, key, sizeof( key ) );
+	if ( PlIsCachedMiss( key ) ) {
+		return false;
+	}
+
+	char buf[ PL_SYSTEM_MAX_PATH + 1 ];
+
+	LockIndexForRead();
+	FSMountedLookup lookup;
+	BeginMountedLookup( &lookup, key );
+	const FSIndexEntry *entry;
+	PLFileSystemMount *location;
+	while ( NextMountedLookup( &lookup, &entry, &location ) ) {
+		if ( location != NULL ) {
+			if ( GetMountedLocalPath( location, key, buf, sizeof( buf ) ) && StatLocalFile( buf, info ) ) {
+				info->mount = location;
+				UnlockIndexForRead();
+				return true;
+			}
+			continue;
+		}
+
+		if ( entry->mount->type == FS_MOUNT_PACKAGE ) {
+			const PLPackageIndex *index = &entry->mount->pkg->table[ entry->packageIndex ];
+			info->size = index->fileSize;
+			info->compressedSize = ( index->compressionType != PL_COMPRESSION_NONE ) ? index->compressedSize : 0;
+			info->timeStamp = entry->mount->timeStamp;
+			info->mount = entry->mount;
+			info->isPackaged = true;
+			UnlockIndexForRead();
+			return true;
+		}
+
+		GetIndexEntryLocalPath( entry, buf, sizeof( buf ) );
+		if ( StatLocalFile( buf, info ) ) {
+			info->mount = entry->mount;
+			UnlockIndexForRead();
+			return true;
+		}
+	}
+	UnlockIndexForRead();
+
+	if ( !lookup.isIndexed ) {
+		CacheMissedPath( key );
+	}
+
+	return false;
+}
+
+bool PlLocalPathExists( const char *path ) {
+#if defined( _MSC_VER )
+	errno_t err = _access_s( path, 0 );
+	if ( err != 0 )
+		return false;
+	
+	struct _stat s;
+	_stat( path, &s );
+	return ( s.st_mode & S_IFDIR );
+#else
+	DIR *dir = opendir( path );
+	if ( dir ) {
+		closedir( dir );
+		return true;
+	}
+
+	return false;
+#endif
+}
+
+bool PlPathExists( const char *path ) {
+	if ( strncmp( FS_LOCAL_HINT, path, FS_LOCAL_HINT_LENGTH ) == 0 ) {
+		path += FS_LOCAL_HINT_LENGTH;
+		return PlLocalPathExists( path );
+	} else if ( strncmp( FS_MEMORY_HINT, path, FS_MEMORY_HINT_LENGTH ) == 0 ) {
+		/* memory files can't be directories */
+		return false;
+	} else if ( fs_mount_root == NULL ) {
+		return PlLocalPathExists( path );
+	}
+
+	char key[ PL_SYSTEM_MAX_PATH ];
+	NormalizePath( path, key, sizeof( key ) );
+	size_t length = strlen( key );
+
+	char buf[ PL_SYSTEM_MAX_PATH + 1 ];
+
+	bool exists = false;
+	LockIndexForRead();
+	for ( PLFileSystemMount *location = fs_mount_root; location != NULL && !exists; location = location->next ) {
+		if ( IsUnwatchedMount( location ) ) {
+			/* only known as it was when it was mounted */
+			exists = ( GetMountedLocalPath( location, key, buf, sizeof( buf ) ) && PlLocalPathExists( buf ) );
+		} else if ( location->localDirectories != NULL ) {
+			exists = ( PlLookupHashTableUserData( location->localDirectories, key, length ) != NULL );
+		} else if ( location->directories != NULL ) {
+			exists = ( GetPackageDirectory( location, key, false ) != NULL );
+		}
+	}
+	UnlockIndexForRead();
+
+	return exists;
+}
+
+/**
+ * Deletes the specified file. Not VFS compatible.
+ * @param path Path to the file you want to delete.
+ * @return True on success and false on fail.
+ */
+bool PlDeleteFile( const char *path ) {
+	if ( !PlLocalFileExists( path ) ) {
+		return true;
+	}
+
+	int result = remove( path );
+	if ( result == 0 ) {
+		return true;
+	}
+
+	PlReportErrorF( PL_RESULT_FILEREAD, strerror( errno ) );
+	return false;
+}
+
+/**
+ * Write the data to the specified location. Not VFS compatible.
+ * @param path Path to the destination.
+ * @param buf Data buffer for whatever you're writing.
+ * @param length Length of the data buffer.
+ * @return True on success and false on fail.
+ */
+bool PlWriteFile( const char *path, const uint8_t *buf, size_t length ) {
+	FILE *fp = fopen( path, "wb" );
+	if ( fp == NULL ) {
+		PlReportErrorF( PL_RESULT_FILEREAD, "failed to open %s", path );
+		return false;
+	}
+
+	/* it may be under a mounted directory, and the watch
+	 * won't let us know about it until it's polled */
+	AddWrittenLocalPath( path, false );
+
+	bool result = true;
+	if ( fwrite( buf, sizeof( char ), length, fp ) != length ) {
+		PlReportErrorF( PL_RESULT_FILEWRITE, "failed to write entirety of file" );
+		result = false;
+	}
+
+	_pl_fclose( fp );
+
+	return result;
+}
+
+/* files are copied through a buffer of this size, when
+ * the system can't do it for us */
+#define FS_COPY_CHUNK_SIZE ( 1024 * 1024 )
+
+/**
+ * Writes out the rest of the given file in fixed-size chunks,
+ * so that it never needs to be held in memory all at once.
+ */
+static bool WriteFileChunked( PLFile *ptr, FILE *out ) {
+	/* already in memory, or mapped */
+	if ( ptr->data != NULL ) {
+		size_t length = ptr->size - PlGetFileOffset( ptr );
+		return ( fwrite( ptr->pos, 1, length, out ) == length );
+	}
+
+	uint8_t *buf = pl_malloc( FS_COPY_CHUNK_SIZE );
+	if ( buf == NULL ) {
+		return false;
+	}
+
+	size_t length;
+	bool status = true;
+	while ( ( length = PlReadFile( ptr, buf, 1, FS_COPY_CHUNK_SIZE ) ) > 0 ) {
+		if ( fwrite( buf, 1, length, out ) != length ) {
+			status = false;
+			break;
+		}
+	}
+
+	pl_free( buf );
+
+	return ( status && PlIsEndOfFile( ptr ) );
+}
+
+/**
+ * Copies between two local files without the data passing through
+ * us, where the system supports it.
+ * @return Number of bytes copied, which might fall short.
+ */
+static size_t CopyLocalFileRange( int in, int out, size_t size ) {
+#if defined( __linux__ )
+	off_t offset = 0;
+	while ( ( size_t ) offset < size ) {
+		loff_t inOffset = offset, outOffset = offset;
+		ssize_t length = copy_file_range( in, &inOffset, out, &outOffset, size - ( size_t ) offset, 0 );
+		if ( length <= 0 ) {
+			break;
+		}
+		offset += length;
+	}
+
+	/* not supported between these filesystems, so try sendfile */
+	if ( ( size_t ) offset < size && lseek( out, offset, SEEK_SET ) != -1 ) {
+		while ( ( size_t ) offset < size ) {
+			if ( sendfile( out, in, &offset, size - ( size_t ) offset ) <= 0 ) {
+				break;
+			}
+		}
+	}
+
+	return ( size_t ) offset;
+#else
+	PlUnused( in );
+	PlUnused( out );
+	PlUnused( size );
+	return 0;
+#endif
+}
+
+/**
+ * Copies the given file via the VFS to the local destination.
+ * Local files are copied by the system where possible, and
+ * anything else is streamed, so it's never all held in memory.
+ */
+bool PlCopyFile( const char *path, const char *dest ) {
+	PLFile *original = PlOpenFile( path, false );
+	if ( original == NULL ) {
+		PlReportErrorF( PL_RESULT_FILEREAD, "failed to open %s", path );
+		return false;
+	}
+
+	FILE *copy = fopen( dest, "wb" );
+	if ( copy == NULL ) {
+		PlReportErrorF( PL_RESULT_FILEWRITE, "failed to open %s for write", dest );
+		PlCloseFile( original );
+		return false;
+	}
+
+	AddWrittenLocalPath( dest, false );
+
+	bool status = true;
+	if ( original->fptr != NULL ) {
+		size_t offset = CopyLocalFileRange( fileno( original->fptr ), fileno( copy ), original->size );
+		if ( offset > 0 ) {
+			/* pick up wherever it left off */
+			status = ( fseek( copy, ( long ) offset, SEEK_SET ) == 0 && PlFileSeek( original, ( long ) offset, PL_SEEK_SET ) );
+		}
+	}
+
+	if ( !status || !WriteFileChunked( original, copy ) ) {
+		PlReportErrorF( PL_RESULT_FILEWRITE, "failed to write out %zu bytes for %s", original->size, path );
+		status = false;
+	}
+
+	if ( fclose( copy ) != 0 ) {
+		status = false;
+	}
+
+	PlCloseFile( original );
+
+	return status;
+}
+
+size_t PlGetLocalFileSize( const char *path ) {
+	struct stat buf;
+	if ( stat( path, &buf ) != 0 ) {
+		PlReportErrorF( PL_RESULT_FILEERR, "failed to stat %s: %s", path, strerror( errno ) );
+		return 0;
+	}
+
+	return ( size_t ) buf.st_size;
+}
+
+///////////////////////////////////////////
+
+PLFile *PlOpenLocalFile( const char *path, bool cache ) {
+	FILE *fp = fopen( path, "rb" );
+	if ( fp == NULL ) {
+		PlReportErrorF( PL_RESULT_FILEREAD, strerror( errno ) );
+		return NULL;
+	}
+
+	PLFile *ptr = pl_calloc( 1, sizeof( PLFile ) );
+	snprintf( ptr->path, sizeof( ptr->path ), "%s", path );
+	ptr->size = PlGetLocalFileSize( path );
+
+	if ( cache ) {
+		ptr->data = pl_malloc( ptr->size * sizeof( uint8_t ) );
+		ptr->pos = ptr->data;
+		if ( fread( ptr->data, sizeof( uint8_t ), ptr->size, fp ) != ptr->size ) {
+			FSLog( "Failed to read complete file (%s)!\n", path );
+		}
+		_pl_fclose( fp );
+	} else {
+		ptr->fptr = fp;
+		/* the buffer is only allocated on the first read */
+		if ( fs_buffer_size != NULL && fs_buffer_size->i_value > 0 ) {
+			ptr->bufferSize = ( size_t ) fs_buffer_size->i_value;
+		}
+	}
+
+	/* timestamp for local files is a special case */
+	ptr->timeStamp = -1;
+
+	return ptr;
+}
+
+static void TraceIndexEntryAccess( const char *path, const FSIndexEntry *entry, const PLFile *file ) {
+	if ( entry->mount->type == FS_MOUNT_DIR ) {
+		PlTraceFileAccess( path, entry->mount->path, 0, file->size );
+		return;
+	}
+
+	const PLPackageIndex *index = &entry->mount->pkg->table[ entry->packageIndex ];
+	PlTraceFileAccess( path, entry->mount->pkg->path, index->offset,
+	                   ( index->compressionType != PL_COMPRESSION_NONE ) ? index->compressedSize : index->fileSize );
+}
+
+/* local files are only read ahead up to this much, as the whole
+ * file might not be needed */
+#define FS_PREFETCH_LIMIT ( 16 * 1024 * 1024 )
+
+static void PrefetchLocalFile( const char *path ) {
+#if !defined( _WIN32 )
+	int fd = open( path, O_RDONLY );
+	if ( fd == -1 ) {
+		return;
+	}
+
+#	if defined( __linux__ )
+	/* blocks until it's read in, so files are fetched in order */
+	readahead( fd, 0, FS_PREFETCH_LIMIT );
+#	else
+	posix_fadvise( fd, 0, FS_PREFETCH_LIMIT, POSIX_FADV_WILLNEED );
+#	endif
+	close( fd );
+#else
+	PlUnused( path );
+#endif
+}
+
+/**
+ * Starts bringing in the given file ahead of it being opened. Compressed
+ * files are decompressed into the package cache, if it's enabled,
+ * otherwise the data is read ahead wherever it's stored.
+ */
+void PlPrefetchMountedFile( const char *path ) {
+	bool folded;
+	LockIndexForRead();
+	const FSIndexEntry *entry = LookupIndex( path, &folded );
+	if ( entry == NULL ) {
+		UnlockIndexForRead();
+		return;
+	}
+
+	if ( entry->mount->type == FS_MOUNT_DIR ) {
+		char buf[ PL_SYSTEM_MAX_PATH + 1 ];
+		GetIndexEntryLocalPath( entry, buf, sizeof( buf ) );
+		UnlockIndexForRead();
+		PrefetchLocalFile( buf );
+		return;
+	}
+
+	/* packaged entries only go along with their mount */
+	PLPackage *package = entry->mount->pkg;
+	unsigned int packageIndex = ( unsigned int ) entry->packageIndex;
+	UnlockIndexForRead();
+
+	const PLPackageIndex *index = &package->table[ packageIndex ];
+	if ( index->compressionType != PL_COMPRESSION_NONE && PlIsPackageCacheEnabled() ) {
+		PlCloseFile( PlOpenPackageFileByIndex( package, packageIndex, true ) );
+	} else if ( package->internal.file != NULL ) {
+		PlPrefetchFileRange( package->internal.file, index->offset,
+		                     ( index->compressionType != PL_COMPRESSION_NONE ) ? index->compressedSize : index->fileSize );
+	}
+}
+
+typedef struct FSOpenMode {
+	bool cache;
+	bool map;
+	PLFileAccessHint hint;
+} FSOpenMode;
+
+static PLFile *OpenLocalFileWithMode( const char *path, const FSOpenMode *mode ) {
+	if ( mode->map ) {
+		return PlMapLocalFile( path, mode->hint );
+	}
+
+	return PlOpenLocalFile( path, mode->cache );
+}
+
+/**
+ * Resolves the given path against the mounted locations and opens it.
+ */
+static PLFile *OpenMountedFile( const char *path, const FSOpenMode *mode ) {
+	char key[ PL_SYSTEM_MAX_PATH ];
+	NormalizePath( path, key, sizeof( key ) );
+	if ( PlIsCachedMiss( key ) ) {
+		PlReportErrorF( PL_RESULT_FILEREAD, "failed to find %s in any mounted location", path );
+		return NULL;
+	}
+
+	char buf[ PL_SYSTEM_MAX_PATH + 1 ];
+
+	LockIndexForRead();
+	FSMountedLookup lookup;
+	BeginMountedLookup( &lookup, key );
+	const FSIndexEntry *entry;
+	PLFileSystemMount *location;
+	while ( NextMountedLookup( &lookup, &entry, &location ) ) {
+		if ( location != NULL ) {
+			if ( GetMountedLocalPath( location, key, buf, sizeof( buf ) ) && PlLocalFileExists( buf ) ) {
+				PLFile *fp = OpenLocalFileWithMode( buf, mode );
+				if ( fp != NULL ) {
+					PlTraceFileAccess( path, location->path, 0, fp->size );
+					UnlockIndexForRead();
+					return fp;
+				}
+			}
+			continue;
+		}
+
+		PLFile *fp;
+		if ( entry->mount->type == FS_MOUNT_DIR ) {
+			GetIndexEntryLocalPath( entry, buf, sizeof( buf ) );
+			fp = OpenLocalFileWithMode( buf, mode );
+		} else {
+			fp = PlOpenPackageFileByIndex( entry->mount->pkg, ( unsigned int ) entry->packageIndex, mode->cache || mode->map );
+		}
+
+		if ( fp != NULL ) {
+			TraceIndexEntryAccess( path, entry, fp );
+			UnlockIndexForRead();
+			return fp;
+		}
+	}
+	UnlockIndexForRead();
+
+	/* if it's in the index, something else went wrong */
+	if ( !lookup.isIndexed ) {
+		CacheMissedPath( key );
+	}
+
+	PlReportErrorF( PL_RESULT_FILEREAD, "failed to find %s in any mounted location", path );
+	return NULL;
+}
+
+/**
+ * Maps the given local file into memory, rather than copying it. The
+ * returned handle can be used like any cached file, but the data is
+ * read-only and is only paged in as it's accessed.
+ * @param path Path to the file you want to map.
+ * @param hint How the file is expected to be accessed.
+ * @return Returns handle to the file instance.
+ */
+PLFile *PlMapLocalFile( const char *path, PLFileAccessHint hint ) {
+	/* the size is taken from the handle we map, so we don't map
+	 * past the end of a file that's been truncated in the meantime */
+#if defined( _WIN32 )
+	HANDLE fileHandle = CreateFile( path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( fileHandle == INVALID_HANDLE_VALUE ) {
+		PlReportErrorF( PL_RESULT_FILEREAD, "failed to open %s: %s", path, GetLastError_strerror( GetLastError() ) );
+		return NULL;
+	}
+
+	LARGE_INTEGER fileSize;
+	if ( !GetFileSizeEx( fileHandle, &fileSize ) ) {
+		PlReportErrorF( PL_RESULT_FILEREAD, "failed to get size of %s: %s", path, GetLastError_strerror( GetLastError() ) );
+		CloseHandle( fileHandle );
+		return NULL;
+	}
+
+	size_t size = ( size_t ) fileSize.QuadPart;
+	if ( size == 0 ) {
+		/* can't map an empty file, so just hand back an empty buffer */
+		CloseHandle( fileHandle );
+		return PlOpenLocalFile( path, true );
+	}
+
+	void *data = NULL;
+	HANDLE mapHandle = CreateFileMapping( fileHandle, NULL, PAGE_READONLY, 0, 0, NULL );
+	if ( mapHandle != NULL ) {
+		data = MapViewOfFile( mapHandle, FILE_MAP_READ, 0, 0, 0 );
+		CloseHandle( mapHandle );
+	}
+	CloseHandle( fileHandle );
+
+	if ( data == NULL ) {
+		PlReportErrorF( PL_RESULT_FILEREAD, "failed to map %s: %s", path, GetLastError_strerror( GetLastError() ) );
+		return NULL;
+	}
+#else
+	int fd = open( path, O_RDONLY );
+	if ( fd == -1 ) {
+		PlReportErrorF( PL_RESULT_FILEREAD, "failed to open %s: %s", path, strerror( errno ) );
+		return NULL;
+	}
+
+	struct stat attributes;
+	if ( fstat( fd, &attributes ) == -1 ) {
+		PlReportErrorF( PL_RESULT_FILEREAD, "failed to get size of %s: %s", path, strerror( errno ) );
+		close( fd );
+		return NULL;
+	}
+
+	size_t size = ( size_t ) attributes.st_size;
+	if ( size == 0 ) {
+		/* can't map an empty file, so just hand back an empty buffer */
+		close( fd );
+		return PlOpenLocalFile( path, true );
+	}
+
+	/* the mapping remains valid after the descriptor is closed */
+	void *data = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+
+	if ( data == MAP_FAILED ) {
+		PlReportErrorF( PL_RESULT_FILEREAD, "failed to map %s: %s", path, strerror( errno ) );
+		return NULL;
+	}
+#endif
+
+	PLFile *ptr = pl_calloc( 1, sizeof( PLFile ) );
+	snprintf( ptr->path, sizeof( ptr->path ), "%s", path );
+	ptr->size = size;
+	ptr->data = data;
+	ptr->pos = ptr->data;
+
+	ptr->mapping = pl_malloc( sizeof( FSMapping ) );
+	ptr->mapping->base = data;
+	ptr->mapping->size = size;
+	ptr->mapping->refCount = 1;
+	ptr->mapping->isAllocated = false;
+
+	/* timestamp for local files is a special case */
+	ptr->timeStamp = -1;
+
+	PlSetFileAccessHint( ptr, hint );
+
+	return ptr;
+}
+
+/**
+ * Maps the specified file via the VFS. Files provided by packages
+ * are already held in memory, so they're returned as-is.
+ * @param path Path to the file you want to map.
+ * @param hint How the file is expected to be accessed.
+ * @return Returns handle to the file instance.
+ */
+PLFile *PlMapFile( const char *path, PLFileAccessHint hint ) {
+	if ( plIsEmptyString( path ) ) {
+		PlReportBasicError( PL_RESULT_FILEPATH );
+		return NULL;
+	}
+
+	if ( strncmp( FS_LOCAL_HINT, path, FS_LOCAL_HINT_LENGTH ) == 0 ) {
+		path += FS_LOCAL_HINT_LENGTH;
+		return PlMapLocalFile( path, hint );
+	} else if ( strncmp( FS_MEMORY_HINT, path, FS_MEMORY_HINT_LENGTH ) == 0 ) {
+		/* already as good as mapped */
+		return PlOpenMemoryFile( path + FS_MEMORY_HINT_LENGTH );
+	} else if ( fs_mount_root == NULL ) {
+		return PlMapLocalFile( path, hint );
+	}
+
+	FSOpenMode mode = { .map = true, .hint = hint };
+	return OpenMountedFile( path, &mode );
+}
+
+static void ReleaseFileMapping( FSMapping *mapping ) {
+	if ( PlAtomicDecrement( &mapping->refCount ) > 0 ) {
+		return;
+	}
+
+	if ( mapping->isBorrowed ) {
+		pl_free( mapping );
+		return;
+	}
+
+	if ( mapping->isAllocated ) {
+		pl_free( mapping->base );
+		pl_free( mapping );
+		return;
+	}
+
+#if defined( _WIN32 )
+	UnmapViewOfFile( mapping->base );
+#else
+	munmap( mapping->base, mapping->size );
+#endif
+	pl_free( mapping );
+}
+
+/**
+ * Creates a read-only handle over a region of a mapped file,
+ * without copying it. The view keeps the mapping alive, so it
+ * remains valid after the parent is closed. Returns NULL if
+ * the parent isn't mapped.
+ */
+PLFile *PlCreateFileView( PLFile *parent, const char *path, size_t offset, size_t size ) {
+	if ( parent->mapping == NULL ) {
+		return NULL;
+	}
+
+	if ( offset > parent->size || size > parent->size - offset ) {
+		PlReportErrorF( PL_RESULT_FILESIZE, "view falls outside of %s", parent->path );
+		return NULL;
+	}
+
+	PLFile *ptr = pl_calloc( 1, sizeof( PLFile ) );
+	snprintf( ptr->path, sizeof( ptr->path ), "%s", path );
+	ptr->size = size;
+	ptr->data = parent->data + offset;
+	ptr->pos = ptr->data;
+	ptr->timeStamp = parent->timeStamp;
+
+	ptr->mapping = parent->mapping;
+	PlAtomicIncrement( &ptr->mapping->refCount );
+
+	return ptr;
+}
+
+/**
+ * Wraps the given buffer in a handle that views can be created
+ * from, taking ownership of it. The buffer is freed once the
+ * handle and all of its views have been closed.
+ */
+PLFile *PlCreateBufferFile( const char *path, uint8_t *data, size_t size ) {
+	PLFile *ptr = pl_calloc( 1, sizeof( PLFile ) );
+	snprintf( ptr->path, sizeof( ptr->path ), "%s", path );
+	ptr->size = size;
+	ptr->data = data;
+	ptr->pos = ptr->data;
+
+	ptr->mapping = pl_malloc( sizeof( FSMapping ) );
+	ptr->mapping->base = data;
+	ptr->mapping->size = size;
+	ptr->mapping->refCount = 1;
+	ptr->mapping->isAllocated = true;
+
+	return ptr;
+}
+
+/* Inflate streams decompress zlib data as it's read, so only the
+ * input buffer and the 32KB window ever need to be held. Seeking
+ * forward inflates and discards, seeking back starts over. */
+
+#define FS_INFLATE_INPUT_SIZE 16384
+
+typedef struct FSInflateStream {
+	PLFile *source; /* takes ownership */
+	size_t sourceOffset;
+	size_t compressedSize;
+	size_t consumed; /* compressed bytes read from the source */
+
+	tinfl_decompressor inflator;
+	uint8_t input[ FS_INFLATE_INPUT_SIZE ];
+	size_t inputPos, inputLength;
+
+	uint8_t window[ TINFL_LZ_DICT_SIZE ];
+	size_t windowOffset;  /* where the next output is written */
+	size_t pendingOffset; /* output that's yet to be handed out */
+	size_t pendingLength;
+	size_t position; /* uncompressed offset of the pending output */
+	bool finished;
+} FSInflateStream;
+
+static void ResetInflateStream( FSInflateStream *stream ) {
+	tinfl_init( &stream->inflator );
+	stream->consumed = 0;
+	stream->inputPos = stream->inputLength = 0;
+	stream->windowOffset = 0;
+	stream->pendingOffset = stream->pendingLength = 0;
+	stream->position = 0;
+	stream->finished = false;
+}
+
+/**
+ * Inflates the next block of output into the window.
+ * Expects any pending output to have been consumed.
+ */
+static void InflateStreamBlock( FSInflateStream *stream ) {
+	if ( stream->inputPos >= stream->inputLength && stream->consumed < stream->compressedSize ) {
+		size_t length = stream->compressedSize - stream->consumed;
+		if ( length > sizeof( stream->input ) ) {
+			length = sizeof( stream->input );
+		}
+
+		stream->inputLength = PlReadFileAt( stream->source, stream->input, length, stream->sourceOffset + stream->consumed );
+		stream->inputPos = 0;
+		stream->consumed += stream->inputLength;
+		if ( stream->inputLength == 0 ) {
+			/* source has been truncated */
+			stream->consumed = stream->compressedSize;
+		}
+	}
+
+	mz_uint32 flags = TINFL_FLAG_PARSE_ZLIB_HEADER;
+	if ( stream->consumed < stream->compressedSize ) {
+		flags |= TINFL_FLAG_HAS_MORE_INPUT;
+	}
+
+	size_t inBytes = stream->inputLength - stream->inputPos;
+	size_t outBytes = sizeof( stream->window ) - stream->windowOffset;
+	tinfl_status status = tinfl_decompress( &stream->inflator, &stream->input[ stream->inputPos ], &inBytes,
+	                                        stream->window, &stream->window[ stream->windowOffset ], &outBytes, flags );
+	stream->inputPos += inBytes;
+
+	stream->pendingOffset = stream->windowOffset;
+	stream->pendingLength = outBytes;
+	stream->windowOffset = ( stream->windowOffset + outBytes ) & ( TINFL_LZ_DICT_SIZE - 1 );
+
+	if ( status <= TINFL_STATUS_DONE ) {
+		if ( status < TINFL_STATUS_DONE ) {
+			FSLog( "Failed to inflate stream (%d)!\n", status );
+		}
+		stream->finished = true;
+	} else if ( inBytes == 0 && outBytes == 0 && !( flags & TINFL_FLAG_HAS_MORE_INPUT ) && stream->inputPos >= stream->inputLength ) {
+		/* ran out of input before the end of the stream */
+		stream->finished = true;
 	}
-
-	return false;
-#endif
 }
 
-bool PlPathExists( const char *path ) {
-	if ( fs_mount_root == NULL ) {
-		return PlLocalPathExists( path );
-	} else if ( strncmp( FS_LOCAL_HINT, path, sizeof( FS_LOCAL_HINT ) ) == 0 ) {
-		path += sizeof( FS_LOCAL_HINT );
-		return PlLocalPathExists( path );
+static size_t ReadInflateStream( FSInflateStream *stream, void *dest, size_t size, size_t offset ) {
+	if ( offset < stream->position ) {
+		ResetInflateStream( stream );
 	}
 
-	PLFileSystemMount *location = fs_mount_root;
-	while ( location != NULL ) {
-		if ( location->type == FS_MOUNT_DIR ) {
-			/* todo: don't allow path to search outside of mounted path */
-			char buf[ PL_SYSTEM_MAX_PATH + 1 ];
-			snprintf( buf, sizeof( buf ), "%s/%s", location->path, path );
-			if ( PlLocalPathExists( buf ) ) {
-				return true;
+	size_t total = 0;
+	while ( total < size ) {
+		if ( stream->pendingLength == 0 ) {
+			if ( stream->finished ) {
+				break;
+			}
+
+			InflateStreamBlock( stream );
+			continue;
+		}
+
+		size_t length = stream->pendingLength;
+		const uint8_t *src = &stream->window[ stream->pendingOffset ];
+		if ( offset + total > stream->position ) {
+			/* still skipping up to the requested offset */
+			size_t skip = offset + total - stream->position;
+			if ( length > skip ) {
+				length = skip;
 			}
 		} else {
-			for ( unsigned int i = 0; i < location->pkg->table_size; ++i ) {
-				char *p = strstr( location->pkg->path, path );
-				if ( p != NULL && p == location->pkg->path ) {
-					return true;
-				}
+			if ( length > size - total ) {
+				length = size - total;
 			}
+
+			memcpy( ( uint8_t * ) dest + total, src, length );
+			total += length;
 		}
 
-		location = location->next;
+		stream->pendingOffset += length;
+		stream->pendingLength -= length;
+		stream->position += length;
 	}
 
-	return false;
+	return total;
 }
 
 /**
- * Deletes the specified file. Not VFS compatible.
- * @param path Path to the file you want to delete.
- * @return True on success and false on fail.
+ * Creates a handle that inflates the given range of zlib data
+ * as it's read. Takes ownership of the source handle.
  */
-bool PlDeleteFile( const char *path ) {
-	if ( !PlLocalFileExists( path ) ) {
-		return true;
+PLFile *PlCreateInflateStream( PLFile *source, const char *path, size_t offset, size_t compressedSize, size_t size ) {
+	PLFile *ptr = pl_calloc( 1, sizeof( PLFile ) );
+	if ( ptr == NULL ) {
+		PlCloseFile( source );
+		return NULL;
 	}
 
-	int result = remove( path );
-	if ( result == 0 ) {
-		return true;
+	ptr->stream = pl_malloc( sizeof( FSInflateStream ) );
+	if ( ptr->stream == NULL ) {
+		pl_free( ptr );
+		PlCloseFile( source );
+		return NULL;
 	}
 
-	PlReportErrorF( PL_RESULT_FILEREAD, strerror( errno ) );
-	return false;
-}
+	ptr->stream->source = source;
+	ptr->stream->sourceOffset = offset;
+	ptr->stream->compressedSize = compressedSize;
+	ResetInflateStream( ptr->stream );
 
-/**
- * Write the data to the specified location. Not VFS compatible.
- * @param path Path to the destination.
- * @param buf Data buffer for whatever you're writing.
- * @param length Length of the data buffer.
- * @return True on success and false on fail.
- */
-bool PlWriteFile( const char *path, const uint8_t *buf, size_t length ) {
-	FILE *fp = fopen( path, "wb" );
-	if ( fp == NULL ) {
-		PlReportErrorF( PL_RESULT_FILEREAD, "failed to open %s", path );
-		return false;
-	}
+	snprintf( ptr->path, sizeof( ptr->path ), "%s", path );
+	ptr->size = size;
+	ptr->timeStamp = source->timeStamp;
 
-	bool result = true;
-	if ( fwrite( buf, sizeof( char ), length, fp ) != length ) {
-		PlReportErrorF( PL_RESULT_FILEWRITE, "failed to write entirety of file" );
-		result = false;
+	if ( fs_buffer_size != NULL && fs_buffer_size->i_value > 0 ) {
+		ptr->bufferSize = ( size_t ) fs_buffer_size->i_value;
 	}
 
-	_pl_fclose( fp );
-
-	return result;
+	return ptr;
 }
 
-bool PlCopyFile( const char *path, const char *dest ) {
-	// read in the original
-	PLFile *original = PlOpenFile( path, true );
-	if ( original == NULL ) {
-		PlReportErrorF( PL_RESULT_FILEREAD, "failed to open %s", path );
-		return false;
-	}
-
-	// write out the copy
-	FILE *copy = fopen( dest, "wb" );
-	if ( copy == NULL ) {
-		PlReportErrorF( PL_RESULT_FILEWRITE, "failed to open %s for write", dest );
-		goto BAIL;
+/**
+ * Tells the system how a mapped file is going to be accessed, so
+ * it can adjust read-ahead accordingly. Does nothing for other files.
+ */
+void PlSetFileAccessHint( PLFile *ptr, PLFileAccessHint hint ) {
+	if ( ptr->mapping == NULL || ptr->mapping->isAllocated ) {
+		return;
 	}
 
-	if ( fwrite( original->data, 1, original->size, copy ) != original->size ) {
-		PlReportErrorF( PL_RESULT_FILEWRITE, "failed to write out %d bytes for %s", original->size, path );
-		goto BAIL;
+#if !defined( _WIN32 )
+	int advice;
+	switch ( hint ) {
+		default:
+			advice = MADV_NORMAL;
+			break;
+		case PL_FILE_ACCESS_SEQUENTIAL:
+			advice = MADV_SEQUENTIAL;
+			break;
+		case PL_FILE_ACCESS_RANDOM:
+			advice = MADV_RANDOM;
+			break;
 	}
 
-	_pl_fclose( copy );
-
-	PlCloseFile( original );
-	return true;
-
-BAIL:
-
-	if ( copy != NULL ) {
-		_pl_fclose( copy );
+	/* views needn't start on a page boundary, but the advice does */
+	uintptr_t pageSize = ( uintptr_t ) sysconf( _SC_PAGESIZE );
+	uintptr_t start = ( uintptr_t ) ptr->data;
+	uintptr_t alignedStart = start & ~( pageSize - 1 );
+	if ( madvise( ( void * ) alignedStart, ptr->size + ( start - alignedStart ), advice ) != 0 ) {
+		FSLog( "Failed to set access hint for %s: %s\n", ptr->path, strerror( errno ) );
 	}
-
-	PlCloseFile( original );
-	return false;
+#else
+	PlUnused( hint );
+#endif
 }
 
-size_t PlGetLocalFileSize( const char *path ) {
-	struct stat buf;
-	if ( stat( path, &buf ) != 0 ) {
-		PlReportErrorF( PL_RESULT_FILEERR, "failed to stat %s: %s", path, strerror( errno ) );
-		return 0;
+/**
+ * Lets the system know that the given range of the file is about to
+ * be read, so it can start bringing it in ahead of time.
+ */
+void PlPrefetchFileRange( PLFile *ptr, size_t offset, size_t size ) {
+	if ( offset >= ptr->size || size == 0 ) {
+		return;
 	}
 
-	return ( size_t ) buf.st_size;
-}
-
-///////////////////////////////////////////
-
-PLFile *PlOpenLocalFile( const char *path, bool cache ) {
-	FILE *fp = fopen( path, "rb" );
-	if ( fp == NULL ) {
-		PlReportErrorF( PL_RESULT_FILEREAD, strerror( errno ) );
-		return NULL;
+	if ( size > ptr->size - offset ) {
+		size = ptr->size - offset;
 	}
 
-	PLFile *ptr = pl_calloc( 1, sizeof( PLFile ) );
-	snprintf( ptr->path, sizeof( ptr->path ), "%s", path );
-	ptr->size = PlGetLocalFileSize( path );
-
-	if ( cache ) {
-		ptr->data = pl_malloc( ptr->size * sizeof( uint8_t ) );
-		ptr->pos = ptr->data;
-		if ( fread( ptr->data, sizeof( uint8_t ), ptr->size, fp ) != ptr->size ) {
-			FSLog( "Failed to read complete file (%s)!\n", path );
+#if !defined( _WIN32 )
+	if ( ptr->mapping != NULL && !ptr->mapping->isAllocated ) {
+		/* has to start on a page boundary */
+		uintptr_t pageSize = ( uintptr_t ) sysconf( _SC_PAGESIZE );
+		uintptr_t start = ( uintptr_t ) ( ptr->data + offset );
+		uintptr_t alignedStart = start & ~( pageSize - 1 );
+		if ( madvise( ( void * ) alignedStart, size + ( start - alignedStart ), MADV_WILLNEED ) != 0 ) {
+			FSLog( "Failed to prefetch %s: %s\n", ptr->path, strerror( errno ) );
 		}
-		_pl_fclose( fp );
-	} else {
-		ptr->fptr = fp;
+	} else if ( ptr->fptr != NULL ) {
+		posix_fadvise( fileno( ptr->fptr ), ( off_t ) offset, ( off_t ) size, POSIX_FADV_WILLNEED );
 	}
-
-	/* timestamp for local files is a special case */
-	ptr->timeStamp = -1;
-
-	return ptr;
+#endif
 }
 
 /**
@@ -963,36 +2921,123 @@ PLFile *PlOpenFile( const char *path, bool cache ) {
 		return NULL;
 	}
 
-	if ( fs_mount_root == NULL ) {
+	if ( strncmp( FS_LOCAL_HINT, path, FS_LOCAL_HINT_LENGTH ) == 0 ) {
+		path += FS_LOCAL_HINT_LENGTH;
 		return PlOpenLocalFile( path, cache );
-	} else if ( strncmp( FS_LOCAL_HINT, path, sizeof( FS_LOCAL_HINT ) ) == 0 ) {
-		path += sizeof( FS_LOCAL_HINT );
+	} else if ( strncmp( FS_MEMORY_HINT, path, FS_MEMORY_HINT_LENGTH ) == 0 ) {
+		return PlOpenMemoryFile( path + FS_MEMORY_HINT_LENGTH );
+	} else if ( fs_mount_root == NULL ) {
 		return PlOpenLocalFile( path, cache );
 	}
 
-	char buf[ PL_SYSTEM_MAX_PATH + 1 ];
-	PLFileSystemMount *location = fs_mount_root;
-	while ( location != NULL ) {
-		PLFile *fp;
-		if ( location->type == FS_MOUNT_DIR ) {
-			/* todo: don't allow path to search outside of mounted path */
-			snprintf( buf, sizeof( buf ), "%s/%s", location->path, path );
-			fp = PlOpenLocalFile( buf, cache );
-		} else {
-			fp = PlLoadPackageFile( location->pkg, path );
+	FSOpenMode mode = { .cache = cache };
+	return OpenMountedFile( path, &mode );
+}
+
+typedef struct FSBatchEntry {
+	PLPackage *package;
+	unsigned int index; /* into the package table */
+	unsigned int slot;  /* into the caller's array */
+} FSBatchEntry;
+
+static int CompareBatchEntries( const void *a, const void *b ) {
+	const FSBatchEntry *x = ( const FSBatchEntry * ) a;
+	const FSBatchEntry *y = ( const FSBatchEntry * ) b;
+	if ( x->package != y->package ) {
+		return ( ( uintptr_t ) x->package < ( uintptr_t ) y->package ) ? -1 : 1;
+	}
+
+	return ( x->slot < y->slot ) ? -1 : ( x->slot > y->slot );
+}
+
+/**
+ * Opens several files at once via the VFS, for when a whole batch of
+ * files are needed up front. Packaged files are grouped by package and
+ * read in the order they're stored, see PlOpenPackageFilesByIndex, which
+ * turns what would be scattered reads into mostly sequential ones.
+ * Files that couldn't be opened are set to NULL.
+ * @return The number of files that were opened.
+ */
+unsigned int PlOpenFiles( const char **paths, unsigned int numPaths, bool cache, PLFile **out ) {
+	memset( out, 0, sizeof( PLFile * ) * numPaths );
+
+	FSBatchEntry *entries = NULL;
+	unsigned int *indices = NULL;
+	PLFile **files = NULL;
+	if ( fs_mount_root != NULL && numPaths > 0 ) {
+		entries = pl_malloc( sizeof( FSBatchEntry ) * numPaths );
+		indices = pl_malloc( sizeof( unsigned int ) * numPaths );
+		files = pl_malloc( sizeof( PLFile * ) * numPaths );
+	}
+
+	/* work out which of these are provided by packages */
+	unsigned int numEntries = 0;
+	if ( entries != NULL && indices != NULL && files != NULL ) {
+		LockIndexForRead();
+		for ( unsigned int i = 0; i < numPaths; ++i ) {
+			if ( plIsEmptyString( paths[ i ] ) || strncmp( FS_LOCAL_HINT, paths[ i ], FS_LOCAL_HINT_LENGTH ) == 0 ) {
+				continue;
+			}
+
+			bool folded;
+			const FSIndexEntry *entry = LookupIndex( paths[ i ], &folded );
+			if ( entry == NULL || entry->mount->type != FS_MOUNT_PACKAGE ) {
+				continue;
+			}
+
+			/* an unwatched directory searched first could be providing it,
+			 * so leave that to be worked out when it's opened on its own */
+			const PLFileSystemMount *unwatched = FindUnwatchedMount( fs_mount_root );
+			if ( unwatched != NULL && unwatched->order < entry->mount->order ) {
+				continue;
+			}
+
+			entries[ numEntries ].package = entry->mount->pkg;
+			entries[ numEntries ].index = ( unsigned int ) entry->packageIndex;
+			entries[ numEntries ].slot = i;
+			numEntries++;
 		}
+		UnlockIndexForRead();
 
-		if ( fp == NULL ) {
-			location = location->next;
-			continue;
+		qsort( entries, numEntries, sizeof( FSBatchEntry ), CompareBatchEntries );
+	}
+
+	for ( unsigned int i = 0; i < numEntries; ) {
+		unsigned int numIndices = 0;
+		for ( unsigned int j = i; j < numEntries && entries[ j ].package == entries[ i ].package; ++j ) {
+			indices[ numIndices++ ] = entries[ j ].index;
+		}
+
+		PlOpenPackageFilesByIndex( entries[ i ].package, indices, numIndices, cache, files );
+		for ( unsigned int j = 0; j < numIndices; ++j ) {
+			out[ entries[ i + j ].slot ] = files[ j ];
+			if ( files[ j ] != NULL ) {
+				const PLPackageIndex *index = &entries[ i ].package->table[ indices[ j ] ];
+				PlTraceFileAccess( paths[ entries[ i + j ].slot ], entries[ i ].package->path, index->offset,
+				                   ( index->compressionType != PL_COMPRESSION_NONE ) ? index->compressedSize : index->fileSize );
+			}
 		}
 
-		return fp;
+		i += numIndices;
 	}
 
-	/* the above will have reported an error */
+	pl_free( entries );
+	pl_free( indices );
+	pl_free( files );
 
-	return NULL;
+	/* everything else, or anything the package failed to provide,
+	 * goes through the usual route */
+	unsigned int numOpened = 0;
+	for ( unsigned int i = 0; i < numPaths; ++i ) {
+		if ( out[ i ] == NULL ) {
+			out[ i ] = PlOpenFile( paths[ i ], cache );
+		}
+		if ( out[ i ] != NULL ) {
+			numOpened++;
+		}
+	}
+
+	return numOpened;
 }
 
 void PlCloseFile( PLFile *ptr ) {
@@ -1000,11 +3045,26 @@ void PlCloseFile( PLFile *ptr ) {
 		return;
 	}
 
+	if ( ptr->isRegistered ) {
+		PlUnregisterMemoryFile( ptr );
+	}
+
 	if ( ptr->fptr != NULL ) {
 		_pl_fclose( ptr->fptr );
 	}
 
-	pl_free( ptr->data );
+	if ( ptr->stream != NULL ) {
+		PlCloseFile( ptr->stream->source );
+		pl_free( ptr->stream );
+	}
+
+	if ( ptr->mapping != NULL ) {
+		ReleaseFileMapping( ptr->mapping );
+	} else {
+		pl_free( ptr->data );
+	}
+
+	pl_free( ptr->buffer );
 	pl_free( ptr );
 }
 
@@ -1027,26 +3087,76 @@ const uint8_t *PlGetFileData( const PLFile *ptr ) {
  * @return Number of bytes within file.
  */
 size_t PlGetFileSize( const PLFile *ptr ) {
-	if ( ptr->fptr != NULL ) {
-		return PlGetLocalFileSize( ptr->path );
-	}
-
 	return ptr->size;
 }
 
+/**
+ * Returns true if the file isn't held in memory, and so
+ * is read through the read-ahead buffer instead.
+ */
+static bool IsBufferedFile( const PLFile *ptr ) {
+	return ( ptr->fptr != NULL || ptr->stream != NULL );
+}
+
 /**
  * Returns the current position within the file handle (ftell).
  * @param ptr Pointer to the file handle.
  * @return Number of bytes into the file.
  */
 size_t PlGetFileOffset( const PLFile *ptr ) {
-	if ( ptr->fptr != NULL ) {
-		return ftell( ptr->fptr );
+	if ( IsBufferedFile( ptr ) ) {
+		return ptr->offset;
 	}
 
 	return ptr->pos - ptr->data;
 }
 
+static bool FillFileBuffer( PLFile *ptr ) {
+	if ( ptr->buffer == NULL ) {
+		ptr->buffer = pl_malloc( ptr->bufferSize );
+		if ( ptr->buffer == NULL ) {
+			return false;
+		}
+	}
+
+	ptr->bufferOffset = ptr->offset;
+	ptr->bufferLength = PlReadFileAt( ptr, ptr->buffer, ptr->bufferSize, ptr->offset );
+	return ( ptr->bufferLength > 0 );
+}
+
+/**
+ * Reads from an uncached file, going through the read-ahead
+ * buffer for anything smaller than it.
+ */
+static size_t ReadBufferedFile( PLFile *ptr, void *dest, size_t length ) {
+	size_t total = 0;
+	while ( total < length && ptr->offset < ptr->size ) {
+		if ( ptr->offset >= ptr->bufferOffset && ptr->offset < ptr->bufferOffset + ptr->bufferLength ) {
+			size_t available = ptr->bufferOffset + ptr->bufferLength - ptr->offset;
+			if ( available > length - total ) {
+				available = length - total;
+			}
+
+			memcpy( ( uint8_t * ) dest + total, ptr->buffer + ( ptr->offset - ptr->bufferOffset ), available );
+			ptr->offset += available;
+			total += available;
+		} else if ( length - total >= ptr->bufferSize ) {
+			/* no point copying big reads through the buffer */
+			size_t r = PlReadFileAt( ptr, ( uint8_t * ) dest + total, length - total, ptr->offset );
+			if ( r == 0 ) {
+				break;
+			}
+
+			ptr->offset += r;
+			total += r;
+		} else if ( !FillFileBuffer( ptr ) ) {
+			break;
+		}
+	}
+
+	return total;
+}
+
 size_t PlReadFile( PLFile *ptr, void *dest, size_t size, size_t count ) {
 	/* bail early if size is 0 to avoid division by 0 */
 	if ( size == 0 ) {
@@ -1054,8 +3164,8 @@ size_t PlReadFile( PLFile *ptr, void *dest, size_t size, size_t count ) {
 		return 0;
 	}
 
-	if ( ptr->fptr != NULL ) {
-		return fread( dest, size, count, ptr->fptr );
+	if ( IsBufferedFile( ptr ) ) {
+		return ReadBufferedFile( ptr, dest, size * count ) / size;
 	}
 
 	/* ensure that the read is valid */
@@ -1071,6 +3181,68 @@ size_t PlReadFile( PLFile *ptr, void *dest, size_t size, size_t count ) {
 	return length / size;
 }
 
+/**
+ * Reads from the given offset, without moving the position
+ * within the file. Returns the number of bytes read.
+ */
+size_t PlReadFileAt( PLFile *ptr, void *dest, size_t size, size_t offset ) {
+	if ( ptr->stream != NULL ) {
+		return ReadInflateStream( ptr->stream, dest, size, offset );
+	} else if ( ptr->fptr == NULL ) {
+		if ( offset >= ptr->size ) {
+			return 0;
+		}
+
+		if ( size > ptr->size - offset ) {
+			size = ptr->size - offset;
+		}
+
+		memcpy( dest, ptr->data + offset, size );
+		return size;
+	}
+
+#if !defined( _WIN32 )
+	size_t total = 0;
+	int fd = fileno( ptr->fptr );
+	while ( total < size ) {
+		ssize_t r = pread( fd, ( uint8_t * ) dest + total, size - total, ( off_t ) ( offset + total ) );
+		if ( r < 0 && errno == EINTR ) {
+			continue;
+		} else if ( r <= 0 ) {
+			break;
+		}
+		total += ( size_t ) r;
+	}
+
+	return total;
+#else
+	/* the offset goes along with each read, same as pread, so
+	 * reads can be made from any thread without a shared position */
+	HANDLE handle = ( HANDLE ) _get_osfhandle( _fileno( ptr->fptr ) );
+	if ( handle == INVALID_HANDLE_VALUE ) {
+		return 0;
+	}
+
+	size_t total = 0;
+	while ( total < size ) {
+		uint64_t position = ( uint64_t ) offset + total;
+		OVERLAPPED overlapped;
+		memset( &overlapped, 0, sizeof( OVERLAPPED ) );
+		overlapped.Offset = ( DWORD ) position;
+		overlapped.OffsetHigh = ( DWORD ) ( position >> 32 );
+
+		DWORD length = ( size - total > MAXDWORD ) ? MAXDWORD : ( DWORD ) ( size - total );
+		DWORD r;
+		if ( !ReadFile( handle, ( uint8_t * ) dest + total, length, &r, &overlapped ) || r == 0 ) {
+			break;
+		}
+		total += r;
+	}
+
+	return total;
+#endif
+}
+
 char PlReadInt8( PLFile *ptr, bool *status ) {
 	if ( PlGetFileOffset( ptr ) >= ptr->size ) {
 		if ( status != NULL ) {
@@ -1083,8 +3255,20 @@ char PlReadInt8( PLFile *ptr, bool *status ) {
 		*status = true;
 	}
 
-	if ( ptr->fptr != NULL ) {
-		return ( char ) ( fgetc( ptr->fptr ) );
+	if ( IsBufferedFile( ptr ) ) {
+		if ( ptr->offset >= ptr->bufferOffset && ptr->offset < ptr->bufferOffset + ptr->bufferLength ) {
+			return ( char ) ptr->buffer[ ptr->offset++ - ptr->bufferOffset ];
+		}
+
+		char c;
+		if ( ReadBufferedFile( ptr, &c, 1 ) != 1 ) {
+			if ( status != NULL ) {
+				*status = false;
+			}
+			return 0;
+		}
+
+		return c;
 	}
 
 	return ( char ) *( ptr->pos++ );
@@ -1133,14 +3317,81 @@ int64_t PlReadInt64( PLFile *ptr, bool big_endian, bool *status ) {
 	return ReadSizedInteger( ptr, sizeof( int64_t ), big_endian, status );
 }
 
+/**
+ * Reads an array of values in one go, and then swaps them
+ * into the host's byte order if necessary.
+ * @return Number of values read.
+ */
+static size_t ReadArray( PLFile *ptr, void *dest, size_t size, size_t count, bool bigEndian ) {
+	if ( count == 0 ) {
+		return 0;
+	}
+
+	size_t numRead = PlReadFile( ptr, dest, size, count );
+	if ( bigEndian != _plIsHostBigEndian() ) {
+		switch ( size ) {
+			case sizeof( uint16_t ):
+				_plSwapArray16( dest, numRead );
+				break;
+			case sizeof( uint32_t ):
+				_plSwapArray32( dest, numRead );
+				break;
+			case sizeof( uint64_t ):
+				_plSwapArray64( dest, numRead );
+				break;
+		}
+	}
+
+	return numRead;
+}
+
+size_t PlReadInt16Array( PLFile *ptr, int16_t *dest, size_t count, bool bigEndian ) {
+	return ReadArray( ptr, dest, sizeof( int16_t ), count, bigEndian );
+}
+
+size_t PlReadInt32Array( PLFile *ptr, int32_t *dest, size_t count, bool bigEndian ) {
+	return ReadArray( ptr, dest, sizeof( int32_t ), count, bigEndian );
+}
+
+size_t PlReadInt64Array( PLFile *ptr, int64_t *dest, size_t count, bool bigEndian ) {
+	return ReadArray( ptr, dest, sizeof( int64_t ), count, bigEndian );
+}
+
+size_t PlReadFloat32Array( PLFile *ptr, float *dest, size_t count, bool bigEndian ) {
+	return ReadArray( ptr, dest, sizeof( float ), count, bigEndian );
+}
+
+size_t PlReadFloat64Array( PLFile *ptr, double *dest, size_t count, bool bigEndian ) {
+	return ReadArray( ptr, dest, sizeof( double ), count, bigEndian );
+}
+
 char *PlReadString( PLFile *ptr, char *str, size_t size ) {
 	if ( size == 0 ) {
 		PlReportBasicError( PL_RESULT_INVALID_PARM3 );
 		return NULL;
 	}
 
-	if ( ptr->fptr != NULL ) {
-		return fgets( str, ( int ) size, ptr->fptr );
+	if ( IsBufferedFile( ptr ) ) {
+		/* behaves the same as fgets */
+		if ( ptr->offset >= ptr->size ) {
+			return NULL;
+		}
+
+		size_t i = 0;
+		while ( i < size - 1 ) {
+			char c;
+			if ( ReadBufferedFile( ptr, &c, 1 ) != 1 ) {
+				break;
+			}
+
+			str[ i++ ] = c;
+			if ( c == '\n' ) {
+				break;
+			}
+		}
+		str[ i ] = '\0';
+
+		return str;
 	}
 
 	if ( ptr->pos >= ptr->data + ptr->size ) {
@@ -1166,13 +3417,30 @@ char *PlReadString( PLFile *ptr, char *str, size_t size ) {
 }
 
 bool PlFileSeek( PLFile *ptr, long int pos, PLFileSeek seek ) {
-	if ( ptr->fptr != NULL ) {
-		int err = fseek( ptr->fptr, pos, seek );
-		if ( err != 0 ) {
-			PlReportErrorF( PL_RESULT_FILEREAD, "failed to seek file (%s)", GetLastError_strerror( GetLastError() ) );
+	if ( IsBufferedFile( ptr ) ) {
+		/* same rules as fseek, other than not allowing a seek past the end */
+		long int base;
+		switch ( seek ) {
+			case PL_SEEK_CUR:
+				base = ( long int ) ptr->offset;
+				break;
+			case PL_SEEK_SET:
+				base = 0;
+				break;
+			case PL_SEEK_END:
+				base = ( long int ) ptr->size;
+				break;
+			default:
+				PlReportBasicError( PL_RESULT_INVALID_PARM3 );
+				return false;
+		}
+
+		if ( base + pos < 0 || base + pos > ( long int ) ptr->size ) {
+			PlReportBasicError( PL_RESULT_INVALID_PARM2 );
 			return false;
 		}
 
+		ptr->offset = ( size_t ) ( base + pos );
 		return true;
 	}
 
@@ -1211,8 +3479,8 @@ bool PlFileSeek( PLFile *ptr, long int pos, PLFileSeek seek ) {
 }
 
 void PlRewindFile( PLFile *ptr ) {
-	if ( ptr->fptr != NULL ) {
-		rewind( ptr->fptr );
+	if ( IsBufferedFile( ptr ) ) {
+		ptr->offset = 0;
 		return;
 	}
 
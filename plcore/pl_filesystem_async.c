@@ -0,0 +1,250 @@
+/**
+ * Hei Platform Library
+ * Copyright (C) 2017-2021 Mark E Sowden <hogsy@oldtimes-software.com>
+ * This software is licensed under MIT. See LICENSE for more details.
+ */
+
+#include <plcore/pl_package.h>
+
+#include "filesystem_private.h"
+#include "pl_private.h"
+#include "thread_private.h"
+
+/*	Asynchronous File I/O	*/
+
+/* Requests are handed off to the worker pool, with each
+ * worker performing a regular blocking open. Requests own
+ * their own job group, so waiting on one lets the caller
+ * help out with the queue rather than sitting idle. */
+
+typedef struct PLFileRequest {
+	char path[ PL_SYSTEM_MAX_PATH ];
+	bool cache;
+
+	PLPackage *package; /* if set, packageIndex is loaded from here instead */
+	unsigned int packageIndex;
+
+	PLFileRequestCallback Callback;
+	void *userData;
+
+	PLJobGroup *group;
+	PLFile *file;
+	bool isRunning;
+	bool isComplete;
+	bool isCancelled;
+	bool isDestroyed; /* by its own callback, so it's freed once that returns */
+} PLFileRequest;
+
+/* only used to protect the state of each request */
+static PLMutex *fs_request_mutex = NULL;
+
+/* the request whose callback is being run on this thread */
+static PL_THREAD_LOCAL PLFileRequest *fs_callback_request = NULL;
+
+/**
+ * Called from PlInitFileSystem, so the mutex exists before
+ * any thread can make a request. It's kept around after
+ * shutdown, as workers may still be finishing requests off.
+ */
+void PlInitFileRequests( void ) {
+	if ( fs_request_mutex == NULL ) {
+		fs_request_mutex = PlCreateMutex();
+	}
+}
+
+static void RunFileRequest( void *userData ) {
+	PLFileRequest *request = ( PLFileRequest * ) userData;
+
+	PlLockMutex( fs_request_mutex );
+	bool isCancelled = request->isCancelled;
+	request->isRunning = !isCancelled;
+	PlUnlockMutex( fs_request_mutex );
+
+	PLFile *file = NULL;
+	if ( !isCancelled ) {
+		if ( request->package != NULL ) {
+			file = PlLoadPackageFileByIndex( request->package, request->packageIndex );
+		} else {
+			file = PlOpenFile( request->path, request->cache );
+		}
+	}
+
+	PlLockMutex( fs_request_mutex );
+	/* might have been cancelled while we were busy */
+	if ( request->isCancelled ) {
+		PlCloseFile( file );
+		file = NULL;
+	}
+	request->isRunning = false;
+	request->isComplete = true;
+	request->file = ( request->Callback == NULL ) ? file : NULL;
+	PlUnlockMutex( fs_request_mutex );
+
+	if ( request->Callback != NULL ) {
+		fs_callback_request = request;
+		request->Callback( request, file, request->userData );
+		fs_callback_request = NULL;
+
+		/* our job is still running, so the group can't be waited on */
+		if ( request->isDestroyed ) {
+			PlReleaseJobGroup( request->group );
+			pl_free( request );
+		}
+	}
+}
+
+static PLFileRequest *QueueFileRequest( PLFileRequest *request ) {
+	if ( fs_request_mutex == NULL ) {
+		PlReportErrorF( PL_RESULT_FAIL, "file system hasn't been initialized" );
+		pl_free( request );
+		return NULL;
+	}
+
+	request->group = PlCreateJobGroup();
+	if ( request->group == NULL ) {
+		pl_free( request );
+		return NULL;
+	}
+
+	if ( !PlQueueJob( request->group, RunFileRequest, request ) ) {
+		PlDestroyJobGroup( request->group );
+		pl_free( request );
+		return NULL;
+	}
+
+	return request;
+}
+
+/**
+ * Opens the specified file via the VFS on one of the workers.
+ * Mounted locations shouldn't be changed, and watches shouldn't be
+ * polled, while requests are pending; see PlWaitFileRequest.
+ * @param path Path to the file you want to open.
+ * @param cache Whether or not to cache the entire file into memory.
+ * @param Callback Optional function that's called from the worker once
+ * the request has completed, and is then responsible for closing the
+ * file. The file is NULL if the request failed or was cancelled. The
+ * callback may destroy its own request, but mustn't wait on it.
+ * @return Handle to the request, which needs to be destroyed via
+ * PlDestroyFileRequest.
+ */
+PLFileRequest *PlOpenFileAsync( const char *path, bool cache, PLFileRequestCallback Callback, void *userData ) {
+	if ( plIsEmptyString( path ) ) {
+		PlReportBasicError( PL_RESULT_FILEPATH );
+		return NULL;
+	}
+
+	PLFileRequest *request = pl_calloc( 1, sizeof( PLFileRequest ) );
+	if ( request == NULL ) {
+		return NULL;
+	}
+
+	snprintf( request->path, sizeof( request->path ), "%s", path );
+	request->cache = cache;
+	request->Callback = Callback;
+	request->userData = userData;
+
+	return QueueFileRequest( request );
+}
+
+/**
+ * Loads the given file from the package on one of the workers,
+ * see PlOpenFileAsync. The package needs to outlive the request,
+ * and the same goes for mounts and watches as with PlOpenFileAsync.
+ */
+PLFileRequest *PlLoadPackageFileAsync( PLPackage *package, const char *path, PLFileRequestCallback Callback, void *userData ) {
+	/* the lookup can rebuild the package's index, so it's done here
+	 * rather than letting workers fight over it */
+	int index = PlGetPackageTableIndex( package, path );
+	if ( index == -1 ) {
+		return NULL;
+	}
+
+	PLFileRequest *request = pl_calloc( 1, sizeof( PLFileRequest ) );
+	if ( request == NULL ) {
+		return NULL;
+	}
+
+	snprintf( request->path, sizeof( request->path ), "%s", path );
+	request->package = package;
+	request->packageIndex = ( unsigned int ) index;
+	request->Callback = Callback;
+	request->userData = userData;
+
+	return QueueFileRequest( request );
+}
+
+/**
+ * Cancels the given request. If it's already being worked on
+ * then the opened file is discarded once it's done.
+ * @return False if the request had already completed.
+ */
+bool PlCancelFileRequest( PLFileRequest *request ) {
+	PlLockMutex( fs_request_mutex );
+	bool wasPending = !request->isComplete;
+	if ( wasPending ) {
+		request->isCancelled = true;
+	}
+	PlUnlockMutex( fs_request_mutex );
+
+	return wasPending;
+}
+
+bool PlIsFileRequestComplete( PLFileRequest *request ) {
+	PlLockMutex( fs_request_mutex );
+	bool isComplete = request->isComplete;
+	PlUnlockMutex( fs_request_mutex );
+
+	return isComplete;
+}
+
+/**
+ * Blocks until the given request has completed, and then hands
+ * over the file. The caller is then responsible for closing it.
+ * @return NULL if the request failed, was cancelled or has a callback.
+ */
+PLFile *PlWaitFileRequest( PLFileRequest *request ) {
+	/* would otherwise wait on ourselves forever */
+	plAssert( request != fs_callback_request );
+
+	PlWaitJobGroup( request->group );
+
+	PlLockMutex( fs_request_mutex );
+	PLFile *file = request->file;
+	request->file = NULL;
+	PlUnlockMutex( fs_request_mutex );
+
+	return file;
+}
+
+/**
+ * Blocks until every one of the given requests has completed.
+ * Files can then be fetched via PlWaitFileRequest without blocking.
+ */
+void PlWaitFileRequests( PLFileRequest **requests, unsigned int numRequests ) {
+	for ( unsigned int i = 0; i < numRequests; ++i ) {
+		if ( requests[ i ] == NULL ) {
+			continue;
+		}
+
+		PlWaitJobGroup( requests[ i ]->group );
+	}
+}
+
+/**
+ * Waits on the request before freeing it, closing the
+ * file if it wasn't fetched. If called from the request's
+ * own callback, it's freed once the callback returns instead.
+ */
+void PlDestroyFileRequest( PLFileRequest *request ) {
+	if ( request == NULL ) {
+		return;
+	} else if ( request == fs_callback_request ) {
+		request->isDestroyed = true;
+		return;
+	}
+
+	PlCloseFile( PlWaitFileRequest( request ) );
+	PlDestroyJobGroup( request->group );
+	pl_free( request );
+}
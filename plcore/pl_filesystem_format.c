@@ -0,0 +1,194 @@
+/**
+ * Hei Platform Library
+ * Copyright (C) 2017-2021 Mark E Sowden <hogsy@oldtimes-software.com>
+ * This software is licensed under MIT. See LICENSE for more details.
+ */
+
+#include <plcore/pl_hashtable.h>
+
+#include "filesystem_private.h"
+#include "pl_private.h"
+
+/*	Format Loaders	*/
+
+/* Packages and images are handed to whichever loaders recognise the
+ * first few bytes of the file, and failing that, to whichever loaders
+ * were registered for its extension without any way of recognising it.
+ * Extensions are looked up through a table, so it doesn't matter how
+ * many loaders have been registered. */
+
+#define FS_MAX_EXTENSION_LENGTH 32
+
+static size_t GetExtensionKey( char *dst, const char *extension ) {
+	size_t length = 0;
+	if ( extension != NULL ) {
+		for ( ; extension[ length ] != '\0' && length < FS_MAX_EXTENSION_LENGTH - 1; ++length ) {
+			dst[ length ] = ( char ) tolower( ( unsigned char ) extension[ length ] );
+		}
+	}
+	dst[ length ] = '\0';
+
+	return length;
+}
+
+static bool IsIdentifiedByContents( const FSFormatLoader *loader ) {
+	return ( loader->hasSignature || loader->Probe != NULL );
+}
+
+static bool MatchesContents( const FSFormatLoader *loader, const uint8_t *header, size_t size ) {
+	if ( loader->hasSignature ) {
+		const PLFileSignature *signature = &loader->signature;
+		if ( signature->offset + signature->length > size ) {
+			return false;
+		}
+
+		for ( unsigned int i = 0; i < signature->length; ++i ) {
+			if ( ( header[ signature->offset + i ] & signature->mask[ i ] ) != ( signature->magic[ i ] & signature->mask[ i ] ) ) {
+				return false;
+			}
+		}
+	}
+
+	if ( loader->Probe != NULL && !loader->Probe( header, size ) ) {
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Adds a loader to the registry. The signature and probe are both
+ * optional; without either, the loader is only used for files with
+ * the given extension.
+ */
+bool PlRegisterFormatLoader( FSFormatRegistry *registry, const char *extension, const PLFileSignature *signature, PLFileProbeFunction Probe, FSLoadFunction LoadFunction ) {
+	PLFileSignature normalized;
+	memset( &normalized, 0, sizeof( PLFileSignature ) );
+	if ( signature != NULL ) {
+		if ( signature->length == 0 || signature->length > PL_MAX_SIGNATURE_LENGTH ||
+		     signature->offset + signature->length > PL_FILE_SIGNATURE_SIZE ) {
+			PlReportErrorF( PL_RESULT_INVALID_PARM2, "invalid signature for \"%s\"", extension );
+			return false;
+		}
+
+		normalized = *signature;
+
+		/* no mask means every bit counts */
+		bool hasMask = false;
+		for ( unsigned int i = 0; i < normalized.length; ++i ) {
+			hasMask |= ( normalized.mask[ i ] != 0 );
+		}
+		if ( !hasMask ) {
+			memset( normalized.mask, 0xFF, normalized.length );
+		}
+	}
+
+	if ( registry->extensions == NULL ) {
+		registry->extensions = PlCreateHashTable();
+		if ( registry->extensions == NULL ) {
+			return false;
+		}
+	}
+
+	char key[ FS_MAX_EXTENSION_LENGTH ];
+	size_t keyLength = GetExtensionKey( key, extension );
+
+	/* registering the same loader twice is harmless */
+	FSFormatLoader *tail = PlLookupHashTableUserData( registry->extensions, key, keyLength );
+	for ( FSFormatLoader *loader = tail; loader != NULL; loader = loader->nextWithExtension ) {
+		if ( loader->LoadFunction == LoadFunction && loader->Probe == Probe &&
+		     loader->hasSignature == ( signature != NULL ) &&
+		     memcmp( &loader->signature, &normalized, sizeof( PLFileSignature ) ) == 0 ) {
+			return true;
+		}
+		tail = loader;
+	}
+
+	FSFormatLoader *loader = pl_calloc( 1, sizeof( FSFormatLoader ) );
+	if ( loader == NULL ) {
+		return false;
+	}
+
+	loader->extension = extension;
+	loader->signature = normalized;
+	loader->hasSignature = ( signature != NULL );
+	loader->Probe = Probe;
+	loader->LoadFunction = LoadFunction;
+
+	if ( tail != NULL ) {
+		tail->nextWithExtension = loader;
+	} else if ( !PlInsertHashTableNode( registry->extensions, key, keyLength, loader ) ) {
+		pl_free( loader );
+		return false;
+	}
+
+	if ( registry->last != NULL ) {
+		registry->last->next = loader;
+	} else {
+		registry->first = loader;
+	}
+	registry->last = loader;
+
+	registry->numLoaders++;
+	if ( IsIdentifiedByContents( loader ) ) {
+		registry->numIdentified++;
+	}
+
+	return true;
+}
+
+void PlClearFormatLoaders( FSFormatRegistry *registry ) {
+	FSFormatLoader *loader = registry->first;
+	while ( loader != NULL ) {
+		FSFormatLoader *next = loader->next;
+		pl_free( loader );
+		loader = next;
+	}
+
+	PlDestroyHashTable( registry->extensions );
+	memset( registry, 0, sizeof( FSFormatRegistry ) );
+}
+
+/**
+ * Fetches the loaders that should be tried for the given file, in the
+ * order they should be tried. Anything that recognises the contents
+ * comes first, followed by anything registered for the extension that
+ * has no way of telling. Only the start of the file is read, and only
+ * if there's a loader that can make use of it.
+ */
+unsigned int PlGetFormatLoaders( const FSFormatRegistry *registry, const char *path, const FSFormatLoader **loaders, unsigned int maxLoaders ) {
+	unsigned int numLoaders = 0;
+
+	if ( registry->numIdentified > 0 ) {
+		uint8_t header[ PL_FILE_SIGNATURE_SIZE ];
+		size_t headerSize = 0;
+
+		PLFile *file = PlOpenFile( path, false );
+		if ( file != NULL ) {
+			headerSize = PlReadFileAt( file, header, sizeof( header ), 0 );
+			PlCloseFile( file );
+		}
+
+		for ( const FSFormatLoader *loader = registry->first; loader != NULL && numLoaders < maxLoaders; loader = loader->next ) {
+			if ( IsIdentifiedByContents( loader ) && MatchesContents( loader, header, headerSize ) ) {
+				loaders[ numLoaders++ ] = loader;
+			}
+		}
+	}
+
+	if ( registry->extensions == NULL ) {
+		return numLoaders;
+	}
+
+	char key[ FS_MAX_EXTENSION_LENGTH ];
+	size_t keyLength = GetExtensionKey( key, PlGetFileExtension( path ) );
+
+	const FSFormatLoader *loader = PlLookupHashTableUserData( registry->extensions, key, keyLength );
+	for ( ; loader != NULL && numLoaders < maxLoaders; loader = loader->nextWithExtension ) {
+		if ( !IsIdentifiedByContents( loader ) ) {
+			loaders[ numLoaders++ ] = loader;
+		}
+	}
+
+	return numLoaders;
+}
@@ -0,0 +1,174 @@
+/**
+ * Hei Platform Library
+ * Copyright (C) 2017-2021 Mark E Sowden <hogsy@oldtimes-software.com>
+ * This software is licensed under MIT. See LICENSE for more details.
+ */
+
+#include <plcore/pl_hashtable.h>
+
+#include "filesystem_private.h"
+#include "pl_private.h"
+#include "thread_private.h"
+
+/*	Memory Files	*/
+
+/* Data that's already in memory can be wrapped in a file, which is
+ * then reachable as "mem://<path>" for as long as it's open. Anything
+ * that takes a path, such as the package loaders, can then be pointed
+ * at it, and each open is handed a view of the same memory, so nothing
+ * is copied. */
+
+static struct {
+	PLMutex *mutex;
+	PLHashTable *files; /* path, without the hint, to file */
+} fs_memory;
+
+static const char *StripMemoryHint( const char *path ) {
+	if ( strncmp( FS_MEMORY_HINT, path, FS_MEMORY_HINT_LENGTH ) == 0 ) {
+		return path + FS_MEMORY_HINT_LENGTH;
+	}
+
+	return path;
+}
+
+/**
+ * Creates a file over the given buffer, which can then be opened as
+ * "mem://<path>", see PlGetFilePath, until it's closed. Anything opened
+ * from it before then remains valid afterwards. On failure, the buffer
+ * is left with the caller.
+ */
+PLFile *PlCreateFileFromMemory( const char *path, void *buffer, size_t size, PLFileMemoryOwnership ownership ) {
+	if ( plIsEmptyString( path ) ) {
+		PlReportBasicError( PL_RESULT_FILEPATH );
+		return NULL;
+	}
+
+	if ( buffer == NULL && size > 0 ) {
+		PlReportBasicError( PL_RESULT_INVALID_PARM2 );
+		return NULL;
+	}
+
+	path = StripMemoryHint( path );
+	size_t length = strlen( path );
+	if ( length + FS_MEMORY_HINT_LENGTH >= PL_SYSTEM_MAX_PATH ) {
+		PlReportBasicError( PL_RESULT_FILEPATH );
+		return NULL;
+	}
+
+	if ( fs_memory.mutex == NULL ) {
+		fs_memory.mutex = PlCreateMutex();
+		fs_memory.files = PlCreateHashTable();
+		if ( fs_memory.mutex == NULL || fs_memory.files == NULL ) {
+			PlClearMemoryFiles();
+			return NULL;
+		}
+	}
+
+	uint8_t *data = buffer;
+	if ( ownership == PL_FILE_MEMORY_COPY ) {
+		data = pl_malloc( ( size > 0 ) ? size : 1 );
+		if ( data == NULL ) {
+			return NULL;
+		}
+		memcpy( data, buffer, size );
+	}
+
+	char filePath[ PL_SYSTEM_MAX_PATH ];
+	snprintf( filePath, sizeof( filePath ), FS_MEMORY_HINT "%s", path );
+
+	PLFile *file = PlCreateBufferFile( filePath, data, size );
+	if ( ownership == PL_FILE_MEMORY_BORROW ) {
+		file->mapping->isAllocated = false;
+		file->mapping->isBorrowed = true;
+	}
+
+	PlLockMutex( fs_memory.mutex );
+	file->isRegistered = PlInsertHashTableNode( fs_memory.files, path, length, file );
+	PlUnlockMutex( fs_memory.mutex );
+
+	if ( !file->isRegistered ) {
+		/* don't free what wasn't ours */
+		if ( ownership != PL_FILE_MEMORY_COPY ) {
+			file->mapping->isAllocated = false;
+			file->mapping->isBorrowed = true;
+		}
+		PlCloseFile( file );
+
+		PlReportErrorF( PL_RESULT_INVALID_PARM1, "memory file already exists, \"%s\"", path );
+		return NULL;
+	}
+
+	return file;
+}
+
+/**
+ * Opens a view of the memory file at the given path,
+ * which is expected to have had the hint stripped.
+ */
+PLFile *PlOpenMemoryFile( const char *path ) {
+	PLFile *view = NULL;
+	if ( fs_memory.mutex != NULL ) {
+		PlLockMutex( fs_memory.mutex );
+		PLFile *file = PlLookupHashTableUserData( fs_memory.files, path, strlen( path ) );
+		if ( file != NULL ) {
+			view = PlCreateFileView( file, file->path, 0, file->size );
+		}
+		PlUnlockMutex( fs_memory.mutex );
+	}
+
+	if ( view == NULL ) {
+		PlReportErrorF( PL_RESULT_FILEREAD, "failed to find memory file, \"%s\"", path );
+	}
+
+	return view;
+}
+
+bool PlStatMemoryFile( const char *path, PLFileInfo *info ) {
+	if ( fs_memory.mutex == NULL ) {
+		return false;
+	}
+
+	PlLockMutex( fs_memory.mutex );
+	PLFile *file = PlLookupHashTableUserData( fs_memory.files, path, strlen( path ) );
+	if ( file != NULL ) {
+		info->size = file->size;
+		info->timeStamp = file->timeStamp;
+	}
+	PlUnlockMutex( fs_memory.mutex );
+
+	return ( file != NULL );
+}
+
+/**
+ * Called as a memory file is closed, so it can't be opened again.
+ */
+void PlUnregisterMemoryFile( PLFile *ptr ) {
+	const char *path = StripMemoryHint( ptr->path );
+
+	PlLockMutex( fs_memory.mutex );
+	PlRemoveHashTableNode( fs_memory.files, path, strlen( path ) );
+	PlUnlockMutex( fs_memory.mutex );
+
+	ptr->isRegistered = false;
+}
+
+static void ForgetMemoryFile( void *value, void *userData ) {
+	PlUnused( userData );
+
+	( ( PLFile * ) value )->isRegistered = false;
+}
+
+/**
+ * Makes any memory files that are still open unreachable by path;
+ * they remain valid until they're closed.
+ */
+void PlClearMemoryFiles( void ) {
+	if ( fs_memory.files != NULL ) {
+		PlIterateHashTable( fs_memory.files, ForgetMemoryFile, NULL );
+	}
+
+	PlDestroyHashTable( fs_memory.files );
+	PlDestroyMutex( fs_memory.mutex );
+	fs_memory.files = NULL;
+	fs_memory.mutex = NULL;
+}
@@ -0,0 +1,158 @@
+/**
+ * Hei Platform Library
+ * Copyright (C) 2017-2021 Mark E Sowden <hogsy@oldtimes-software.com>
+ * This software is licensed under MIT. See LICENSE for more details.
+ */
+
+#include <plcore/pl_hashtable.h>
+
+#include "filesystem_private.h"
+#include "thread_private.h"
+
+/*	Miss Cache	*/
+
+/* Paths that couldn't be found in any mounted location are
+ * remembered, so probing for optional files over and over
+ * doesn't mean walking the mounts each time. The oldest miss
+ * is dropped once the cache is full, and everything is
+ * dropped whenever the set of files could have changed. */
+
+static struct {
+	PLMutex *mutex;
+	PLHashTable *paths;
+	char **ring; /* oldest first, starting from head */
+	unsigned int head;
+	unsigned int numEntries;
+	unsigned int maxEntries;
+
+	unsigned int hits, misses, evictions, flushes;
+} miss_cache;
+
+static void ClearMissCache( void ) {
+	for ( unsigned int i = 0; i < miss_cache.numEntries; ++i ) {
+		pl_free( miss_cache.ring[ ( miss_cache.head + i ) % miss_cache.maxEntries ] );
+	}
+
+	PlClearHashTable( miss_cache.paths );
+	miss_cache.head = 0;
+	miss_cache.numEntries = 0;
+}
+
+/**
+ * Sets how many paths can be held on to. Setting it
+ * to 0 disables the cache.
+ */
+void PlSetMissCacheSize( unsigned int size ) {
+	if ( miss_cache.mutex == NULL ) {
+		if ( size == 0 ) {
+			return;
+		}
+
+		miss_cache.mutex = PlCreateMutex();
+		miss_cache.paths = PlCreateHashTable();
+		if ( miss_cache.mutex == NULL || miss_cache.paths == NULL ) {
+			PlDestroyMutex( miss_cache.mutex );
+			PlDestroyHashTable( miss_cache.paths );
+			miss_cache.mutex = NULL;
+			miss_cache.paths = NULL;
+			return;
+		}
+	}
+
+	PlLockMutex( miss_cache.mutex );
+	ClearMissCache();
+	pl_free( miss_cache.ring );
+	miss_cache.ring = ( size > 0 ) ? pl_malloc( sizeof( char * ) * size ) : NULL;
+	miss_cache.maxEntries = size;
+	PlUnlockMutex( miss_cache.mutex );
+}
+
+/**
+ * Returns true if the given normalized path is known not
+ * to exist in any mounted location.
+ */
+bool PlIsCachedMiss( const char *path ) {
+	if ( miss_cache.mutex == NULL ) {
+		return false;
+	}
+
+	PlLockMutex( miss_cache.mutex );
+	bool isCached = ( miss_cache.numEntries > 0 && PlLookupHashTableUserData( miss_cache.paths, path, strlen( path ) ) != NULL );
+	if ( isCached ) {
+		miss_cache.hits++;
+	} else {
+		miss_cache.misses++;
+	}
+	PlUnlockMutex( miss_cache.mutex );
+
+	return isCached;
+}
+
+void PlCacheMiss( const char *path ) {
+	if ( miss_cache.mutex == NULL ) {
+		return;
+	}
+
+	PlLockMutex( miss_cache.mutex );
+	if ( miss_cache.maxEntries == 0 ) {
+		PlUnlockMutex( miss_cache.mutex );
+		return;
+	}
+
+	size_t length = strlen( path );
+	char *key = pl_malloc( length + 1 );
+	memcpy( key, path, length + 1 );
+
+	/* another thread may have beaten us to it */
+	if ( !PlInsertHashTableNode( miss_cache.paths, key, length, key ) ) {
+		PlUnlockMutex( miss_cache.mutex );
+		pl_free( key );
+		return;
+	}
+
+	if ( miss_cache.numEntries == miss_cache.maxEntries ) {
+		char *oldest = miss_cache.ring[ miss_cache.head ];
+		PlRemoveHashTableNode( miss_cache.paths, oldest, strlen( oldest ) );
+		pl_free( oldest );
+
+		miss_cache.ring[ miss_cache.head ] = key;
+		miss_cache.head = ( miss_cache.head + 1 ) % miss_cache.maxEntries;
+		miss_cache.evictions++;
+	} else {
+		miss_cache.ring[ ( miss_cache.head + miss_cache.numEntries ) % miss_cache.maxEntries ] = key;
+		miss_cache.numEntries++;
+	}
+	PlUnlockMutex( miss_cache.mutex );
+}
+
+/**
+ * Forgets every miss, for when files may have been added.
+ */
+void PlFlushMissCache( void ) {
+	if ( miss_cache.mutex == NULL ) {
+		return;
+	}
+
+	PlLockMutex( miss_cache.mutex );
+	if ( miss_cache.numEntries > 0 ) {
+		ClearMissCache();
+		miss_cache.flushes++;
+	}
+	PlUnlockMutex( miss_cache.mutex );
+}
+
+void PlGetMissCacheStats( PLMissCacheStats *stats ) {
+	memset( stats, 0, sizeof( PLMissCacheStats ) );
+	if ( miss_cache.mutex == NULL ) {
+		return;
+	}
+
+	PlLockMutex( miss_cache.mutex );
+	stats->numEntries = miss_cache.numEntries;
+	stats->maxEntries = miss_cache.maxEntries;
+	stats->hits = miss_cache.hits;
+	stats->misses = miss_cache.misses;
+	stats->evictions = miss_cache.evictions;
+	stats->flushes = miss_cache.flushes;
+	PlUnlockMutex( miss_cache.mutex );
+}
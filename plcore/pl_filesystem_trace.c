@@ -0,0 +1,209 @@
+/**
+ * Hei Platform Library
+ * Copyright (C) 2017-2021 Mark E Sowden <hogsy@oldtimes-software.com>
+ * This software is licensed under MIT. See LICENSE for more details.
+ */
+
+#include <plcore/pl_console.h>
+#include <plcore/pl_hashtable.h>
+
+#include "filesystem_private.h"
+#include "pl_private.h"
+#include "thread_private.h"
+
+/*	Access Tracing	*/
+
+/* Applications tend to open the same files in much the same order
+ * every time they start up. Opens can be recorded to a trace, which
+ * a later run can then replay on a worker, so the files are already
+ * on their way in by the time they're asked for.
+ *
+ * Traces are plain text, with one open per line, in the form of
+ *   <milliseconds>	<location>	<offset>	<size>	<path>
+ * where location is the mount the file was provided by. */
+
+#define FS_TRACE_HEADER "# access trace 1\n"
+
+static struct {
+	PLMutex *mutex;
+	FILE *file;
+	double startTime;
+} fs_trace;
+
+static struct {
+	PLJobGroup *group;
+	char **paths;
+	unsigned int numPaths;
+	volatile bool isCancelled;
+} fs_replay;
+
+/**
+ * Starts recording every file opened via the VFS to the given
+ * local file, until PlStopAccessTrace is called.
+ */
+bool PlStartAccessTrace( const char *path ) {
+	if ( fs_trace.mutex == NULL ) {
+		fs_trace.mutex = PlCreateMutex();
+		if ( fs_trace.mutex == NULL ) {
+			return false;
+		}
+	}
+
+	PlStopAccessTrace();
+
+	FILE *file = fopen( path, "w" );
+	if ( file == NULL ) {
+		PlReportErrorF( PL_RESULT_FILEWRITE, "failed to open %s for write", path );
+		return false;
+	}
+
+	fputs( FS_TRACE_HEADER, file );
+
+	PlLockMutex( fs_trace.mutex );
+	fs_trace.file = file;
+	fs_trace.startTime = PlGetCurrentSeconds();
+	PlUnlockMutex( fs_trace.mutex );
+
+	return true;
+}
+
+void PlStopAccessTrace( void ) {
+	if ( fs_trace.mutex == NULL ) {
+		return;
+	}
+
+	PlLockMutex( fs_trace.mutex );
+	if ( fs_trace.file != NULL ) {
+		fclose( fs_trace.file );
+		fs_trace.file = NULL;
+	}
+	PlUnlockMutex( fs_trace.mutex );
+}
+
+/**
+ * Records an open to the trace, if one is being recorded.
+ * Offset and size are where the data sits within the location.
+ */
+void PlTraceFileAccess( const char *path, const char *location, size_t offset, size_t size ) {
+	/* checked again once we have the lock */
+	if ( fs_trace.file == NULL ) {
+		return;
+	}
+
+	PlLockMutex( fs_trace.mutex );
+	if ( fs_trace.file != NULL ) {
+		fprintf( fs_trace.file, "%.3f\t%s\t%zu\t%zu\t%s\n",
+		         ( PlGetCurrentSeconds() - fs_trace.startTime ) * 1000.0, location, offset, size, path );
+	}
+	PlUnlockMutex( fs_trace.mutex );
+}
+
+static void ClearReplay( void ) {
+	for ( unsigned int i = 0; i < fs_replay.numPaths; ++i ) {
+		pl_free( fs_replay.paths[ i ] );
+	}
+	pl_free( fs_replay.paths );
+	fs_replay.paths = NULL;
+	fs_replay.numPaths = 0;
+
+	PlDestroyJobGroup( fs_replay.group );
+	fs_replay.group = NULL;
+}
+
+static void ReplayJob( void *userData ) {
+	PlUnused( userData );
+
+	for ( unsigned int i = 0; i < fs_replay.numPaths && !fs_replay.isCancelled; ++i ) {
+		PlPrefetchMountedFile( fs_replay.paths[ i ] );
+	}
+}
+
+/**
+ * Reads in the given trace, and starts prefetching everything it
+ * opened, in the same order, on a worker. Mounts need to be in place
+ * beforehand, and shouldn't be changed until the replay is done; see
+ * PlWaitAccessTraceReplay.
+ */
+bool PlReplayAccessTrace( const char *path ) {
+	PlWaitAccessTraceReplay();
+
+	PLFile *file = PlOpenLocalFile( path, true );
+	if ( file == NULL ) {
+		return false;
+	}
+
+	/* files are only worth fetching the first time round */
+	PLHashTable *seen = PlCreateHashTable();
+	unsigned int maxPaths = 0;
+
+	char line[ PL_SYSTEM_MAX_PATH * 2 ];
+	while ( PlReadString( file, line, sizeof( line ) ) != NULL ) {
+		if ( line[ 0 ] == '#' ) {
+			continue;
+		}
+
+		const char *fileName = strrchr( line, '\t' );
+		if ( fileName == NULL ) {
+			continue;
+		}
+		fileName++;
+
+		size_t length = strcspn( fileName, "\r\n" );
+		if ( length == 0 || length >= PL_SYSTEM_MAX_PATH ) {
+			continue;
+		}
+
+		char *copy = pl_malloc( length + 1 );
+		memcpy( copy, fileName, length );
+		copy[ length ] = '\0';
+		if ( seen == NULL || !PlInsertHashTableNode( seen, copy, length, copy ) ) {
+			pl_free( copy );
+			continue;
+		}
+
+		if ( fs_replay.numPaths >= maxPaths ) {
+			maxPaths = ( maxPaths > 0 ) ? maxPaths * 2 : 64;
+			fs_replay.paths = pl_realloc( fs_replay.paths, sizeof( char * ) * maxPaths );
+		}
+		fs_replay.paths[ fs_replay.numPaths++ ] = copy;
+	}
+
+	PlDestroyHashTable( seen );
+	PlCloseFile( file );
+
+	if ( fs_replay.numPaths == 0 ) {
+		ClearReplay();
+		return true;
+	}
+
+	fs_replay.isCancelled = false;
+	fs_replay.group = PlCreateJobGroup();
+	if ( fs_replay.group == NULL || !PlQueueJob( fs_replay.group, ReplayJob, NULL ) ) {
+		ClearReplay();
+		return false;
+	}
+
+	FSLog( "Replaying %u files from %s\n", fs_replay.numPaths, path );
+
+	return true;
+}
+
+/**
+ * Blocks until the current replay, if any, has finished.
+ */
+void PlWaitAccessTraceReplay( void ) {
+	if ( fs_replay.group == NULL ) {
+		return;
+	}
+
+	PlWaitJobGroup( fs_replay.group );
+	ClearReplay();
+}
+
+/**
+ * Stops the current replay as soon as possible.
+ */
+void PlCancelAccessTraceReplay( void ) {
+	fs_replay.isCancelled = true;
+	PlWaitAccessTraceReplay();
+}
@@ -0,0 +1,516 @@
+/**
+ * Hei Platform Library
+ * Copyright (C) 2017-2021 Mark E Sowden <hogsy@oldtimes-software.com>
+ * This software is licensed under MIT. See LICENSE for more details.
+ */
+
+#if defined( __linux__ )
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#endif
+
+#include <plcore/pl_console.h>
+#include <plcore/pl_hashtable.h>
+
+#include "filesystem_private.h"
+#include "pl_private.h"
+
+/*	File Watching	*/
+
+/* Changes are picked up via inotify, which isn't recursive, so every
+ * directory beneath a watched path gets a watch of its own. Events are
+ * only read when the application polls, which means callbacks are
+ * always run on its thread, at a time of its choosing. */
+
+typedef struct PLFileWatch {
+	char path[ PL_SYSTEM_MAX_PATH ];     /* as it was given to us */
+	char realPath[ PL_SYSTEM_MAX_PATH ]; /* what events are matched against */
+	bool isDirectory;
+
+	PLWatchCallback Callback;
+	void *userData;
+
+	int *descriptors;
+	unsigned int numDescriptors, maxDescriptors;
+
+	bool isRemoved; /* freed once polling is done with it */
+	struct PLFileWatch *next;
+} PLFileWatch;
+
+#if defined( __linux__ )
+
+#define FS_WATCH_MASK ( IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ONLYDIR )
+
+/* descriptors are shared between watches covering the same directory */
+typedef struct FSWatchDescriptor {
+	int wd;
+	char path[ PL_SYSTEM_MAX_PATH ];
+	unsigned int refCount;
+} FSWatchDescriptor;
+
+static struct {
+	int fd;
+	PLHashTable *descriptors; /* wd to FSWatchDescriptor */
+	PLFileWatch *watches;
+	bool isPolling;
+
+	/* directory that's been moved, until we know where to */
+	uint32_t moveCookie;
+	char movedPath[ PL_SYSTEM_MAX_PATH ];
+} fs_watcher = { .fd = -1 };
+
+static bool StartWatcher( void ) {
+	if ( fs_watcher.fd != -1 ) {
+		return true;
+	}
+
+	fs_watcher.fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if ( fs_watcher.fd == -1 ) {
+		PlReportErrorF( PL_RESULT_SYSERR, "failed to initialize inotify: %s", strerror( errno ) );
+		return false;
+	}
+
+	fs_watcher.descriptors = PlCreateHashTable();
+	return true;
+}
+
+/**
+ * Returns true if the path is the given directory, or beneath it.
+ */
+static bool IsWithinPath( const char *path, const char *directory ) {
+	size_t length = strlen( directory );
+	return ( strncmp( path, directory, length ) == 0 && ( path[ length ] == '\0' || path[ length ] == '/' ) );
+}
+
+typedef struct FSWatchRename {
+	const char *oldPath;
+	const char *newPath;
+} FSWatchRename;
+
+static void RenameWatchDescriptor( void *value, void *userData ) {
+	FSWatchDescriptor *descriptor = value;
+	const FSWatchRename *rename = userData;
+	if ( !IsWithinPath( descriptor->path, rename->oldPath ) ) {
+		return;
+	}
+
+	char path[ PL_SYSTEM_MAX_PATH ];
+	int length = snprintf( path, sizeof( path ), "%s%s", rename->newPath, &descriptor->path[ strlen( rename->oldPath ) ] );
+	if ( length < 0 || ( size_t ) length >= sizeof( path ) ) {
+		return;
+	}
+	memcpy( descriptor->path, path, ( size_t ) length + 1 );
+}
+
+/**
+ * Directories keep their watch when they're moved, so anything
+ * that was beneath the old path needs to be given the new one.
+ */
+static void RenameWatchDescriptors( const char *oldPath, const char *newPath ) {
+	/* the old path may belong to one of the descriptors being renamed */
+	char path[ PL_SYSTEM_MAX_PATH ];
+	snprintf( path, sizeof( path ), "%s", oldPath );
+
+	FSWatchRename rename = { .oldPath = path, .newPath = newPath };
+	PlIterateHashTable( fs_watcher.descriptors, RenameWatchDescriptor, &rename );
+}
+
+static bool AddWatchDescriptor( PLFileWatch *watch, const char *path ) {
+	int wd = inotify_add_watch( fs_watcher.fd, path, FS_WATCH_MASK );
+	if ( wd == -1 ) {
+		PlReportErrorF( PL_RESULT_FILEERR, "failed to watch %s: %s", path, strerror( errno ) );
+		return false;
+	}
+
+	/* we're handed back the same descriptor if it's been moved */
+	FSWatchDescriptor *descriptor = PlLookupHashTableUserData( fs_watcher.descriptors, &wd, sizeof( int ) );
+	if ( descriptor != NULL && strcmp( descriptor->path, path ) != 0 ) {
+		RenameWatchDescriptors( descriptor->path, path );
+	}
+
+	for ( unsigned int i = 0; i < watch->numDescriptors; ++i ) {
+		if ( watch->descriptors[ i ] == wd ) {
+			return true;
+		}
+	}
+
+	if ( watch->numDescriptors >= watch->maxDescriptors ) {
+		unsigned int maxDescriptors = ( watch->maxDescriptors == 0 ) ? 16 : watch->maxDescriptors * 2;
+		int *descriptors = pl_realloc( watch->descriptors, sizeof( int ) * maxDescriptors );
+		if ( descriptors == NULL ) {
+			return false;
+		}
+		watch->descriptors = descriptors;
+		watch->maxDescriptors = maxDescriptors;
+	}
+
+	if ( descriptor == NULL ) {
+		descriptor = pl_calloc( 1, sizeof( FSWatchDescriptor ) );
+		descriptor->wd = wd;
+		snprintf( descriptor->path, sizeof( descriptor->path ), "%s", path );
+		PlInsertHashTableNode( fs_watcher.descriptors, &descriptor->wd, sizeof( int ), descriptor );
+	}
+	descriptor->refCount++;
+
+	watch->descriptors[ watch->numDescriptors++ ] = wd;
+	return true;
+}
+
+static void ReleaseWatchDescriptor( int wd ) {
+	FSWatchDescriptor *descriptor = PlLookupHashTableUserData( fs_watcher.descriptors, &wd, sizeof( int ) );
+	if ( descriptor == NULL || --descriptor->refCount > 0 ) {
+		return;
+	}
+
+	inotify_rm_watch( fs_watcher.fd, wd );
+	PlRemoveHashTableNode( fs_watcher.descriptors, &wd, sizeof( int ) );
+	pl_free( descriptor );
+}
+
+/**
+ * Forgets the given descriptor once the kernel has dropped it, so
+ * that nothing releases it after the number has been handed out
+ * again for something else.
+ */
+static void DetachWatchDescriptor( int wd ) {
+	for ( PLFileWatch *watch = fs_watcher.watches; watch != NULL; watch = watch->next ) {
+		for ( unsigned int i = 0; i < watch->numDescriptors; ++i ) {
+			if ( watch->descriptors[ i ] == wd ) {
+				watch->descriptors[ i ] = watch->descriptors[ --watch->numDescriptors ];
+				break;
+			}
+		}
+	}
+
+	FSWatchDescriptor *descriptor = PlLookupHashTableUserData( fs_watcher.descriptors, &wd, sizeof( int ) );
+	if ( descriptor != NULL ) {
+		PlRemoveHashTableNode( fs_watcher.descriptors, &wd, sizeof( int ) );
+		pl_free( descriptor );
+	}
+}
+
+/**
+ * Stops watching anything at or beneath the given path, for
+ * when it's been moved somewhere we're not watching.
+ */
+static void ReleaseWatchDescriptors( const char *path ) {
+	for ( PLFileWatch *watch = fs_watcher.watches; watch != NULL; watch = watch->next ) {
+		for ( unsigned int i = 0; i < watch->numDescriptors; ) {
+			int wd = watch->descriptors[ i ];
+			const FSWatchDescriptor *descriptor = PlLookupHashTableUserData( fs_watcher.descriptors, &wd, sizeof( int ) );
+			if ( descriptor == NULL || !IsWithinPath( descriptor->path, path ) ) {
+				++i;
+				continue;
+			}
+
+			watch->descriptors[ i ] = watch->descriptors[ --watch->numDescriptors ];
+			ReleaseWatchDescriptor( wd );
+		}
+	}
+}
+
+/**
+ * Deals with a directory that was moved without us seeing where it
+ * went, which means it's no longer somewhere that's being watched.
+ */
+static void FlushMovedDirectory( void ) {
+	if ( fs_watcher.moveCookie == 0 ) {
+		return;
+	}
+
+	ReleaseWatchDescriptors( fs_watcher.movedPath );
+	fs_watcher.moveCookie = 0;
+}
+
+/**
+ * Watches the given directory, along with everything beneath it.
+ */
+static void AddWatchDirectory( PLFileWatch *watch, const char *path ) {
+	if ( !AddWatchDescriptor( watch, path ) ) {
+		return;
+	}
+
+	DIR *dir = opendir( path );
+	if ( dir == NULL ) {
+		return;
+	}
+
+	struct dirent *entry;
+	while ( ( entry = readdir( dir ) ) != NULL ) {
+		if ( strcmp( entry->d_name, "." ) == 0 || strcmp( entry->d_name, ".." ) == 0 ) {
+			continue;
+		}
+
+		char childPath[ PL_SYSTEM_MAX_PATH ];
+		int length = snprintf( childPath, sizeof( childPath ), "%s/%s", path, entry->d_name );
+		if ( length < 0 || ( size_t ) length >= sizeof( childPath ) ) {
+			continue;
+		}
+
+		/* links aren't followed, to save us from going round in circles */
+		bool isDirectory = ( entry->d_type == DT_DIR );
+		if ( entry->d_type == DT_UNKNOWN ) {
+			struct stat attributes;
+			isDirectory = ( lstat( childPath, &attributes ) == 0 && S_ISDIR( attributes.st_mode ) );
+		}
+
+		if ( isDirectory ) {
+			AddWatchDirectory( watch, childPath );
+		}
+	}
+
+	closedir( dir );
+}
+
+/**
+ * Returns what's left of the path after the watched path,
+ * or NULL if it's not something the watch cares about.
+ */
+static const char *MatchWatchPath( const PLFileWatch *watch, const char *path ) {
+	size_t length = strlen( watch->realPath );
+	if ( strncmp( path, watch->realPath, length ) != 0 ) {
+		return NULL;
+	}
+
+	if ( path[ length ] == '\0' ) {
+		return watch->isDirectory ? NULL : &path[ length ];
+	}
+
+	return ( watch->isDirectory && path[ length ] == '/' ) ? &path[ length ] : NULL;
+}
+
+static unsigned int DispatchWatchEvent( const struct inotify_event *event ) {
+	if ( event->mask & IN_IGNORED ) {
+		/* the directory's gone, or we asked for it to be removed */
+		DetachWatchDescriptor( event->wd );
+		return 0;
+	}
+
+	if ( event->mask & IN_Q_OVERFLOW ) {
+		PrintWarning( "Too many file changes to keep up with, some have been missed!\n" );
+		return 0;
+	}
+
+	FSWatchDescriptor *descriptor = PlLookupHashTableUserData( fs_watcher.descriptors, &event->wd, sizeof( int ) );
+	if ( descriptor == NULL || event->len == 0 ) {
+		return 0;
+	}
+
+	PLWatchEvent type;
+	if ( event->mask & ( IN_CREATE | IN_MOVED_TO ) ) {
+		type = PL_WATCH_CREATED;
+	} else if ( event->mask & ( IN_DELETE | IN_MOVED_FROM ) ) {
+		type = PL_WATCH_DELETED;
+	} else {
+		type = PL_WATCH_MODIFIED;
+	}
+
+	/* too long to be handed on, so it's dropped */
+	char path[ PL_SYSTEM_MAX_PATH ];
+	int length = snprintf( path, sizeof( path ), "%s/%s", descriptor->path, event->name );
+	if ( length < 0 || ( size_t ) length >= sizeof( path ) ) {
+		return 0;
+	}
+
+	bool isDirectory = ( event->mask & IN_ISDIR );
+
+	/* moves come as a pair, sharing a cookie, if both ends are watched */
+	if ( isDirectory && ( event->mask & IN_MOVED_FROM ) ) {
+		FlushMovedDirectory();
+		fs_watcher.moveCookie = event->cookie;
+		memcpy( fs_watcher.movedPath, path, ( size_t ) length + 1 );
+	} else if ( isDirectory && ( event->mask & IN_MOVED_TO ) && event->cookie == fs_watcher.moveCookie ) {
+		RenameWatchDescriptors( fs_watcher.movedPath, path );
+		fs_watcher.moveCookie = 0;
+	}
+
+	unsigned int numCallbacks = 0;
+	for ( PLFileWatch *watch = fs_watcher.watches; watch != NULL; watch = watch->next ) {
+		if ( watch->isRemoved ) {
+			continue;
+		}
+
+		const char *relativePath = MatchWatchPath( watch, path );
+		if ( relativePath == NULL ) {
+			continue;
+		}
+
+		/* new directories aren't covered by their parent's watch */
+		if ( isDirectory && type == PL_WATCH_CREATED ) {
+			AddWatchDirectory( watch, path );
+		}
+
+		char watchPath[ PL_SYSTEM_MAX_PATH ];
+		snprintf( watchPath, sizeof( watchPath ), "%s%s", watch->path, relativePath );
+		watch->Callback( watchPath, type, isDirectory, watch->userData );
+		numCallbacks++;
+	}
+
+	return numCallbacks;
+}
+
+static void FreeWatch( PLFileWatch *watch ) {
+	pl_free( watch->descriptors );
+	pl_free( watch );
+}
+
+#endif
+
+/**
+ * Watches the given local file or directory for changes, including
+ * anything that's beneath it. Changes are queued up until they're
+ * delivered via PlPollWatchedPaths.
+ * @param Callback Called with the path of whatever's changed, which
+ * starts with the path that was given here.
+ * @return NULL if the path couldn't be watched.
+ */
+PLFileWatch *PlWatchPath( const char *path, PLWatchCallback Callback, void *userData ) {
+#if defined( __linux__ )
+	if ( plIsEmptyString( path ) || Callback == NULL ) {
+		PlReportBasicError( PL_RESULT_INVALID_PARM1 );
+		return NULL;
+	}
+
+	if ( !StartWatcher() ) {
+		return NULL;
+	}
+
+	PLFileWatch *watch = pl_calloc( 1, sizeof( PLFileWatch ) );
+	snprintf( watch->path, sizeof( watch->path ), "%s", path );
+	size_t length = strlen( watch->path );
+	while ( length > 1 && watch->path[ length - 1 ] == '/' ) {
+		watch->path[ --length ] = '\0';
+	}
+
+	char realPath[ PATH_MAX ];
+	struct stat attributes;
+	if ( realpath( watch->path, realPath ) == NULL || stat( realPath, &attributes ) != 0 ) {
+		PlReportErrorF( PL_RESULT_FILEPATH, "failed to resolve %s: %s", path, strerror( errno ) );
+		FreeWatch( watch );
+		return NULL;
+	}
+
+	size_t realLength = strlen( realPath ) + 1;
+	if ( realLength > sizeof( watch->realPath ) ) {
+		PlReportErrorF( PL_RESULT_FILEPATH, "path is too long, %s", realPath );
+		FreeWatch( watch );
+		return NULL;
+	}
+	memcpy( watch->realPath, realPath, realLength );
+	watch->isDirectory = S_ISDIR( attributes.st_mode );
+	watch->Callback = Callback;
+	watch->userData = userData;
+
+	/* files are watched via their directory, so we don't lose
+	 * track of them when they're replaced rather than written */
+	if ( watch->isDirectory ) {
+		AddWatchDirectory( watch, watch->realPath );
+	} else {
+		char *c = strrchr( realPath, '/' );
+		if ( c != NULL ) {
+			*( c == realPath ? c + 1 : c ) = '\0';
+			AddWatchDescriptor( watch, realPath );
+		}
+	}
+
+	if ( watch->numDescriptors == 0 ) {
+		FreeWatch( watch );
+		return NULL;
+	}
+
+	watch->next = fs_watcher.watches;
+	fs_watcher.watches = watch;
+
+	return watch;
+#else
+	PlUnused( path );
+	PlUnused( Callback );
+	PlUnused( userData );
+
+	PlReportErrorF( PL_RESULT_UNSUPPORTED, "watching paths isn't supported on this platform" );
+	return NULL;
+#endif
+}
+
+void PlUnwatchPath( PLFileWatch *watch ) {
+	if ( watch == NULL ) {
+		return;
+	}
+
+#if defined( __linux__ )
+	for ( unsigned int i = 0; i < watch->numDescriptors; ++i ) {
+		ReleaseWatchDescriptor( watch->descriptors[ i ] );
+	}
+	watch->numDescriptors = 0;
+
+	/* callbacks can unwatch things while we're still going */
+	watch->isRemoved = true;
+	if ( fs_watcher.isPolling ) {
+		return;
+	}
+
+	PLFileWatch **link = &fs_watcher.watches;
+	while ( *link != NULL ) {
+		if ( *link == watch ) {
+			*link = watch->next;
+			break;
+		}
+		link = &( *link )->next;
+	}
+
+	FreeWatch( watch );
+#endif
+}
+
+/**
+ * Delivers any changes to watched paths since the last time
+ * this was called, which is expected to be once per frame.
+ * @return Number of callbacks that were run.
+ */
+unsigned int PlPollWatchedPaths( void ) {
+#if defined( __linux__ )
+	if ( fs_watcher.fd == -1 || fs_watcher.isPolling ) {
+		return 0;
+	}
+
+	fs_watcher.isPolling = true;
+
+	union {
+		struct inotify_event event; /* for the alignment */
+		char buf[ 4096 ];
+	} events;
+
+	unsigned int numCallbacks = 0;
+	ssize_t length;
+	while ( ( length = read( fs_watcher.fd, events.buf, sizeof( events.buf ) ) ) > 0 ) {
+		for ( const char *p = events.buf; p < events.buf + length; ) {
+			const struct inotify_event *event = ( const struct inotify_event * ) p;
+			numCallbacks += DispatchWatchEvent( event );
+			p += sizeof( struct inotify_event ) + event->len;
+		}
+	}
+
+	FlushMovedDirectory();
+
+	fs_watcher.isPolling = false;
+
+	PLFileWatch **link = &fs_watcher.watches;
+	while ( *link != NULL ) {
+		PLFileWatch *watch = *link;
+		if ( watch->isRemoved ) {
+			*link = watch->next;
+			FreeWatch( watch );
+			continue;
+		}
+		link = &watch->next;
+	}
+
+	return numCallbacks;
+#else
+	return 0;
+#endif
+}
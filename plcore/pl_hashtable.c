@@ -0,0 +1,207 @@
+/**
+ * Hei Platform Library
+ * Copyright (C) 2017-2021 Mark E Sowden <hogsy@oldtimes-software.com>
+ * This software is licensed under MIT. See LICENSE for more details.
+ */
+
+#include <plcore/pl_hashtable.h>
+
+/* Simple chained hash table. Keys are copied into
+ * the table, while values are left up to the caller
+ * to manage, much like the linked list. */
+
+#define HASH_TABLE_MIN_BUCKETS 64
+
+typedef struct PLHashTableNode {
+	uint64_t hash;
+	size_t keySize;
+	void *value;
+	struct PLHashTableNode *next;
+	uint8_t key[];
+} PLHashTableNode;
+
+typedef struct PLHashTable {
+	PLHashTableNode **buckets;
+	unsigned int numBuckets; /* always a power of two */
+	unsigned int numNodes;
+} PLHashTable;
+
+/**
+ * 64-bit FNV-1a, which is cheap and good enough for file paths.
+ */
+uint64_t PlGenerateHash( const void *data, size_t size ) {
+	const uint8_t *p = data;
+	uint64_t hash = 14695981039346656037ULL;
+	for ( size_t i = 0; i < size; ++i ) {
+		hash ^= p[ i ];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+PLHashTable *PlCreateHashTable( void ) {
+	PLHashTable *hashTable = pl_calloc( 1, sizeof( PLHashTable ) );
+	if ( hashTable == NULL ) {
+		return NULL;
+	}
+
+	hashTable->numBuckets = HASH_TABLE_MIN_BUCKETS;
+	hashTable->buckets = pl_calloc( hashTable->numBuckets, sizeof( PLHashTableNode * ) );
+	if ( hashTable->buckets == NULL ) {
+		pl_free( hashTable );
+		return NULL;
+	}
+
+	return hashTable;
+}
+
+/**
+ * Removes all of the nodes from the table.
+ * Keep in mind this does not free any user data!
+ */
+void PlClearHashTable( PLHashTable *hashTable ) {
+	for ( unsigned int i = 0; i < hashTable->numBuckets; ++i ) {
+		PLHashTableNode *node = hashTable->buckets[ i ];
+		while ( node != NULL ) {
+			PLHashTableNode *next = node->next;
+			pl_free( node );
+			node = next;
+		}
+		hashTable->buckets[ i ] = NULL;
+	}
+
+	hashTable->numNodes = 0;
+}
+
+void PlDestroyHashTable( PLHashTable *hashTable ) {
+	if ( hashTable == NULL ) {
+		return;
+	}
+
+	PlClearHashTable( hashTable );
+	pl_free( hashTable->buckets );
+	pl_free( hashTable );
+}
+
+static PLHashTableNode **GetHashTableBucket( const PLHashTable *hashTable, uint64_t hash ) {
+	return &hashTable->buckets[ hash & ( hashTable->numBuckets - 1 ) ];
+}
+
+static PLHashTableNode *FindHashTableNode( const PLHashTable *hashTable, const void *key, size_t keySize, uint64_t hash ) {
+	PLHashTableNode *node = *GetHashTableBucket( hashTable, hash );
+	while ( node != NULL ) {
+		if ( node->hash == hash && node->keySize == keySize && memcmp( node->key, key, keySize ) == 0 ) {
+			return node;
+		}
+		node = node->next;
+	}
+
+	return NULL;
+}
+
+static void ResizeHashTable( PLHashTable *hashTable, unsigned int numBuckets ) {
+	PLHashTableNode **buckets = pl_calloc( numBuckets, sizeof( PLHashTableNode * ) );
+	if ( buckets == NULL ) {
+		/* not fatal, we'll just have longer chains */
+		return;
+	}
+
+	for ( unsigned int i = 0; i < hashTable->numBuckets; ++i ) {
+		PLHashTableNode *node = hashTable->buckets[ i ];
+		while ( node != NULL ) {
+			PLHashTableNode *next = node->next;
+			PLHashTableNode **bucket = &buckets[ node->hash & ( numBuckets - 1 ) ];
+			node->next = *bucket;
+			*bucket = node;
+			node = next;
+		}
+	}
+
+	pl_free( hashTable->buckets );
+	hashTable->buckets = buckets;
+	hashTable->numBuckets = numBuckets;
+}
+
+/**
+ * Inserts the given value under the key. If the key is
+ * already present the table is left untouched and false
+ * is returned.
+ */
+bool PlInsertHashTableNode( PLHashTable *hashTable, const void *key, size_t keySize, void *value ) {
+	uint64_t hash = PlGenerateHash( key, keySize );
+	if ( FindHashTableNode( hashTable, key, keySize, hash ) != NULL ) {
+		return false;
+	}
+
+	PLHashTableNode *node = pl_malloc( sizeof( PLHashTableNode ) + keySize );
+	if ( node == NULL ) {
+		return false;
+	}
+
+	node->hash = hash;
+	node->keySize = keySize;
+	node->value = value;
+	memcpy( node->key, key, keySize );
+
+	PLHashTableNode **bucket = GetHashTableBucket( hashTable, hash );
+	node->next = *bucket;
+	*bucket = node;
+
+	/* keep the load factor below 0.75 */
+	if ( ++hashTable->numNodes > ( hashTable->numBuckets / 4 ) * 3 ) {
+		ResizeHashTable( hashTable, hashTable->numBuckets * 2 );
+	}
+
+	return true;
+}
+
+/**
+ * Removes the node with the given key from the table.
+ * Keep in mind this does not free any user data!
+ */
+bool PlRemoveHashTableNode( PLHashTable *hashTable, const void *key, size_t keySize ) {
+	uint64_t hash = PlGenerateHash( key, keySize );
+	PLHashTableNode **link = GetHashTableBucket( hashTable, hash );
+	while ( *link != NULL ) {
+		PLHashTableNode *node = *link;
+		if ( node->hash == hash && node->keySize == keySize && memcmp( node->key, key, keySize ) == 0 ) {
+			*link = node->next;
+			pl_free( node );
+			hashTable->numNodes--;
+			return true;
+		}
+		link = &node->next;
+	}
+
+	return false;
+}
+
+/**
+ * Returns the value stored under the given key, or
+ * NULL if the key isn't in the table.
+ */
+void *PlLookupHashTableUserData( const PLHashTable *hashTable, const void *key, size_t keySize ) {
+	PLHashTableNode *node = FindHashTableNode( hashTable, key, keySize, PlGenerateHash( key, keySize ) );
+	if ( node == NULL ) {
+		return NULL;
+	}
+
+	return node->value;
+}
+
+/**
+ * Calls the given function for every value in the table.
+ * The table must not be modified while iterating.
+ */
+void PlIterateHashTable( PLHashTable *hashTable, void ( *Callback )( void *value, void *userData ), void *userData ) {
+	for ( unsigned int i = 0; i < hashTable->numBuckets; ++i ) {
+		for ( PLHashTableNode *node = hashTable->buckets[ i ]; node != NULL; node = node->next ) {
+			Callback( node->value, userData );
+		}
+	}
+}
+
+unsigned int PlGetNumHashTableNodes( const PLHashTable *hashTable ) {
+	return hashTable->numNodes;
+}
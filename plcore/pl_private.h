@@ -58,6 +58,15 @@ void PlShutdownConsole( void );
 
 void PlInitPackageSubSystem( void );
 
+/* * * * * * * * * * * * * * * * * * * */
+/* Byte Swapping                       */
+
+bool _plIsHostBigEndian( void );
+
+void _plSwapArray16( void *data, size_t count );
+void _plSwapArray32( void *data, size_t count );
+void _plSwapArray64( void *data, size_t count );
+
 /* * * * * * * * * * * * * * * * * * * */
 
 #ifdef _WIN32
@@ -0,0 +1,514 @@
+/**
+ * Hei Platform Library
+ * Copyright (C) 2017-2021 Mark E Sowden <hogsy@oldtimes-software.com>
+ * This software is licensed under MIT. See LICENSE for more details.
+ */
+
+#if defined( _WIN32 )
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "pl_private.h"
+#include "thread_private.h"
+
+/*	Threading	*/
+
+#define MAX_WORKERS 32
+
+typedef struct PLMutex {
+#if defined( _WIN32 )
+	SRWLOCK lock;
+#else
+	pthread_mutex_t mutex;
+#endif
+} PLMutex;
+
+typedef struct PLReadWriteLock {
+#if defined( _WIN32 )
+	SRWLOCK lock;
+#else
+	pthread_rwlock_t lock;
+#endif
+} PLReadWriteLock;
+
+typedef struct PLCondition {
+#if defined( _WIN32 )
+	CONDITION_VARIABLE condition;
+#else
+	pthread_cond_t condition;
+#endif
+} PLCondition;
+
+PLMutex *PlCreateMutex( void ) {
+	PLMutex *mutex = pl_malloc( sizeof( PLMutex ) );
+	if ( mutex == NULL ) {
+		return NULL;
+	}
+
+#if defined( _WIN32 )
+	InitializeSRWLock( &mutex->lock );
+#else
+	pthread_mutex_init( &mutex->mutex, NULL );
+#endif
+
+	return mutex;
+}
+
+void PlDestroyMutex( PLMutex *mutex ) {
+	if ( mutex == NULL ) {
+		return;
+	}
+
+#if !defined( _WIN32 )
+	pthread_mutex_destroy( &mutex->mutex );
+#endif
+	pl_free( mutex );
+}
+
+void PlLockMutex( PLMutex *mutex ) {
+#if defined( _WIN32 )
+	AcquireSRWLockExclusive( &mutex->lock );
+#else
+	pthread_mutex_lock( &mutex->mutex );
+#endif
+}
+
+void PlUnlockMutex( PLMutex *mutex ) {
+#if defined( _WIN32 )
+	ReleaseSRWLockExclusive( &mutex->lock );
+#else
+	pthread_mutex_unlock( &mutex->mutex );
+#endif
+}
+
+PLReadWriteLock *PlCreateReadWriteLock( void ) {
+	PLReadWriteLock *lock = pl_malloc( sizeof( PLReadWriteLock ) );
+	if ( lock == NULL ) {
+		return NULL;
+	}
+
+#if defined( _WIN32 )
+	InitializeSRWLock( &lock->lock );
+#else
+	pthread_rwlock_init( &lock->lock, NULL );
+#endif
+
+	return lock;
+}
+
+void PlDestroyReadWriteLock( PLReadWriteLock *lock ) {
+	if ( lock == NULL ) {
+		return;
+	}
+
+#if !defined( _WIN32 )
+	pthread_rwlock_destroy( &lock->lock );
+#endif
+	pl_free( lock );
+}
+
+void PlLockRead( PLReadWriteLock *lock ) {
+#if defined( _WIN32 )
+	AcquireSRWLockShared( &lock->lock );
+#else
+	pthread_rwlock_rdlock( &lock->lock );
+#endif
+}
+
+void PlUnlockRead( PLReadWriteLock *lock ) {
+#if defined( _WIN32 )
+	ReleaseSRWLockShared( &lock->lock );
+#else
+	pthread_rwlock_unlock( &lock->lock );
+#endif
+}
+
+void PlLockWrite( PLReadWriteLock *lock ) {
+#if defined( _WIN32 )
+	AcquireSRWLockExclusive( &lock->lock );
+#else
+	pthread_rwlock_wrlock( &lock->lock );
+#endif
+}
+
+void PlUnlockWrite( PLReadWriteLock *lock ) {
+#if defined( _WIN32 )
+	ReleaseSRWLockExclusive( &lock->lock );
+#else
+	pthread_rwlock_unlock( &lock->lock );
+#endif
+}
+
+PLCondition *PlCreateCondition( void ) {
+	PLCondition *condition = pl_malloc( sizeof( PLCondition ) );
+	if ( condition == NULL ) {
+		return NULL;
+	}
+
+#if defined( _WIN32 )
+	InitializeConditionVariable( &condition->condition );
+#else
+	pthread_cond_init( &condition->condition, NULL );
+#endif
+
+	return condition;
+}
+
+void PlDestroyCondition( PLCondition *condition ) {
+	if ( condition == NULL ) {
+		return;
+	}
+
+#if !defined( _WIN32 )
+	pthread_cond_destroy( &condition->condition );
+#endif
+	pl_free( condition );
+}
+
+void PlWaitCondition( PLCondition *condition, PLMutex *mutex ) {
+#if defined( _WIN32 )
+	SleepConditionVariableSRW( &condition->condition, &mutex->lock, INFINITE, 0 );
+#else
+	pthread_cond_wait( &condition->condition, &mutex->mutex );
+#endif
+}
+
+void PlSignalCondition( PLCondition *condition ) {
+#if defined( _WIN32 )
+	WakeConditionVariable( &condition->condition );
+#else
+	pthread_cond_signal( &condition->condition );
+#endif
+}
+
+void PlBroadcastCondition( PLCondition *condition ) {
+#if defined( _WIN32 )
+	WakeAllConditionVariable( &condition->condition );
+#else
+	pthread_cond_broadcast( &condition->condition );
+#endif
+}
+
+/**
+ * Returns the value after it's been incremented.
+ */
+unsigned int PlAtomicIncrement( volatile unsigned int *value ) {
+#if defined( _WIN32 )
+	return ( unsigned int ) InterlockedIncrement( ( volatile LONG * ) value );
+#else
+	return __atomic_add_fetch( value, 1, __ATOMIC_ACQ_REL );
+#endif
+}
+
+/**
+ * Returns the value after it's been decremented.
+ */
+unsigned int PlAtomicDecrement( volatile unsigned int *value ) {
+#if defined( _WIN32 )
+	return ( unsigned int ) InterlockedDecrement( ( volatile LONG * ) value );
+#else
+	return __atomic_sub_fetch( value, 1, __ATOMIC_ACQ_REL );
+#endif
+}
+
+/****/
+
+typedef struct PLJob {
+	PLJobFunction Function;
+	void *userData;
+	PLJobGroup *group;
+	struct PLJob *next;
+} PLJob;
+
+typedef struct PLJobGroup {
+	unsigned int numPending;
+	bool isReleased; /* freed once the last job is done */
+} PLJobGroup;
+
+static struct {
+	PLMutex *mutex;
+	PLCondition *jobQueued;
+	PLCondition *jobDone;
+	PLJob *head, *tail;
+	bool shutdown;
+
+#if defined( _WIN32 )
+	HANDLE threads[ MAX_WORKERS ];
+#else
+	pthread_t threads[ MAX_WORKERS ];
+#endif
+	unsigned int numThreads;
+} workers;
+
+static unsigned int GetNumProcessors( void ) {
+#if defined( _WIN32 )
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	long n = ( long ) info.dwNumberOfProcessors;
+#else
+	long n = sysconf( _SC_NPROCESSORS_ONLN );
+#endif
+	if ( n < 1 ) {
+		return 1;
+	} else if ( n > MAX_WORKERS ) {
+		return MAX_WORKERS;
+	}
+
+	return ( unsigned int ) n;
+}
+
+/**
+ * Pops the next job off the queue, expects the lock to be held.
+ */
+static PLJob *PopJob( void ) {
+	PLJob *job = workers.head;
+	if ( job == NULL ) {
+		return NULL;
+	}
+
+	workers.head = job->next;
+	if ( workers.head == NULL ) {
+		workers.tail = NULL;
+	}
+
+	return job;
+}
+
+/**
+ * Runs the given job, expects the lock to be held on entry
+ * and returns with it held again.
+ */
+static void RunJob( PLJob *job ) {
+	PlUnlockMutex( workers.mutex );
+	job->Function( job->userData );
+	PlLockMutex( workers.mutex );
+
+	if ( job->group != NULL && --job->group->numPending == 0 ) {
+		if ( job->group->isReleased ) {
+			pl_free( job->group );
+		} else {
+			PlBroadcastCondition( workers.jobDone );
+		}
+	}
+
+	pl_free( job );
+}
+
+#if defined( _WIN32 )
+static unsigned int __stdcall WorkerThread( void *userData ) {
+#else
+static void *WorkerThread( void *userData ) {
+#endif
+	PlUnused( userData );
+
+	PlLockMutex( workers.mutex );
+	for ( ;; ) {
+		PLJob *job = PopJob();
+		if ( job != NULL ) {
+			RunJob( job );
+			continue;
+		}
+
+		/* anything still queued is finished off before exiting */
+		if ( workers.shutdown ) {
+			break;
+		}
+
+		PlWaitCondition( workers.jobQueued, workers.mutex );
+	}
+	PlUnlockMutex( workers.mutex );
+
+	return 0;
+}
+
+/* jobs can queue jobs of their own, so the workers could be started
+ * from any thread; this is taken before anything else exists */
+static PLMutex workers_start_mutex = {
+#if defined( _WIN32 )
+	SRWLOCK_INIT
+#else
+	PTHREAD_MUTEX_INITIALIZER
+#endif
+};
+
+/**
+ * Starts the workers, expects the start lock to be held.
+ */
+static bool LaunchWorkers( void ) {
+	if ( workers.mutex == NULL ) {
+		workers.mutex = PlCreateMutex();
+		workers.jobQueued = PlCreateCondition();
+		workers.jobDone = PlCreateCondition();
+		if ( workers.mutex == NULL || workers.jobQueued == NULL || workers.jobDone == NULL ) {
+			return false;
+		}
+	}
+
+	workers.shutdown = false;
+
+	unsigned int numThreads = GetNumProcessors();
+	for ( unsigned int i = 0; i < numThreads; ++i ) {
+#if defined( _WIN32 )
+		workers.threads[ i ] = ( HANDLE ) _beginthreadex( NULL, 0, WorkerThread, NULL, 0, NULL );
+		if ( workers.threads[ i ] == NULL ) {
+			break;
+		}
+#else
+		if ( pthread_create( &workers.threads[ i ], NULL, WorkerThread, NULL ) != 0 ) {
+			break;
+		}
+#endif
+		workers.numThreads++;
+	}
+
+	if ( workers.numThreads == 0 ) {
+		PlReportErrorF( PL_RESULT_SYSERR, "failed to start any workers" );
+		return false;
+	}
+
+	return true;
+}
+
+static bool StartWorkers( void ) {
+	PlLockMutex( &workers_start_mutex );
+	bool status = ( workers.numThreads > 0 ) || LaunchWorkers();
+	PlUnlockMutex( &workers_start_mutex );
+
+	return status;
+}
+
+/**
+ * Stops all of the workers, once they've finished whatever's queued.
+ */
+void PlShutdownWorkers( void ) {
+	if ( workers.numThreads == 0 ) {
+		return;
+	}
+
+	PlLockMutex( workers.mutex );
+	workers.shutdown = true;
+	PlBroadcastCondition( workers.jobQueued );
+	PlUnlockMutex( workers.mutex );
+
+	for ( unsigned int i = 0; i < workers.numThreads; ++i ) {
+#if defined( _WIN32 )
+		WaitForSingleObject( workers.threads[ i ], INFINITE );
+		CloseHandle( workers.threads[ i ] );
+#else
+		pthread_join( workers.threads[ i ], NULL );
+#endif
+	}
+	workers.numThreads = 0;
+}
+
+unsigned int PlGetNumWorkers( void ) {
+	if ( !StartWorkers() ) {
+		return 0;
+	}
+
+	return workers.numThreads;
+}
+
+/**
+ * Queues the given function to be run by one of the workers.
+ * @param group Optional group the job should count towards.
+ */
+bool PlQueueJob( PLJobGroup *group, PLJobFunction Function, void *userData ) {
+	if ( !StartWorkers() ) {
+		return false;
+	}
+
+	PLJob *job = pl_malloc( sizeof( PLJob ) );
+	if ( job == NULL ) {
+		return false;
+	}
+
+	job->Function = Function;
+	job->userData = userData;
+	job->group = group;
+	job->next = NULL;
+
+	PlLockMutex( workers.mutex );
+	if ( group != NULL ) {
+		group->numPending++;
+	}
+
+	if ( workers.tail != NULL ) {
+		workers.tail->next = job;
+	} else {
+		workers.head = job;
+	}
+	workers.tail = job;
+
+	PlSignalCondition( workers.jobQueued );
+	PlUnlockMutex( workers.mutex );
+
+	return true;
+}
+
+PLJobGroup *PlCreateJobGroup( void ) {
+	return pl_calloc( 1, sizeof( PLJobGroup ) );
+}
+
+/**
+ * Waits on and then frees the given group.
+ */
+void PlDestroyJobGroup( PLJobGroup *group ) {
+	if ( group == NULL ) {
+		return;
+	}
+
+	PlWaitJobGroup( group );
+	pl_free( group );
+}
+
+/**
+ * Frees the given group once its jobs have finished, without
+ * waiting on them. Unlike PlDestroyJobGroup, this can be called
+ * from one of the group's own jobs. Nothing can wait on the
+ * group afterwards.
+ */
+void PlReleaseJobGroup( PLJobGroup *group ) {
+	if ( group == NULL ) {
+		return;
+	} else if ( workers.mutex == NULL ) {
+		pl_free( group );
+		return;
+	}
+
+	PlLockMutex( workers.mutex );
+	bool isDone = ( group->numPending == 0 );
+	group->isReleased = !isDone;
+	PlUnlockMutex( workers.mutex );
+
+	if ( isDone ) {
+		pl_free( group );
+	}
+}
+
+/**
+ * Blocks until every job in the group has finished. Rather
+ * than sitting idle, the caller helps out with the queue,
+ * which also means jobs can safely wait on other groups.
+ */
+void PlWaitJobGroup( PLJobGroup *group ) {
+	if ( group == NULL || workers.mutex == NULL ) {
+		return;
+	}
+
+	PlLockMutex( workers.mutex );
+	while ( group->numPending > 0 ) {
+		PLJob *job = PopJob();
+		if ( job != NULL ) {
+			RunJob( job );
+			continue;
+		}
+
+		PlWaitCondition( workers.jobDone, workers.mutex );
+	}
+	PlUnlockMutex( workers.mutex );
+}
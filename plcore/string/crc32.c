@@ -3,23 +3,281 @@
  * Invalid file names and files that cause errors are silently skipped.
  * The program reads from stdin if it is called with no arguments. */
 
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
-uint32_t pl_crc32_for_byte( uint32_t r ) {
-	for( int j = 0; j < 8; ++j )
-		r = ( r & 1 ? 0 : (uint32_t)0xEDB88320L ) ^ r >> 1;
-	return r ^ (uint32_t)0xFF000000L;
-}
+#if defined( _WIN32 )
+#	include <windows.h>
+#else
+#	include <pthread.h>
+#endif
+
+/* Larger buffers are handed to whatever the CPU offers for it, which
+ * is carryless multiplication on x86 and the CRC32 instructions on
+ * ARMv8, and otherwise go through slicing-by-8 tables. SSE4.2's own
+ * CRC32 instruction isn't any use here, since it's for CRC-32C.
+ *
+ * Internally these all work on the usual inverted state, whereas the
+ * checksum passed in and out of pl_crc32 is the final value. */
+
+#if defined( __x86_64__ ) || defined( _M_X64 ) || defined( __i386__ ) || defined( _M_IX86 )
+#	define PL_CRC32_X86
+#	include <immintrin.h>
+#	if defined( _MSC_VER )
+#		include <intrin.h>
+#		define PL_CRC32_TARGET
+#	else
+#		define PL_CRC32_TARGET __attribute__( ( target( "sse4.2,pclmul" ) ) )
+#	endif
+#elif defined( __aarch64__ ) && ( defined( __GNUC__ ) || defined( __clang__ ) )
+#	define PL_CRC32_ARMV8
+#	include <arm_acle.h>
+#	if defined( __clang__ )
+#		define PL_CRC32_TARGET __attribute__( ( target( "crc" ) ) )
+#	else
+#		define PL_CRC32_TARGET __attribute__( ( target( "+crc" ) ) )
+#	endif
+#	if defined( __linux__ )
+#		include <sys/auxv.h>
+#		if !defined( HWCAP_CRC32 )
+#			define HWCAP_CRC32 ( 1 << 7 )
+#		endif
+#	endif
+#endif
 
-void pl_crc32( const void* data, uint32_t n_bytes, uint32_t* crc ) {
-	static uint32_t table[ 0x100 ];
-	if( !*table ) {
-		for( uint32_t i = 0; i < 0x100; ++i ) {
-			table[ i ] = pl_crc32_for_byte( i );
+static uint32_t crc32_tables[ 8 ][ 0x100 ];
+
+static void crc32_init_tables( void ) {
+	for( uint32_t i = 0; i < 0x100; ++i ) {
+		uint32_t c = i;
+		for( int j = 0; j < 8; ++j ) {
+			c = ( c & 1 ) ? ( c >> 1 ) ^ (uint32_t)0xEDB88320L : c >> 1;
 		}
+		crc32_tables[ 0 ][ i ] = c;
+	}
+
+	for( uint32_t i = 0; i < 0x100; ++i ) {
+		for( int k = 1; k < 8; ++k ) {
+			uint32_t c = crc32_tables[ k - 1 ][ i ];
+			crc32_tables[ k ][ i ] = ( c >> 8 ) ^ crc32_tables[ 0 ][ c & 0xFF ];
+		}
+	}
+}
+
+static uint32_t crc32_slice8( uint32_t s, const uint8_t *p, size_t n ) {
+	while( n >= 8 ) {
+		uint32_t one = s ^ ( (uint32_t)p[ 0 ] | (uint32_t)p[ 1 ] << 8 | (uint32_t)p[ 2 ] << 16 | (uint32_t)p[ 3 ] << 24 );
+		uint32_t two = (uint32_t)p[ 4 ] | (uint32_t)p[ 5 ] << 8 | (uint32_t)p[ 6 ] << 16 | (uint32_t)p[ 7 ] << 24;
+		s = crc32_tables[ 7 ][ one & 0xFF ] ^ crc32_tables[ 6 ][ ( one >> 8 ) & 0xFF ] ^
+		    crc32_tables[ 5 ][ ( one >> 16 ) & 0xFF ] ^ crc32_tables[ 4 ][ one >> 24 ] ^
+		    crc32_tables[ 3 ][ two & 0xFF ] ^ crc32_tables[ 2 ][ ( two >> 8 ) & 0xFF ] ^
+		    crc32_tables[ 1 ][ ( two >> 16 ) & 0xFF ] ^ crc32_tables[ 0 ][ two >> 24 ];
+		p += 8;
+		n -= 8;
+	}
+
+	while( n-- > 0 ) {
+		s = crc32_tables[ 0 ][ ( s ^ *p++ ) & 0xFF ] ^ ( s >> 8 );
+	}
+
+	return s;
+}
+
+#if defined( PL_CRC32_X86 )
+
+/* Folds 64 bytes at a time with carryless multiplies, then reduces down
+ * to 32 bits, as laid out in Intel's "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction". Needs at least 64 bytes, and
+ * only handles whole blocks of 16. */
+PL_CRC32_TARGET static uint32_t crc32_pclmul( uint32_t s, const uint8_t *p, size_t n ) {
+	static const uint64_t k1k2[ 2 ] = { 0x0154442bd4, 0x01c6e41596 };
+	static const uint64_t k3k4[ 2 ] = { 0x01751997d0, 0x00ccaa009e };
+	static const uint64_t k5k0[ 2 ] = { 0x0163cd6124, 0x0000000000 };
+	static const uint64_t poly[ 2 ] = { 0x01db710641, 0x01f7011641 };
+
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+	x1 = _mm_loadu_si128( ( const __m128i * ) ( p + 0x00 ) );
+	x2 = _mm_loadu_si128( ( const __m128i * ) ( p + 0x10 ) );
+	x3 = _mm_loadu_si128( ( const __m128i * ) ( p + 0x20 ) );
+	x4 = _mm_loadu_si128( ( const __m128i * ) ( p + 0x30 ) );
+	x1 = _mm_xor_si128( x1, _mm_cvtsi32_si128( ( int ) s ) );
+
+	x0 = _mm_loadu_si128( ( const __m128i * ) k1k2 );
+	p += 64;
+	n -= 64;
+
+	while( n >= 64 ) {
+		x5 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+		x6 = _mm_clmulepi64_si128( x2, x0, 0x00 );
+		x7 = _mm_clmulepi64_si128( x3, x0, 0x00 );
+		x8 = _mm_clmulepi64_si128( x4, x0, 0x00 );
+
+		x1 = _mm_clmulepi64_si128( x1, x0, 0x11 );
+		x2 = _mm_clmulepi64_si128( x2, x0, 0x11 );
+		x3 = _mm_clmulepi64_si128( x3, x0, 0x11 );
+		x4 = _mm_clmulepi64_si128( x4, x0, 0x11 );
+
+		x1 = _mm_xor_si128( _mm_xor_si128( x1, x5 ), _mm_loadu_si128( ( const __m128i * ) ( p + 0x00 ) ) );
+		x2 = _mm_xor_si128( _mm_xor_si128( x2, x6 ), _mm_loadu_si128( ( const __m128i * ) ( p + 0x10 ) ) );
+		x3 = _mm_xor_si128( _mm_xor_si128( x3, x7 ), _mm_loadu_si128( ( const __m128i * ) ( p + 0x20 ) ) );
+		x4 = _mm_xor_si128( _mm_xor_si128( x4, x8 ), _mm_loadu_si128( ( const __m128i * ) ( p + 0x30 ) ) );
+
+		p += 64;
+		n -= 64;
 	}
 
-	for( uint32_t i = 0; i < n_bytes; ++i ) {
-		*crc = table[ (uint8_t)* crc ^ ( (uint8_t*)data )[ i ] ] ^ *crc >> 8;
+	/* fold the four lanes into one */
+	x0 = _mm_loadu_si128( ( const __m128i * ) k3k4 );
+
+	x5 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+	x1 = _mm_clmulepi64_si128( x1, x0, 0x11 );
+	x1 = _mm_xor_si128( _mm_xor_si128( x1, x2 ), x5 );
+
+	x5 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+	x1 = _mm_clmulepi64_si128( x1, x0, 0x11 );
+	x1 = _mm_xor_si128( _mm_xor_si128( x1, x3 ), x5 );
+
+	x5 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+	x1 = _mm_clmulepi64_si128( x1, x0, 0x11 );
+	x1 = _mm_xor_si128( _mm_xor_si128( x1, x4 ), x5 );
+
+	while( n >= 16 ) {
+		x2 = _mm_loadu_si128( ( const __m128i * ) p );
+
+		x5 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+		x1 = _mm_clmulepi64_si128( x1, x0, 0x11 );
+		x1 = _mm_xor_si128( _mm_xor_si128( x1, x2 ), x5 );
+
+		p += 16;
+		n -= 16;
 	}
+
+	/* 128 bits down to 64 */
+	x2 = _mm_clmulepi64_si128( x1, x0, 0x10 );
+	x3 = _mm_setr_epi32( ~0, 0, ~0, 0 );
+	x1 = _mm_srli_si128( x1, 8 );
+	x1 = _mm_xor_si128( x1, x2 );
+
+	x0 = _mm_loadl_epi64( ( const __m128i * ) k5k0 );
+
+	x2 = _mm_srli_si128( x1, 4 );
+	x1 = _mm_and_si128( x1, x3 );
+	x1 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+	x1 = _mm_xor_si128( x1, x2 );
+
+	/* and Barrett reduce to 32 */
+	x0 = _mm_loadu_si128( ( const __m128i * ) poly );
+
+	x2 = _mm_and_si128( x1, x3 );
+	x2 = _mm_clmulepi64_si128( x2, x0, 0x10 );
+	x2 = _mm_and_si128( x2, x3 );
+	x2 = _mm_clmulepi64_si128( x2, x0, 0x00 );
+	x1 = _mm_xor_si128( x1, x2 );
+
+	return ( uint32_t ) _mm_extract_epi32( x1, 1 );
+}
+
+static int crc32_has_pclmul( void ) {
+#	if defined( _MSC_VER )
+	int info[ 4 ];
+	__cpuid( info, 1 );
+	return ( info[ 2 ] & ( 1 << 1 ) ) && ( info[ 2 ] & ( 1 << 20 ) );
+#	else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports( "pclmul" ) && __builtin_cpu_supports( "sse4.2" );
+#	endif
+}
+
+static uint32_t crc32_hardware( uint32_t s, const uint8_t *p, size_t n ) {
+	if( n < 64 ) {
+		return crc32_slice8( s, p, n );
+	}
+
+	size_t blocks = n & ~(size_t)15;
+	s = crc32_pclmul( s, p, blocks );
+	return crc32_slice8( s, p + blocks, n - blocks );
+}
+
+#elif defined( PL_CRC32_ARMV8 )
+
+PL_CRC32_TARGET static uint32_t crc32_hardware( uint32_t s, const uint8_t *p, size_t n ) {
+	while( n > 0 && ( (uintptr_t)p & 7 ) != 0 ) {
+		s = __crc32b( s, *p++ );
+		n--;
+	}
+
+	while( n >= 8 ) {
+		uint64_t v;
+		memcpy( &v, p, sizeof( v ) );
+		s = __crc32d( s, v );
+		p += 8;
+		n -= 8;
+	}
+
+	while( n-- > 0 ) {
+		s = __crc32b( s, *p++ );
+	}
+
+	return s;
+}
+
+static int crc32_has_armv8( void ) {
+#	if defined( __APPLE__ ) || defined( __ARM_FEATURE_CRC32 )
+	return 1;
+#	elif defined( __linux__ )
+	return ( getauxval( AT_HWCAP ) & HWCAP_CRC32 ) != 0;
+#	else
+	return 0;
+#	endif
+}
+
+#endif
+
+typedef uint32_t ( *crc32_function_t )( uint32_t s, const uint8_t *p, size_t n );
+static crc32_function_t crc32_update = NULL;
+
+static void crc32_select( void ) {
+	crc32_init_tables();
+
+#if defined( PL_CRC32_X86 )
+	if( crc32_has_pclmul() ) {
+		crc32_update = crc32_hardware;
+		return;
+	}
+#elif defined( PL_CRC32_ARMV8 )
+	if( crc32_has_armv8() ) {
+		crc32_update = crc32_hardware;
+		return;
+	}
+#endif
+
+	crc32_update = crc32_slice8;
+}
+
+/* checksums can be taken from any number of workers at once,
+ * so the first one to get here sets things up for the rest */
+#if defined( _WIN32 )
+static INIT_ONCE crc32_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK crc32_select_once( PINIT_ONCE once, PVOID parameter, PVOID *context ) {
+	( void ) once;
+	( void ) parameter;
+	( void ) context;
+	crc32_select();
+	return TRUE;
+}
+#else
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+#endif
+
+void pl_crc32( const void* data, size_t n_bytes, uint32_t* crc ) {
+#if defined( _WIN32 )
+	InitOnceExecuteOnce( &crc32_once, crc32_select_once, NULL, NULL );
+#else
+	pthread_once( &crc32_once, crc32_select );
+#endif
+
+	*crc = ~crc32_update( ~*crc, (const uint8_t *)data, n_bytes );
 }
@@ -0,0 +1,59 @@
+/**
+ * Hei Platform Library
+ * Copyright (C) 2017-2021 Mark E Sowden <hogsy@oldtimes-software.com>
+ * This software is licensed under MIT. See LICENSE for more details.
+ */
+
+#pragma once
+
+#include <plcore/pl.h>
+
+#if defined( _MSC_VER )
+#   define PL_THREAD_LOCAL __declspec( thread )
+#else
+#   define PL_THREAD_LOCAL _Thread_local
+#endif
+
+typedef struct PLMutex PLMutex;
+typedef struct PLReadWriteLock PLReadWriteLock;
+typedef struct PLCondition PLCondition;
+
+PLMutex *PlCreateMutex( void );
+void PlDestroyMutex( PLMutex *mutex );
+void PlLockMutex( PLMutex *mutex );
+void PlUnlockMutex( PLMutex *mutex );
+
+/* Any number of readers, or a single writer. Neither side can be
+ * taken again by a thread that already holds it. */
+PLReadWriteLock *PlCreateReadWriteLock( void );
+void PlDestroyReadWriteLock( PLReadWriteLock *lock );
+void PlLockRead( PLReadWriteLock *lock );
+void PlUnlockRead( PLReadWriteLock *lock );
+void PlLockWrite( PLReadWriteLock *lock );
+void PlUnlockWrite( PLReadWriteLock *lock );
+
+PLCondition *PlCreateCondition( void );
+void PlDestroyCondition( PLCondition *condition );
+void PlWaitCondition( PLCondition *condition, PLMutex *mutex );
+void PlSignalCondition( PLCondition *condition );
+void PlBroadcastCondition( PLCondition *condition );
+
+unsigned int PlAtomicIncrement( volatile unsigned int *value );
+unsigned int PlAtomicDecrement( volatile unsigned int *value );
+
+/* Jobs are run by a pool of workers that's shared by the whole
+ * library, and started the first time anything is queued. Jobs
+ * can be gathered into a group, which can then be waited on. */
+
+typedef struct PLJobGroup PLJobGroup;
+typedef void ( *PLJobFunction )( void *userData );
+
+PLJobGroup *PlCreateJobGroup( void );
+void PlDestroyJobGroup( PLJobGroup *group );
+void PlReleaseJobGroup( PLJobGroup *group );
+void PlWaitJobGroup( PLJobGroup *group );
+
+bool PlQueueJob( PLJobGroup *group, PLJobFunction Function, void *userData );
+unsigned int PlGetNumWorkers( void );
+
+void PlShutdownWorkers( void );
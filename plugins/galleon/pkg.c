@@ -118,6 +118,12 @@ static PLPackage *PKG_ReadFile( PLFile *file ) {
 
 		numFiles++;
 	}
+
+	/* the names are all we can get at so far, and a table
+	 * without offsets and lengths is no use to anyone */
+	gInterface->Free( fileTable );
+	gInterface->ReportError( PL_RESULT_UNSUPPORTED, PL_FUNCTION, "offsets and lengths aren't supported yet" );
+	return NULL;
 }
 
 PLPackage *PKG_LoadFile( const char *path ) {
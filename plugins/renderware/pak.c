@@ -31,7 +31,7 @@ static PLPackage *PAK_ReadFile( PLFile *file ) {
 	const char *path = gInterface->GetFilePath( file );
 	PLPackage *package = gInterface->CreatePackageHandle( path, numFiles, NULL );
 	for ( unsigned int i = 0; i < numFiles; ++i ) {
-		snprintf( package->table[ i ].fileName, sizeof( package->table[ i ].fileName ), "%s", indices[ i ].fileName );
+		gInterface->SetPackageFileName( package, i, indices[ i ].fileName, sizeof( indices[ i ].fileName ) );
 
 #if 0 /* this appears to be wrong, sadly, so for now just dump the compressed file */
 		/* extract the flag from the end of the index */
@@ -27,6 +27,11 @@ For more information, please refer to <http://unlicense.org>
 
 #include <plcore/pl.h>
 #include <plcore/pl_console.h>
+#include <plcore/pl_filesystem.h>
+#include <plcore/pl_hashtable.h>
+#include <plcore/pl_image.h>
+#include <plcore/pl_memory.h>
+#include <plcore/pl_package.h>
 
 enum {
 	TEST_RETURN_SUCCESS,
@@ -95,9 +100,1508 @@ FUNC_TEST( GetConsoleCommand )
     }
 FUNC_TEST_END()
 
+/*============================================================
+ * HASH TABLE
+ ===========================================================*/
+
+FUNC_TEST( HashTable )
+    PLHashTable *table = PlCreateHashTable();
+    static int values[ 1000 ];
+    char key[ 16 ];
+    for ( unsigned int i = 0; i < plArrayElements( values ); ++i ) {
+	    snprintf( key, sizeof( key ), "key%u", i );
+	    if ( !PlInsertHashTableNode( table, key, strlen( key ), &values[ i ] ) ) {
+		    printf( "Failed to insert \"%s\"!\n", key );
+		    return TEST_RETURN_FAILURE;
+	    }
+    }
+    if ( PlInsertHashTableNode( table, "key0", 4, NULL ) ) {
+	    printf( "Inserted duplicate key!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    for ( unsigned int i = 0; i < plArrayElements( values ); i += 2 ) {
+	    snprintf( key, sizeof( key ), "key%u", i );
+	    PlRemoveHashTableNode( table, key, strlen( key ) );
+    }
+    for ( unsigned int i = 0; i < plArrayElements( values ); ++i ) {
+	    snprintf( key, sizeof( key ), "key%u", i );
+	    void *value = PlLookupHashTableUserData( table, key, strlen( key ) );
+	    if ( value != ( ( i % 2 ) ? &values[ i ] : NULL ) ) {
+		    printf( "Unexpected value for \"%s\"!\n", key );
+		    return TEST_RETURN_FAILURE;
+	    }
+    }
+    if ( PlGetNumHashTableNodes( table ) != plArrayElements( values ) / 2 ) {
+	    printf( "Unexpected number of nodes!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    PlDestroyHashTable( table );
+FUNC_TEST_END()
+
+/*============================================================
+ * FILESYSTEM
+ ===========================================================*/
+
+#define TEST_FILE_PATH "pl_test_file.bin"
+static const char testFileData[] = "PLTESTFILE\nsecond line\n";
+
+FUNC_TEST( MapLocalFile )
+    if ( !PlWriteFile( TEST_FILE_PATH, ( const uint8_t * ) testFileData, sizeof( testFileData ) - 1 ) ) {
+	    printf( "Failed to write test file!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    PLFile *file = PlMapLocalFile( TEST_FILE_PATH, PL_FILE_ACCESS_SEQUENTIAL );
+    if ( file == NULL ) {
+	    printf( "Failed to map test file!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    if ( PlGetFileSize( file ) != sizeof( testFileData ) - 1 || memcmp( PlGetFileData( file ), testFileData, sizeof( testFileData ) - 1 ) != 0 ) {
+	    printf( "Mapped data doesn't match!\n" );
+	    PlCloseFile( file );
+	    return TEST_RETURN_FAILURE;
+    }
+    char line[ 32 ];
+    if ( PlReadString( file, line, sizeof( line ) ) == NULL || strcmp( line, "PLTESTFILE\n" ) != 0 ) {
+	    printf( "Failed to read string from mapped file!\n" );
+	    PlCloseFile( file );
+	    return TEST_RETURN_FAILURE;
+    }
+    if ( !PlFileSeek( file, 2, PL_SEEK_SET ) || PlReadInt8( file, NULL ) != 'T' ) {
+	    printf( "Failed to seek within mapped file!\n" );
+	    PlCloseFile( file );
+	    return TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( file );
+    PlDeleteFile( TEST_FILE_PATH );
+FUNC_TEST_END()
+
+FUNC_TEST( ReadBufferedFile )
+    if ( !PlWriteFile( TEST_FILE_PATH, ( const uint8_t * ) testFileData, sizeof( testFileData ) - 1 ) ) {
+	    printf( "Failed to write test file!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    /* small enough that reads have to cross the buffer */
+    PlSetConsoleVariableByName( "fs.bufferSize", "4" );
+    PLFile *file = PlOpenLocalFile( TEST_FILE_PATH, false );
+    PlSetConsoleVariableByName( "fs.bufferSize", "32768" );
+    if ( file == NULL ) {
+	    printf( "Failed to open test file!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    char line[ 32 ];
+    if ( PlReadString( file, line, sizeof( line ) ) == NULL || strcmp( line, "PLTESTFILE\n" ) != 0 ) {
+	    printf( "Unexpected string read from file!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    if ( PlGetFileOffset( file ) != 11 || PlReadInt8( file, NULL ) != 's' ) {
+	    printf( "Unexpected offset after reading string!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    char buf[ sizeof( testFileData ) ];
+    if ( !PlFileSeek( file, 0, PL_SEEK_SET ) || PlReadFile( file, buf, 1, sizeof( buf ) ) != sizeof( testFileData ) - 1 ||
+         memcmp( buf, testFileData, sizeof( testFileData ) - 1 ) != 0 || !PlIsEndOfFile( file ) ) {
+	    printf( "Failed to read back file contents!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    if ( !PlFileSeek( file, -5, PL_SEEK_END ) || PlReadInt8( file, NULL ) != 'l' ) {
+	    printf( "Failed to seek from end of file!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( file );
+    PlDeleteFile( TEST_FILE_PATH );
+    return ret;
+FUNC_TEST_END()
+
+FUNC_TEST( ReadArrays )
+    /* enough values that both the vector and scalar paths are hit */
+    uint8_t data[ 8 * 37 ];
+    for ( unsigned int i = 0; i < sizeof( data ); ++i ) {
+	    data[ i ] = ( uint8_t ) i;
+    }
+    if ( !PlWriteFile( TEST_FILE_PATH, data, sizeof( data ) ) ) {
+	    printf( "Failed to write test file!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    PLFile *file = PlOpenFile( TEST_FILE_PATH, true );
+    if ( file == NULL ) {
+	    printf( "Failed to open test file!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    int64_t values[ 37 ];
+    size_t numValues[ 3 ] = { 37 * 4, 37 * 2, 37 };
+    for ( unsigned int size = 0; size < 3; ++size ) {
+	    for ( unsigned int bigEndian = 0; bigEndian < 2; ++bigEndian ) {
+		    PlRewindFile( file );
+		    size_t r = 0;
+		    if ( size == 0 ) {
+			    r = PlReadInt16Array( file, ( int16_t * ) values, numValues[ size ], bigEndian );
+		    } else if ( size == 1 ) {
+			    r = PlReadInt32Array( file, ( int32_t * ) values, numValues[ size ], bigEndian );
+		    } else {
+			    r = PlReadInt64Array( file, values, numValues[ size ], bigEndian );
+		    }
+		    if ( r != numValues[ size ] ) {
+			    printf( "Failed to read array!\n" );
+			    ret = TEST_RETURN_FAILURE;
+			    continue;
+		    }
+		    unsigned int width = 2 << size;
+		    for ( unsigned int i = 0; i < sizeof( data ); i += width ) {
+			    uint64_t expected = 0, actual = 0;
+			    for ( unsigned int j = 0; j < width; ++j ) {
+				    unsigned int shift = bigEndian ? ( width - 1 - j ) * 8 : j * 8;
+				    expected |= ( uint64_t ) data[ i + j ] << shift;
+			    }
+			    memcpy( &actual, ( uint8_t * ) values + i, width );
+			    if ( actual != expected ) {
+				    printf( "Unexpected value at %u (width %u, big endian %u)!\n", i, width, bigEndian );
+				    ret = TEST_RETURN_FAILURE;
+				    break;
+			    }
+		    }
+	    }
+    }
+    PlCloseFile( file );
+    PlDeleteFile( TEST_FILE_PATH );
+    return ret;
+FUNC_TEST_END()
+
+FUNC_TEST( MountLocation )
+    PlCreatePath( "pl_test_mount/Sub" );
+    if ( !PlWriteFile( "pl_test_mount/Sub/File.TXT", ( const uint8_t * ) testFileData, sizeof( testFileData ) - 1 ) ) {
+	    printf( "Failed to write test file!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    PLFileSystemMount *mount = PlMountLocation( "pl_test_mount" );
+    if ( mount == NULL ) {
+	    printf( "Failed to mount test directory!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    if ( !PlFileExists( "Sub/File.TXT" ) || !PlFileExists( "./Sub//File.TXT" ) ) {
+	    printf( "Failed to find file in mounted location!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    if ( PlFileExists( "sub/file.txt" ) ) {
+	    printf( "Found file with mismatched case!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PLFileInfo info;
+    if ( !PlStatFile( "Sub/File.TXT", &info ) || info.size != sizeof( testFileData ) - 1 || info.mount != mount || info.isPackaged ) {
+	    printf( "Failed to stat file in mounted location!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlSetConsoleVariableByName( "fs.casefold", "1" );
+    PLFile *file = PlOpenFile( "sub/file.txt", false );
+    if ( file == NULL ) {
+	    printf( "Failed to open file with case folding enabled!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( file );
+    PlSetConsoleVariableByName( "fs.casefold", "0" );
+    PlClearMountedLocation( mount );
+    PlDeleteFile( "pl_test_mount/Sub/File.TXT" );
+    return ret;
+FUNC_TEST_END()
+
+static void CountScannedFile( const char *path, void *userData ) {
+	( *( unsigned int * ) userData )++;
+}
+
+FUNC_TEST( ScanDirectory )
+    const char *files[] = {
+            "pl_test_scan/a/One.txt",
+            "pl_test_scan/a/b/Two.txt",
+            "pl_test_scan/a/b/Three.bin",
+            "pl_test_scan2/a/One.txt",
+            "pl_test_scan2/a/Four.txt",
+    };
+    PlCreatePath( "pl_test_scan/a/b" );
+    PlCreatePath( "pl_test_scan2/a" );
+    for ( unsigned int i = 0; i < plArrayElements( files ); ++i ) {
+	    if ( !PlWriteFile( files[ i ], ( const uint8_t * ) testFileData, i + 1 ) ) {
+		    printf( "Failed to write test file!\n" );
+		    return TEST_RETURN_FAILURE;
+	    }
+    }
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    unsigned int numEntries;
+    PLDirectoryEntry *entries = PlScanDirectoryEntries( "local://pl_test_scan", "txt", true, &numEntries );
+    if ( entries == NULL || numEntries != 2 ) {
+	    printf( "Unexpected number of entries from local scan!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    for ( unsigned int i = 0; i < numEntries; ++i ) {
+	    size_t expectedSize = ( strcmp( entries[ i ].path, files[ 0 ] ) == 0 ) ? 1 : 2;
+	    if ( entries[ i ].size != expectedSize || entries[ i ].timeStamp == 0 ) {
+		    printf( "Unexpected size or timestamp for \"%s\"!\n", entries[ i ].path );
+		    ret = TEST_RETURN_FAILURE;
+	    }
+    }
+    PlDestroyDirectoryEntries( entries );
+    /* One.txt is in both, so should only be returned once */
+    PLFileSystemMount *mount = PlMountLocation( "pl_test_scan" );
+    PLFileSystemMount *mount2 = PlMountLocation( "local://pl_test_scan2" );
+    if ( mount == NULL || mount2 == NULL ) {
+	    printf( "Failed to mount test directories!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    unsigned int numFiles = 0;
+    PlScanDirectory( "a", "txt", CountScannedFile, true, &numFiles );
+    if ( numFiles != 3 ) {
+	    printf( "Unexpected number of files from mounted scan (%u)!\n", numFiles );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlClearMountedLocation( mount2 );
+    PlClearMountedLocation( mount );
+    for ( unsigned int i = 0; i < plArrayElements( files ); ++i ) {
+	    PlDeleteFile( files[ i ] );
+    }
+    return ret;
+FUNC_TEST_END()
+
+#define TEST_WAD_PATH "pl_test.wad"
+
+/**
+ * Writes out a WAD containing a few bytes of data for
+ * each of the given names, which can be up to 8 characters.
+ */
+static bool WriteTestWad( const char *path, const char **names, unsigned int numNames ) {
+	uint8_t buf[ 1024 ];
+	uint32_t tableOffset = 12 + numNames * 4;
+	memcpy( buf, "PWAD", 4 );
+	memcpy( &buf[ 4 ], &numNames, 4 );
+	memcpy( &buf[ 8 ], &tableOffset, 4 );
+	for ( unsigned int i = 0; i < numNames; ++i ) {
+		uint32_t offset = 12 + i * 4, size = 4;
+		memcpy( &buf[ offset ], &i, 4 );
+		uint8_t *index = &buf[ tableOffset + i * 16 ];
+		memcpy( index, &offset, 4 );
+		memcpy( index + 4, &size, 4 );
+		memset( index + 8, 0, 8 );
+		memcpy( index + 8, names[ i ], strlen( names[ i ] ) );
+	}
+	return PlWriteFile( path, buf, tableOffset + numNames * 16 );
+}
+
+FUNC_TEST( PackageDirectories )
+    const char *names[] = { "d/1.txt", "d/e/2.t", "top.txt" };
+    if ( !WriteTestWad( TEST_WAD_PATH, names, plArrayElements( names ) ) ) {
+	    printf( "Failed to write test package!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    PlCreatePath( "pl_test_pkg/d" );
+    PlWriteFile( "pl_test_pkg/d/1.txt", ( const uint8_t * ) testFileData, 1 );
+    PlRegisterStandardPackageLoaders();
+    PLFileSystemMount *mount = PlMountLocation( "pl_test_pkg" );
+    PLFileSystemMount *packageMount = PlMountLocation( "local://" TEST_WAD_PATH );
+    if ( mount == NULL || packageMount == NULL ) {
+	    printf( "Failed to mount test locations!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    if ( !PlPathExists( "d/e" ) || PlPathExists( "d/x" ) ) {
+	    printf( "Unexpected result checking package paths!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    /* d/1.txt is provided by both */
+    unsigned int numFiles = 0;
+    PlScanDirectory( "d", NULL, CountScannedFile, true, &numFiles );
+    if ( numFiles != 2 ) {
+	    printf( "Unexpected number of files from recursive scan (%u)!\n", numFiles );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    /* and paths take the same form whichever mount they came from */
+    PLDirectoryEntry *entries = PlScanDirectoryEntries( "d", NULL, true, &numFiles );
+    for ( unsigned int i = 0; i < numFiles; ++i ) {
+	    if ( strcmp( entries[ i ].path, "d/1.txt" ) != 0 && strcmp( entries[ i ].path, "d/e/2.t" ) != 0 ) {
+		    printf( "Unexpected path from recursive scan, \"%s\"!\n", entries[ i ].path );
+		    ret = TEST_RETURN_FAILURE;
+	    }
+    }
+    PlDestroyDirectoryEntries( entries );
+    numFiles = 0;
+    PlScanDirectory( "", "txt", CountScannedFile, false, &numFiles );
+    if ( numFiles != 1 ) {
+	    printf( "Unexpected number of files from root scan (%u)!\n", numFiles );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlClearMountedLocation( packageMount );
+    PlClearMountedLocation( mount );
+    PlDeleteFile( "pl_test_pkg/d/1.txt" );
+    PlDeleteFile( TEST_WAD_PATH );
+    return ret;
+FUNC_TEST_END()
+
+FUNC_TEST( PackageFileNames )
+    PLPackage *package = PlCreatePackageHandle( "pl_test_names", 4, NULL );
+    if ( package == NULL ) {
+	    printf( "Failed to create package handle!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    /* fixed-size fields, as they'd be read out of an archive, which
+     * are only terminated when the name is shorter than the field */
+    struct {
+	    char name[ 8 ];
+	    char next[ 8 ];
+    } fields[ 2 ];
+    memset( fields, 0, sizeof( fields ) );
+    memcpy( fields[ 0 ].name, "THINGSXX", 8 );
+    memcpy( fields[ 0 ].next, "JUNK", 4 );
+    memcpy( fields[ 1 ].name, "THINGSXX", 8 );
+    memcpy( fields[ 1 ].next, "MORE", 4 );
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    if ( !PlSetPackageFileName( package, 0, "MAP01", 8 ) || !PlSetPackageFileName( package, 1, fields[ 0 ].name, 8 ) ||
+         !PlSetPackageFileName( package, 2, "MAP01", 8 ) || !PlSetPackageFileName( package, 3, fields[ 1 ].name, 8 ) ||
+         PlSetPackageFileName( package, 4, "MAP01", 8 ) ) {
+	    printf( "Unexpected result setting file names!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    if ( strcmp( PlGetPackageFileName( package, 0 ), "MAP01" ) != 0 || strcmp( PlGetPackageFileName( package, 1 ), "THINGSXX" ) != 0 ||
+         strcmp( PlGetPackageFileName( package, 2 ), "MAP01" ) != 0 || strcmp( PlGetPackageFileName( package, 3 ), "THINGSXX" ) != 0 ) {
+	    printf( "Unexpected file names!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    /* repeated names should share the one copy in the pool */
+    if ( package->table[ 0 ].nameOffset != package->table[ 2 ].nameOffset ||
+         package->table[ 1 ].nameOffset != package->table[ 3 ].nameOffset ||
+         package->table[ 0 ].nameOffset == package->table[ 1 ].nameOffset ) {
+	    printf( "Repeated names weren't shared!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    /* renaming the entry that first used a name mustn't affect
+     * entries given that name afterwards */
+    if ( !PlSetPackageFileName( package, 0, "FOO", 8 ) || !PlSetPackageFileName( package, 2, "MAP01", 8 ) ||
+         strcmp( PlGetPackageFileName( package, 0 ), "FOO" ) != 0 || strcmp( PlGetPackageFileName( package, 2 ), "MAP01" ) != 0 ) {
+	    printf( "Unexpected file names after renaming!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDestroyPackage( package );
+    return ret;
+FUNC_TEST_END()
+
+FUNC_TEST( PackageIndex )
+    const char *names[] = { "A.TXT", "b.txt", "a.txt", "B.TXT", "b.txt" };
+    if ( !WriteTestWad( TEST_WAD_PATH, names, plArrayElements( names ) ) ) {
+	    printf( "Failed to write test package!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    PLPackage *package = PlLoadPackage( TEST_WAD_PATH );
+    if ( package == NULL || PlGetPackageTableSize( package ) != plArrayElements( names ) ) {
+	    printf( "Failed to load test package! (%s)\n", PlGetError() );
+	    PlDestroyPackage( package );
+	    return TEST_RETURN_FAILURE;
+    }
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    /* duplicates resolve to whichever comes first in the table */
+    if ( PlGetPackageTableIndex( package, "A.TXT" ) != 0 || PlGetPackageTableIndex( package, "b.txt" ) != 1 ||
+         PlGetPackageTableIndex( package, "a.txt" ) != 2 || PlGetPackageTableIndex( package, "B.TXT" ) != 3 ||
+         PlGetPackageTableIndex( package, "A.txt" ) != -1 ) {
+	    printf( "Unexpected result looking up files!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlSetPackageCaseInsensitive( package, true );
+    if ( PlGetPackageTableIndex( package, "a.txt" ) != 0 || PlGetPackageTableIndex( package, "A.txt" ) != 0 ||
+         PlGetPackageTableIndex( package, "B.TXT" ) != 1 || PlGetPackageTableIndex( package, "c.txt" ) != -1 ) {
+	    printf( "Unexpected result looking up files case-insensitively!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    /* and the index should go back to how it was */
+    PlSetPackageCaseInsensitive( package, false );
+    if ( PlGetPackageTableIndex( package, "a.txt" ) != 2 || PlGetPackageTableIndex( package, "B.TXT" ) != 3 ||
+         PlGetPackageTableIndex( package, "A.txt" ) != -1 ) {
+	    printf( "Unexpected result looking up files after toggling case!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDestroyPackage( package );
+    PlDeleteFile( TEST_WAD_PATH );
+    return ret;
+FUNC_TEST_END()
+
+#define TEST_ZLIB_PATH "pl_test.ztst"
+#define TEST_ZLIB_SIZE 300000
+
+static uint8_t GetTestZlibByte( size_t i ) {
+	return ( uint8_t ) ( ( i * 7 ) ^ ( i >> 8 ) );
+}
+
+/**
+ * Writes out a zlib stream made up of stored blocks, which
+ * is enough to exercise streaming without needing a deflater.
+ */
+static bool WriteTestZlibFile( const char *path ) {
+	size_t numBlocks = ( TEST_ZLIB_SIZE + 65534 ) / 65535;
+	size_t size = 2 + numBlocks * 5 + TEST_ZLIB_SIZE + 4;
+	uint8_t *buf = pl_malloc( size );
+	uint8_t *p = buf;
+	*p++ = 0x78;
+	*p++ = 0x01;
+	uint32_t a = 1, b = 0;
+	for ( size_t i = 0; i < TEST_ZLIB_SIZE; ) {
+		uint16_t length = ( TEST_ZLIB_SIZE - i > 65535 ) ? 65535 : ( uint16_t ) ( TEST_ZLIB_SIZE - i );
+		uint16_t nlength = ( uint16_t ) ~length;
+		*p++ = ( i + length == TEST_ZLIB_SIZE ) ? 1 : 0;
+		memcpy( p, &length, 2 );
+		memcpy( p + 2, &nlength, 2 );
+		p += 4;
+		for ( uint16_t j = 0; j < length; ++j, ++i ) {
+			*p = GetTestZlibByte( i );
+			a = ( a + *p++ ) % 65521;
+			b = ( b + a ) % 65521;
+		}
+	}
+	uint32_t adler = ( b << 16 ) | a;
+	*p++ = ( uint8_t ) ( adler >> 24 );
+	*p++ = ( uint8_t ) ( adler >> 16 );
+	*p++ = ( uint8_t ) ( adler >> 8 );
+	*p++ = ( uint8_t ) adler;
+	bool status = PlWriteFile( path, buf, size );
+	pl_free( buf );
+	return status;
+}
+
+static PLPackage *LoadTestZlibPackage( const char *path ) {
+	PLFile *file = PlOpenFile( path, false );
+	if ( file == NULL ) {
+		return NULL;
+	}
+	size_t size = PlGetFileSize( file );
+	PlCloseFile( file );
+
+	PLPackage *package = PlCreatePackageHandle( path, 1, NULL );
+	package->table[ 0 ].fileSize = TEST_ZLIB_SIZE;
+	package->table[ 0 ].compressedSize = size;
+	package->table[ 0 ].compressionType = PL_COMPRESSION_ZLIB;
+	PlSetPackageFileName( package, 0, "big.bin", 8 );
+	return package;
+}
+
+static bool CheckTestZlibData( const uint8_t *data, size_t offset, size_t length ) {
+	for ( size_t i = 0; i < length; ++i ) {
+		if ( data[ i ] != GetTestZlibByte( offset + i ) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+FUNC_TEST( InflateStream )
+    if ( !WriteTestZlibFile( TEST_ZLIB_PATH ) ) {
+	    printf( "Failed to write test file!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    PlRegisterPackageLoader( "ztst", LoadTestZlibPackage );
+    PLFileSystemMount *mount = PlMountLocation( "local://" TEST_ZLIB_PATH );
+    if ( mount == NULL ) {
+	    printf( "Failed to mount test package!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    static uint8_t buf[ TEST_ZLIB_SIZE ];
+    PLFile *file = PlOpenFile( "big.bin", false );
+    if ( file == NULL || PlGetFileData( file ) != NULL || PlGetFileSize( file ) != TEST_ZLIB_SIZE ) {
+	    printf( "Large compressed entry wasn't streamed!\n" );
+	    PlCloseFile( file );
+	    PlClearMountedLocation( mount );
+	    return TEST_RETURN_FAILURE;
+    }
+    /* read in odd-sized chunks, so reads straddle the window */
+    size_t total = 0, r;
+    while ( ( r = PlReadFile( file, buf + total, 1, 7777 ) ) > 0 ) {
+	    total += r;
+    }
+    if ( total != TEST_ZLIB_SIZE || !CheckTestZlibData( buf, 0, total ) || !PlIsEndOfFile( file ) ) {
+	    printf( "Streamed data doesn't match (%zu bytes)!\n", total );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    /* seeking back means starting over */
+    if ( !PlFileSeek( file, 100000, PL_SEEK_SET ) || PlReadFile( file, buf, 1, 70000 ) != 70000 || !CheckTestZlibData( buf, 100000, 70000 ) ) {
+	    printf( "Failed to read after seeking back!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    if ( !PlFileSeek( file, 250000, PL_SEEK_SET ) || ( uint8_t ) PlReadInt8( file, NULL ) != GetTestZlibByte( 250000 ) ) {
+	    printf( "Failed to read after seeking forward!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( file );
+    file = PlOpenFile( "big.bin", true );
+    if ( file == NULL || PlGetFileData( file ) == NULL || !CheckTestZlibData( PlGetFileData( file ), 0, TEST_ZLIB_SIZE ) ) {
+	    printf( "Cached data doesn't match!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( file );
+    PlClearMountedLocation( mount );
+    PlDeleteFile( TEST_ZLIB_PATH );
+    return ret;
+FUNC_TEST_END()
+
+FUNC_TEST( PackageCache )
+    if ( !WriteTestZlibFile( TEST_ZLIB_PATH ) ) {
+	    printf( "Failed to write test file!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    PLFileSystemMount *mount = PlMountLocation( "local://" TEST_ZLIB_PATH );
+    if ( mount == NULL ) {
+	    printf( "Failed to mount test package!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    PlSetConsoleVariableByName( "fs.cacheSize", "1024" );
+    /* both should share the one decompressed copy */
+    PLFile *a = PlOpenFile( "big.bin", true );
+    PLFile *b = PlOpenFile( "big.bin", true );
+    if ( a == NULL || b == NULL || PlGetFileData( a ) != PlGetFileData( b ) ) {
+	    printf( "Second open wasn't served from the cache!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( b );
+    /* shrinking the budget evicts it, but open handles keep it alive */
+    PlSetConsoleVariableByName( "fs.cacheSize", "256" );
+    b = PlOpenFile( "big.bin", true );
+    if ( a == NULL || b == NULL || PlGetFileData( a ) == PlGetFileData( b ) ||
+         !CheckTestZlibData( PlGetFileData( a ), 0, TEST_ZLIB_SIZE ) || !CheckTestZlibData( PlGetFileData( b ), 0, TEST_ZLIB_SIZE ) ) {
+	    printf( "Evicted file is still being served!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( a );
+    PlCloseFile( b );
+    PlSetConsoleVariableByName( "fs.cacheSize", "0" );
+    PlClearMountedLocation( mount );
+    PlDeleteFile( TEST_ZLIB_PATH );
+    return ret;
+FUNC_TEST_END()
+
+#define TEST_PACK_PATH "pl_test.pkg"
+
+FUNC_TEST( NativePackage )
+    const char *names[] = { "a.txt", "b.txt", "a.txt" };
+    WriteTestZlibFile( TEST_ZLIB_PATH );
+    if ( !WriteTestWad( TEST_WAD_PATH, names, plArrayElements( names ) ) ) {
+	    printf( "Failed to write test package!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    PLPackage *wad = PlLoadPackage( TEST_WAD_PATH );
+    if ( wad == NULL || !PlWritePackage( wad, TEST_PACK_PATH, PL_COMPRESSION_NONE ) ) {
+	    printf( "Failed to repack test package! (%s)\n", PlGetError() );
+	    PlDestroyPackage( wad );
+	    return TEST_RETURN_FAILURE;
+    }
+    PlDestroyPackage( wad );
+    PLPackage *package = PlLoadPackage( TEST_PACK_PATH );
+    if ( package == NULL || PlGetPackageTableSize( package ) != 3 ) {
+	    printf( "Failed to load repacked package! (%s)\n", PlGetError() );
+	    PlDestroyPackage( package );
+	    return TEST_RETURN_FAILURE;
+    }
+    /* the first of any duplicates should be found */
+    if ( PlGetPackageTableIndex( package, "a.txt" ) != 0 || PlGetPackageTableIndex( package, "b.txt" ) != 1 ||
+         PlGetPackageTableIndex( package, "c.txt" ) != -1 ) {
+	    printf( "Unexpected result looking up repacked files!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    /* can't be written over itself while it's being read from */
+    if ( PlWritePackage( package, TEST_PACK_PATH, PL_COMPRESSION_NONE ) || PlFileExists( "local://" TEST_PACK_PATH ".tmp" ) ) {
+	    printf( "Package was written over its own source!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PLFile *file = PlLoadPackageFile( package, "b.txt" );
+    if ( file == NULL || PlGetFileSize( file ) != 4 || *( const uint32_t * ) PlGetFileData( file ) != 1 ||
+         package->table[ 1 ].offset % 4096 != 0 ) {
+	    printf( "Unexpected data in repacked file!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( file );
+    PlDestroyPackage( package );
+    /* and now with compression */
+    PLPackage *zlib = PlLoadPackage( TEST_ZLIB_PATH );
+    if ( zlib == NULL || !PlWritePackage( zlib, TEST_PACK_PATH, PL_COMPRESSION_ZLIB ) ) {
+	    printf( "Failed to repack compressed package! (%s)\n", PlGetError() );
+	    PlDestroyPackage( zlib );
+	    return TEST_RETURN_FAILURE;
+    }
+    PlDestroyPackage( zlib );
+    package = PlLoadPackage( TEST_PACK_PATH );
+    file = ( package != NULL ) ? PlLoadPackageFile( package, "BIG.bin" ) : NULL;
+    if ( file != NULL || ( package != NULL && package->table[ 0 ].compressionType != PL_COMPRESSION_ZLIB ) ) {
+	    printf( "Unexpected compressed entry!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    if ( package != NULL ) {
+	    PlSetPackageCaseInsensitive( package, true );
+	    file = PlLoadPackageFile( package, "BIG.bin" );
+    }
+    if ( file == NULL || PlGetFileSize( file ) != TEST_ZLIB_SIZE || !CheckTestZlibData( PlGetFileData( file ), 0, TEST_ZLIB_SIZE ) ) {
+	    printf( "Compressed entry doesn't match!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( file );
+    PlDestroyPackage( package );
+    PlDeleteFile( TEST_PACK_PATH );
+    PlDeleteFile( TEST_WAD_PATH );
+    PlDeleteFile( TEST_ZLIB_PATH );
+    return ret;
+FUNC_TEST_END()
+
+FUNC_TEST( StatPackagedFile )
+    const char *names[] = { "s.txt" };
+    if ( !WriteTestWad( TEST_WAD_PATH, names, plArrayElements( names ) ) ) {
+	    printf( "Failed to write test package!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    /* not a valid stream, so stat can only get by if it sticks to the table */
+    static uint8_t junk[ 1000 ];
+    memset( junk, 0xAA, sizeof( junk ) );
+    PlWriteFile( TEST_ZLIB_PATH, junk, sizeof( junk ) );
+    PLFileSystemMount *wadMount = PlMountLocation( "local://" TEST_WAD_PATH );
+    PLFileSystemMount *zlibMount = PlMountLocation( "local://" TEST_ZLIB_PATH );
+    if ( wadMount == NULL || zlibMount == NULL ) {
+	    printf( "Failed to mount test packages!\n" );
+	    PlClearMountedLocation( wadMount );
+	    PlClearMountedLocation( zlibMount );
+	    return TEST_RETURN_FAILURE;
+    }
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    PLFileInfo info;
+    if ( !PlStatFile( "s.txt", &info ) || !info.isPackaged || info.size != 4 || info.compressedSize != 0 ||
+         info.mount != wadMount || info.timeStamp != PlGetLocalFileTimeStamp( TEST_WAD_PATH ) ) {
+	    printf( "Unexpected stat for stored entry!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    if ( !PlStatFile( "big.bin", &info ) || !info.isPackaged || info.size != TEST_ZLIB_SIZE ||
+         info.compressedSize != sizeof( junk ) || info.mount != zlibMount ||
+         info.timeStamp != PlGetLocalFileTimeStamp( TEST_ZLIB_PATH ) ) {
+	    printf( "Unexpected stat for compressed entry!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PLFile *file = PlOpenFile( "big.bin", true );
+    if ( file != NULL ) {
+	    printf( "Opened an entry that can't be inflated!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( file );
+    if ( !PlFileExists( "s.txt" ) || !PlFileExists( "big.bin" ) || PlFileExists( "t.txt" ) ) {
+	    printf( "Unexpected result checking packaged files exist!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlClearMountedLocation( zlibMount );
+    PlClearMountedLocation( wadMount );
+    PlDeleteFile( TEST_ZLIB_PATH );
+    PlDeleteFile( TEST_WAD_PATH );
+    return ret;
+FUNC_TEST_END()
+
+FUNC_TEST( CopyFile )
+    /* larger than a single chunk */
+    size_t size = 3 * 1024 * 1024 + 17;
+    uint8_t *buf = pl_malloc( size );
+    for ( size_t i = 0; i < size; ++i ) {
+	    buf[ i ] = GetTestZlibByte( i );
+    }
+    PlWriteFile( "pl_test_copy.bin", buf, size );
+    pl_free( buf );
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    PLFile *file = NULL;
+    if ( !PlCopyFile( "local://pl_test_copy.bin", "pl_test_copy2.bin" ) ||
+         ( file = PlOpenFile( "local://pl_test_copy2.bin", true ) ) == NULL ||
+         PlGetFileSize( file ) != size || !CheckTestZlibData( PlGetFileData( file ), 0, size ) ) {
+	    printf( "Local copy doesn't match!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( file );
+    /* and out of a package, which is streamed */
+    WriteTestZlibFile( TEST_ZLIB_PATH );
+    PLFileSystemMount *mount = PlMountLocation( "local://" TEST_ZLIB_PATH );
+    file = NULL;
+    if ( mount == NULL || !PlCopyFile( "big.bin", "pl_test_copy2.bin" ) ||
+         ( file = PlOpenFile( "local://pl_test_copy2.bin", true ) ) == NULL ||
+         PlGetFileSize( file ) != TEST_ZLIB_SIZE || !CheckTestZlibData( PlGetFileData( file ), 0, TEST_ZLIB_SIZE ) ) {
+	    printf( "Copy from package doesn't match!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( file );
+    if ( mount != NULL ) {
+	    PlClearMountedLocation( mount );
+    }
+    PlDeleteFile( TEST_ZLIB_PATH );
+    PlDeleteFile( "pl_test_copy.bin" );
+    PlDeleteFile( "pl_test_copy2.bin" );
+    return ret;
+FUNC_TEST_END()
+
+static void CountWatchEvent( const char *path, PLWatchEvent event, bool isDirectory, void *userData ) {
+	PlUnused( isDirectory );
+	if ( event == PL_WATCH_CREATED && strcmp( path, "pl_test_watch/sub/new.txt" ) == 0 ) {
+		( *( unsigned int * ) userData )++;
+	}
+}
+
+FUNC_TEST( WatchPath )
+    PlCreatePath( "pl_test_watch" );
+    unsigned int numCreated = 0;
+    PLFileWatch *watch = PlWatchPath( "pl_test_watch", CountWatchEvent, &numCreated );
+    PLFileSystemMount *mount = PlMountLocation( "local://pl_test_watch" );
+    if ( watch == NULL || mount == NULL ) {
+	    printf( "Failed to watch test directory! (%s)\n", PlGetError() );
+	    PlUnwatchPath( watch );
+	    return TEST_RETURN_FAILURE;
+    }
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    /* the directory's picked up first, so it then needs watching too */
+    PlCreatePath( "pl_test_watch/sub" );
+    PlPollWatchedPaths();
+    PlWriteFile( "pl_test_watch/sub/new.txt", ( const uint8_t * ) testFileData, 1 );
+    PlPollWatchedPaths();
+    unsigned int numFiles = 0;
+    PlScanDirectory( "sub", NULL, CountScannedFile, false, &numFiles );
+    if ( numCreated != 1 || numFiles != 1 ) {
+	    printf( "New file wasn't picked up (%u events, %u files)!\n", numCreated, numFiles );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDeleteFile( "pl_test_watch/sub/new.txt" );
+    PlPollWatchedPaths();
+    numFiles = 0;
+    PlScanDirectory( "sub", NULL, CountScannedFile, false, &numFiles );
+    if ( numFiles != 0 ) {
+	    printf( "Deleted file is still indexed!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    /* moved directories keep their watch, which has to follow them */
+    PlCreatePath( "pl_test_watch/d" );
+    PlPollWatchedPaths();
+    rename( "pl_test_watch/d", "pl_test_watch/e" );
+    PlPollWatchedPaths();
+    FILE *fp = fopen( "pl_test_watch/e/z.txt", "wb" );
+    if ( fp != NULL ) {
+	    fclose( fp );
+    }
+    PlPollWatchedPaths();
+    if ( !PlFileExists( "e/z.txt" ) || PlFileExists( "d/z.txt" ) ) {
+	    printf( "File in renamed directory wasn't picked up!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    if ( !PlPathExists( "e" ) || PlPathExists( "d" ) || !PlPathExists( "sub" ) ) {
+	    printf( "Renamed directory wasn't picked up!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDeleteFile( "pl_test_watch/e/z.txt" );
+    PlPollWatchedPaths();
+    if ( PlFileExists( "e/z.txt" ) ) {
+	    printf( "File deleted from renamed directory is still indexed!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    /* packages are reloaded when their archive changes */
+    const char *names[] = { "old.txt" };
+    PLFileSystemMount *packageMount = NULL;
+    if ( WriteTestWad( "pl_test_watch/pl_test.wad", names, plArrayElements( names ) ) ) {
+	    packageMount = PlMountLocation( "local://pl_test_watch/pl_test.wad" );
+    }
+    PlPollWatchedPaths();
+    names[ 0 ] = "new.txt";
+    WriteTestWad( "pl_test_watch/pl_test.wad", names, plArrayElements( names ) );
+    PlPollWatchedPaths();
+    if ( packageMount == NULL || PlFileExists( "old.txt" ) || !PlFileExists( "new.txt" ) ) {
+	    printf( "Changed package wasn't reloaded!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    if ( packageMount != NULL ) {
+	    PlClearMountedLocation( packageMount );
+    }
+    PlDeleteFile( "pl_test_watch/pl_test.wad" );
+    PlClearMountedLocation( mount );
+    PlUnwatchPath( watch );
+    return ret;
+FUNC_TEST_END()
+
+FUNC_TEST( MissCache )
+    PlCreatePath( "pl_test_miss" );
+    PLFileSystemMount *mount = PlMountLocation( "local://pl_test_miss" );
+    if ( mount == NULL ) {
+	    printf( "Failed to mount test directory!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    /* off by default, so anything written behind our back is found once the watch is polled */
+    if ( PlFileExists( "c.txt" ) ) {
+	    printf( "Found file that doesn't exist!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    FILE *fp = fopen( "pl_test_miss/c.txt", "wb" );
+    if ( fp != NULL ) {
+	    fclose( fp );
+    }
+    PlPollWatchedPaths();
+    if ( !PlFileExists( "c.txt" ) ) {
+	    printf( "Miss was cached by default!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlSetConsoleVariableByName( "fs.missCacheSize", "1024" );
+    if ( PlFileExists( "a.txt" ) || PlFileExists( "a.txt" ) ) {
+	    printf( "Found file that doesn't exist!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    /* written behind our back, so it's not known until the watch is polled */
+    fp = fopen( "pl_test_miss/a.txt", "wb" );
+    if ( fp != NULL ) {
+	    fclose( fp );
+    }
+    if ( PlFileExists( "a.txt" ) ) {
+	    printf( "Miss wasn't cached!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlPollWatchedPaths();
+    if ( !PlFileExists( "a.txt" ) ) {
+	    printf( "Cached miss wasn't flushed by the watch!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlFileExists( "b.txt" );
+    PlWriteFile( "pl_test_miss/b.txt", ( const uint8_t * ) testFileData, 1 );
+    PLFile *file = PlOpenFile( "b.txt", false );
+    if ( file == NULL ) {
+	    printf( "Cached miss wasn't flushed by writing the file!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( file );
+    PlSetConsoleVariableByName( "fs.missCacheSize", "0" );
+    PlClearMountedLocation( mount );
+    PlDeleteFile( "pl_test_miss/a.txt" );
+    PlDeleteFile( "pl_test_miss/b.txt" );
+    PlDeleteFile( "pl_test_miss/c.txt" );
+    return ret;
+FUNC_TEST_END()
+
+FUNC_TEST( MountOrder )
+    /* unwatched, so what's created in the first after it's mounted isn't indexed */
+    PlSetConsoleVariableByName( "fs.watchMounts", "0" );
+    PlCreatePath( "pl_test_order_a" );
+    PlCreatePath( "pl_test_order_b" );
+    PlWriteFile( "pl_test_order_b/x.txt", ( const uint8_t * ) testFileData, 1 );
+    PLFileSystemMount *first = PlMountLocation( "local://pl_test_order_a" );
+    PLFileSystemMount *second = PlMountLocation( "local://pl_test_order_b" );
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    FILE *fp = fopen( "pl_test_order_a/x.txt", "wb" );
+    if ( fp != NULL ) {
+	    fwrite( testFileData, 2, 1, fp );
+	    fclose( fp );
+    }
+    PLFileInfo info;
+    PLFile *file = PlOpenFile( "x.txt", false );
+    if ( first == NULL || second == NULL || file == NULL || PlGetFileSize( file ) != 2 ||
+         !PlStatFile( "x.txt", &info ) || info.mount != first ) {
+	    printf( "Later mount was searched first!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( file );
+    /* directories in it are checked on disk too */
+    PlCreatePath( "pl_test_order_a/y" );
+    if ( !PlPathExists( "y" ) ) {
+	    printf( "Directory created in unwatched mount wasn't found!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    if ( second != NULL ) {
+	    PlClearMountedLocation( second );
+    }
+    if ( first != NULL ) {
+	    PlClearMountedLocation( first );
+    }
+    PlSetConsoleVariableByName( "fs.watchMounts", "1" );
+    PlDeleteFile( "pl_test_order_a/x.txt" );
+    PlDeleteFile( "pl_test_order_b/x.txt" );
+    return ret;
+FUNC_TEST_END()
+
+static bool CheckTestWadEntry( PLFile *file, uint32_t index ) {
+	uint32_t value;
+	return ( file != NULL && PlReadFile( file, &value, sizeof( value ), 1 ) == 1 && value == index );
+}
+
+FUNC_TEST( OpenFiles )
+    const char *names[] = { "a.txt", "b.txt", "c.txt" };
+    if ( !WriteTestWad( TEST_WAD_PATH, names, plArrayElements( names ) ) ) {
+	    printf( "Failed to write test package!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    PLFileSystemMount *mount = PlMountLocation( "local://" TEST_WAD_PATH );
+    if ( mount == NULL ) {
+	    printf( "Failed to mount test package!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    const char *paths[] = { "c.txt", "missing.txt", "a.txt", "b.txt" };
+    PLFile *files[ plArrayElements( paths ) ];
+    if ( PlOpenFiles( paths, plArrayElements( paths ), true, files ) != 3 || files[ 1 ] != NULL ||
+         !CheckTestWadEntry( files[ 0 ], 2 ) || !CheckTestWadEntry( files[ 2 ], 0 ) || !CheckTestWadEntry( files[ 3 ], 1 ) ) {
+	    printf( "Unexpected files from batched open!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    for ( unsigned int i = 0; i < plArrayElements( files ); ++i ) {
+	    PlCloseFile( files[ i ] );
+    }
+    PlClearMountedLocation( mount );
+    /* read through a regular handle rather than a mapping, so the entries are read together */
+    PLPackage *package = PlLoadPackage( TEST_WAD_PATH );
+    if ( package != NULL ) {
+	    PlCloseFile( package->internal.file );
+	    package->internal.file = PlOpenFile( TEST_WAD_PATH, false );
+	    unsigned int indices[] = { 2, 0, 1 };
+	    if ( PlOpenPackageFilesByIndex( package, indices, plArrayElements( indices ), true, files ) != 3 ||
+	         !CheckTestWadEntry( files[ 0 ], 2 ) || !CheckTestWadEntry( files[ 1 ], 0 ) || !CheckTestWadEntry( files[ 2 ], 1 ) ) {
+		    printf( "Unexpected files from batched package read!\n" );
+		    ret = TEST_RETURN_FAILURE;
+	    }
+	    for ( unsigned int i = 0; i < plArrayElements( indices ); ++i ) {
+		    PlCloseFile( files[ i ] );
+	    }
+	    PlDestroyPackage( package );
+    }
+    PlDeleteFile( TEST_WAD_PATH );
+    return ret;
+FUNC_TEST_END()
+
+#define TEST_TRACE_PATH "pl_test.trace"
+
+FUNC_TEST( AccessTrace )
+    const char *names[] = { "a.txt", "b.txt", "c.txt" };
+    if ( !WriteTestWad( TEST_WAD_PATH, names, plArrayElements( names ) ) ) {
+	    printf( "Failed to write test package!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    PLFileSystemMount *mount = PlMountLocation( "local://" TEST_WAD_PATH );
+    if ( mount == NULL || !PlStartAccessTrace( TEST_TRACE_PATH ) ) {
+	    printf( "Failed to start trace! (%s)\n", PlGetError() );
+	    return TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( PlOpenFile( "c.txt", false ) );
+    PlCloseFile( PlOpenFile( "a.txt", false ) );
+    PlStopAccessTrace();
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    unsigned int numLines = 0;
+    char line[ 512 ];
+    PLFile *trace = PlOpenLocalFile( TEST_TRACE_PATH, true );
+    while ( trace != NULL && PlReadString( trace, line, sizeof( line ) ) != NULL ) {
+	    if ( line[ 0 ] == '#' ) {
+		    continue;
+	    }
+	    /* c.txt is the third entry, so it's at 12 + 2 * 4 */
+	    if ( ( numLines == 0 && ( strstr( line, TEST_WAD_PATH "\t20\t4\tc.txt" ) == NULL ) ) ||
+	         ( numLines == 1 && ( strstr( line, "\ta.txt" ) == NULL ) ) ) {
+		    printf( "Unexpected line in trace: %s", line );
+		    ret = TEST_RETURN_FAILURE;
+	    }
+	    numLines++;
+    }
+    PlCloseFile( trace );
+    if ( numLines != 2 ) {
+	    printf( "Unexpected number of opens in trace (%u)!\n", numLines );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    if ( !PlReplayAccessTrace( TEST_TRACE_PATH ) ) {
+	    printf( "Failed to replay trace! (%s)\n", PlGetError() );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlWaitAccessTraceReplay();
+    PlClearMountedLocation( mount );
+    PlDeleteFile( TEST_TRACE_PATH );
+    PlDeleteFile( TEST_WAD_PATH );
+    return ret;
+FUNC_TEST_END()
+
+#define TEST_LARGE_WAD_LUMPS 50000
+
+FUNC_TEST( LargePackage )
+    /* every lump shares the same four bytes of data */
+    uint32_t tableOffset = 16;
+    size_t size = tableOffset + TEST_LARGE_WAD_LUMPS * 16;
+    uint8_t *buf = pl_calloc( size, 1 );
+    uint32_t numLumps = TEST_LARGE_WAD_LUMPS;
+    memcpy( buf, "IWAD", 4 );
+    memcpy( &buf[ 4 ], &numLumps, 4 );
+    memcpy( &buf[ 8 ], &tableOffset, 4 );
+    for ( unsigned int i = 0; i < numLumps; ++i ) {
+	    uint32_t offset = 12, lumpSize = 4;
+	    uint8_t *index = &buf[ tableOffset + i * 16 ];
+	    memcpy( index, &offset, 4 );
+	    memcpy( index + 4, &lumpSize, 4 );
+	    char name[ 16 ];
+	    snprintf( name, sizeof( name ), "L%05u", i );
+	    memcpy( index + 8, name, strlen( name ) );
+    }
+    bool status = PlWriteFile( TEST_WAD_PATH, buf, size );
+    /* and again, with the table cut short */
+    status = status && PlWriteFile( "pl_test_cut.wad", buf, size - 8 );
+    pl_free( buf );
+    if ( !status ) {
+	    printf( "Failed to write test package!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    PlRegisterStandardPackageLoaders();
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    PLPackage *package = PlLoadPackage( TEST_WAD_PATH );
+    if ( package == NULL || PlGetPackageTableSize( package ) != TEST_LARGE_WAD_LUMPS ) {
+	    printf( "Failed to load large package! (%s)\n", PlGetError() );
+	    ret = TEST_RETURN_FAILURE;
+    } else if ( strcmp( PlGetPackageFileName( package, TEST_LARGE_WAD_LUMPS - 1 ), "L49999" ) != 0 ) {
+	    printf( "Last name didn't match (%s)!\n", PlGetPackageFileName( package, TEST_LARGE_WAD_LUMPS - 1 ) );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDestroyPackage( package );
+    package = PlLoadPackage( "pl_test_cut.wad" );
+    if ( package != NULL ) {
+	    printf( "Unexpected success loading truncated package!\n" );
+	    PlDestroyPackage( package );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDeleteFile( TEST_WAD_PATH );
+    PlDeleteFile( "pl_test_cut.wad" );
+    return ret;
+FUNC_TEST_END()
+
+FUNC_TEST( SignatureDispatch )
+    /* neither of these have an extension anyone registered for */
+    const char *names[] = { "a.txt" };
+    if ( !WriteTestWad( "pl_test_wad.dat", names, plArrayElements( names ) ) ) {
+	    printf( "Failed to write test package!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    PLImage *image = PlCreateImage( NULL, 4, 4, PL_COLOURFORMAT_RGBA, PL_IMAGEFORMAT_RGBA8 );
+    if ( image == NULL || !PlWriteImage( image, "pl_test_img.png" ) || !PlCopyFile( "pl_test_img.png", "pl_test_img" ) ) {
+	    printf( "Failed to write test image!\n" );
+	    PlDestroyImage( image );
+	    return TEST_RETURN_FAILURE;
+    }
+    PlDestroyImage( image );
+    PlRegisterStandardPackageLoaders();
+    PlRegisterStandardImageLoaders( PL_IMAGE_FILEFORMAT_ALL );
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    PLPackage *package = PlLoadPackage( "pl_test_wad.dat" );
+    if ( package == NULL || PlGetPackageTableSize( package ) != 1 ) {
+	    printf( "Failed to load package by signature! (%s)\n", PlGetError() );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDestroyPackage( package );
+    image = PlLoadImage( "pl_test_img" );
+    if ( image == NULL || image->width != 4 ) {
+	    printf( "Failed to load image by signature! (%s)\n", PlGetError() );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDestroyImage( image );
+    /* named like a package, but isn't one */
+    PlCopyFile( "pl_test_img.png", "pl_test_img.wad" );
+    package = PlLoadPackage( "pl_test_img.wad" );
+    if ( package != NULL ) {
+	    printf( "Unexpected success loading mismatched package!\n" );
+	    PlDestroyPackage( package );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDeleteFile( "pl_test_wad.dat" );
+    PlDeleteFile( "pl_test_img.png" );
+    PlDeleteFile( "pl_test_img.wad" );
+    PlDeleteFile( "pl_test_img" );
+    return ret;
+FUNC_TEST_END()
+
+FUNC_TEST( Crc32 )
+    uint32_t crc = 0;
+    pl_crc32( "123456789", 9, &crc );
+    if ( crc != 0xCBF43926 ) {
+	    printf( "Unexpected checksum (%08X)!\n", crc );
+	    return TEST_RETURN_FAILURE;
+    }
+    /* larger buffers take a different path, so check them against a plain bytewise crc */
+    uint8_t buf[ 4096 ];
+    for ( unsigned int i = 0; i < sizeof( buf ); ++i ) {
+	    buf[ i ] = ( uint8_t ) ( i * 7 + ( i >> 5 ) );
+    }
+    for ( unsigned int length = 0; length < 1024; length += 13 ) {
+	    uint32_t expected = 0xFFFFFFFF;
+	    for ( unsigned int i = 0; i < length; ++i ) {
+		    expected ^= buf[ 3 + i ];
+		    for ( unsigned int j = 0; j < 8; ++j ) {
+			    expected = ( expected >> 1 ) ^ ( 0xEDB88320 & -( expected & 1 ) );
+		    }
+	    }
+	    expected = ~expected;
+	    /* and in two halves, which should give the same result */
+	    crc = 0;
+	    pl_crc32( &buf[ 3 ], length / 2, &crc );
+	    pl_crc32( &buf[ 3 + length / 2 ], length - length / 2, &crc );
+	    if ( crc != expected ) {
+		    printf( "Unexpected checksum for %u bytes (%08X, expected %08X)!\n", length, crc, expected );
+		    return TEST_RETURN_FAILURE;
+	    }
+    }
+    return TEST_RETURN_SUCCESS;
+FUNC_TEST_END()
+
+FUNC_TEST( VerifyPackage )
+    const char *names[] = { "a.txt", "b.txt", "c.txt" };
+    if ( !WriteTestWad( TEST_WAD_PATH, names, plArrayElements( names ) ) ) {
+	    printf( "Failed to write test package!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    PlRegisterStandardPackageLoaders();
+    PLPackage *wad = PlLoadPackage( TEST_WAD_PATH );
+    if ( wad == NULL || !PlWritePackage( wad, TEST_PACK_PATH, PL_COMPRESSION_NONE ) ) {
+	    printf( "Failed to repack test package! (%s)\n", PlGetError() );
+	    PlDestroyPackage( wad );
+	    return TEST_RETURN_FAILURE;
+    }
+    PlDestroyPackage( wad );
+    PlDeleteFile( TEST_WAD_PATH );
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    PLPackage *package = PlLoadPackage( TEST_PACK_PATH );
+    unsigned int numChecked = 0;
+    if ( package == NULL || PlVerifyPackage( package, NULL, &numChecked ) != 0 || numChecked != 3 ) {
+	    printf( "Failed to verify package (%u checked)! (%s)\n", numChecked, PlGetError() );
+	    PlDestroyPackage( package );
+	    PlDeleteFile( TEST_PACK_PATH );
+	    return TEST_RETURN_FAILURE;
+    }
+    /* flip a byte in b.txt */
+    size_t offset = package->table[ 1 ].offset;
+    PlDestroyPackage( package );
+    PLFile *file = PlOpenLocalFile( TEST_PACK_PATH, true );
+    size_t size = PlGetFileSize( file );
+    uint8_t *data = pl_malloc( size );
+    memcpy( data, PlGetFileData( file ), size );
+    PlCloseFile( file );
+    data[ offset ] ^= 0xFF;
+    PlWriteFile( TEST_PACK_PATH, data, size );
+    pl_free( data );
+    package = PlLoadPackage( TEST_PACK_PATH );
+    bool failed[ 3 ] = { false, false, false };
+    if ( package == NULL || PlVerifyPackage( package, failed, NULL ) != 1 || failed[ 0 ] || !failed[ 1 ] || failed[ 2 ] ) {
+	    printf( "Corrupted entry wasn't caught!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    /* and when loading, if asked */
+    PlSetConsoleVariableByName( "fs.verifyPackages", "1" );
+    file = ( package != NULL ) ? PlLoadPackageFile( package, "b.txt" ) : NULL;
+    if ( file != NULL ) {
+	    printf( "Unexpected success loading corrupted entry!\n" );
+	    PlCloseFile( file );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    file = ( package != NULL ) ? PlLoadPackageFile( package, "c.txt" ) : NULL;
+    if ( file == NULL ) {
+	    printf( "Failed to load intact entry! (%s)\n", PlGetError() );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( file );
+    PlSetConsoleVariableByName( "fs.verifyPackages", "0" );
+    PlDestroyPackage( package );
+    PlDeleteFile( TEST_PACK_PATH );
+    return ret;
+FUNC_TEST_END()
+
+#define TEST_EXTRACT_PATH "pl_test_extract"
+
+static bool CountExtractProgress( unsigned int numExtracted, unsigned int numFiles, uint64_t numBytes, void *userData ) {
+	PlUnused( numFiles );
+	PlUnused( numBytes );
+	*( unsigned int * ) userData = numExtracted;
+	return true;
+}
+
+static bool CheckExtractedFile( const char *path, uint32_t expected ) {
+	PLFile *file = PlOpenLocalFile( path, false );
+	if ( file == NULL ) {
+		return false;
+	}
+	bool status = false;
+	uint32_t value = PlReadInt32( file, false, &status );
+	PlCloseFile( file );
+	PlDeleteFile( path );
+	return ( status && value == expected );
+}
+
+FUNC_TEST( ExtractPackage )
+    /* the later d/a.txt should win, and ../x.txt shouldn't go anywhere */
+    const char *names[] = { "d/a.txt", "b.txt", "d/a.txt", "../x.txt", "d/e/c.t" };
+    if ( !WriteTestWad( TEST_WAD_PATH, names, plArrayElements( names ) ) ) {
+	    printf( "Failed to write test package!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    PlRegisterStandardPackageLoaders();
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    PLPackage *wad = PlLoadPackage( TEST_WAD_PATH );
+    if ( wad == NULL || !PlWritePackage( wad, TEST_PACK_PATH, PL_COMPRESSION_ZLIB ) ) {
+	    printf( "Failed to repack test package! (%s)\n", PlGetError() );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDestroyPackage( wad );
+    /* both as stored, and compressed */
+    const char *paths[] = { TEST_WAD_PATH, TEST_PACK_PATH };
+    for ( unsigned int i = 0; i < plArrayElements( paths ) && ret == TEST_RETURN_SUCCESS; ++i ) {
+	    PLPackage *package = PlLoadPackage( paths[ i ] );
+	    unsigned int numExtracted = 0;
+	    unsigned int numFailed = ( package != NULL ) ? PlExtractPackage( package, TEST_EXTRACT_PATH, CountExtractProgress, &numExtracted ) : 0;
+	    if ( package == NULL || numFailed != 1 || numExtracted != 3 ) {
+		    printf( "Unexpected result extracting %s (%u failed, %u extracted)!\n", paths[ i ], numFailed, numExtracted );
+		    ret = TEST_RETURN_FAILURE;
+	    }
+	    PlDestroyPackage( package );
+	    if ( !CheckExtractedFile( TEST_EXTRACT_PATH "/d/a.txt", 2 ) ||
+	         !CheckExtractedFile( TEST_EXTRACT_PATH "/b.txt", 1 ) ||
+	         !CheckExtractedFile( TEST_EXTRACT_PATH "/d/e/c.t", 4 ) ||
+	         PlLocalFileExists( "x.txt" ) ) {
+		    printf( "Extracted files from %s didn't match!\n", paths[ i ] );
+		    ret = TEST_RETURN_FAILURE;
+	    }
+    }
+    PlDeleteFile( TEST_WAD_PATH );
+    PlDeleteFile( TEST_PACK_PATH );
+    return ret;
+FUNC_TEST_END()
+
+#define TEST_INDEX_CACHE_PATH "pl_test_index_cache"
+
+static void CountScannedIndexCache( const char *path, void *userData ) {
+	PlUnused( path );
+	( *( unsigned int * ) userData )++;
+}
+
+static void DeleteScannedIndexCache( const char *path, void *userData ) {
+	PlUnused( userData );
+	PlDeleteFile( path );
+}
+
+FUNC_TEST( PackageIndexCache )
+    const char *names[] = { "a.txt", "b.txt", "c.txt" };
+    if ( !WriteTestWad( TEST_WAD_PATH, names, plArrayElements( names ) ) ) {
+	    printf( "Failed to write test package!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    PlRegisterStandardPackageLoaders();
+    PlSetConsoleVariableByName( "fs.packageIndexCache", TEST_INDEX_CACHE_PATH );
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    /* first time round the table is parsed and written out */
+    PLPackage *package = PlLoadPackage( TEST_WAD_PATH );
+    unsigned int numCached = 0;
+    PlScanDirectory( TEST_INDEX_CACHE_PATH, "pidx", CountScannedIndexCache, false, &numCached );
+    if ( package == NULL || package->internal.indexCache != NULL || numCached != 1 ) {
+	    printf( "Package table wasn't cached (%u cached)! (%s)\n", numCached, PlGetError() );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDestroyPackage( package );
+    /* and then used from there */
+    package = PlLoadPackage( TEST_WAD_PATH );
+    if ( package == NULL || package->internal.indexCache == NULL || PlGetPackageTableSize( package ) != 3 ||
+         strcmp( PlGetPackageFileName( package, 2 ), "c.txt" ) != 0 || PlGetPackageTableIndex( package, "b.txt" ) != 1 ) {
+	    printf( "Cached package table didn't match!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PLFile *file = ( package != NULL ) ? PlLoadPackageFile( package, "B.TXT" ) : NULL;
+    if ( file != NULL ) {
+	    printf( "Unexpected case-insensitive match in cached package!\n" );
+	    PlCloseFile( file );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    if ( package != NULL ) {
+	    PlSetPackageCaseInsensitive( package, true );
+    }
+    file = ( package != NULL ) ? PlLoadPackageFile( package, "B.TXT" ) : NULL;
+    bool status = false;
+    if ( file == NULL || PlReadInt32( file, false, &status ) != 1 || !status ) {
+	    printf( "Failed to load file from cached package! (%s)\n", PlGetError() );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( file );
+    /* renaming copies the table out of the cache */
+    if ( package != NULL && ( !PlSetPackageFileName( package, 0, "d.txt", 5 ) || package->internal.indexCache != NULL ||
+                              PlGetPackageTableIndex( package, "d.txt" ) != 0 ) ) {
+	    printf( "Failed to rename file in cached package!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDestroyPackage( package );
+    /* anything cached goes stale once the package changes */
+    const char *newNames[] = { "x.txt", "y.txt" };
+    WriteTestWad( TEST_WAD_PATH, newNames, plArrayElements( newNames ) );
+    package = PlLoadPackage( TEST_WAD_PATH );
+    if ( package == NULL || package->internal.indexCache != NULL || PlGetPackageTableSize( package ) != 2 ||
+         strcmp( PlGetPackageFileName( package, 0 ), "x.txt" ) != 0 ) {
+	    printf( "Stale package table was used!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDestroyPackage( package );
+    PlSetConsoleVariableByName( "fs.packageIndexCache", "" );
+    package = PlLoadPackage( TEST_WAD_PATH );
+    if ( package == NULL || package->internal.indexCache != NULL ) {
+	    printf( "Package table was cached while disabled!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDestroyPackage( package );
+    PlDeleteFile( TEST_WAD_PATH );
+    PlScanDirectory( TEST_INDEX_CACHE_PATH, "pidx", DeleteScannedIndexCache, false, NULL );
+    remove( TEST_INDEX_CACHE_PATH );
+    return ret;
+FUNC_TEST_END()
+
+/* wraps the given data up as the only lump in a wad */
+static uint8_t *CreateTestWadBuffer( const char *name, const uint8_t *data, uint32_t size, size_t *outSize ) {
+	uint32_t numLumps = 1, tableOffset = 12 + size;
+	*outSize = tableOffset + 16;
+	uint8_t *buf = pl_calloc( 1, *outSize );
+	memcpy( buf, "PWAD", 4 );
+	memcpy( &buf[ 4 ], &numLumps, 4 );
+	memcpy( &buf[ 8 ], &tableOffset, 4 );
+	memcpy( &buf[ 12 ], data, size );
+	uint32_t offset = 12;
+	memcpy( &buf[ tableOffset ], &offset, 4 );
+	memcpy( &buf[ tableOffset + 4 ], &size, 4 );
+	memcpy( &buf[ tableOffset + 8 ], name, strlen( name ) );
+	return buf;
+}
+
+static bool CheckMountedTestFile( const char *path, int32_t expected ) {
+	PLFile *file = PlOpenFile( path, false );
+	bool status = false;
+	int32_t value = ( file != NULL ) ? PlReadInt32( file, false, &status ) : -1;
+	PlCloseFile( file );
+	return ( status && value == expected );
+}
+
+FUNC_TEST( MemoryFile )
+    const char *names[] = { "a.txt", "b.txt" };
+    if ( !WriteTestWad( TEST_WAD_PATH, names, plArrayElements( names ) ) ) {
+	    printf( "Failed to write test package!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    PLFile *local = PlOpenLocalFile( TEST_WAD_PATH, true );
+    size_t innerSize = PlGetFileSize( local );
+    size_t outerSize;
+    uint8_t *outer = CreateTestWadBuffer( "in.wad", PlGetFileData( local ), ( uint32_t ) innerSize, &outerSize );
+    PLFile *innerFile = PlCreateFileFromMemory( "in.wad", ( void * ) PlGetFileData( local ), innerSize, PL_FILE_MEMORY_BORROW );
+    PLFile *outerFile = PlCreateFileFromMemory( "outer.wad", outer, outerSize, PL_FILE_MEMORY_TAKE );
+    if ( innerFile == NULL || outerFile == NULL || strcmp( PlGetFilePath( outerFile ), "mem://outer.wad" ) != 0 ) {
+	    printf( "Failed to create memory files! (%s)\n", PlGetError() );
+	    return TEST_RETURN_FAILURE;
+    }
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    if ( PlCreateFileFromMemory( "in.wad", outer, outerSize, PL_FILE_MEMORY_BORROW ) != NULL || !PlFileExists( "mem://in.wad" ) ) {
+	    printf( "Unexpected result creating memory file twice!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlRegisterStandardPackageLoaders();
+    /* loaded straight from memory */
+    PLPackage *package = PlLoadPackage( PlGetFilePath( innerFile ) );
+    PlCloseFile( innerFile );
+    PLFile *file = ( package != NULL ) ? PlLoadPackageFile( package, "b.txt" ) : NULL;
+    bool status = false;
+    if ( file == NULL || PlReadInt32( file, false, &status ) != 1 || !status || PlFileExists( "mem://in.wad" ) ) {
+	    printf( "Failed to load package from memory! (%s)\n", PlGetError() );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlCloseFile( file );
+    PlDestroyPackage( package );
+    PlCloseFile( local );
+    /* and one package inside another, both as stored and compressed */
+    package = PlLoadPackage( PlGetFilePath( outerFile ) );
+    if ( package == NULL || !PlWritePackage( package, TEST_PACK_PATH, PL_COMPRESSION_ZLIB ) ) {
+	    printf( "Failed to repack package from memory! (%s)\n", PlGetError() );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDestroyPackage( package );
+    const char *outerPaths[] = { PlGetFilePath( outerFile ), "local://" TEST_PACK_PATH };
+    for ( unsigned int i = 0; i < plArrayElements( outerPaths ); ++i ) {
+	    PLFileSystemMount *outerMount = PlMountLocation( outerPaths[ i ] );
+	    PLFileSystemMount *innerMount = PlMountLocation( "in.wad" );
+	    if ( outerMount == NULL || innerMount == NULL || !CheckMountedTestFile( "b.txt", 1 ) ) {
+		    printf( "Failed to mount package nested in %s! (%s)\n", outerPaths[ i ], PlGetError() );
+		    ret = TEST_RETURN_FAILURE;
+	    }
+	    PlClearMountedLocation( innerMount );
+	    PlClearMountedLocation( outerMount );
+    }
+    PlCloseFile( outerFile );
+    if ( PlFileExists( "mem://outer.wad" ) ) {
+	    printf( "Memory file still exists after being closed!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDeleteFile( TEST_PACK_PATH );
+    PlDeleteFile( TEST_WAD_PATH );
+    return ret;
+FUNC_TEST_END()
+
+static void AsyncOpenCallback( PLFileRequest *request, PLFile *file, void *userData ) {
+	*( size_t * ) userData = ( file != NULL ) ? PlGetFileSize( file ) : 0;
+	PlCloseFile( file );
+}
+
+static void AsyncDestroyCallback( PLFileRequest *request, PLFile *file, void *userData ) {
+	PlCloseFile( file );
+	PlDestroyFileRequest( request );
+	*( volatile bool * ) userData = true;
+}
+
+FUNC_TEST( OpenFileAsync )
+    if ( !PlWriteFile( TEST_FILE_PATH, ( const uint8_t * ) testFileData, sizeof( testFileData ) - 1 ) ) {
+	    printf( "Failed to write test file!\n" );
+	    return TEST_RETURN_FAILURE;
+    }
+    uint8_t ret = TEST_RETURN_SUCCESS;
+    PLFileRequest *requests[ 8 ];
+    for ( unsigned int i = 0; i < plArrayElements( requests ); ++i ) {
+	    requests[ i ] = PlOpenFileAsync( TEST_FILE_PATH, ( i % 2 ) == 0, NULL, NULL );
+    }
+    size_t callbackSize = 0;
+    PLFileRequest *callbackRequest = PlOpenFileAsync( TEST_FILE_PATH, true, AsyncOpenCallback, &callbackSize );
+    PLFileRequest *missingRequest = PlOpenFileAsync( "pl_test_missing.bin", true, NULL, NULL );
+    PlWaitFileRequests( requests, plArrayElements( requests ) );
+    for ( unsigned int i = 0; i < plArrayElements( requests ); ++i ) {
+	    if ( requests[ i ] == NULL || !PlIsFileRequestComplete( requests[ i ] ) ) {
+		    printf( "Request %u didn't complete!\n", i );
+		    ret = TEST_RETURN_FAILURE;
+		    continue;
+	    }
+	    PLFile *file = PlWaitFileRequest( requests[ i ] );
+	    char buf[ sizeof( testFileData ) ];
+	    if ( file == NULL || PlReadFile( file, buf, 1, sizeof( buf ) ) != sizeof( testFileData ) - 1 ||
+	         memcmp( buf, testFileData, sizeof( testFileData ) - 1 ) != 0 ) {
+		    printf( "Unexpected contents from request %u!\n", i );
+		    ret = TEST_RETURN_FAILURE;
+	    }
+	    PlCloseFile( file );
+	    PlDestroyFileRequest( requests[ i ] );
+    }
+    if ( PlWaitFileRequest( missingRequest ) != NULL ) {
+	    printf( "Opened a file that doesn't exist!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDestroyFileRequest( missingRequest );
+    PlDestroyFileRequest( callbackRequest );
+    if ( callbackSize != sizeof( testFileData ) - 1 ) {
+	    printf( "Callback wasn't passed the file!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PLFileRequest *cancelledRequest = PlOpenFileAsync( TEST_FILE_PATH, true, NULL, NULL );
+    if ( PlCancelFileRequest( cancelledRequest ) && PlWaitFileRequest( cancelledRequest ) != NULL ) {
+	    printf( "Cancelled request still returned a file!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDestroyFileRequest( cancelledRequest );
+    /* a request can be destroyed by its own callback */
+    volatile bool isDestroyed = false;
+    if ( PlOpenFileAsync( TEST_FILE_PATH, true, AsyncDestroyCallback, ( void * ) &isDestroyed ) != NULL ) {
+	    double timeOut = PlGetCurrentSeconds() + 5.0;
+	    while ( !isDestroyed && PlGetCurrentSeconds() < timeOut ) {}
+    }
+    if ( !isDestroyed ) {
+	    printf( "Request wasn't destroyed by its callback!\n" );
+	    ret = TEST_RETURN_FAILURE;
+    }
+    PlDeleteFile( TEST_FILE_PATH );
+    return ret;
+FUNC_TEST_END()
+
 int main( int argc, char **argv ) {
 	printf( "Starting tests...\n" );
 
+	PlInitialize( argc, argv );
+	PlInitializeSubSystems( PL_SUBSYSTEM_IO );
+
 #define CALL_FUNC_TEST( NAME ) \
     { int ret = test_##NAME(); \
 		if ( ret != TEST_RETURN_SUCCESS ) { printf( "Failed on " #NAME "!\n"); \
@@ -107,5 +1611,34 @@ int main( int argc, char **argv ) {
 	CALL_FUNC_TEST( GetConsoleCommands )
 	CALL_FUNC_TEST( GetConsoleCommand )
 
+	CALL_FUNC_TEST( HashTable )
+
+	CALL_FUNC_TEST( MapLocalFile )
+	CALL_FUNC_TEST( ReadBufferedFile )
+	CALL_FUNC_TEST( ReadArrays )
+	CALL_FUNC_TEST( MountLocation )
+	CALL_FUNC_TEST( ScanDirectory )
+	CALL_FUNC_TEST( PackageDirectories )
+	CALL_FUNC_TEST( PackageFileNames )
+	CALL_FUNC_TEST( PackageIndex )
+	CALL_FUNC_TEST( InflateStream )
+	CALL_FUNC_TEST( PackageCache )
+	CALL_FUNC_TEST( NativePackage )
+	CALL_FUNC_TEST( StatPackagedFile )
+	CALL_FUNC_TEST( CopyFile )
+	CALL_FUNC_TEST( WatchPath )
+	CALL_FUNC_TEST( MissCache )
+	CALL_FUNC_TEST( MountOrder )
+	CALL_FUNC_TEST( OpenFiles )
+	CALL_FUNC_TEST( AccessTrace )
+	CALL_FUNC_TEST( LargePackage )
+	CALL_FUNC_TEST( SignatureDispatch )
+	CALL_FUNC_TEST( Crc32 )
+	CALL_FUNC_TEST( VerifyPackage )
+	CALL_FUNC_TEST( ExtractPackage )
+	CALL_FUNC_TEST( PackageIndexCache )
+	CALL_FUNC_TEST( MemoryFile )
+	CALL_FUNC_TEST( OpenFileAsync )
+
     return EXIT_SUCCESS;
 }